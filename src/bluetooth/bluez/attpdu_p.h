@@ -0,0 +1,149 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef ATTPDU_P_H
+#define ATTPDU_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QByteArrayView>
+#include <QtBluetooth/qbluetooth.h>
+#include <QtBluetooth/qbluetoothuuid.h>
+
+#include "bluez_data_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Non-owning view onto a single ATT PDU.
+
+    The view does not copy the underlying bytes; it merely decodes the fields of the
+    PDU in place. The caller has to ensure that the viewed buffer outlives the view
+    and that the PDU is large enough for the accessed fields. Values which have to
+    outlive the buffer must be copied via toByteArray().
+
+    Field offsets follow Bluetooth Core Spec v4.2, Vol 3, Part F, 3.4.
+ */
+class AttPduView
+{
+public:
+    constexpr AttPduView() noexcept = default;
+    constexpr AttPduView(QByteArrayView pdu) noexcept : m_pdu(pdu) {}
+    AttPduView(const QByteArray &pdu) noexcept : m_pdu(pdu) {}
+
+    constexpr bool isEmpty() const noexcept { return m_pdu.isEmpty(); }
+    constexpr qsizetype size() const noexcept { return m_pdu.size(); }
+    constexpr const char *constData() const noexcept { return m_pdu.data(); }
+    constexpr QByteArrayView bytes() const noexcept { return m_pdu; }
+
+    QBluezConst::AttCommand opcode() const
+    {
+        return static_cast<QBluezConst::AttCommand>(u8(0));
+    }
+
+    quint8 u8(qsizetype offset) const
+    {
+        Q_ASSERT(offset < m_pdu.size());
+        return static_cast<quint8>(m_pdu.at(offset));
+    }
+    quint16 le16(qsizetype offset) const
+    {
+        Q_ASSERT(offset + 2 <= m_pdu.size());
+        return bt_get_le16(m_pdu.data() + offset);
+    }
+    template<typename T> T get(qsizetype offset) const
+    {
+        Q_ASSERT(offset + qsizetype(sizeof(T)) <= m_pdu.size());
+        return getBtData<T>(m_pdu.data() + offset);
+    }
+    // Little endian 16 or 128 bit UUID, depending on size
+    QBluetoothUuid uuid(qsizetype offset, qsizetype size) const
+    {
+        Q_ASSERT(offset + size <= m_pdu.size());
+        if (size == 2)
+            return QBluetoothUuid(bt_get_le16(m_pdu.data() + offset));
+        Q_ASSERT(size == 16);
+        return QUuid::fromBytes(m_pdu.data() + offset, QSysInfo::LittleEndian);
+    }
+    QByteArrayView tail(qsizetype offset) const
+    {
+        return offset < m_pdu.size() ? m_pdu.sliced(offset) : QByteArrayView();
+    }
+
+    // ATT_OP_ERROR_RESPONSE
+    QBluezConst::AttCommand errorRequestOpcode() const
+    {
+        return static_cast<QBluezConst::AttCommand>(u8(1));
+    }
+    QLowEnergyHandle errorHandle() const { return le16(2); }
+    QBluezConst::AttError errorCode() const
+    {
+        return static_cast<QBluezConst::AttError>(u8(4));
+    }
+
+    // ATT_OP_EXCHANGE_MTU_REQUEST/RESPONSE
+    quint16 mtu() const { return le16(1); }
+
+    // Requests with a handle range: find information, find by type value,
+    // read by type and read by group type
+    QLowEnergyHandle startingHandle() const { return le16(1); }
+    QLowEnergyHandle endingHandle() const { return le16(3); }
+    // read by type and read by group type requests; invalid if neither 16 nor 128 bit
+    QBluetoothUuid attributeType() const
+    {
+        const qsizetype typeSize = m_pdu.size() - 5;
+        return (typeSize == 2 || typeSize == 16) ? uuid(5, typeSize) : QBluetoothUuid();
+    }
+    // find by type value request
+    quint16 attributeType16() const { return le16(5); }
+    QByteArrayView findByTypeValue() const { return tail(7); }
+
+    // PDUs starting with a single handle: read, read blob, write request/command,
+    // prepare write, notification and indication
+    QLowEnergyHandle attributeHandle() const { return le16(1); }
+    // read blob and prepare write request/response
+    quint16 valueOffset() const { return le16(3); }
+    // write request/command, notification and indication
+    QByteArrayView handleValue() const { return tail(3); }
+    // prepare write request/response
+    QByteArrayView partValue() const { return tail(5); }
+    // read multiple request
+    qsizetype handleCount() const { return (m_pdu.size() - 1) / qsizetype(sizeof(QLowEnergyHandle)); }
+    QLowEnergyHandle handleAt(qsizetype i) const { return le16(1 + i * sizeof(QLowEnergyHandle)); }
+    // execute write request
+    bool isExecuteWriteCancel() const { return u8(1) == 0x00; }
+
+    // Responses with an attribute value: read, read blob, read multiple
+    QByteArrayView responseValue() const { return tail(1); }
+
+    // List responses: read by type, read by group type and find information.
+    // For find information responses the second byte is the format and not the length.
+    quint8 elementLength() const { return u8(1); }
+    qsizetype elementCount(qsizetype elemLength) const
+    {
+        return elemLength > 0 ? (m_pdu.size() - 2) / elemLength : 0;
+    }
+    const char *element(qsizetype i, qsizetype elemLength) const
+    {
+        Q_ASSERT(2 + (i + 1) * elemLength <= m_pdu.size());
+        return m_pdu.data() + 2 + i * elemLength;
+    }
+
+private:
+    QByteArrayView m_pdu;
+};
+
+Q_DECLARE_TYPEINFO(AttPduView, Q_PRIMITIVE_TYPE);
+
+QT_END_NAMESPACE
+
+#endif // ATTPDU_P_H
@@ -12,6 +12,8 @@
 #include "properties_p.h"
 #include "adapter1_bluez5_p.h"
 
+#include <algorithm>
+
 QT_BEGIN_NAMESPACE
 
 QT_IMPL_METATYPE_EXTERN(InterfaceList)
@@ -255,6 +257,10 @@ public:
     int reference;
     bool wasListeningAlready;
     OrgFreedesktopDBusPropertiesInterface *propteryListener = nullptr;
+    // clients registered with a filter, the other clients take any device
+    QHash<const QObject *, QtBluezDiscoveryFilter> filters;
+    // the filter the adapter last accepted, if any
+    std::optional<QtBluezDiscoveryFilter> appliedFilter;
 };
 
 class QtBluezDiscoveryManagerPrivate
@@ -266,6 +272,64 @@ public:
 
 Q_GLOBAL_STATIC(QtBluezDiscoveryManager, discoveryManager)
 
+QVariantMap QtBluezDiscoveryFilter::toDBusMap() const
+{
+    QVariantMap map;
+    map.insert(QStringLiteral("Transport"), transport);
+    if (!uuids.isEmpty()) {
+        QStringList uuidStrings;
+        for (const QBluetoothUuid &uuid : uuids)
+            uuidStrings << uuid.toString(QUuid::WithoutBraces);
+        map.insert(QStringLiteral("UUIDs"), uuidStrings);
+    }
+    if (rssi)
+        map.insert(QStringLiteral("RSSI"), QVariant::fromValue<qint16>(*rssi));
+    // older BlueZ versions reject the key, only set it if it differs from the default
+    if (!duplicateData)
+        map.insert(QStringLiteral("DuplicateData"), false);
+    return map;
+}
+
+QtBluezDiscoveryFilter QtBluezDiscoveryFilter::merged(const QList<QtBluezDiscoveryFilter> &filters)
+{
+    if (filters.isEmpty())
+        return QtBluezDiscoveryFilter();
+
+    QtBluezDiscoveryFilter result = filters.first();
+    bool anyUuid = result.uuids.isEmpty();
+    for (qsizetype i = 1; i < filters.size(); ++i) {
+        const QtBluezDiscoveryFilter &filter = filters.at(i);
+
+        anyUuid = anyUuid || filter.uuids.isEmpty();
+        if (!anyUuid) {
+            for (const QBluetoothUuid &uuid : filter.uuids) {
+                if (!result.uuids.contains(uuid))
+                    result.uuids.append(uuid);
+            }
+        }
+
+        if (!result.rssi || !filter.rssi)
+            result.rssi.reset();
+        else
+            result.rssi = qMin(*result.rssi, *filter.rssi);
+
+        if (result.transport != filter.transport)
+            result.transport = QStringLiteral("auto");
+
+        result.duplicateData = result.duplicateData || filter.duplicateData;
+    }
+
+    if (anyUuid)
+        result.uuids.clear();
+    // independent of the order of the filters
+    std::sort(result.uuids.begin(), result.uuids.end(),
+              [](const QBluetoothUuid &a, const QBluetoothUuid &b) {
+        return static_cast<const QUuid &>(a) < static_cast<const QUuid &>(b);
+    });
+
+    return result;
+}
+
 /*!
     \internal
     \class QtBluezDiscoveryManager
@@ -280,6 +344,11 @@ Q_GLOBAL_STATIC(QtBluezDiscoveryManager, discoveryManager)
 
     Once the signal was emitted, all existing requests for discovery mode on the same adapter
     have to be renewed via \l registerDiscoveryInterest(QString).
+
+    BlueZ keeps a single discovery filter per D-Bus client. Clients which register
+    with a QtBluezDiscoveryFilter therefore get the merge of all filters on the same
+    adapter. A client without filter counts as a default filter which lets pass
+    any device on any transport.
 */
 
 QtBluezDiscoveryManager::QtBluezDiscoveryManager(QObject *parent) :
@@ -330,6 +399,8 @@ bool QtBluezDiscoveryManager::registerDiscoveryInterest(const QString &adapterPa
     // already monitored adapter? -> increase ref count -> done
     if (d->references.contains(adapterPath)) {
         d->references[adapterPath]->reference++;
+        // the new client takes any device
+        applyDiscoveryFilter(adapterPath);
         return true;
     }
 
@@ -353,6 +424,97 @@ bool QtBluezDiscoveryManager::registerDiscoveryInterest(const QString &adapterPa
     return true;
 }
 
+bool QtBluezDiscoveryManager::registerDiscoveryInterest(const QString &adapterPath,
+                                                        const QObject *client,
+                                                        const QtBluezDiscoveryFilter &filter,
+                                                        QDBusError *error)
+{
+    if (adapterPath.isEmpty())
+        return false;
+
+    AdapterData *data = d->references.value(adapterPath);
+    const bool newAdapter = !data;
+    if (newAdapter) {
+        data = new AdapterData();
+
+        OrgFreedesktopDBusPropertiesInterface *propIface =
+                new OrgFreedesktopDBusPropertiesInterface(QStringLiteral("org.bluez"), adapterPath,
+                                                          QDBusConnection::systemBus());
+        connect(propIface, &OrgFreedesktopDBusPropertiesInterface::PropertiesChanged,
+                this, &QtBluezDiscoveryManager::PropertiesChanged);
+        data->propteryListener = propIface;
+
+        OrgBluezAdapter1Interface iface(QStringLiteral("org.bluez"), adapterPath,
+                                        QDBusConnection::systemBus());
+        data->wasListeningAlready = iface.discovering();
+        d->references[adapterPath] = data;
+    } else {
+        data->reference++;
+    }
+    data->filters.insert(client, filter);
+
+    // BlueZ applies the filter when starting the discovery and updates a running one
+    const QDBusError filterError = applyDiscoveryFilter(adapterPath);
+    if (filterError.isValid() && filterError.type() != QDBusError::UnknownMethod) {
+        // e.g. the adapter does not support the requested transport
+        if (error)
+            *error = filterError;
+        unregisterDiscoveryInterest(adapterPath, client);
+        return false;
+    }
+
+    if (newAdapter && !data->wasListeningAlready) {
+        OrgBluezAdapter1Interface iface(QStringLiteral("org.bluez"), adapterPath,
+                                        QDBusConnection::systemBus());
+        iface.StartDiscovery();
+    }
+
+    return true;
+}
+
+void QtBluezDiscoveryManager::unregisterDiscoveryInterest(const QString &adapterPath,
+                                                          const QObject *client)
+{
+    AdapterData *data = d->references.value(adapterPath);
+    if (!data)
+        return;
+
+    data->filters.remove(client);
+    unregisterDiscoveryInterest(adapterPath);
+}
+
+QDBusError QtBluezDiscoveryManager::applyDiscoveryFilter(const QString &adapterPath)
+{
+    AdapterData *data = d->references.value(adapterPath);
+    if (!data)
+        return QDBusError();
+
+    QList<QtBluezDiscoveryFilter> filters = data->filters.values();
+    // the clients without filter take any device
+    for (qsizetype i = filters.size(); i < data->reference; ++i)
+        filters.append(QtBluezDiscoveryFilter());
+    const QtBluezDiscoveryFilter filter = QtBluezDiscoveryFilter::merged(filters);
+
+    // only skip the call if the adapter accepted the very same filter, otherwise
+    // its error has to reach the client which just registered
+    if (data->appliedFilter == filter)
+        return QDBusError();
+
+    OrgBluezAdapter1Interface iface(QStringLiteral("org.bluez"), adapterPath,
+                                    QDBusConnection::systemBus());
+    QDBusPendingReply<> reply = iface.SetDiscoveryFilter(filter.toDBusMap());
+    reply.waitForFinished();
+    if (reply.isError()) {
+        // older BlueZ 5.x versions don't have this function
+        if (reply.error().type() != QDBusError::UnknownMethod)
+            qCDebug(QT_BT_BLUEZ) << "SetDiscoveryFilter failed:" << reply.error();
+        return reply.error();
+    }
+
+    data->appliedFilter = filter;
+    return QDBusError();
+}
+
 void QtBluezDiscoveryManager::unregisterDiscoveryInterest(const QString &adapterPath)
 {
     if (!d->references.contains(adapterPath))
@@ -361,8 +523,10 @@ void QtBluezDiscoveryManager::unregisterDiscoveryInterest(const QString &adapter
     AdapterData *data = d->references[adapterPath];
     data->reference--;
 
-    if (data->reference > 0) // more than one client requested discovery mode
+    if (data->reference > 0) { // more than one client requested discovery mode
+        applyDiscoveryFilter(adapterPath);
         return;
+    }
 
     d->references.remove(adapterPath);
     if (!data->wasListeningAlready) { // Qt turned discovery mode on, Qt has to turn it off again
@@ -20,6 +20,9 @@
 #include <QtBluetooth/QBluetoothUuid>
 #include <QtBluetooth/QBluetoothAddress>
 #include <QtBluetooth/private/qtbluetoothglobal_p.h>
+#include <QtCore/private/qglobal_p.h>
+
+#include <optional>
 
 typedef QMap<QString, QVariantMap> InterfaceList;
 typedef QMap<QDBusObjectPath, InterfaceList> ManagedObjectList;
@@ -45,6 +48,38 @@ QString findAdapterForAddress(const QBluetoothAddress &wantedAddress, bool *ok);
 
 QString adapterWithDBusPeripheralInterface(const QBluetoothAddress &localAddress);
 
+/*
+    Discovery filter of org.bluez.Adapter1.SetDiscoveryFilter.
+
+    BlueZ keeps a single filter per D-Bus connection, the filters of all
+    clients of QtBluezDiscoveryManager are therefore merged into one.
+ */
+struct Q_AUTOTEST_EXPORT QtBluezDiscoveryFilter
+{
+    // any device if empty
+    QList<QBluetoothUuid> uuids;
+    // any signal strength if not set
+    std::optional<qint16> rssi;
+    // "auto", "bredr" or "le"
+    QString transport = QStringLiteral("auto");
+    // false reports changed advertising data only
+    bool duplicateData = true;
+
+    QVariantMap toDBusMap() const;
+    // a filter which lets pass everything that any of the filters lets pass
+    static QtBluezDiscoveryFilter merged(const QList<QtBluezDiscoveryFilter> &filters);
+
+    friend bool operator==(const QtBluezDiscoveryFilter &a, const QtBluezDiscoveryFilter &b)
+    {
+        return a.uuids == b.uuids && a.rssi == b.rssi && a.transport == b.transport
+                && a.duplicateData == b.duplicateData;
+    }
+    friend bool operator!=(const QtBluezDiscoveryFilter &a, const QtBluezDiscoveryFilter &b)
+    {
+        return !(a == b);
+    }
+};
+
 class QtBluezDiscoveryManagerPrivate;
 class QtBluezDiscoveryManager : public QObject
 {
@@ -56,6 +91,12 @@ public:
 
     bool registerDiscoveryInterest(const QString &adapterPath);
     void unregisterDiscoveryInterest(const QString &adapterPath);
+    // Discovery interest of client which only needs the devices passing filter.
+    // Returns false if BlueZ rejects the filter, error is set in that case.
+    bool registerDiscoveryInterest(const QString &adapterPath, const QObject *client,
+                                   const QtBluezDiscoveryFilter &filter,
+                                   QDBusError *error = nullptr);
+    void unregisterDiscoveryInterest(const QString &adapterPath, const QObject *client);
 
     //void dumpState() const;
 
@@ -72,6 +113,7 @@ private slots:
 
 private:
     void removeAdapterFromMonitoring(const QString &dbusPath);
+    QDBusError applyDiscoveryFilter(const QString &adapterPath);
 
     QtBluezDiscoveryManagerPrivate *d;
 };
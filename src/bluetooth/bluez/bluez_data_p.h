@@ -61,6 +61,25 @@ struct bt_security {
 #define BT_SECURITY_MEDIUM  2
 #define BT_SECURITY_HIGH    3
 
+#define BT_SNDMTU   12
+
+#define L2CAP_OPTIONS   0x01
+struct l2cap_options {
+    quint16 omtu;
+    quint16 imtu;
+    quint16 flush_to;
+    quint8 mode;
+    quint8 fcs;
+    quint8 max_tx;
+    quint16 txwin_size;
+};
+
+#define L2CAP_CONNINFO  0x02
+struct l2cap_conninfo {
+    quint16 hci_handle;
+    quint8 dev_class[3];
+};
+
 #define BDADDR_LE_PUBLIC    0x01
 #define BDADDR_LE_RANDOM    0x02
 
@@ -315,6 +334,8 @@ namespace QBluezConst {
         OcfLeSetAdvData = 0x8,
         OcfLeSetScanResponseData = 0x9,
         OcfLeSetAdvEnable = 0xa,
+        OcfLeSetScanParameters = 0xb,
+        OcfLeSetScanEnable = 0xc,
         OcfLeClearWhiteList = 0x10,
         OcfLeAddToWhiteList = 0x11,
         OcfLeConnectionUpdate = 0x13,
@@ -348,6 +369,8 @@ namespace QBluezConst {
         ATT_OP_HANDLE_VAL_NOTIFICATION     = 0x1b, //informs about value change
         ATT_OP_HANDLE_VAL_INDICATION       = 0x1d, //informs about value change -> requires reply
         ATT_OP_HANDLE_VAL_CONFIRMATION     = 0x1e, //answer for ATT_OP_HANDLE_VAL_INDICATION
+        ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST  = 0x20, //read values of any length, spec v5.2
+        ATT_OP_READ_MULTIPLE_VARIABLE_RESPONSE = 0x21,
         ATT_OP_WRITE_COMMAND               = 0x52, //write characteristic without response
         ATT_OP_SIGNED_WRITE_COMMAND        = 0xD2
     };
@@ -0,0 +1,243 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "bondstatecache_p.h"
+#include "objectmanager_p.h"
+
+#include <QtCore/QGlobalStatic>
+#include <QtCore/QLoggingCategory>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusServiceWatcher>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
+
+Q_GLOBAL_STATIC(QtBluezBondStateCache, bondStateCache)
+
+using namespace Qt::StringLiterals;
+
+static constexpr auto adapterInterface{"org.bluez.Adapter1"_L1};
+static constexpr auto deviceInterface{"org.bluez.Device1"_L1};
+
+QtBluezBondStateCache::QtBluezBondStateCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QtBluezBondStateCache::~QtBluezBondStateCache() = default;
+
+QtBluezBondStateCache *QtBluezBondStateCache::instance()
+{
+    QtBluezBondStateCache *cache = bondStateCache();
+    if (!cache->manager)
+        cache->initialize();
+    return cache;
+}
+
+void QtBluezBondStateCache::initialize()
+{
+    // subscribe before the snapshot, so that no change is missed
+    connectToBluez();
+    QDBusPendingReply<ManagedObjectList> reply = manager->GetManagedObjects();
+    reply.waitForFinished();
+    applySnapshot(reply);
+}
+
+void QtBluezBondStateCache::applySnapshot(const QDBusPendingReply<ManagedObjectList> &reply)
+{
+    if (reply.isError()) {
+        // retried by bluezRegistered()
+        qCWarning(QT_BT_BLUEZ) << "Cannot fetch the bond state of BlueZ devices:"
+                               << reply.error().message();
+        return;
+    }
+
+    const ManagedObjectList managedObjectList = reply.value();
+    // adapters first, devices are indexed by their adapter address
+    for (auto it = managedObjectList.cbegin(); it != managedObjectList.cend(); ++it) {
+        if (it.value().contains(adapterInterface))
+            interfacesAdded(it.key(), { { adapterInterface, it.value().value(adapterInterface) } });
+    }
+    for (auto it = managedObjectList.cbegin(); it != managedObjectList.cend(); ++it) {
+        if (it.value().contains(deviceInterface))
+            interfacesAdded(it.key(), { { deviceInterface, it.value().value(deviceInterface) } });
+    }
+}
+
+void QtBluezBondStateCache::connectToBluez()
+{
+    initializeBluez5();
+
+    manager = new OrgFreedesktopDBusObjectManagerInterface(
+                QStringLiteral("org.bluez"), QStringLiteral("/"),
+                QDBusConnection::systemBus(), this);
+    connect(manager, &OrgFreedesktopDBusObjectManagerInterface::InterfacesAdded,
+            this, &QtBluezBondStateCache::interfacesAdded);
+    connect(manager, &OrgFreedesktopDBusObjectManagerInterface::InterfacesRemoved,
+            this, &QtBluezBondStateCache::interfacesRemoved);
+    // a single match rule for all devices instead of one Properties proxy per device
+    const bool connected = QDBusConnection::systemBus().connect(
+                QStringLiteral("org.bluez"), QString(),
+                QStringLiteral("org.freedesktop.DBus.Properties"),
+                QStringLiteral("PropertiesChanged"), { QString(deviceInterface) }, QString(),
+                this, SLOT(dbusPropertiesChanged(QString,QVariantMap,QStringList,QDBusMessage)));
+    if (!connected)
+        qCWarning(QT_BT_BLUEZ) << "Cannot monitor the bond state of BlueZ devices";
+
+    auto serviceWatcher = new QDBusServiceWatcher(
+                QStringLiteral("org.bluez"), QDBusConnection::systemBus(),
+                QDBusServiceWatcher::WatchForRegistration
+                | QDBusServiceWatcher::WatchForUnregistration, this);
+    connect(serviceWatcher, &QDBusServiceWatcher::serviceRegistered,
+            this, &QtBluezBondStateCache::bluezRegistered);
+    connect(serviceWatcher, &QDBusServiceWatcher::serviceUnregistered,
+            this, &QtBluezBondStateCache::bluezUnregistered);
+}
+
+void QtBluezBondStateCache::bluezRegistered()
+{
+    auto watcher = new QDBusPendingCallWatcher(manager->GetManagedObjects(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, [this](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+        applySnapshot(*watcher);
+    });
+}
+
+// bluetoothd does not announce the removal of its objects when it exits
+void QtBluezBondStateCache::bluezUnregistered()
+{
+    adapters.clear();
+    devices.clear();
+    bondedDevices.clear();
+}
+
+void QtBluezBondStateCache::interfacesAdded(const QDBusObjectPath &objectPath,
+                                            const InterfaceList &interfaces)
+{
+    const QString path = objectPath.path();
+    auto adapterIt = interfaces.constFind(adapterInterface);
+    if (adapterIt != interfaces.constEnd()) {
+        const QBluetoothAddress address(adapterIt->value(QStringLiteral("Address")).toString());
+        adapters.insert(path, address.toUInt64());
+        // devices may have been announced before their adapter
+        for (const Device &device : std::as_const(devices)) {
+            if (device.adapterPath == path)
+                updateIndex(device);
+        }
+    }
+
+    auto deviceIt = interfaces.constFind(deviceInterface);
+    if (deviceIt == interfaces.constEnd())
+        return;
+
+    const QVariantMap &properties = deviceIt.value();
+    removeDevice(path);
+    Device device;
+    device.paired = properties.value(QStringLiteral("Paired")).toBool();
+    // BlueZ 5.70 and later distinguish bonding from pairing
+    device.bonded = properties.value(QStringLiteral("Bonded")).toBool();
+    if (!device.paired && !device.bonded)
+        return;
+    device.adapterPath = properties.value(QStringLiteral("Adapter"))
+            .value<QDBusObjectPath>().path();
+    device.address = QBluetoothAddress(properties.value(QStringLiteral("Address")).toString())
+            .toUInt64();
+    devices.insert(path, device);
+    updateIndex(device);
+}
+
+void QtBluezBondStateCache::interfacesRemoved(const QDBusObjectPath &objectPath,
+                                              const QStringList &interfaces)
+{
+    const QString path = objectPath.path();
+    if (interfaces.contains(deviceInterface))
+        removeDevice(path);
+
+    if (interfaces.contains(adapterInterface)) {
+        const auto adapterIt = adapters.constFind(path);
+        if (adapterIt == adapters.constEnd())
+            return;
+        const quint64 adapterAddress = adapterIt.value();
+        adapters.erase(adapterIt);
+        bondedDevices.removeIf([adapterAddress](const std::pair<quint64, quint64> &key) {
+            return key.first == adapterAddress;
+        });
+    }
+}
+
+void QtBluezBondStateCache::propertiesChanged(const QString &objectPath, const QString &interface,
+                                              const QVariantMap &changedProperties,
+                                              const QStringList &invalidatedProperties)
+{
+    if (interface != deviceInterface)
+        return;
+    const QString paired = QStringLiteral("Paired");
+    const QString bonded = QStringLiteral("Bonded");
+    if (!changedProperties.contains(paired) && !changedProperties.contains(bonded)
+            && !invalidatedProperties.contains(paired)
+            && !invalidatedProperties.contains(bonded)) {
+        return;
+    }
+
+    Device device = devices.value(objectPath);
+    if (device.adapterPath.isEmpty()) {
+        // not paired so far, the path contains the address
+        // (e.g.: /org/bluez/hci0/dev_XX_XX_XX_XX_XX_XX)
+        const qsizetype separator = objectPath.lastIndexOf(u'/');
+        QString addressString = objectPath.right(17);
+        addressString.replace(u'_', u':');
+        device.adapterPath = objectPath.left(separator);
+        device.address = QBluetoothAddress(addressString).toUInt64();
+        if (separator <= 0 || device.address == 0)
+            return;
+    }
+    if (changedProperties.contains(paired))
+        device.paired = changedProperties.value(paired).toBool();
+    else if (invalidatedProperties.contains(paired))
+        device.paired = false;
+    if (changedProperties.contains(bonded))
+        device.bonded = changedProperties.value(bonded).toBool();
+    else if (invalidatedProperties.contains(bonded))
+        device.bonded = false;
+
+    if (!device.paired && !device.bonded) {
+        removeDevice(objectPath);
+        return;
+    }
+    devices.insert(objectPath, device);
+    updateIndex(device);
+}
+
+void QtBluezBondStateCache::dbusPropertiesChanged(const QString &interface,
+                                                  const QVariantMap &changedProperties,
+                                                  const QStringList &invalidatedProperties,
+                                                  const QDBusMessage &message)
+{
+    propertiesChanged(message.path(), interface, changedProperties, invalidatedProperties);
+}
+
+void QtBluezBondStateCache::updateIndex(const Device &device, bool remove)
+{
+    const auto adapterIt = adapters.constFind(device.adapterPath);
+    if (adapterIt == adapters.constEnd())
+        return;
+
+    const std::pair<quint64, quint64> key(adapterIt.value(), device.address);
+    if (!remove && (device.paired || device.bonded))
+        bondedDevices.insert(key);
+    else
+        bondedDevices.remove(key);
+}
+
+void QtBluezBondStateCache::removeDevice(const QString &devicePath)
+{
+    const auto it = devices.constFind(devicePath);
+    if (it == devices.constEnd())
+        return;
+    updateIndex(it.value(), true);
+    devices.erase(it);
+}
+
+QT_END_NAMESPACE
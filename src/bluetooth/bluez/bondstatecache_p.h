@@ -0,0 +1,96 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef BONDSTATECACHE_P_H
+#define BONDSTATECACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtBluetooth/qbluetoothaddress.h>
+#include <QtBluetooth/private/bluez5_helper_p.h>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/private/qglobal_p.h>
+
+#include <utility>
+
+class OrgFreedesktopDBusObjectManagerInterface;
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Paired and bonded state of the devices known to BlueZ, shared by all controllers.
+
+    The state of all adapters is fetched when instance() is first called and kept
+    up to date by the ObjectManager and PropertiesChanged signals of BlueZ, so that
+    isBonded() never blocks on D-Bus. If bluetoothd is not running yet or restarts,
+    the state is fetched again, asynchronously, once org.bluez appears on the bus.
+
+    Only paired or bonded devices are kept, a scan can announce many others. The
+    adapter and address of a device becoming paired are taken from its object path.
+ */
+class Q_AUTOTEST_EXPORT QtBluezBondStateCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QtBluezBondStateCache(QObject *parent = nullptr);
+    ~QtBluezBondStateCache() override;
+    static QtBluezBondStateCache *instance();
+
+    // true if the device is paired or bonded with the local adapter
+    bool isBonded(const QBluetoothAddress &localAdapter, const QBluetoothAddress &remote) const
+    {
+        return bondedDevices.contains({ localAdapter.toUInt64(), remote.toUInt64() });
+    }
+
+    // BlueZ signal handlers, public for unit tests
+    void interfacesAdded(const QDBusObjectPath &objectPath, const InterfaceList &interfaces);
+    void interfacesRemoved(const QDBusObjectPath &objectPath, const QStringList &interfaces);
+    void propertiesChanged(const QString &objectPath, const QString &interface,
+                           const QVariantMap &changedProperties,
+                           const QStringList &invalidatedProperties);
+
+private slots:
+    void dbusPropertiesChanged(const QString &interface, const QVariantMap &changedProperties,
+                               const QStringList &invalidatedProperties,
+                               const QDBusMessage &message);
+    void bluezRegistered();
+    void bluezUnregistered();
+
+private:
+    struct Device {
+        QString adapterPath;
+        quint64 address = 0;
+        bool paired = false;
+        bool bonded = false;
+    };
+
+    void initialize();
+    void connectToBluez();
+    void applySnapshot(const QDBusPendingReply<ManagedObjectList> &reply);
+    void updateIndex(const Device &device, bool remove = false);
+    void removeDevice(const QString &devicePath);
+
+    OrgFreedesktopDBusObjectManagerInterface *manager = nullptr;
+    // adapter object path -> adapter address
+    QHash<QString, quint64> adapters;
+    // paired or bonded devices by object path
+    QHash<QString, Device> devices;
+    // (adapter address, device address) of all paired or bonded devices
+    QSet<std::pair<quint64, quint64>> bondedDevices;
+};
+
+QT_END_NAMESPACE
+
+#endif // BONDSTATECACHE_P_H
@@ -0,0 +1,513 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "discovereddevices_p.h"
+#include "bluez5_helper_p.h"
+
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QtEndian>
+
+#include <algorithm>
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
+
+void QtBluezDiscoveredDevices::DeviceProperties::update(const QVariantMap &changedProperties)
+{
+    for (auto it = changedProperties.cbegin(); it != changedProperties.cend(); ++it) {
+        const QString &name = it.key();
+        if (name == QLatin1String("RSSI")) {
+            rssi = qvariant_cast<short>(it.value());
+        } else if (name == QLatin1String("ManufacturerData")) {
+            const ManufacturerDataList data = qdbus_cast<ManufacturerDataList>(it.value());
+            manufacturerData.clear();
+            for (auto dataIt = data.cbegin(); dataIt != data.cend(); ++dataIt)
+                manufacturerData.insert(dataIt.key(), dataIt.value().variant().toByteArray());
+        } else if (name == QLatin1String("ServiceData")) {
+            const ServiceDataList data = qdbus_cast<ServiceDataList>(it.value());
+            serviceData.clear();
+            for (auto dataIt = data.cbegin(); dataIt != data.cend(); ++dataIt)
+                serviceData.insert(QBluetoothUuid(dataIt.key()),
+                                   dataIt.value().variant().toByteArray());
+        } else if (name == QLatin1String("Address")) {
+            address = QBluetoothAddress(it.value().toString());
+        } else if (name == QLatin1String("Alias")) {
+            alias = it.value().toString();
+        } else if (name == QLatin1String("Class")) {
+            deviceClass = it.value().toUInt();
+        } else if (name == QLatin1String("UUIDs")) {
+            uuids.clear();
+            const QStringList foundUuids = qvariant_cast<QStringList>(it.value());
+            for (const auto &u : foundUuids) {
+                const QBluetoothUuid id(u);
+                if (!id.isNull())
+                    uuids.append(id);
+            }
+        }
+    }
+}
+
+void QtBluezDiscoveredDevices::DeviceProperties::reset(const QStringList &invalidatedProperties)
+{
+    for (const QString &name : invalidatedProperties) {
+        if (name == QLatin1String("RSSI"))
+            rssi = 0;
+        else if (name == QLatin1String("ManufacturerData"))
+            manufacturerData.clear();
+        else if (name == QLatin1String("ServiceData"))
+            serviceData.clear();
+        else if (name == QLatin1String("Address"))
+            address = QBluetoothAddress();
+        else if (name == QLatin1String("Alias"))
+            alias.clear();
+        else if (name == QLatin1String("Class"))
+            deviceClass = 0;
+        else if (name == QLatin1String("UUIDs"))
+            uuids.clear();
+    }
+}
+
+// Returns invalid QBluetoothDeviceInfo in case of error
+QBluetoothDeviceInfo QtBluezDiscoveredDevices::DeviceProperties::toDeviceInfo() const
+{
+    if (address.isNull())
+        return QBluetoothDeviceInfo();
+
+    QBluetoothDeviceInfo deviceInfo(address, alias, deviceClass);
+    deviceInfo.setRssi(rssi);
+
+    bool foundLikelyLowEnergyUuid = false;
+    for (const QBluetoothUuid &id : uuids) {
+        //once we found one BTLE service we are done
+        bool ok = false;
+        quint16 shortId = id.toUInt16(&ok);
+        quint16 genericAccessInt = static_cast<quint16>(QBluetoothUuid::ServiceClassUuid::GenericAccess);
+        if (ok && ((shortId & genericAccessInt) == genericAccessInt)) {
+            foundLikelyLowEnergyUuid = true;
+            break;
+        }
+    }
+    deviceInfo.setServiceUuids(uuids);
+
+    if (!deviceClass) {
+        deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+    } else {
+        deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::BaseRateCoreConfiguration);
+        if (foundLikelyLowEnergyUuid)
+            deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::BaseRateAndLowEnergyCoreConfiguration);
+    }
+
+    for (auto it = manufacturerData.cbegin(); it != manufacturerData.cend(); ++it)
+        deviceInfo.setManufacturerData(it.key(), it.value());
+    for (auto it = serviceData.cbegin(); it != serviceData.cend(); ++it)
+        deviceInfo.setServiceData(it.key(), it.value());
+
+    return deviceInfo;
+}
+
+// Properties which are applied to the stored QBluetoothDeviceInfo without rebuilding it
+static bool isUpdatedInPlace(const QString &name)
+{
+    return name == QLatin1String("RSSI") || name == QLatin1String("ManufacturerData");
+}
+
+static bool isDeviceInfoProperty(const QString &name)
+{
+    return isUpdatedInPlace(name) || name == QLatin1String("Address")
+            || name == QLatin1String("Alias") || name == QLatin1String("Class")
+            || name == QLatin1String("UUIDs") || name == QLatin1String("ServiceData");
+}
+
+QtBluezDiscoveredDevices::QtBluezDiscoveredDevices(QObject *parent)
+    : QObject(parent)
+{
+    batchTimer.setSingleShot(true);
+    connect(&batchTimer, &QTimer::timeout, this, &QtBluezDiscoveredDevices::flush);
+    clock.start();
+}
+
+void QtBluezDiscoveredDevices::setBatchInterval(int msInterval)
+{
+    interval = qMax(0, msInterval);
+    if (interval == 0)
+        flush();
+}
+
+void QtBluezDiscoveredDevices::setMaximumDeviceCount(int count)
+{
+    maxCount = qMax(0, count);
+    if (maxCount > 0 && entries.size() > maxCount)
+        evictLeastRecentlySeen(entries.size() - maxCount);
+}
+
+void QtBluezDiscoveredDevices::setMaximumDeviceAge(int msAge)
+{
+    maxAge = qMax(0, msAge);
+    lastAgeCheck = 0;
+    evictStaleDevices();
+}
+
+void QtBluezDiscoveredDevices::clear()
+{
+    batchTimer.stop();
+    discoveredDevices.clear();
+    entries.clear();
+    deviceIndex.clear();
+    pathIndex.clear();
+    evictedPaths.clear();
+    pendingDevices.clear();
+}
+
+void QtBluezDiscoveredDevices::deviceFound(const QString &devicePath,
+                                           const QVariantMap &properties)
+{
+    evictStaleDevices();
+
+    DeviceProperties deviceProperties;
+    deviceProperties.update(properties);
+    if (deviceProperties.address.isNull()) // no point reporting an empty address
+        return;
+
+    evictedPaths.remove(devicePath);
+
+    qCDebug(QT_BT_BLUEZ) << "Discovered: " << deviceProperties.alias << deviceProperties.address
+                         << "Num UUIDs" << deviceProperties.uuids.size()
+                         << "total device" << discoveredDevices.size() << "cached"
+                         << "RSSI" << deviceProperties.rssi
+                         << "Num ManufacturerData" << deviceProperties.manufacturerData.size()
+                         << "Num ServiceData" << deviceProperties.serviceData.size();
+
+    const auto it = deviceIndex.constFind(deviceProperties.address);
+    if (it != deviceIndex.cend()) {
+        const qsizetype index = it.value();
+        Entry &entry = entries[index];
+        if (entry.path != devicePath) {
+            pathIndex.remove(entry.path);
+            pathIndex.insert(devicePath, index);
+            entry.path = devicePath;
+        }
+        touch(entry);
+
+        // the stored device is only rebuilt if the properties differ
+        if (!reportUnchanged && !entry.outdated && entry.properties == deviceProperties) {
+            qCDebug(QT_BT_BLUEZ) << "Duplicate: " << deviceProperties.address;
+            return;
+        }
+        entry.properties = std::move(deviceProperties);
+        entry.outdated = false;
+        discoveredDevices.replace(index, entry.properties.toDeviceInfo());
+        reportDiscovered(index);
+        return;
+    }
+
+    // make room for the new device
+    if (maxCount > 0 && entries.size() >= maxCount)
+        evictLeastRecentlySeen(entries.size() - maxCount + 1 + maxCount / 10);
+
+    const qsizetype index = discoveredDevices.size();
+    Entry entry;
+    entry.path = devicePath;
+    entry.properties = std::move(deviceProperties);
+    touch(entry);
+    discoveredDevices.append(entry.properties.toDeviceInfo());
+    deviceIndex.insert(entry.properties.address, index);
+    entries.append(std::move(entry));
+    pathIndex.insert(devicePath, index);
+    reportDiscovered(index);
+}
+
+void QtBluezDiscoveredDevices::propertiesChanged(const QString &devicePath,
+                                                 const QVariantMap &changedProperties,
+                                                 const QStringList &invalidatedProperties)
+{
+    evictStaleDevices();
+
+    const auto pathIt = pathIndex.constFind(devicePath);
+    if (pathIt == pathIndex.cend()) {
+        // PropertiesChanged carries only the changed properties, not enough to
+        // report the device again
+        const auto evictedIt = evictedPaths.find(devicePath);
+        if (evictedIt != evictedPaths.end()
+                && clock.elapsed() - evictedIt.value() >= refetchDelay) {
+            evictedPaths.erase(evictedIt);
+            emit evictedDeviceChanged(devicePath);
+        }
+        return;
+    }
+
+    // Update the cached properties before checking changedProperties for RSSI and ManufacturerData
+    // so the cached properties are always up to date.
+    const qsizetype index = pathIt.value();
+    Entry &entry = entries[index];
+    entry.properties.update(changedProperties);
+    entry.properties.reset(invalidatedProperties);
+    touch(entry);
+
+    // The other properties require a rebuild, done with the next RSSI or ManufacturerData update
+    for (auto it = changedProperties.cbegin(); it != changedProperties.cend(); ++it) {
+        if (!isUpdatedInPlace(it.key()) && isDeviceInfoProperty(it.key()))
+            entry.outdated = true;
+    }
+    for (const QString &name : invalidatedProperties) {
+        if (isDeviceInfoProperty(name))
+            entry.outdated = true;
+    }
+
+    const bool rssiChanged = changedProperties.contains(QStringLiteral("RSSI"));
+    const bool manufacturerDataChanged =
+            changedProperties.contains(QStringLiteral("ManufacturerData"));
+    if (!rssiChanged && !manufacturerDataChanged)
+        return;
+
+    // The common case of a frequent RSSI or advertisement update, the stored
+    // device is updated in place
+    QBluetoothDeviceInfo &device = discoveredDevices[index];
+    QBluetoothDeviceInfo::Fields updatedFields = QBluetoothDeviceInfo::Field::None;
+    if (rssiChanged) {
+        qCDebug(QT_BT_BLUEZ) << "Updating RSSI for" << device.address()
+                             << entry.properties.rssi;
+        device.setRssi(entry.properties.rssi);
+        updatedFields.setFlag(QBluetoothDeviceInfo::Field::RSSI);
+    }
+    if (manufacturerDataChanged) {
+        qCDebug(QT_BT_BLUEZ) << "Updating ManufacturerData for" << device.address();
+        const auto &changedManufacturerData = entry.properties.manufacturerData;
+        bool wasNewValue = false;
+        for (auto it = changedManufacturerData.cbegin(); it != changedManufacturerData.cend();
+             ++it) {
+            bool added = device.setManufacturerData(it.key(), it.value());
+            wasNewValue = (wasNewValue || added);
+        }
+
+        if (wasNewValue)
+            updatedFields.setFlag(QBluetoothDeviceInfo::Field::ManufacturerData);
+    }
+
+    if (entry.outdated) {
+        const auto info = entry.properties.toDeviceInfo();
+        if (!info.isValid() || info.address() != device.address())
+            return;
+
+        // field other than manufacturer or rssi changed
+        if (reportUnchanged || device.name() == info.name()) {
+            qCDebug(QT_BT_BLUEZ) << "Almost Duplicate " << info.address()
+                                 << info.name() << "- replacing in place";
+            entry.outdated = false;
+            discoveredDevices.replace(index, info);
+            reportDiscovered(index);
+        }
+        if (!reportUnchanged)
+            return;
+    } else if (reportUnchanged) {
+        reportDiscovered(index);
+    }
+
+    if (!updatedFields.testFlag(QBluetoothDeviceInfo::Field::None))
+        reportUpdated(index, updatedFields);
+}
+
+// The Manufacturer Specific Data AD structures of an advertising report
+static QHash<quint16, QByteArray> manufacturerDataOf(const QByteArray &adData)
+{
+    // Spec v5.3, Vol 3, Part C, 11: <length><AD type><AD data>, a zero length ends the data
+    QHash<quint16, QByteArray> manufacturerData;
+    qsizetype offset = 0;
+    while (offset < adData.size()) {
+        const qsizetype length = quint8(adData.at(offset));
+        if (length == 0 || offset + 1 + length > adData.size())
+            break;
+        const quint8 type = quint8(adData.at(offset + 1));
+        if (type == 0xff && length >= 3) {
+            const quint16 companyId = qFromLittleEndian<quint16>(adData.constData() + offset + 2);
+            manufacturerData.insert(companyId, adData.mid(offset + 4, length - 3));
+        }
+        offset += 1 + length;
+    }
+    return manufacturerData;
+}
+
+/*
+    Every advertisement of a device updates it, unlike the PropertiesChanged signals
+    of BlueZ which are throttled by its duplicate filtering. Devices unknown so far
+    are reported once BlueZ announces them, the reports lack their other properties.
+ */
+void QtBluezDiscoveredDevices::advertisingReportsReceived(
+        const QList<HciManager::AdvertisingReport> &reports)
+{
+    for (const HciManager::AdvertisingReport &report : reports) {
+        const auto indexIt = deviceIndex.constFind(report.address);
+        if (indexIt == deviceIndex.cend())
+            continue;
+
+        QVariantMap changedProperties;
+        if (report.rssi != 127) { // not available
+            changedProperties.insert(QStringLiteral("RSSI"),
+                                     QVariant::fromValue<short>(report.rssi));
+        }
+        const QHash<quint16, QByteArray> manufacturerData = manufacturerDataOf(report.data);
+        if (!manufacturerData.isEmpty()) {
+            ManufacturerDataList data;
+            for (auto it = manufacturerData.cbegin(); it != manufacturerData.cend(); ++it)
+                data.insert(it.key(), QDBusVariant(it.value()));
+            changedProperties.insert(QStringLiteral("ManufacturerData"),
+                                     QVariant::fromValue(data));
+        }
+        if (!changedProperties.isEmpty())
+            propertiesChanged(entries.at(indexIt.value()).path, changedProperties, {});
+    }
+}
+
+void QtBluezDiscoveredDevices::deviceRemoved(const QString &devicePath)
+{
+    evictedPaths.remove(devicePath);
+}
+
+void QtBluezDiscoveredDevices::touch(Entry &entry)
+{
+    entry.lastUse = ++useCounter;
+    entry.lastSeen = clock.elapsed();
+}
+
+void QtBluezDiscoveredDevices::evictStaleDevices()
+{
+    if (maxAge <= 0 || entries.isEmpty())
+        return;
+
+    // a full scan of the devices is only worth it every now and then
+    const qint64 now = clock.elapsed();
+    if (lastAgeCheck > 0 && now - lastAgeCheck < qMax(maxAge / 4, 1))
+        return;
+
+    lastAgeCheck = now;
+    removeDevices(0, now - maxAge);
+}
+
+void QtBluezDiscoveredDevices::evictLeastRecentlySeen(qsizetype count)
+{
+    if (count <= 0)
+        return;
+    if (count >= entries.size()) {
+        removeDevices(std::numeric_limits<quint64>::max(), 0);
+        return;
+    }
+
+    QList<quint64> uses;
+    uses.reserve(entries.size());
+    for (const Entry &entry : std::as_const(entries))
+        uses.append(entry.lastUse);
+    // lastUse is unique, the count oldest devices were used before the threshold
+    std::nth_element(uses.begin(), uses.begin() + count, uses.end());
+    removeDevices(uses.at(count), 0);
+}
+
+void QtBluezDiscoveredDevices::removeDevices(quint64 usedBefore, qint64 seenBefore)
+{
+    // new position of the devices, -1 if removed
+    QList<qsizetype> newIndex(entries.size(), -1);
+    const qint64 now = clock.elapsed();
+    qsizetype kept = 0;
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        const Entry &entry = entries.at(i);
+        if (entry.lastUse < usedBefore || entry.lastSeen < seenBefore) {
+            qCDebug(QT_BT_BLUEZ) << "Evicting" << discoveredDevices.at(i).address();
+            evictedPaths.insert(entry.path, now);
+            continue;
+        }
+        if (kept != i) {
+            entries[kept] = std::move(entries[i]);
+            discoveredDevices[kept] = std::move(discoveredDevices[i]);
+        }
+        newIndex[i] = kept++;
+    }
+    if (kept == entries.size())
+        return;
+
+    entries.resize(kept);
+    discoveredDevices.resize(kept);
+
+    deviceIndex.clear();
+    pathIndex.clear();
+    for (qsizetype i = 0; i < kept; ++i) {
+        deviceIndex.insert(discoveredDevices.at(i).address(), i);
+        pathIndex.insert(entries.at(i).path, i);
+    }
+
+    // pending reports of evicted devices are dropped
+    QList<qsizetype> pending;
+    for (qsizetype index : std::as_const(pendingDevices)) {
+        if (newIndex.at(index) >= 0)
+            pending.append(newIndex.at(index));
+    }
+    pendingDevices = std::move(pending);
+    if (pendingDevices.isEmpty())
+        batchTimer.stop();
+}
+
+void QtBluezDiscoveredDevices::reportDiscovered(qsizetype index)
+{
+    if (interval > 0) {
+        schedule(index, PendingDiscovered);
+        return;
+    }
+
+    // a copy, the receiver may restart the discovery
+    const QBluetoothDeviceInfo info = discoveredDevices.at(index);
+    emit deviceDiscovered(info);
+}
+
+void QtBluezDiscoveredDevices::reportUpdated(qsizetype index,
+                                             QBluetoothDeviceInfo::Fields updatedFields)
+{
+    if (index >= discoveredDevices.size()) // cleared by the receiver of deviceDiscovered()
+        return;
+
+    if (interval > 0) {
+        schedule(index, PendingUpdated);
+        return;
+    }
+
+    const QBluetoothDeviceInfo info = discoveredDevices.at(index);
+    emit deviceUpdated(info, updatedFields);
+}
+
+void QtBluezDiscoveredDevices::schedule(qsizetype index, PendingState state)
+{
+    PendingState &pending = entries[index].pending;
+    // a pending discovery reports the updates as well
+    if (pending == PendingDiscovered || pending == state)
+        return;
+
+    if (pending == NotPending)
+        pendingDevices.append(index);
+    pending = state;
+
+    if (!batchTimer.isActive())
+        batchTimer.start(interval);
+}
+
+void QtBluezDiscoveredDevices::flush()
+{
+    batchTimer.stop();
+    if (pendingDevices.isEmpty())
+        return;
+
+    QList<QBluetoothDeviceInfo> discovered;
+    QList<QBluetoothDeviceInfo> updated;
+    for (qsizetype index : std::as_const(pendingDevices)) {
+        if (entries.at(index).pending == PendingDiscovered)
+            discovered.append(discoveredDevices.at(index));
+        else
+            updated.append(discoveredDevices.at(index));
+        entries[index].pending = NotPending;
+    }
+    pendingDevices.clear();
+
+    if (!discovered.isEmpty())
+        emit devicesDiscovered(discovered);
+    if (!updated.isEmpty())
+        emit devicesUpdated(updated);
+}
+
+QT_END_NAMESPACE
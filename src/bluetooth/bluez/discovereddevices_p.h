@@ -0,0 +1,173 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef DISCOVEREDDEVICES_P_H
+#define DISCOVEREDDEVICES_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtBluetooth/qbluetoothaddress.h>
+#include <QtBluetooth/qbluetoothdeviceinfo.h>
+#include <QtBluetooth/qbluetoothuuid.h>
+#include <QtBluetooth/private/hcimanager_p.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <QtCore/QVariantMap>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Devices found by QBluetoothDeviceDiscoveryAgent on BlueZ, indexed by address.
+
+    Receives the org.bluez.Device1 properties of InterfacesAdded and
+    PropertiesChanged and turns them into the signals of the agent. With a batch
+    interval, the per device signals are replaced by devicesDiscovered() and
+    devicesUpdated(), which are emitted at most once per interval.
+
+    Only the properties relevant for QBluetoothDeviceInfo are kept. To bound
+    the memory of long-running scans, the least recently seen devices are
+    evicted once there are more than maximumDeviceCount() devices, and devices
+    which have not been seen for maximumDeviceAge() are evicted as well.
+    BlueZ does not announce an evicted device again while its object exists,
+    only its paths are kept and evictedDeviceChanged() asks for its properties
+    once it changes. deviceFound() then reports it as a new device. When more
+    devices are active than the limit allows, the devices would cycle between
+    eviction and refetch, so an evicted device is asked for at most once per
+    evictedRefetchDelay().
+ */
+class Q_AUTOTEST_EXPORT QtBluezDiscoveredDevices : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QtBluezDiscoveredDevices(QObject *parent = nullptr);
+
+    // Unchanged devices are reported again, see lowEnergyDiscoveryTimeout() == 0
+    void setReportUnchangedDevices(bool report) { reportUnchanged = report; }
+    // 0 emits a signal per device
+    void setBatchInterval(int msInterval);
+    int batchInterval() const { return interval; }
+
+    // 0 means no limit
+    void setMaximumDeviceCount(int count);
+    int maximumDeviceCount() const { return maxCount; }
+    void setMaximumDeviceAge(int msAge);
+    int maximumDeviceAge() const { return maxAge; }
+    // time after its eviction before a changed device is fetched again
+    void setEvictedRefetchDelay(int msDelay) { refetchDelay = qMax(0, msDelay); }
+    int evictedRefetchDelay() const { return refetchDelay; }
+
+    QList<QBluetoothDeviceInfo> devices() const { return discoveredDevices; }
+    void clear();
+
+    void deviceFound(const QString &devicePath, const QVariantMap &properties);
+    void propertiesChanged(const QString &devicePath, const QVariantMap &changedProperties,
+                           const QStringList &invalidatedProperties);
+    // Applies RSSI and manufacturer data of HCI advertising reports to the known devices
+    void advertisingReportsReceived(const QList<HciManager::AdvertisingReport> &reports);
+    // The org.bluez.Device1 object is gone
+    void deviceRemoved(const QString &devicePath);
+    // Emits the pending batches right away
+    void flush();
+
+signals:
+    void deviceDiscovered(const QBluetoothDeviceInfo &info);
+    void deviceUpdated(const QBluetoothDeviceInfo &info,
+                       QBluetoothDeviceInfo::Fields updatedFields);
+    void devicesDiscovered(const QList<QBluetoothDeviceInfo> &infos);
+    void devicesUpdated(const QList<QBluetoothDeviceInfo> &infos);
+    // An evicted device changed, the receiver calls deviceFound() with all its properties
+    void evictedDeviceChanged(const QString &devicePath);
+
+private:
+    enum PendingState : quint8 {
+        NotPending,
+        PendingDiscovered,
+        PendingUpdated
+    };
+
+    // The org.bluez.Device1 properties of a device which end up in QBluetoothDeviceInfo
+    struct DeviceProperties {
+        QBluetoothAddress address;
+        QString alias;
+        QList<QBluetoothUuid> uuids;
+        QHash<quint16, QByteArray> manufacturerData;
+        QHash<QBluetoothUuid, QByteArray> serviceData;
+        quint32 deviceClass = 0;
+        qint16 rssi = 0;
+
+        bool operator==(const DeviceProperties &other) const
+        {
+            return address == other.address && alias == other.alias && uuids == other.uuids
+                    && manufacturerData == other.manufacturerData
+                    && serviceData == other.serviceData && deviceClass == other.deviceClass
+                    && rssi == other.rssi;
+        }
+
+        void update(const QVariantMap &changedProperties);
+        void reset(const QStringList &invalidatedProperties);
+        QBluetoothDeviceInfo toDeviceInfo() const;
+    };
+
+    struct Entry {
+        QString path;
+        DeviceProperties properties;
+        // for the least recently seen eviction, unique across the entries
+        quint64 lastUse = 0;
+        // clock time in ms for the age based eviction
+        qint64 lastSeen = 0;
+        // batch state
+        PendingState pending = NotPending;
+        // properties changed which cannot be applied to the stored QBluetoothDeviceInfo
+        // in place, it is rebuilt on the next update
+        bool outdated = false;
+    };
+
+    void touch(Entry &entry);
+    void evictStaleDevices();
+    void evictLeastRecentlySeen(qsizetype count);
+    void removeDevices(quint64 usedBefore, qint64 seenBefore);
+
+    void reportDiscovered(qsizetype index);
+    void reportUpdated(qsizetype index, QBluetoothDeviceInfo::Fields updatedFields);
+    void schedule(qsizetype index, PendingState state);
+
+    QList<QBluetoothDeviceInfo> discoveredDevices;
+    // same order as discoveredDevices
+    QList<Entry> entries;
+    // indexes into discoveredDevices
+    QHash<QBluetoothAddress, qsizetype> deviceIndex;
+    QHash<QString, qsizetype> pathIndex;
+    // object paths of the evicted devices which still exist in BlueZ, with the clock
+    // time of their eviction
+    QHash<QString, qint64> evictedPaths;
+
+    QList<qsizetype> pendingDevices;
+    QTimer batchTimer;
+    QElapsedTimer clock;
+    quint64 useCounter = 0;
+    qint64 lastAgeCheck = 0;
+    int interval = 0;
+    int maxCount = 0;
+    int maxAge = 0;
+    int refetchDelay = 10000;
+    bool reportUnchanged = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // DISCOVEREDDEVICES_P_H
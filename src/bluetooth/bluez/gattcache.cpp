@@ -0,0 +1,153 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "gattcache_p.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QSettings>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
+
+// Increment whenever the layout of the cache file changes
+static const int gattCacheVersion = 1;
+
+GattCache::Service *GattCache::Database::service(const QBluetoothUuid &uuid)
+{
+    for (Service &service : services) {
+        if (service.uuid == uuid)
+            return &service;
+    }
+    return nullptr;
+}
+
+GattCache::Database GattCache::load(const QString &filePath)
+{
+    Database database;
+    if (!QFileInfo::exists(filePath))
+        return database;
+
+    QSettings settings(filePath, QSettings::IniFormat);
+    if (settings.value(QLatin1String("Version")).toInt() != gattCacheVersion) {
+        qCDebug(QT_BT_BLUEZ) << "Ignoring GATT cache" << filePath << "of unknown version";
+        return database;
+    }
+    database.databaseHash = QByteArray::fromHex(
+                settings.value(QLatin1String("DatabaseHash")).toByteArray());
+
+    const int serviceCount = settings.beginReadArray(QLatin1String("Services"));
+    for (int i = 0; i < serviceCount; ++i) {
+        settings.setArrayIndex(i);
+        Service service;
+        service.uuid = QBluetoothUuid(settings.value(QLatin1String("Uuid")).toString());
+        service.startHandle = settings.value(QLatin1String("StartHandle")).toUInt();
+        service.endHandle = settings.value(QLatin1String("EndHandle")).toUInt();
+        service.type = QLowEnergyService::ServiceTypes::fromInt(
+                    settings.value(QLatin1String("Type")).toInt());
+        const QStringList included = settings.value(QLatin1String("IncludedServices"))
+                .toStringList();
+        for (const QString &uuid : included)
+            service.includedServices << QBluetoothUuid(uuid);
+        service.hasDetails = settings.value(QLatin1String("HasDetails")).toBool();
+
+        const int charCount = settings.beginReadArray(QLatin1String("Characteristics"));
+        for (int j = 0; j < charCount; ++j) {
+            settings.setArrayIndex(j);
+            Characteristic characteristic;
+            characteristic.handle = settings.value(QLatin1String("Handle")).toUInt();
+            characteristic.valueHandle = settings.value(QLatin1String("ValueHandle")).toUInt();
+            characteristic.uuid = QBluetoothUuid(settings.value(QLatin1String("Uuid")).toString());
+            characteristic.properties = QLowEnergyCharacteristic::PropertyTypes::fromInt(
+                        settings.value(QLatin1String("Properties")).toInt());
+
+            const int descCount = settings.beginReadArray(QLatin1String("Descriptors"));
+            for (int k = 0; k < descCount; ++k) {
+                settings.setArrayIndex(k);
+                Descriptor descriptor;
+                descriptor.handle = settings.value(QLatin1String("Handle")).toUInt();
+                descriptor.uuid = QBluetoothUuid(settings.value(QLatin1String("Uuid")).toString());
+                characteristic.descriptors << descriptor;
+            }
+            settings.endArray();
+            service.characteristics << characteristic;
+        }
+        settings.endArray();
+
+        if (service.uuid.isNull() || service.startHandle == 0
+                || service.startHandle > service.endHandle) {
+            qCWarning(QT_BT_BLUEZ) << "Ignoring corrupt GATT cache" << filePath;
+            return Database();
+        }
+        database.services << service;
+    }
+    settings.endArray();
+
+    return database;
+}
+
+bool GattCache::save(const QString &filePath, const Database &database)
+{
+    if (!QDir().mkpath(QFileInfo(filePath).absolutePath()))
+        return false;
+
+    QSettings settings(filePath, QSettings::IniFormat);
+    if (!settings.isWritable())
+        return false;
+
+    settings.clear();
+    settings.setValue(QLatin1String("Version"), gattCacheVersion);
+    settings.setValue(QLatin1String("DatabaseHash"), database.databaseHash.toHex());
+
+    settings.beginWriteArray(QLatin1String("Services"), database.services.size());
+    for (qsizetype i = 0; i < database.services.size(); ++i) {
+        const Service &service = database.services.at(i);
+        settings.setArrayIndex(i);
+        settings.setValue(QLatin1String("Uuid"), service.uuid.toString());
+        settings.setValue(QLatin1String("StartHandle"), service.startHandle);
+        settings.setValue(QLatin1String("EndHandle"), service.endHandle);
+        settings.setValue(QLatin1String("Type"), service.type.toInt());
+        QStringList included;
+        for (const QBluetoothUuid &uuid : service.includedServices)
+            included << uuid.toString();
+        settings.setValue(QLatin1String("IncludedServices"), included);
+        settings.setValue(QLatin1String("HasDetails"), service.hasDetails);
+
+        settings.beginWriteArray(QLatin1String("Characteristics"),
+                                 service.characteristics.size());
+        for (qsizetype j = 0; j < service.characteristics.size(); ++j) {
+            const Characteristic &characteristic = service.characteristics.at(j);
+            settings.setArrayIndex(j);
+            settings.setValue(QLatin1String("Handle"), characteristic.handle);
+            settings.setValue(QLatin1String("ValueHandle"), characteristic.valueHandle);
+            settings.setValue(QLatin1String("Uuid"), characteristic.uuid.toString());
+            settings.setValue(QLatin1String("Properties"), characteristic.properties.toInt());
+
+            settings.beginWriteArray(QLatin1String("Descriptors"),
+                                     characteristic.descriptors.size());
+            for (qsizetype k = 0; k < characteristic.descriptors.size(); ++k) {
+                const Descriptor &descriptor = characteristic.descriptors.at(k);
+                settings.setArrayIndex(k);
+                settings.setValue(QLatin1String("Handle"), descriptor.handle);
+                settings.setValue(QLatin1String("Uuid"), descriptor.uuid.toString());
+            }
+            settings.endArray();
+        }
+        settings.endArray();
+    }
+    settings.endArray();
+
+    settings.sync();
+    return settings.status() == QSettings::NoError;
+}
+
+void GattCache::remove(const QString &filePath)
+{
+    if (QFileInfo::exists(filePath) && !QFile::remove(filePath))
+        qCWarning(QT_BT_BLUEZ) << "Cannot remove stale GATT cache" << filePath;
+}
+
+QT_END_NAMESPACE
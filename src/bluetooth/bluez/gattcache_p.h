@@ -0,0 +1,80 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef GATTCACHE_P_H
+#define GATTCACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtBluetooth/qbluetooth.h>
+#include <QtBluetooth/qbluetoothuuid.h>
+#include <QtBluetooth/qlowenergycharacteristic.h>
+#include <QtBluetooth/qlowenergyservice.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Persistent copy of the attribute structure of a remote GATT server.
+
+    Only the layout of the database (services, characteristics and descriptors
+    with their handles) is stored, never attribute values. The cached layout is
+    valid as long as the Database Hash of the remote device is unchanged
+    (Bluetooth Core Spec v5.1, Vol 3, Part G, 7.3).
+ */
+class Q_AUTOTEST_EXPORT GattCache
+{
+public:
+    struct Descriptor {
+        QLowEnergyHandle handle = 0;
+        QBluetoothUuid uuid;
+    };
+
+    struct Characteristic {
+        QLowEnergyHandle handle = 0;
+        QLowEnergyHandle valueHandle = 0;
+        QBluetoothUuid uuid;
+        QLowEnergyCharacteristic::PropertyTypes properties;
+        QList<Descriptor> descriptors;
+    };
+
+    struct Service {
+        QBluetoothUuid uuid;
+        QLowEnergyHandle startHandle = 0;
+        QLowEnergyHandle endHandle = 0;
+        QLowEnergyService::ServiceTypes type = QLowEnergyService::PrimaryService;
+        QList<QBluetoothUuid> includedServices;
+        // false if only the service declaration is known
+        bool hasDetails = false;
+        QList<Characteristic> characteristics;
+    };
+
+    struct Database {
+        // empty if the remote device does not expose a Database Hash characteristic
+        QByteArray databaseHash;
+        QList<Service> services;
+
+        Service *service(const QBluetoothUuid &uuid);
+        bool isEmpty() const { return services.isEmpty(); }
+    };
+
+    static Database load(const QString &filePath);
+    static bool save(const QString &filePath, const Database &database);
+    static void remove(const QString &filePath);
+};
+
+QT_END_NAMESPACE
+
+#endif // GATTCACHE_P_H
@@ -7,9 +7,12 @@
 #include "qbluetoothsocketbase_p.h"
 #include "qlowenergyconnectionparameters.h"
 
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qpointer.h>
 
 #include <cstring>
+#include <utility>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -21,9 +24,21 @@ QT_BEGIN_NAMESPACE
 
 Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
 
+// Reports are emitted early once this many are pending
+static constexpr qsizetype maxPendingReports = 1024;
+
+// Packets read by a single recvmmsg() call
+static constexpr int readBatchSize = 16;
+// Upper bound of packets per socket notification, so other events get their turn
+static constexpr int maxPacketsPerWakeup = 256;
+static constexpr int packetBufferSize = qMax<int>(HCI_MAX_EVENT_SIZE, sizeof(AclData));
+
 HciManager::HciManager(const QBluetoothAddress& deviceAdapter) :
     QObject(nullptr), hciSocket(-1), hciDev(-1)
 {
+    reportTimer.setSingleShot(true);
+    connect(&reportTimer, &QTimer::timeout, this, &HciManager::flushAdvertisingReports);
+
     hciSocket = ::socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
     if (hciSocket < 0) {
         qCWarning(QT_BT_BLUEZ) << "Cannot open HCI socket";
@@ -56,11 +71,30 @@ HciManager::HciManager(const QBluetoothAddress& deviceAdapter) :
 
 }
 
+HciManager::HciManager(int socketDescriptor) :
+    QObject(nullptr), hciSocket(socketDescriptor), hciDev(-1)
+{
+    reportTimer.setSingleShot(true);
+    connect(&reportTimer, &QTimer::timeout, this, &HciManager::flushAdvertisingReports);
+
+    notifier = new QSocketNotifier(hciSocket, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(QSocketDescriptor)), this, SLOT(_q_readNotify()));
+}
+
 HciManager::~HciManager()
 {
     if (hciSocket >= 0)
         ::close(hciSocket);
 
+    if (statistics.wakeups > 0) {
+        qCDebug(QT_BT_BLUEZ) << "HCI packets:" << statistics.packets
+                             << "wakeups:" << statistics.wakeups
+                             << "max packets per wakeup:" << statistics.maxPacketsPerWakeup
+                             << "average dispatch time (ns):"
+                             << statistics.totalDispatchTime / qint64(statistics.wakeups)
+                             << "max dispatch time (ns):" << statistics.maxDispatchTime;
+    }
+
 }
 
 bool HciManager::isValid() const
@@ -386,30 +420,179 @@ bool HciManager::sendConnectionParameterUpdateRequest(quint16 handle,
     return true;
 }
 
+/*
+ * Starts a passive LE scan. Unlike the discovery of BlueZ, every advertisement
+ * is reported, including the repeated ones. Requires CAP_NET_ADMIN.
+ *
+ * The scan parameters cannot be changed while the controller is scanning.
+ * If BlueZ is already scanning, the commands fail but the reports of that
+ * scan are delivered nonetheless.
+ */
+bool HciManager::startLeScan(quint16 interval, quint16 window)
+{
+    if (!isValid() || !monitorEvent(HciEvent::EVT_LE_META_EVENT))
+        return false;
+
+    // Spec v5.3, Vol 4, Part E, 7.8.10
+    struct ScanParameters {
+        quint8 type;
+        quint16 interval;
+        quint16 window;
+        quint8 ownAddressType;
+        quint8 filterPolicy;
+    } __attribute__((packed)) parameters;
+    interval = qBound<quint16>(0x4, interval, 0x4000);
+    window = qBound<quint16>(0x4, window, interval);
+    parameters.type = 0x00; // passive
+    parameters.interval = qToLittleEndian(interval);
+    parameters.window = qToLittleEndian(window);
+    parameters.ownAddressType = 0x00; // public
+    parameters.filterPolicy = 0x00; // accept all
+    if (!sendCommand(QBluezConst::OgfLinkControl, QBluezConst::OcfLeSetScanParameters,
+                     QByteArray(reinterpret_cast<const char *>(&parameters), sizeof parameters))) {
+        return false;
+    }
+
+    // Spec v5.3, Vol 4, Part E, 7.8.11, enabled without duplicate filtering
+    const char enable[] = { 0x01, 0x00 };
+    return sendCommand(QBluezConst::OgfLinkControl, QBluezConst::OcfLeSetScanEnable,
+                       QByteArray(enable, sizeof enable));
+}
+
+void HciManager::setAdvertisingReportInterval(int msInterval)
+{
+    reportInterval = qMax(0, msInterval);
+    if (reportInterval == 0)
+        flushAdvertisingReports();
+}
+
+void HciManager::flushAdvertisingReports()
+{
+    reportTimer.stop();
+    if (pendingReports.isEmpty())
+        return;
+
+    const QList<AdvertisingReport> reports = std::exchange(pendingReports, {});
+    emit advertisingReportsReceived(reports);
+}
+
 /*!
  * Process all incoming HCI events. Function cannot process anything else but events.
+ *
+ * All pending packets are read, so a busy controller does not cost an event loop
+ * iteration per packet.
  */
 void HciManager::_q_readNotify()
 {
-    unsigned char buffer[qMax<int>(HCI_MAX_EVENT_SIZE, sizeof(AclData))];
+    QElapsedTimer dispatchTimer;
+    dispatchTimer.start();
+
+    // the receivers of the signals may delete this object
+    QPointer<HciManager> guard(this);
+    int packetCount = 0;
+    while (packetCount < maxPacketsPerWakeup) {
+        const int received = readPackets();
+        for (int i = 0; i < received; ++i) {
+            dispatchHciPacket(readBuffer.data() + i * packetBufferSize, packetSizes[i]);
+            if (!guard)
+                return;
+        }
+        packetCount += received;
+        if (received < readBatchSize)
+            break; // drained
+    }
+
+    if (reportInterval == 0)
+        flushAdvertisingReports();
+    if (!guard)
+        return;
+
+    const qint64 dispatchTime = dispatchTimer.nsecsElapsed();
+    ++statistics.wakeups;
+    statistics.packets += packetCount;
+    statistics.maxPacketsPerWakeup = qMax(statistics.maxPacketsPerWakeup, packetCount);
+    statistics.totalDispatchTime += dispatchTime;
+    statistics.maxDispatchTime = qMax(statistics.maxDispatchTime, dispatchTime);
+}
+
+/*
+ * Reads up to readBatchSize packets into readBuffer without blocking.
+ * Returns the number of packets read, their sizes are in packetSizes.
+ */
+int HciManager::readPackets()
+{
+    if (readBuffer.empty()) {
+        readBuffer.resize(readBatchSize * packetBufferSize);
+        packetSizes.resize(readBatchSize);
+    }
+
+    if (recvmmsgSupported) {
+        iovec vectors[readBatchSize];
+        mmsghdr messages[readBatchSize];
+        memset(messages, 0, sizeof messages);
+        for (int i = 0; i < readBatchSize; ++i) {
+            vectors[i].iov_base = readBuffer.data() + i * packetBufferSize;
+            vectors[i].iov_len = packetBufferSize;
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int count;
+        do {
+            count = ::recvmmsg(hciSocket, messages, readBatchSize, MSG_DONTWAIT, nullptr);
+        } while (count < 0 && errno == EINTR);
+
+        if (count >= 0) {
+            for (int i = 0; i < count; ++i)
+                packetSizes[i] = int(messages[i].msg_len);
+            return count;
+        }
+        if (errno != ENOSYS) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                qCWarning(QT_BT_BLUEZ) << "Failed reading HCI events:" << qt_error_string(errno);
+            return 0;
+        }
+        recvmmsgSupported = false;
+    }
+
+    // one packet per call
+    ssize_t size;
+    do {
+        size = ::recv(hciSocket, readBuffer.data(), packetBufferSize, MSG_DONTWAIT);
+    } while (size < 0 && errno == EINTR);
 
-    const auto size = ::read(hciSocket, buffer, sizeof(buffer));
     if (size < 0) {
-        if (errno != EAGAIN && errno != EINTR)
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
             qCWarning(QT_BT_BLUEZ) << "Failed reading HCI events:" << qt_error_string(errno);
+        return 0;
+    }
 
+    packetSizes[0] = int(size);
+    return 1;
+}
+
+void HciManager::handleHciPacket(const quint8 *data, int size)
+{
+    dispatchHciPacket(data, size);
+
+    if (reportInterval == 0)
+        flushAdvertisingReports();
+}
+
+void HciManager::dispatchHciPacket(const quint8 *data, int size)
+{
+    if (size < 1)
         return;
-    }
 
-    switch (buffer[0]) {
+    switch (data[0]) {
     case HCI_EVENT_PKT:
-        handleHciEventPacket(buffer + 1, size - 1);
+        handleHciEventPacket(data + 1, size - 1);
         break;
     case HCI_ACL_PKT:
-        handleHciAclPacket(buffer + 1, size - 1);
+        handleHciAclPacket(data + 1, size - 1);
         break;
     default:
-        qCWarning(QT_BT_BLUEZ) << "Ignoring unexpected HCI packet type" << buffer[0];
+        qCWarning(QT_BT_BLUEZ) << "Ignoring unexpected HCI packet type" << data[0];
     }
 }
 
@@ -452,12 +635,13 @@ void HciManager::handleHciEventPacket(const quint8 *data, int size)
         // There is always a status byte right after the generic structure.
         Q_ASSERT(size > static_cast<int>(sizeof *event));
         const quint8 status = data[sizeof *event];
-        const auto additionalData = QByteArray(reinterpret_cast<const char *>(data)
-                                               + sizeof *event + 1, size - sizeof *event - 1);
+        // a copy, the read buffer is reused for the next packets
+        const QByteArray additionalData(reinterpret_cast<const char *>(data) + sizeof *event + 1,
+                                        size - sizeof *event - 1);
         emit commandCompleted(event->opcode, status, additionalData);
     } break;
     case HciEvent::EVT_LE_META_EVENT:
-        handleLeMetaEvent(data);
+        handleLeMetaEvent(data, size);
         break;
     default:
         break;
@@ -522,8 +706,11 @@ void HciManager::handleHciAclPacket(const quint8 *data, int size)
     emit signatureResolvingKeyReceived(aclData->handle, isRemoteKey, csrk);
 }
 
-void HciManager::handleLeMetaEvent(const quint8 *data)
+void HciManager::handleLeMetaEvent(const quint8 *data, int size)
 {
+    if (size < 1)
+        return;
+
     // Spec v5.3, Vol 4, part E, 7.7.65.*
     switch (*data) {
     case 0x1: // HCI_LE_Connection_Complete
@@ -554,11 +741,104 @@ void HciManager::handleLeMetaEvent(const quint8 *data)
         }
         break;
     }
+    case 0x2: // HCI_LE_Advertising_Report
+        handleLeAdvertisingReport(data + 1, size - 1);
+        break;
+    case 0xD: // HCI_LE_Extended_Advertising_Report
+        handleLeExtendedAdvertisingReport(data + 1, size - 1);
+        break;
     default:
         break;
     }
 }
 
+void HciManager::handleLeAdvertisingReport(const quint8 *data, int size)
+{
+    // Spec v5.3, Vol 4, Part E, 7.7.65.2
+    // Like the kernel, the reports are parsed as consecutive structures
+    if (size < 1)
+        return;
+
+    const int reportCount = data[0];
+    int offset = 1;
+    for (int i = 0; i < reportCount; ++i) {
+        // event type, address type, address, data length
+        constexpr int headerSize = 1 + 1 + 6 + 1;
+        if (size - offset < headerSize) {
+            qCWarning(QT_BT_BLUEZ) << "Truncated HCI LE Advertising Report";
+            return;
+        }
+        const quint8 *report = data + offset;
+        const int dataLength = report[8];
+        // the data is followed by the RSSI
+        if (size - offset < headerSize + dataLength + 1) {
+            qCWarning(QT_BT_BLUEZ) << "Truncated HCI LE Advertising Report";
+            return;
+        }
+
+        AdvertisingReport advertisingReport;
+        advertisingReport.eventType = report[0];
+        advertisingReport.addressType = report[1];
+        quint8 address[6];
+        memcpy(address, report + 2, sizeof address);
+        advertisingReport.address = QBluetoothAddress(convertAddress(address));
+        advertisingReport.data = QByteArray(reinterpret_cast<const char *>(report) + headerSize,
+                                            dataLength);
+        advertisingReport.rssi = qint8(report[headerSize + dataLength]);
+        addAdvertisingReport(std::move(advertisingReport));
+
+        offset += headerSize + dataLength + 1;
+    }
+}
+
+void HciManager::handleLeExtendedAdvertisingReport(const quint8 *data, int size)
+{
+    // Spec v5.3, Vol 4, Part E, 7.7.65.13
+    if (size < 1)
+        return;
+
+    const int reportCount = data[0];
+    int offset = 1;
+    for (int i = 0; i < reportCount; ++i) {
+        // event type, address type, address, primary PHY, secondary PHY, SID, TX power,
+        // RSSI, periodic advertising interval, direct address type, direct address,
+        // data length
+        constexpr int headerSize = 2 + 1 + 6 + 1 + 1 + 1 + 1 + 1 + 2 + 1 + 6 + 1;
+        if (size - offset < headerSize) {
+            qCWarning(QT_BT_BLUEZ) << "Truncated HCI LE Extended Advertising Report";
+            return;
+        }
+        const quint8 *report = data + offset;
+        const int dataLength = report[headerSize - 1];
+        if (size - offset < headerSize + dataLength) {
+            qCWarning(QT_BT_BLUEZ) << "Truncated HCI LE Extended Advertising Report";
+            return;
+        }
+
+        AdvertisingReport advertisingReport;
+        advertisingReport.eventType = bt_get_le16(report);
+        advertisingReport.addressType = report[2];
+        quint8 address[6];
+        memcpy(address, report + 3, sizeof address);
+        advertisingReport.address = QBluetoothAddress(convertAddress(address));
+        advertisingReport.rssi = qint8(report[13]);
+        advertisingReport.data = QByteArray(reinterpret_cast<const char *>(report) + headerSize,
+                                            dataLength);
+        addAdvertisingReport(std::move(advertisingReport));
+
+        offset += headerSize + dataLength;
+    }
+}
+
+void HciManager::addAdvertisingReport(AdvertisingReport &&report)
+{
+    pendingReports.append(std::move(report));
+    if (pendingReports.size() >= maxPendingReports)
+        flushAdvertisingReports();
+    else if (reportInterval > 0 && !reportTimer.isActive())
+        reportTimer.start(reportInterval);
+}
+
 QT_END_NAMESPACE
 
 #include "moc_hcimanager_p.cpp"
@@ -16,17 +16,22 @@
 //
 
 #include <QtCore/QObject>
+#include <QtCore/QByteArray>
 #include <QtCore/QList>
 #include <QtCore/QSet>
 #include <QtCore/QSocketNotifier>
+#include <QtCore/QTimer>
 #include <QtBluetooth/QBluetoothAddress>
-#include "bluez/bluez_data_p.h"
+#include <QtBluetooth/private/bluez_data_p.h>
+#include <QtCore/private/qglobal_p.h>
+
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 
 class QLowEnergyConnectionParameters;
 
-class HciManager : public QObject
+class Q_AUTOTEST_EXPORT HciManager : public QObject
 {
     Q_OBJECT
 public:
@@ -156,7 +161,31 @@ public:
     };
     Q_ENUM(HciError);
 
+    // A single report of the HCI LE (Extended) Advertising Report event
+    struct AdvertisingReport {
+        QBluetoothAddress address;
+        // AD structures of the advertising or scan response PDU
+        QByteArray data;
+        // legacy event type or extended event type bits
+        quint16 eventType = 0;
+        quint8 addressType = 0;
+        // 127 if not available
+        qint8 rssi = 127;
+    };
+
+    // Counters of the packets read from the HCI socket
+    struct ReadStatistics {
+        quint64 wakeups = 0;
+        quint64 packets = 0;
+        int maxPacketsPerWakeup = 0;
+        // time in ns to read and dispatch the packets of a wakeup
+        qint64 totalDispatchTime = 0;
+        qint64 maxDispatchTime = 0;
+    };
+
     explicit HciManager(const QBluetoothAddress &deviceAdapter);
+    // Reads the packets from socketDescriptor, which it takes over, for testing
+    explicit HciManager(int socketDescriptor);
     ~HciManager();
 
     bool isValid() const;
@@ -174,27 +203,58 @@ public:
     bool sendConnectionParameterUpdateRequest(quint16 handle,
                                               const QLowEnergyConnectionParameters &params);
 
+    // Passive LE scan whose reports are emitted by advertisingReportsReceived().
+    // Interval and window are in units of 0.625 ms. Needs CAP_NET_ADMIN. While bluetoothd
+    // scans, only the duplicate filtering is turned off; its scan ends with the discovery.
+    bool startLeScan(quint16 interval = 0x10, quint16 window = 0x10);
+    // 0 emits the reports of each socket notification right away
+    void setAdvertisingReportInterval(int msInterval);
+    int advertisingReportInterval() const { return reportInterval; }
+    void flushAdvertisingReports();
+
+    // Processes a packet as read from the HCI socket, public for testing
+    void handleHciPacket(const quint8 *data, int size);
+
+    const ReadStatistics &readStatistics() const { return statistics; }
+    void resetReadStatistics() { statistics = ReadStatistics(); }
+
 signals:
     void encryptionChangedEvent(const QBluetoothAddress &address, bool wasSuccess);
     void commandCompleted(quint16 opCode, quint8 status, const QByteArray &data);
     void connectionComplete(quint16 handle);
     void connectionUpdate(quint16 handle, const QLowEnergyConnectionParameters &parameters);
     void signatureResolvingKeyReceived(quint16 connHandle, bool remoteKey, BluezUint128 csrk);
+    void advertisingReportsReceived(const QList<HciManager::AdvertisingReport> &reports);
 
 private slots:
     void _q_readNotify();
 
 private:
     int hciForAddress(const QBluetoothAddress &deviceAdapter);
+    int readPackets();
+    void dispatchHciPacket(const quint8 *data, int size);
     void handleHciEventPacket(const quint8 *data, int size);
     void handleHciAclPacket(const quint8 *data, int size);
-    void handleLeMetaEvent(const quint8 *data);
+    void handleLeMetaEvent(const quint8 *data, int size);
+    void handleLeAdvertisingReport(const quint8 *data, int size);
+    void handleLeExtendedAdvertisingReport(const quint8 *data, int size);
+    void addAdvertisingReport(AdvertisingReport &&report);
 
     int hciSocket;
     int hciDev;
     quint8 sigPacketIdentifier = 0;
     QSocketNotifier *notifier = nullptr;
     QSet<HciManager::HciEvent> runningEvents;
+
+    // reused for all reads, room for a batch of packets
+    std::vector<quint8> readBuffer;
+    std::vector<int> packetSizes;
+    bool recvmmsgSupported = true;
+    ReadStatistics statistics;
+
+    QList<AdvertisingReport> pendingReports;
+    QTimer reportTimer;
+    int reportInterval = 0;
 };
 
 QT_END_NAMESPACE
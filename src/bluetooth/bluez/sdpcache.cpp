@@ -0,0 +1,305 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "sdpcache_p.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QSettings>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTimeZone>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
+
+// Increment whenever the layout of the cache file changes
+static const int sdpCacheVersion = 1;
+
+namespace {
+
+struct ConfiguredSdpCache : SdpCache
+{
+    ConfiguredSdpCache()
+    {
+        bool ok = false;
+        const int ttl = qEnvironmentVariableIntValue("QT_BLUETOOTH_SDP_CACHE_TTL", &ok);
+        if (!ok || ttl <= 0)
+            return;
+        setTimeToLive(std::chrono::seconds(ttl));
+
+        const int size = qEnvironmentVariableIntValue("QT_BLUETOOTH_SDP_CACHE_SIZE", &ok);
+        if (ok && size > 0)
+            setMaximumSize(size);
+
+        QString path = qEnvironmentVariable("QT_BLUETOOTH_SDP_CACHE_FILE");
+        if (path.isEmpty()) {
+            const QString cacheDir =
+                    QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+            if (cacheDir.isEmpty())
+                return; // in-memory only
+            path = cacheDir + QLatin1String("/qt_sdp_cache");
+        }
+        setFilePath(path);
+        load(path);
+    }
+};
+
+} // namespace
+
+Q_GLOBAL_STATIC(ConfiguredSdpCache, sdpCache)
+
+SdpCache *SdpCache::instance()
+{
+    return sdpCache();
+}
+
+bool SdpCache::isEnabled() const
+{
+    QMutexLocker locker(&mutex);
+    return ttl > std::chrono::seconds::zero();
+}
+
+void SdpCache::setTimeToLive(std::chrono::seconds timeToLive)
+{
+    QMutexLocker locker(&mutex);
+    ttl = timeToLive;
+}
+
+std::chrono::seconds SdpCache::timeToLive() const
+{
+    QMutexLocker locker(&mutex);
+    return ttl;
+}
+
+void SdpCache::setMaximumSize(qsizetype size)
+{
+    QMutexLocker locker(&mutex);
+    maxSize = qMax(qsizetype(1), size);
+    evict();
+}
+
+qsizetype SdpCache::maximumSize() const
+{
+    QMutexLocker locker(&mutex);
+    return maxSize;
+}
+
+qsizetype SdpCache::size() const
+{
+    QMutexLocker locker(&mutex);
+    return entries.size();
+}
+
+bool SdpCache::isModified() const
+{
+    QMutexLocker locker(&mutex);
+    return modified;
+}
+
+void SdpCache::setFilePath(const QString &filePath)
+{
+    QMutexLocker locker(&mutex);
+    cacheFilePath = filePath;
+}
+
+QString SdpCache::filePath() const
+{
+    QMutexLocker locker(&mutex);
+    return cacheFilePath;
+}
+
+QString SdpCache::key(const QBluetoothAddress &address, const QList<QBluetoothUuid> &uuidFilter)
+{
+    // the order of the filter does not change the scan result
+    QStringList uuids;
+    uuids.reserve(uuidFilter.size());
+    for (const QBluetoothUuid &uuid : uuidFilter)
+        uuids << uuid.toString();
+    uuids.sort();
+    uuids.removeDuplicates();
+    uuids.prepend(address.toString());
+    return uuids.join(QLatin1Char(' '));
+}
+
+std::optional<SdpCache::Entry> SdpCache::find(const QBluetoothAddress &address,
+                                              const QList<QBluetoothUuid> &uuidFilter)
+{
+    QMutexLocker locker(&mutex);
+    const auto it = entries.find(key(address, uuidFilter));
+    if (it == entries.end())
+        return std::nullopt;
+
+    it->lastUsed = ++useCounter;
+    return it->entry;
+}
+
+bool SdpCache::isExpired(const Entry &entry, const QDateTime &now) const
+{
+    QMutexLocker locker(&mutex);
+    return !entry.timestamp.isValid()
+            || entry.timestamp.addSecs(ttl.count()) <= now;
+}
+
+void SdpCache::insert(const QBluetoothAddress &address, const QList<QBluetoothUuid> &uuidFilter,
+                      const QList<QByteArray> &records, const QDateTime &timestamp)
+{
+    QMutexLocker locker(&mutex);
+    CachedEntry &cached = entries[key(address, uuidFilter)];
+    cached.entry.address = address;
+    cached.entry.uuidFilter = uuidFilter;
+    cached.entry.records = records;
+    cached.entry.timestamp = timestamp;
+    cached.lastUsed = ++useCounter;
+    modified = true;
+
+    evict();
+}
+
+void SdpCache::remove(const QBluetoothAddress &address)
+{
+    QMutexLocker locker(&mutex);
+    const qsizetype removed = entries.removeIf([&address](const auto &it) {
+        return it.value().entry.address == address;
+    });
+    if (removed)
+        modified = true;
+}
+
+void SdpCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    if (!entries.isEmpty())
+        modified = true;
+    entries.clear();
+}
+
+void SdpCache::evict()
+{
+    while (entries.size() > maxSize) {
+        const auto lru = std::min_element(entries.begin(), entries.end(),
+                                          [](const CachedEntry &a, const CachedEntry &b) {
+            return a.lastUsed < b.lastUsed;
+        });
+        entries.erase(lru);
+        modified = true;
+    }
+}
+
+bool SdpCache::load(const QString &filePath)
+{
+    QMutexLocker locker(&mutex);
+    entries.clear();
+    modified = false;
+    if (!QFileInfo::exists(filePath))
+        return false;
+
+    QSettings settings(filePath, QSettings::IniFormat);
+    if (settings.value(QLatin1String("Version")).toInt() != sdpCacheVersion) {
+        qCDebug(QT_BT_BLUEZ) << "Ignoring SDP cache" << filePath << "of unknown version";
+        return false;
+    }
+
+    // entries are stored from least to most recently used
+    const int entryCount = settings.beginReadArray(QLatin1String("Entries"));
+    for (int i = 0; i < entryCount; ++i) {
+        settings.setArrayIndex(i);
+        CachedEntry cached;
+        cached.entry.address = QBluetoothAddress(settings.value(QLatin1String("Address"))
+                                                 .toString());
+        const QStringList uuids = settings.value(QLatin1String("UuidFilter")).toStringList();
+        for (const QString &uuid : uuids)
+            cached.entry.uuidFilter << QBluetoothUuid(uuid);
+        cached.entry.timestamp = QDateTime::fromMSecsSinceEpoch(
+                    settings.value(QLatin1String("Timestamp")).toLongLong(), QTimeZone::UTC);
+
+        const int recordCount = settings.beginReadArray(QLatin1String("Records"));
+        for (int j = 0; j < recordCount; ++j) {
+            settings.setArrayIndex(j);
+            cached.entry.records << settings.value(QLatin1String("Data")).toByteArray();
+        }
+        settings.endArray();
+
+        if (cached.entry.address.isNull()) {
+            qCWarning(QT_BT_BLUEZ) << "Ignoring corrupt SDP cache" << filePath;
+            entries.clear();
+            return false;
+        }
+        cached.lastUsed = ++useCounter;
+        entries.insert(key(cached.entry.address, cached.entry.uuidFilter), cached);
+    }
+    settings.endArray();
+
+    evict();
+    modified = false;
+    return true;
+}
+
+bool SdpCache::save(const QString &filePath)
+{
+    QMutexLocker locker(&mutex);
+    return write(filePath);
+}
+
+bool SdpCache::write(const QString &filePath)
+{
+    if (!QDir().mkpath(QFileInfo(filePath).absolutePath()))
+        return false;
+
+    QSettings settings(filePath, QSettings::IniFormat);
+    if (!settings.isWritable())
+        return false;
+
+    QList<const CachedEntry *> ordered;
+    ordered.reserve(entries.size());
+    for (const CachedEntry &cached : std::as_const(entries))
+        ordered << &cached;
+    std::sort(ordered.begin(), ordered.end(), [](const CachedEntry *a, const CachedEntry *b) {
+        return a->lastUsed < b->lastUsed;
+    });
+
+    settings.clear();
+    settings.setValue(QLatin1String("Version"), sdpCacheVersion);
+
+    settings.beginWriteArray(QLatin1String("Entries"), ordered.size());
+    for (qsizetype i = 0; i < ordered.size(); ++i) {
+        const Entry &entry = ordered.at(i)->entry;
+        settings.setArrayIndex(i);
+        settings.setValue(QLatin1String("Address"), entry.address.toString());
+        QStringList uuids;
+        for (const QBluetoothUuid &uuid : entry.uuidFilter)
+            uuids << uuid.toString();
+        settings.setValue(QLatin1String("UuidFilter"), uuids);
+        settings.setValue(QLatin1String("Timestamp"), entry.timestamp.toMSecsSinceEpoch());
+
+        settings.beginWriteArray(QLatin1String("Records"), entry.records.size());
+        for (qsizetype j = 0; j < entry.records.size(); ++j) {
+            settings.setArrayIndex(j);
+            settings.setValue(QLatin1String("Data"), entry.records.at(j));
+        }
+        settings.endArray();
+    }
+    settings.endArray();
+
+    settings.sync();
+    if (settings.status() != QSettings::NoError)
+        return false;
+
+    modified = false;
+    return true;
+}
+
+void SdpCache::sync()
+{
+    QMutexLocker locker(&mutex);
+    if (!modified || cacheFilePath.isEmpty())
+        return;
+
+    if (!write(cacheFilePath))
+        qCWarning(QT_BT_BLUEZ) << "Cannot write SDP cache" << cacheFilePath;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,106 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef SDPCACHE_P_H
+#define SDPCACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <chrono>
+#include <optional>
+
+#include <QtBluetooth/qbluetoothaddress.h>
+#include <QtBluetooth/qbluetoothuuid.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Size-bounded cache of SDP scan results keyed by remote device and UUID filter.
+
+    The records are kept in the binary format of sdpscanner -b, so that cached
+    and fresh records pass through the same parser. Entries older than the time
+    to live are expired but kept until they are refreshed, removed or evicted.
+    The least recently used entry is evicted once maximumSize() is exceeded.
+    The global instance is shared by the agents of all threads, every function
+    is therefore serialized by a mutex.
+ */
+class Q_AUTOTEST_EXPORT SdpCache
+{
+public:
+    struct Entry {
+        QBluetoothAddress address;
+        QList<QBluetoothUuid> uuidFilter;
+        QList<QByteArray> records;
+        QDateTime timestamp;
+    };
+
+    // Configured by QT_BLUETOOTH_SDP_CACHE_TTL, QT_BLUETOOTH_SDP_CACHE_SIZE
+    // and QT_BLUETOOTH_SDP_CACHE_FILE; disabled unless a time to live is set
+    static SdpCache *instance();
+
+    bool isEnabled() const;
+    void setTimeToLive(std::chrono::seconds timeToLive);
+    std::chrono::seconds timeToLive() const;
+    void setMaximumSize(qsizetype size);
+    qsizetype maximumSize() const;
+    qsizetype size() const;
+
+    std::optional<Entry> find(const QBluetoothAddress &address,
+                              const QList<QBluetoothUuid> &uuidFilter);
+    bool isExpired(const Entry &entry,
+                   const QDateTime &now = QDateTime::currentDateTimeUtc()) const;
+    void insert(const QBluetoothAddress &address, const QList<QBluetoothUuid> &uuidFilter,
+                const QList<QByteArray> &records,
+                const QDateTime &timestamp = QDateTime::currentDateTimeUtc());
+    // Drops the results of all UUID filters of the device
+    void remove(const QBluetoothAddress &address);
+    void clear();
+
+    bool load(const QString &filePath);
+    bool save(const QString &filePath);
+    bool isModified() const;
+
+    // File used by sync(), no persistence if empty
+    void setFilePath(const QString &filePath);
+    QString filePath() const;
+    // Saves the cache if it changed since it was loaded or saved
+    void sync();
+
+private:
+    struct CachedEntry {
+        Entry entry;
+        quint64 lastUsed = 0;
+    };
+
+    static QString key(const QBluetoothAddress &address, const QList<QBluetoothUuid> &uuidFilter);
+    void evict();
+    bool write(const QString &filePath);
+
+    mutable QMutex mutex;
+    QHash<QString, CachedEntry> entries;
+    QString cacheFilePath;
+    std::chrono::seconds ttl = std::chrono::seconds::zero();
+    qsizetype maxSize = 256;
+    quint64 useCounter = 0;
+    bool modified = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // SDPCACHE_P_H
@@ -0,0 +1,307 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "sdpscannerworker_p.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFileInfo>
+#include <QtCore/QLibraryInfo>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QtEndian>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
+
+// Frame types of the sdpscanner worker mode, see src/tools/sdpscanner
+enum WorkerFrameType : quint8 {
+    WorkerRecordFrame = 0x01,
+    WorkerFinishedFrame = 0x02
+};
+
+// frame type and remote address following the frame size
+static constexpr qsizetype frameHeaderSize = 1 + 6;
+// Upper bound for a single frame, anything larger indicates a corrupt stream
+static constexpr quint32 maxFrameSize = 1024 * 1024;
+// Exit code of sdpscanner for unknown options
+static constexpr int sdpScannerUsageError = 1;
+
+Q_GLOBAL_STATIC(QtBluezSdpScannerWorker, sdpScannerWorker)
+
+QtBluezSdpScannerWorker::QtBluezSdpScannerWorker(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QtBluezSdpScannerWorker::~QtBluezSdpScannerWorker()
+{
+    stopWorkers();
+}
+
+// true while stopSdpScannerWorkers() is registered for the current QCoreApplication
+static bool stopRoutineAdded = false;
+
+// The processes have to end while QCoreApplication exists, rather than in the
+// destructor of the global instance
+static void stopSdpScannerWorkers()
+{
+    stopRoutineAdded = false;
+    if (sdpScannerWorker.exists())
+        sdpScannerWorker->stopWorkers();
+}
+
+QtBluezSdpScannerWorker *QtBluezSdpScannerWorker::instance()
+{
+    QtBluezSdpScannerWorker *worker = sdpScannerWorker();
+    // post routines are dropped once called, a later application registers it again
+    if (!stopRoutineAdded && QCoreApplication::instance()) {
+        qAddPostRoutine(stopSdpScannerWorkers);
+        stopRoutineAdded = true;
+    }
+    return worker;
+}
+
+void QtBluezSdpScannerWorker::stopWorkers()
+{
+    for (const auto &worker : workers) {
+        QProcess *process = worker->process;
+        if (!process)
+            continue;
+
+        // no more job results are of interest
+        process->disconnect(this);
+        if (process->state() != QProcess::NotRunning) {
+            // closing stdin lets the worker terminate once the current job is done
+            process->closeWriteChannel();
+            if (!process->waitForFinished(500)) {
+                process->kill();
+                process->waitForFinished();
+            }
+        }
+        delete process;
+    }
+    workers.clear();
+    jobQueue.clear();
+    // later scans start new processes
+}
+
+void QtBluezSdpScannerWorker::setMaximumProcessCount(int count)
+{
+    maxProcessCount = qMax(1, count);
+    // surplus workers are not stopped, they merely do not get new jobs
+    QMetaObject::invokeMethod(this, [this]() { runNextJobs(); }, Qt::QueuedConnection);
+}
+
+void QtBluezSdpScannerWorker::setProgram(const QString &path)
+{
+    program = path;
+}
+
+quint64 QtBluezSdpScannerWorker::scan(const QBluetoothAddress &remote,
+                                      const QBluetoothAddress &local,
+                                      const QList<QBluetoothUuid> &uuidFilter)
+{
+    Job job;
+    job.id = ++lastJobId;
+    job.remote = remote;
+    job.command = remote.toString().toLatin1() + ' ' + local.toString().toLatin1();
+    // No filter implies PUBLIC_BROWSE_GROUP based SDP scan
+    for (const QBluetoothUuid &uuid : uuidFilter)
+        job.command += ' ' + uuid.toString().toLatin1();
+    job.command += '\n';
+
+    jobQueue.push_back(job);
+    // results are always reported asynchronously, even if the worker is unavailable
+    QMetaObject::invokeMethod(this, [this]() { runNextJobs(); }, Qt::QueuedConnection);
+
+    return job.id;
+}
+
+void QtBluezSdpScannerWorker::cancel(quint64 jobId)
+{
+    for (auto it = jobQueue.begin(); it != jobQueue.end(); ++it) {
+        if (it->id == jobId) {
+            jobQueue.erase(it);
+            return;
+        }
+    }
+
+    for (const auto &worker : workers) {
+        if (worker->job && worker->job->id == jobId) {
+            worker->job->canceled = true; // sdpscanner cannot be interrupted
+            return;
+        }
+    }
+}
+
+QtBluezSdpScannerWorker::Worker *QtBluezSdpScannerWorker::idleWorker()
+{
+    for (const auto &worker : workers) {
+        if (!worker->job)
+            return worker.get();
+    }
+
+    if (int(workers.size()) >= maxProcessCount)
+        return nullptr;
+
+    workers.push_back(std::make_unique<Worker>());
+    return workers.back().get();
+}
+
+bool QtBluezSdpScannerWorker::ensureProcess(Worker *worker)
+{
+    if (worker->process && worker->process->state() != QProcess::NotRunning)
+        return true;
+
+    QString path = program;
+    if (path.isEmpty()) {
+        const QString binPath = QLibraryInfo::path(QLibraryInfo::LibraryExecutablesPath);
+        const QFileInfo fileInfo(binPath, QStringLiteral("sdpscanner"));
+        if (!fileInfo.exists() || !fileInfo.isExecutable()) {
+            qCWarning(QT_BT_BLUEZ) << "Cannot find sdpscanner:" << fileInfo.canonicalFilePath();
+            return false;
+        }
+        path = fileInfo.canonicalFilePath();
+    }
+
+    if (!worker->process) {
+        QProcess *process = new QProcess(this);
+        process->setReadChannel(QProcess::StandardOutput);
+        // a long-lived worker must not fill up an unread stderr pipe
+        if (QT_BT_BLUEZ().isDebugEnabled())
+            process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        else
+            process->setStandardErrorFile(QProcess::nullDevice());
+        process->setArguments({ QStringLiteral("-w") });
+        connect(process, &QProcess::readyReadStandardOutput, this, [this, worker]() {
+            readFrames(worker);
+        });
+        connect(process, &QProcess::finished,
+                this, [this, worker](int exitCode, QProcess::ExitStatus status) {
+            workerFinished(worker, exitCode, status);
+        });
+        worker->process = process;
+    }
+
+    worker->output.clear();
+    worker->process->setProgram(path);
+    worker->process->start();
+    return true;
+}
+
+void QtBluezSdpScannerWorker::runNextJobs()
+{
+    while (!jobQueue.empty()) {
+        // no new processes once the application is gone
+        if (!available || !QCoreApplication::instance()) {
+            failQueuedJobs(WorkerUnavailable);
+            return;
+        }
+
+        Worker *worker = idleWorker();
+        if (!worker)
+            return; // all workers are busy
+
+        if (!ensureProcess(worker)) {
+            // jobs of the other workers are still completed
+            available = false;
+            failQueuedJobs(WorkerUnavailable);
+            return;
+        }
+
+        worker->job = jobQueue.front();
+        jobQueue.pop_front();
+        worker->process->write(worker->job->command);
+    }
+}
+
+void QtBluezSdpScannerWorker::finishJob(Worker *worker, int exitCode)
+{
+    const Job job = *worker->job;
+    worker->job.reset();
+    if (!job.canceled)
+        emit scanFinished(job.id, exitCode);
+}
+
+void QtBluezSdpScannerWorker::failQueuedJobs(int exitCode)
+{
+    while (!jobQueue.empty()) {
+        const Job job = jobQueue.front();
+        jobQueue.pop_front();
+        emit scanFinished(job.id, exitCode);
+    }
+}
+
+void QtBluezSdpScannerWorker::readFrames(Worker *worker)
+{
+    QByteArray &output = worker->output;
+    output += worker->process->readAllStandardOutput();
+
+    qsizetype offset = 0;
+    while (output.size() - offset >= qsizetype(sizeof(quint32))) {
+        const quint32 frameSize = qFromBigEndian<quint32>(output.constData() + offset);
+        if (frameSize < frameHeaderSize || frameSize > maxFrameSize) {
+            qCWarning(QT_BT_BLUEZ) << "Restarting sdpscanner after corrupt output";
+            output.clear();
+            // workerFinished() fails the current job and continues with the next one
+            worker->process->kill();
+            return;
+        }
+        if (output.size() - offset - qsizetype(sizeof(quint32)) < frameSize)
+            break; // wait for the remainder of the frame
+
+        const char *frame = output.constData() + offset + sizeof(quint32);
+        offset += sizeof(quint32) + frameSize;
+        workerConfirmed = true;
+
+        const quint8 type = quint8(frame[0]);
+        quint64 address = 0;
+        for (int i = 1; i < frameHeaderSize; ++i)
+            address = (address << 8) | quint8(frame[i]);
+        const QBluetoothAddress remote(address);
+        const QByteArray payload(frame + frameHeaderSize, frameSize - frameHeaderSize);
+
+        // sdpscanner reports a null address if it cannot parse the remote address
+        const bool currentJob = worker->job
+                && (worker->job->remote == remote
+                    || (type == WorkerFinishedFrame && remote.isNull()));
+        if (!currentJob) {
+            qCWarning(QT_BT_BLUEZ) << "Ignoring unexpected sdpscanner result for"
+                                   << remote.toString();
+            continue;
+        }
+
+        if (type == WorkerRecordFrame) {
+            if (!worker->job->canceled)
+                emit recordReceived(worker->job->id, payload);
+        } else if (type == WorkerFinishedFrame) {
+            finishJob(worker, payload.isEmpty() ? WorkerCrashed : int(payload.at(0)));
+        }
+    }
+    output.remove(0, offset);
+
+    runNextJobs();
+}
+
+void QtBluezSdpScannerWorker::workerFinished(Worker *worker, int exitCode,
+                                             QProcess::ExitStatus status)
+{
+    if (!workerConfirmed && status == QProcess::NormalExit && exitCode == sdpScannerUsageError) {
+        qCDebug(QT_BT_BLUEZ) << "sdpscanner does not support the worker mode";
+        available = false;
+        // the jobs of the other workers finish on their own
+        if (worker->job)
+            finishJob(worker, WorkerUnavailable);
+        failQueuedJobs(WorkerUnavailable);
+        return;
+    }
+
+    qCWarning(QT_BT_BLUEZ) << "sdpscanner worker terminated" << status << exitCode;
+    if (worker->job)
+        finishJob(worker, WorkerCrashed);
+
+    // restarts the worker for the remaining jobs
+    runNextJobs();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,115 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef SDPSCANNERWORKER_P_H
+#define SDPSCANNERWORKER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QProcess>
+#include <QtCore/QString>
+
+#include <QtBluetooth/qbluetoothaddress.h>
+#include <QtBluetooth/qbluetoothuuid.h>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Pool of long-lived sdpscanner processes shared by all service discovery agents.
+
+    Every process handles one scan job at a time. Up to maximumProcessCount()
+    jobs run in parallel, the remaining ones are queued. The records of a scan
+    are reported as they arrive, tagged with the id returned by scan().
+ */
+class Q_AUTOTEST_EXPORT QtBluezSdpScannerWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // exit codes of scanFinished() in addition to the ones of sdpscanner
+    enum {
+        // the installed sdpscanner does not support the worker mode
+        WorkerUnavailable = -1,
+        // the worker terminated while scanning
+        WorkerCrashed = -2
+    };
+
+    explicit QtBluezSdpScannerWorker(QObject *parent = nullptr);
+    ~QtBluezSdpScannerWorker() override;
+    static QtBluezSdpScannerWorker *instance();
+
+    bool isAvailable() const { return available; }
+
+    // Number of sdpscanner processes and therefore of parallel scans, default is 1
+    void setMaximumProcessCount(int count);
+    int maximumProcessCount() const { return maxProcessCount; }
+
+    // Overrides the installed sdpscanner, used by tests
+    void setProgram(const QString &program);
+
+    quint64 scan(const QBluetoothAddress &remote, const QBluetoothAddress &local,
+                 const QList<QBluetoothUuid> &uuidFilter);
+    // Results of a canceled scan are not reported anymore
+    void cancel(quint64 jobId);
+    // Terminates all sdpscanner processes, pending scans are not reported anymore.
+    // Later scans start new processes.
+    void stopWorkers();
+
+signals:
+    void recordReceived(quint64 jobId, const QByteArray &record);
+    void scanFinished(quint64 jobId, int exitCode);
+
+private:
+    struct Job {
+        quint64 id;
+        QBluetoothAddress remote;
+        QByteArray command;
+        bool canceled = false;
+    };
+
+    struct Worker {
+        QProcess *process = nullptr;
+        QByteArray output;
+        // job processed by this sdpscanner instance, if any
+        std::optional<Job> job;
+    };
+
+    Worker *idleWorker();
+    bool ensureProcess(Worker *worker);
+    void runNextJobs();
+    void finishJob(Worker *worker, int exitCode);
+    void failQueuedJobs(int exitCode);
+    void readFrames(Worker *worker);
+    void workerFinished(Worker *worker, int exitCode, QProcess::ExitStatus status);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    // jobs which are not yet handed to a worker
+    std::deque<Job> jobQueue;
+    quint64 lastJobId = 0;
+    int maxProcessCount = 1;
+    QString program;
+    // true once the worker has sent anything, i.e. it supports the worker mode
+    bool workerConfirmed = false;
+    bool available = true;
+};
+
+QT_END_NAMESPACE
+
+#endif // SDPSCANNERWORKER_P_H
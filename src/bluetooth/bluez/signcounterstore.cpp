@@ -0,0 +1,162 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "signcounterstore_p.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFileInfo>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QSettings>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
+
+static QString entryKey(const QString &filePath, SignCounterStore::KeyType keyType)
+{
+    return filePath + u'#' + SignCounterStore::settingsGroup(keyType);
+}
+
+SignCounterStore::SignCounterStore(QObject *parent)
+    : QObject(parent)
+{
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(1000);
+    connect(&flushTimer, &QTimer::timeout, this, &SignCounterStore::flush);
+}
+
+SignCounterStore::~SignCounterStore()
+{
+    flush();
+    if (stats.flushes || stats.reservations) {
+        qCDebug(QT_BT_BLUEZ) << "sign counter store:" << stats.flushes << "flushes,"
+                             << stats.reservations << "reservations,"
+                             << stats.writtenCounters << "written counters,"
+                             << stats.failedWrites << "failed writes, max write time"
+                             << stats.maxWriteTime / 1000 << "us";
+    }
+}
+
+void SignCounterStore::setFlushInterval(int msec)
+{
+    flushTimer.setInterval(qMax(0, msec));
+}
+
+void SignCounterStore::setReservationSize(quint32 size)
+{
+    reservation = qMax(1u, size);
+}
+
+QString SignCounterStore::settingsGroup(KeyType keyType)
+{
+    return QLatin1String(keyType == LocalKey ? "LocalSignatureKey" : "RemoteSignatureKey");
+}
+
+quint32 SignCounterStore::nextCounter(const QString &filePath, KeyType keyType,
+                                      quint32 storedCounter)
+{
+    const QString key = entryKey(filePath, keyType);
+    const auto it = entries.constFind(key);
+    if (it != entries.constEnd())
+        return it->nextCounter; // the file may lag behind
+
+    Entry entry;
+    entry.filePath = filePath;
+    entry.keyType = keyType;
+    entry.nextCounter = storedCounter;
+    entry.storedCounter = storedCounter;
+    entries.insert(key, entry);
+    return storedCounter;
+}
+
+void SignCounterStore::setNextCounter(const QString &filePath, KeyType keyType, quint32 counter)
+{
+    const QString key = entryKey(filePath, keyType);
+    auto it = entries.find(key);
+    // the value in the file is unknown, it gets written in any case
+    if (it == entries.end())
+        it = entries.insert(key, Entry{ filePath, keyType, counter, 0, false });
+
+    Entry &entry = it.value();
+    entry.nextCounter = counter;
+    if (keyType == LocalKey) {
+        // Counters up to storedCounter are covered by the file already.
+        if (counter <= entry.storedCounter)
+            return;
+        const quint32 reserved = counter > quint32(-1) - reservation
+                ? quint32(-1) : counter + reservation;
+        ++stats.reservations;
+        if (writeCounter(filePath, keyType, reserved))
+            entry.storedCounter = reserved;
+        return;
+    }
+
+    entry.dirty = counter != entry.storedCounter;
+    if (entry.dirty && !flushTimer.isActive())
+        flushTimer.start();
+}
+
+void SignCounterStore::remove(const QString &filePath, KeyType keyType)
+{
+    entries.remove(entryKey(filePath, keyType));
+}
+
+void SignCounterStore::flush()
+{
+    flushTimer.stop();
+    bool flushed = false;
+    bool failed = false;
+    for (Entry &entry : entries) {
+        if (!entry.dirty)
+            continue;
+        flushed = true;
+        if (writeCounter(entry.filePath, entry.keyType, entry.nextCounter)) {
+            entry.storedCounter = entry.nextCounter;
+            entry.dirty = false;
+        } else {
+            failed = true;
+        }
+    }
+    if (flushed)
+        ++stats.flushes;
+    // the next flush repeats the failed writes
+    if (failed)
+        flushTimer.start();
+}
+
+// Returns false if the counter could not be written, i.e. the write is to be repeated
+bool SignCounterStore::writeCounter(const QString &filePath, KeyType keyType, quint32 counter)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // BlueZ owns the key file, the counter is only updated if it exists
+    if (!QFileInfo::exists(filePath))
+        return true;
+    QSettings settings(filePath, QSettings::IniFormat);
+    if (!settings.isWritable()) {
+        ++stats.failedWrites;
+        return false;
+    }
+    settings.beginGroup(settingsGroup(keyType));
+    const QString counterKey = QLatin1String("Counter");
+    if (!settings.contains(counterKey))
+        return true;
+    if (settings.value(counterKey).toUInt() != counter) {
+        settings.setValue(counterKey, counter);
+        settings.sync();
+        if (settings.status() != QSettings::NoError) {
+            qCWarning(QT_BT_BLUEZ) << "Cannot store sign counter in" << filePath;
+            ++stats.failedWrites;
+            return false;
+        }
+        ++stats.writtenCounters;
+    }
+
+    const qint64 elapsed = timer.nsecsElapsed();
+    stats.totalWriteTime += elapsed;
+    stats.maxWriteTime = qMax(stats.maxWriteTime, elapsed);
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,96 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef SIGNCOUNTERSTORE_P_H
+#define SIGNCOUNTERSTORE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Write-behind cache for the sign counters in the BlueZ key files.
+
+    The "Counter" entry of a signature key group holds the next counter value
+    to be used (local key) respectively expected (remote key).
+
+    Local counters are never written behind. Instead a block of counter values
+    is reserved on disk ahead of use, so that no value is ever used twice, even
+    if the process crashes. Remote counters are written at most
+    flushInterval() milliseconds after they changed, and always by flush().
+ */
+class Q_AUTOTEST_EXPORT SignCounterStore : public QObject
+{
+    Q_OBJECT
+public:
+    enum KeyType { LocalKey, RemoteKey };
+
+    struct Statistics {
+        quint64 flushes = 0;
+        // counter values written by flushes and reservations
+        quint64 writtenCounters = 0;
+        quint64 reservations = 0;
+        quint64 failedWrites = 0;
+        // time in ns spent writing key files
+        qint64 totalWriteTime = 0;
+        qint64 maxWriteTime = 0;
+    };
+
+    explicit SignCounterStore(QObject *parent = nullptr);
+    ~SignCounterStore() override;
+
+    void setFlushInterval(int msec);
+    int flushInterval() const { return flushTimer.interval(); }
+    // Number of local counter values reserved by a single write
+    void setReservationSize(quint32 size);
+    quint32 reservationSize() const { return reservation; }
+
+    // Returns the next counter of the key, storedCounter is the value read from filePath
+    quint32 nextCounter(const QString &filePath, KeyType keyType, quint32 storedCounter);
+    void setNextCounter(const QString &filePath, KeyType keyType, quint32 counter);
+    // Drops the cached counter, e.g. after the key was replaced
+    void remove(const QString &filePath, KeyType keyType);
+    // Writes all pending remote counters, failed writes are repeated after flushInterval()
+    void flush();
+
+    const Statistics &statistics() const { return stats; }
+    void resetStatistics() { stats = Statistics(); }
+
+    static QString settingsGroup(KeyType keyType);
+
+private:
+    struct Entry {
+        QString filePath;
+        KeyType keyType;
+        quint32 nextCounter = 0;
+        // value of the file, for local keys the end of the reserved block
+        quint32 storedCounter = 0;
+        bool dirty = false;
+    };
+
+    bool writeCounter(const QString &filePath, KeyType keyType, quint32 counter);
+
+    QHash<QString, Entry> entries;
+    QTimer flushTimer;
+    quint32 reservation = 64;
+    Statistics stats;
+};
+
+QT_END_NAMESPACE
+
+#endif // SIGNCOUNTERSTORE_P_H
@@ -8,6 +8,7 @@
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/private/qcore_unix_p.h>
 
+#include <algorithm>
 #include <cstring>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -21,34 +22,20 @@ QT_BEGIN_NAMESPACE
 
 Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
 
+// Number of signature keys whose crypto sockets are kept open
+static constexpr qsizetype maxCachedKeys = 8;
+
 LeCmacCalculator::LeCmacCalculator()
 {
-#ifdef CONFIG_LINUX_CRYPTO_API
-    m_baseSocket = socket(AF_ALG, SOCK_SEQPACKET, 0);
-    if (m_baseSocket == -1) {
-        qCWarning(QT_BT_BLUEZ) << "failed to create first level crypto socket:"
-                               << strerror(errno);
-        return;
-    }
-    sockaddr_alg sa;
-    using namespace std;
-    memset(&sa, 0, sizeof sa);
-    sa.salg_family = AF_ALG;
-    strcpy(reinterpret_cast<char *>(sa.salg_type), "hash");
-    strcpy(reinterpret_cast<char *>(sa.salg_name), "cmac(aes)");
-    if (::bind(m_baseSocket, reinterpret_cast<sockaddr *>(&sa), sizeof sa) == -1) {
-        qCWarning(QT_BT_BLUEZ) << "bind() failed for crypto socket:" << strerror(errno);
-        return;
-    }
-#else // CONFIG_LINUX_CRYPTO_API
+#ifndef CONFIG_LINUX_CRYPTO_API
     qCWarning(QT_BT_BLUEZ) << "Linux crypto API not present, CMAC verification will fail.";
 #endif
 }
 
 LeCmacCalculator::~LeCmacCalculator()
 {
-    if (m_baseSocket != -1)
-        close(m_baseSocket);
+    for (const KeySockets &sockets : std::as_const(m_keySockets))
+        closeSockets(sockets);
 }
 
 QByteArray LeCmacCalculator::createFullMessage(const QByteArray &message, quint32 signCounter)
@@ -60,60 +47,114 @@ QByteArray LeCmacCalculator::createFullMessage(const QByteArray &message, quint3
     return fullMessage;
 }
 
-quint64 LeCmacCalculator::calculateMac(const QByteArray &message, QUuid::Id128Bytes csrk) const
+void LeCmacCalculator::closeSockets(const KeySockets &sockets)
+{
+    if (sockets.operationSocket != -1)
+        close(sockets.operationSocket);
+    if (sockets.baseSocket != -1)
+        close(sockets.baseSocket);
+}
+
+/*
+    Returns the operation socket for csrk, -1 on error.
+
+    The key of an AF_ALG hash is shared by all operation sockets accepted from
+    the same base socket. Every key therefore gets its own pair of sockets.
+ */
+int LeCmacCalculator::operationSocket(const QUuid::Id128Bytes &csrk) const
 {
 #ifdef CONFIG_LINUX_CRYPTO_API
-    if (m_baseSocket == -1)
-        return false;
+    for (qsizetype i = 0; i < m_keySockets.size(); ++i) {
+        if (memcmp(m_keySockets.at(i).csrk.data, csrk.data, sizeof csrk.data) == 0) {
+            m_keySockets.move(i, 0);
+            return m_keySockets.first().operationSocket;
+        }
+    }
+
+    KeySockets sockets;
+    sockets.csrk = csrk;
+    sockets.baseSocket = socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sockets.baseSocket == -1) {
+        qCWarning(QT_BT_BLUEZ) << "failed to create first level crypto socket:"
+                               << strerror(errno);
+        return -1;
+    }
+    sockaddr_alg sa;
+    using namespace std;
+    memset(&sa, 0, sizeof sa);
+    sa.salg_family = AF_ALG;
+    strcpy(reinterpret_cast<char *>(sa.salg_type), "hash");
+    strcpy(reinterpret_cast<char *>(sa.salg_name), "cmac(aes)");
+    if (::bind(sockets.baseSocket, reinterpret_cast<sockaddr *>(&sa), sizeof sa) == -1) {
+        qCWarning(QT_BT_BLUEZ) << "bind() failed for crypto socket:" << strerror(errno);
+        closeSockets(sockets);
+        return -1;
+    }
+
     QUuid::Id128Bytes csrkMsb;
     std::reverse_copy(std::begin(csrk.data), std::end(csrk.data), std::begin(csrkMsb.data));
     qCDebug(QT_BT_BLUEZ) << "CSRK (MSB):" << QByteArray(reinterpret_cast<char *>(csrkMsb.data),
                                                         sizeof csrkMsb).toHex();
-    if (setsockopt(m_baseSocket, 279 /* SOL_ALG */, ALG_SET_KEY, csrkMsb.data, sizeof csrkMsb) == -1) {
+    if (setsockopt(sockets.baseSocket, 279 /* SOL_ALG */, ALG_SET_KEY, csrkMsb.data,
+                   sizeof csrkMsb) == -1) {
         qCWarning(QT_BT_BLUEZ) << "setsockopt() failed for crypto socket:" << strerror(errno);
-        return 0;
+        closeSockets(sockets);
+        return -1;
     }
 
-    class SocketWrapper
-    {
-    public:
-        SocketWrapper(int socket) : m_socket(socket) {}
-        ~SocketWrapper() {
-            if (m_socket != -1)
-                close(m_socket);
-        }
-
-        int value() const { return m_socket; }
-    private:
-        int m_socket;
-    };
-    SocketWrapper cryptoSocket(accept(m_baseSocket, nullptr, nullptr));
-    if (cryptoSocket.value() == -1) {
+    sockets.operationSocket = accept4(sockets.baseSocket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sockets.operationSocket == -1) {
         qCWarning(QT_BT_BLUEZ) << "accept() failed for crypto socket:" << strerror(errno);
-        return 0;
+        closeSockets(sockets);
+        return -1;
     }
 
-    QByteArray messageSwapped(message.size(), Qt::Uninitialized);
-    std::reverse_copy(message.begin(), message.end(), messageSwapped.begin());
+    if (m_keySockets.size() >= maxCachedKeys)
+        closeSockets(m_keySockets.takeLast());
+    m_keySockets.prepend(sockets);
+    return sockets.operationSocket;
+#else // CONFIG_LINUX_CRYPTO_API
+    Q_UNUSED(csrk);
+    return -1;
+#endif
+}
+
+quint64 LeCmacCalculator::calculateMac(const QByteArray &message, QUuid::Id128Bytes csrk) const
+{
+#ifdef CONFIG_LINUX_CRYPTO_API
+    const int cryptoSocket = operationSocket(csrk);
+    if (cryptoSocket == -1)
+        return 0;
+
+    // the socket is in an undefined state after an error
+    const auto discardSocket = [this]() {
+        closeSockets(m_keySockets.takeFirst());
+    };
+
+    // Each write without MSG_MORE is a complete message, the MAC is read right after.
+    m_messageBuffer.resize(message.size());
+    std::reverse_copy(message.begin(), message.end(), m_messageBuffer.begin());
     qint64 totalBytesWritten = 0;
     do {
-        const qint64 bytesWritten = qt_safe_write(cryptoSocket.value(),
-                                                  messageSwapped.constData() + totalBytesWritten,
-                                                  messageSwapped.size() - totalBytesWritten);
+        const qint64 bytesWritten = qt_safe_write(cryptoSocket,
+                                                  m_messageBuffer.constData() + totalBytesWritten,
+                                                  m_messageBuffer.size() - totalBytesWritten);
         if (bytesWritten == -1) {
             qCWarning(QT_BT_BLUEZ) << "writing to crypto socket failed:" << strerror(errno);
+            discardSocket();
             return 0;
         }
         totalBytesWritten += bytesWritten;
-    } while (totalBytesWritten < messageSwapped.size());
+    } while (totalBytesWritten < m_messageBuffer.size());
     quint64 mac;
     quint8 * const macPtr = reinterpret_cast<quint8 *>(&mac);
     qint64 totalBytesRead = 0;
     do {
-        const qint64 bytesRead = qt_safe_read(cryptoSocket.value(), macPtr + totalBytesRead,
+        const qint64 bytesRead = qt_safe_read(cryptoSocket, macPtr + totalBytesRead,
                                               sizeof mac - totalBytesRead);
         if (bytesRead == -1) {
             qCWarning(QT_BT_BLUEZ) << "reading from crypto socket failed:" << strerror(errno);
+            discardSocket();
             return 0;
         }
         totalBytesRead += bytesRead;
@@ -15,12 +15,15 @@
 //
 
 #include <QtCore/private/qglobal_p.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
 #include <QtCore/quuid.h>
 
 QT_BEGIN_NAMESPACE
 
 class Q_AUTOTEST_EXPORT LeCmacCalculator
 {
+    Q_DISABLE_COPY_MOVE(LeCmacCalculator)
 public:
     LeCmacCalculator();
     ~LeCmacCalculator();
@@ -33,7 +36,21 @@ public:
     bool verify(const QByteArray &message, QUuid::Id128Bytes csrk, quint64 expectedMac) const;
 
 private:
-    int m_baseSocket = -1;
+    // AF_ALG sockets of one key. The key belongs to the base socket, the
+    // operation socket computes any number of MACs with it.
+    struct KeySockets {
+        QUuid::Id128Bytes csrk;
+        int baseSocket = -1;
+        int operationSocket = -1;
+    };
+
+    int operationSocket(const QUuid::Id128Bytes &csrk) const;
+    static void closeSockets(const KeySockets &sockets);
+
+    // most recently used first
+    mutable QList<KeySockets> m_keySockets;
+    // byte swapped message, kept to avoid an allocation per MAC
+    mutable QByteArray m_messageBuffer;
 };
 
 
@@ -4,6 +4,9 @@
 
 #include "qbluetoothdevicediscoveryagent.h"
 #include "qbluetoothdevicediscoveryagent_p.h"
+#if QT_CONFIG(bluez)
+#include "bluez/discovereddevices_p.h"
+#endif
 #include <QtCore/qloggingcategory.h>
 
 QT_BEGIN_NAMESPACE
@@ -128,6 +131,30 @@ Q_DECLARE_LOGGING_CATEGORY(QT_BT)
     \sa QBluetoothDeviceInfo::rssi(), lowEnergyDiscoveryTimeout()
 */
 
+/*!
+    \fn void QBluetoothDeviceDiscoveryAgent::devicesDiscovered(const QList<QBluetoothDeviceInfo> &infos)
+
+    This signal replaces \l deviceDiscovered() if \l deviceBatchInterval() is
+    larger than \c 0. It reports the devices \a infos which were discovered, or
+    which would have been reported by \l deviceDiscovered() again, since the last
+    emission. Each device is contained at most once.
+
+    \sa setDeviceBatchInterval(), devicesUpdated()
+    \since 6.9
+*/
+
+/*!
+    \fn void QBluetoothDeviceDiscoveryAgent::devicesUpdated(const QList<QBluetoothDeviceInfo> &infos)
+
+    This signal replaces \l deviceUpdated() if \l deviceBatchInterval() is
+    larger than \c 0. It reports the devices \a infos whose signal strength or
+    manufacturer data changed since the last emission. Devices which are reported
+    by \l devicesDiscovered() in the same interval are not contained.
+
+    \sa setDeviceBatchInterval(), devicesDiscovered()
+    \since 6.9
+*/
+
 /*!
     \fn void QBluetoothDeviceDiscoveryAgent::finished()
 
@@ -209,7 +236,11 @@ QBluetoothDeviceDiscoveryAgent::~QBluetoothDeviceDiscoveryAgent()
 QList<QBluetoothDeviceInfo> QBluetoothDeviceDiscoveryAgent::discoveredDevices() const
 {
     Q_D(const QBluetoothDeviceDiscoveryAgent);
+#if QT_CONFIG(bluez)
+    return d->devices->devices();
+#else
     return d->discoveredDevices;
+#endif
 }
 
 /*!
@@ -266,6 +297,251 @@ int QBluetoothDeviceDiscoveryAgent::lowEnergyDiscoveryTimeout() const
     return d->lowEnergySearchTimeout;
 }
 
+/*!
+    Sets the interval for batched device signals to \a msInterval milliseconds.
+
+    If \a msInterval is larger than \c 0, the \l deviceDiscovered() and
+    \l deviceUpdated() signals are no longer emitted. Instead, all devices which
+    were discovered or updated since the last emission are reported by the
+    \l devicesDiscovered() and \l devicesUpdated() signals, which are emitted at most
+    once per \a msInterval. This reduces the signal load when a large number of
+    Bluetooth Low Energy devices is advertising. The remaining devices are reported
+    before \l finished() or \l canceled() is emitted. The default of \c 0 emits
+    a signal per device.
+
+    The new interval does not take effect until the device search is restarted.
+
+    \note Currently this is only supported on Linux (BlueZ).
+
+    \sa deviceBatchInterval()
+    \since 6.9
+ */
+void QBluetoothDeviceDiscoveryAgent::setDeviceBatchInterval(int msInterval)
+{
+    Q_D(QBluetoothDeviceDiscoveryAgent);
+
+    if (msInterval < 0) {
+        qCDebug(QT_BT) << "The device batch interval cannot be negative.";
+        return;
+    }
+
+    if (d->deviceBatchInterval < 0) {
+        qCDebug(QT_BT) << "The device batch interval cannot be set on a backend "
+                          "which does not support this feature.";
+        return;
+    }
+
+    d->deviceBatchInterval = msInterval;
+}
+
+/*!
+    Returns the interval in milliseconds for batched device signals. A value of \c -1
+    implies that the platform does not support batched signals. A return value of \c 0
+    implies that each device is reported by its own signal.
+
+    \sa setDeviceBatchInterval()
+    \since 6.9
+ */
+int QBluetoothDeviceDiscoveryAgent::deviceBatchInterval() const
+{
+    Q_D(const QBluetoothDeviceDiscoveryAgent);
+    return d->deviceBatchInterval;
+}
+
+/*!
+    Limits the number of devices kept in discoveredDevices() to \a count.
+
+    Once the limit is reached, the devices which have not been seen for the
+    longest time are removed to make room for new devices. Removed devices are
+    reported by \l deviceDiscovered() again once they are seen again. This bounds
+    the memory of long-running searches in environments with many Bluetooth Low
+    Energy advertisers. The default of \c 0 keeps all devices.
+
+    The new limit does not take effect until the device search is restarted.
+
+    \note Currently this is only supported on Linux (BlueZ).
+
+    \sa maximumDeviceCount(), setMaximumDeviceAge()
+    \since 6.9
+ */
+void QBluetoothDeviceDiscoveryAgent::setMaximumDeviceCount(int count)
+{
+    Q_D(QBluetoothDeviceDiscoveryAgent);
+
+    if (count < 0) {
+        qCDebug(QT_BT) << "The maximum device count cannot be negative.";
+        return;
+    }
+
+    if (d->maximumDeviceCount < 0) {
+        qCDebug(QT_BT) << "The maximum device count cannot be set on a backend "
+                          "which does not support this feature.";
+        return;
+    }
+
+    d->maximumDeviceCount = count;
+}
+
+/*!
+    Returns the maximum number of devices kept in discoveredDevices(). A value of
+    \c -1 implies that the platform does not support removing devices. A return
+    value of \c 0 implies that all devices are kept.
+
+    \sa setMaximumDeviceCount()
+    \since 6.9
+ */
+int QBluetoothDeviceDiscoveryAgent::maximumDeviceCount() const
+{
+    Q_D(const QBluetoothDeviceDiscoveryAgent);
+    return d->maximumDeviceCount;
+}
+
+/*!
+    Removes devices from discoveredDevices() which have not been seen for
+    \a msAge milliseconds.
+
+    Removed devices are reported by \l deviceDiscovered() again once they are
+    seen again. The default of \c 0 keeps all devices regardless of their age.
+
+    The new age does not take effect until the device search is restarted.
+
+    \note Currently this is only supported on Linux (BlueZ).
+
+    \sa maximumDeviceAge(), setMaximumDeviceCount()
+    \since 6.9
+ */
+void QBluetoothDeviceDiscoveryAgent::setMaximumDeviceAge(int msAge)
+{
+    Q_D(QBluetoothDeviceDiscoveryAgent);
+
+    if (msAge < 0) {
+        qCDebug(QT_BT) << "The maximum device age cannot be negative.";
+        return;
+    }
+
+    if (d->maximumDeviceAge < 0) {
+        qCDebug(QT_BT) << "The maximum device age cannot be set on a backend "
+                          "which does not support this feature.";
+        return;
+    }
+
+    d->maximumDeviceAge = msAge;
+}
+
+/*!
+    Returns the time in milliseconds after which unseen devices are removed from
+    discoveredDevices(). A value of \c -1 implies that the platform does not
+    support removing devices. A return value of \c 0 implies that devices are
+    kept regardless of their age.
+
+    \sa setMaximumDeviceAge()
+    \since 6.9
+ */
+int QBluetoothDeviceDiscoveryAgent::maximumDeviceAge() const
+{
+    Q_D(const QBluetoothDeviceDiscoveryAgent);
+    return d->maximumDeviceAge;
+}
+
+/*!
+    Restricts the discovery to devices which advertise at least one of the
+    service \a uuids. An empty list, the default, disables the filter.
+
+    The filter takes effect the next time the discovery is started.
+
+    \note The filter is only supported on Linux (BlueZ). There, the Bluetooth
+    daemon drops other devices before they reach the application.
+
+    \sa serviceUuidFilter(), setMinimumRssi()
+    \since 6.9
+ */
+void QBluetoothDeviceDiscoveryAgent::setServiceUuidFilter(const QList<QBluetoothUuid> &uuids)
+{
+    Q_D(QBluetoothDeviceDiscoveryAgent);
+    d->serviceUuidFilter = uuids;
+}
+
+/*!
+    Returns the service UUIDs the discovery is restricted to. The list is empty if
+    any device is discovered.
+
+    \sa setServiceUuidFilter()
+    \since 6.9
+ */
+QList<QBluetoothUuid> QBluetoothDeviceDiscoveryAgent::serviceUuidFilter() const
+{
+    Q_D(const QBluetoothDeviceDiscoveryAgent);
+    return d->serviceUuidFilter;
+}
+
+/*!
+    Restricts the discovery to devices whose signal strength is at least \a rssi dBm.
+    The default value \c 0 disables the filter.
+
+    The filter takes effect the next time the discovery is started.
+
+    \note The filter is only supported on Linux (BlueZ).
+
+    \sa minimumRssi(), setServiceUuidFilter()
+    \since 6.9
+ */
+void QBluetoothDeviceDiscoveryAgent::setMinimumRssi(int rssi)
+{
+    Q_D(QBluetoothDeviceDiscoveryAgent);
+    if (rssi < -127 || rssi > 20) {
+        qCDebug(QT_BT) << "The minimum RSSI must be in the range of -127 to 20 dBm.";
+        return;
+    }
+
+    d->minimumRssi = rssi;
+}
+
+/*!
+    Returns the minimum signal strength of discovered devices in dBm. A value of
+    \c 0 implies that devices are discovered regardless of their signal strength.
+
+    \sa setMinimumRssi()
+    \since 6.9
+ */
+int QBluetoothDeviceDiscoveryAgent::minimumRssi() const
+{
+    Q_D(const QBluetoothDeviceDiscoveryAgent);
+    return d->minimumRssi;
+}
+
+/*!
+    Sets whether repeated advertisements with unchanged data are filtered out
+    to \a enabled. The filter reduces the traffic during Bluetooth Low Energy
+    discoveries considerably. On the other hand, \l deviceUpdated() is then
+    only emitted once the advertised data changes, signal strength changes
+    alone are not reported anymore.
+
+    The filter is disabled by default and takes effect the next time the
+    discovery is started.
+
+    \note The filter is only supported on Linux (BlueZ).
+
+    \sa isDuplicateFilterEnabled()
+    \since 6.9
+ */
+void QBluetoothDeviceDiscoveryAgent::setDuplicateFilterEnabled(bool enabled)
+{
+    Q_D(QBluetoothDeviceDiscoveryAgent);
+    d->duplicateFilterEnabled = enabled;
+}
+
+/*!
+    Returns whether repeated advertisements with unchanged data are filtered out.
+
+    \sa setDuplicateFilterEnabled()
+    \since 6.9
+ */
+bool QBluetoothDeviceDiscoveryAgent::isDuplicateFilterEnabled() const
+{
+    Q_D(const QBluetoothDeviceDiscoveryAgent);
+    return d->duplicateFilterEnabled;
+}
+
 /*!
     \fn QBluetoothDeviceDiscoveryAgent::DiscoveryMethods QBluetoothDeviceDiscoveryAgent::supportedDiscoveryMethods()
 
@@ -59,6 +59,24 @@ public:
     void setLowEnergyDiscoveryTimeout(int msTimeout);
     int lowEnergyDiscoveryTimeout() const;
 
+    void setDeviceBatchInterval(int msInterval);
+    int deviceBatchInterval() const;
+
+    void setMaximumDeviceCount(int count);
+    int maximumDeviceCount() const;
+
+    void setMaximumDeviceAge(int msAge);
+    int maximumDeviceAge() const;
+
+    void setServiceUuidFilter(const QList<QBluetoothUuid> &uuids);
+    QList<QBluetoothUuid> serviceUuidFilter() const;
+
+    void setMinimumRssi(int rssi);
+    int minimumRssi() const;
+
+    void setDuplicateFilterEnabled(bool enabled);
+    bool isDuplicateFilterEnabled() const;
+
     static DiscoveryMethods supportedDiscoveryMethods();
 public Q_SLOTS:
     void start();
@@ -68,6 +86,8 @@ public Q_SLOTS:
 Q_SIGNALS:
     void deviceDiscovered(const QBluetoothDeviceInfo &info);
     void deviceUpdated(const QBluetoothDeviceInfo &info, QBluetoothDeviceInfo::Fields updatedFields);
+    void devicesDiscovered(const QList<QBluetoothDeviceInfo> &infos);
+    void devicesUpdated(const QList<QBluetoothDeviceInfo> &infos);
     void finished();
     void errorOccurred(QBluetoothDeviceDiscoveryAgent::Error error);
     void canceled();
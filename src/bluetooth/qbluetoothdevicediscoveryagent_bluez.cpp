@@ -4,6 +4,7 @@
 #include <QtCore/QLoggingCategory>
 
 #include <QtCore/qcoreapplication.h>
+#include <QtDBus/QDBusPendingCallWatcher>
 
 #include "qbluetoothdevicediscoveryagent.h"
 #include "qbluetoothdevicediscoveryagent_p.h"
@@ -16,6 +17,8 @@
 #include "bluez/device1_bluez5_p.h"
 #include "bluez/properties_p.h"
 #include "bluez/bluetoothmanagement_p.h"
+#include "bluez/discovereddevices_p.h"
+#include "bluez/hcimanager_p.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -24,9 +27,26 @@ Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
 QBluetoothDeviceDiscoveryAgentPrivate::QBluetoothDeviceDiscoveryAgentPrivate(
     const QBluetoothAddress &deviceAdapter, QBluetoothDeviceDiscoveryAgent *parent) :
     adapterAddress(deviceAdapter),
+    deviceBatchInterval(0),
+    maximumDeviceCount(0),
+    maximumDeviceAge(0),
     q_ptr(parent)
 {
     initializeBluez5();
+    devices = new QtBluezDiscoveredDevices(parent);
+    QObject::connect(devices, &QtBluezDiscoveredDevices::deviceDiscovered,
+                     parent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered);
+    QObject::connect(devices, &QtBluezDiscoveredDevices::deviceUpdated,
+                     parent, &QBluetoothDeviceDiscoveryAgent::deviceUpdated);
+    QObject::connect(devices, &QtBluezDiscoveredDevices::devicesDiscovered,
+                     parent, &QBluetoothDeviceDiscoveryAgent::devicesDiscovered);
+    QObject::connect(devices, &QtBluezDiscoveredDevices::devicesUpdated,
+                     parent, &QBluetoothDeviceDiscoveryAgent::devicesUpdated);
+    QObject::connect(devices, &QtBluezDiscoveredDevices::evictedDeviceChanged,
+                     parent, [this](const QString &devicePath) {
+        this->fetchDeviceProperties(devicePath);
+    });
+
     manager = new OrgFreedesktopDBusObjectManagerInterface(
                                        QStringLiteral("org.bluez"),
                                        QStringLiteral("/"),
@@ -37,6 +57,13 @@ QBluetoothDeviceDiscoveryAgentPrivate::QBluetoothDeviceDiscoveryAgentPrivate(
                      [this](const QDBusObjectPath &objectPath, InterfaceList interfacesAndProperties) {
         this->_q_InterfacesAdded(objectPath, interfacesAndProperties);
     });
+    QObject::connect(manager,
+                     &OrgFreedesktopDBusObjectManagerInterface::InterfacesRemoved,
+                     q_ptr,
+                     [this](const QDBusObjectPath &objectPath, const QStringList &interfaces) {
+        if (interfaces.contains(QStringLiteral("org.bluez.Device1")))
+            devices->deviceRemoved(objectPath.path());
+    });
 
     // start private address monitoring
     BluetoothManagement::instance();
@@ -44,6 +71,7 @@ QBluetoothDeviceDiscoveryAgentPrivate::QBluetoothDeviceDiscoveryAgentPrivate(
 
 QBluetoothDeviceDiscoveryAgentPrivate::~QBluetoothDeviceDiscoveryAgentPrivate()
 {
+    delete hciScanner;
     delete adapter;
 }
 
@@ -78,8 +106,11 @@ void QBluetoothDeviceDiscoveryAgentPrivate::start(QBluetoothDeviceDiscoveryAgent
 
     lastError = QBluetoothDeviceDiscoveryAgent::NoError;
     errorString.clear();
-    discoveredDevices.clear();
-    devicesProperties.clear();
+    devices->clear();
+    devices->setReportUnchangedDevices(lowEnergySearchTimeout == 0);
+    devices->setBatchInterval(deviceBatchInterval);
+    devices->setMaximumDeviceCount(maximumDeviceCount);
+    devices->setMaximumDeviceAge(maximumDeviceAge);
 
     Q_Q(QBluetoothDeviceDiscoveryAgent);
 
@@ -106,39 +137,39 @@ void QBluetoothDeviceDiscoveryAgentPrivate::start(QBluetoothDeviceDiscoveryAgent
         return;
     }
 
-    QVariantMap map;
+    QtBluezDiscoveryFilter filter;
     if (methods == (QBluetoothDeviceDiscoveryAgent::LowEnergyMethod|QBluetoothDeviceDiscoveryAgent::ClassicMethod))
-        map.insert(QStringLiteral("Transport"), QStringLiteral("auto"));
+        filter.transport = QStringLiteral("auto");
     else if (methods & QBluetoothDeviceDiscoveryAgent::LowEnergyMethod)
-        map.insert(QStringLiteral("Transport"), QStringLiteral("le"));
+        filter.transport = QStringLiteral("le");
     else
-        map.insert(QStringLiteral("Transport"), QStringLiteral("bredr"));
-
-    // older BlueZ 5.x versions don't have this function
-    // filterReply returns UnknownMethod which we ignore
-    QDBusPendingReply<> filterReply = adapter->SetDiscoveryFilter(map);
-    filterReply.waitForFinished();
-    if (filterReply.isError()) {
-        if (filterReply.error().type() == QDBusError::Other
-                    && filterReply.error().name() == QStringLiteral("org.bluez.Error.Failed")) {
-            qCDebug(QT_BT_BLUEZ) << "Discovery method" << methods << "not supported";
-            lastError = QBluetoothDeviceDiscoveryAgent::UnsupportedDiscoveryMethod;
-            errorString = QBluetoothDeviceDiscoveryAgent::tr("One or more device discovery methods "
-                                                             "are not supported on this platform");
-            delete adapter;
-            adapter = nullptr;
-            emit q->errorOccurred(lastError);
-            return;
-        } else if (filterReply.error().type() != QDBusError::UnknownMethod) {
-            qCDebug(QT_BT_BLUEZ) << "SetDiscoveryFilter failed:" << filterReply.error();
-        }
+        filter.transport = QStringLiteral("bredr");
+    filter.uuids = serviceUuidFilter;
+    if (minimumRssi != 0)
+        filter.rssi = qint16(minimumRssi);
+    filter.duplicateData = !duplicateFilterEnabled;
+
+    // the filter is merged with the ones of the other agents on the same adapter
+    QDBusError filterError;
+    if (!QtBluezDiscoveryManager::instance()->registerDiscoveryInterest(adapter->path(), q, filter,
+                                                                        &filterError)) {
+        qCDebug(QT_BT_BLUEZ) << "Discovery method" << methods << "not supported" << filterError;
+        lastError = QBluetoothDeviceDiscoveryAgent::UnsupportedDiscoveryMethod;
+        errorString = QBluetoothDeviceDiscoveryAgent::tr("One or more device discovery methods "
+                                                         "are not supported on this platform");
+        delete adapter;
+        adapter = nullptr;
+        emit q->errorOccurred(lastError);
+        return;
     }
-
-    QtBluezDiscoveryManager::instance()->registerDiscoveryInterest(adapter->path());
     QObject::connect(QtBluezDiscoveryManager::instance(), &QtBluezDiscoveryManager::discoveryInterrupted,
                      q, [this](const QString &path){
         this->_q_discoveryInterrupted(path);
     });
+    if ((methods & QBluetoothDeviceDiscoveryAgent::LowEnergyMethod)
+            && Q_UNLIKELY(qEnvironmentVariableIsSet("QT_BLUETOOTH_HCI_LE_SCAN"))) {
+        startHciLeScan();
+    }
     OrgFreedesktopDBusPropertiesInterface *prop = new OrgFreedesktopDBusPropertiesInterface(
                 QStringLiteral("org.bluez"), QStringLiteral(""), QDBusConnection::systemBus());
     QObject::connect(prop, &OrgFreedesktopDBusPropertiesInterface::PropertiesChanged,
@@ -203,63 +234,6 @@ void QBluetoothDeviceDiscoveryAgentPrivate::stop()
     _q_discoveryFinished();
 }
 
-// Returns invalid QBluetoothDeviceInfo in case of error
-static QBluetoothDeviceInfo createDeviceInfoFromBluez5Device(const QVariantMap& properties)
-{
-    const QBluetoothAddress btAddress(properties[QStringLiteral("Address")].toString());
-    if (btAddress.isNull())
-        return QBluetoothDeviceInfo();
-
-    const QString btName = properties[QStringLiteral("Alias")].toString();
-    quint32 btClass = properties[QStringLiteral("Class")].toUInt();
-
-    QBluetoothDeviceInfo deviceInfo(btAddress, btName, btClass);
-    deviceInfo.setRssi(qvariant_cast<short>(properties[QStringLiteral("RSSI")]));
-
-    QList<QBluetoothUuid> uuids;
-    bool foundLikelyLowEnergyUuid = false;
-    const QStringList foundUuids = qvariant_cast<QStringList>(properties[QStringLiteral("UUIDs")]);
-    for (const auto &u: foundUuids) {
-        const QBluetoothUuid id(u);
-        if (id.isNull())
-            continue;
-
-        if (!foundLikelyLowEnergyUuid) {
-            //once we found one BTLE service we are done
-            bool ok = false;
-            quint16 shortId = id.toUInt16(&ok);
-            quint16 genericAccessInt = static_cast<quint16>(QBluetoothUuid::ServiceClassUuid::GenericAccess);
-            if (ok && ((shortId & genericAccessInt) == genericAccessInt))
-                foundLikelyLowEnergyUuid = true;
-        }
-        uuids.append(id);
-    }
-    deviceInfo.setServiceUuids(uuids);
-
-    if (!btClass) {
-        deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
-    } else {
-        deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::BaseRateCoreConfiguration);
-        if (foundLikelyLowEnergyUuid)
-            deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::BaseRateAndLowEnergyCoreConfiguration);
-    }
-
-    const ManufacturerDataList deviceManufacturerData = qdbus_cast<ManufacturerDataList>(properties[QStringLiteral("ManufacturerData")]);
-    const QList<quint16> keysManufacturer = deviceManufacturerData.keys();
-    for (quint16 key : keysManufacturer)
-        deviceInfo.setManufacturerData(
-                    key, deviceManufacturerData.value(key).variant().toByteArray());
-
-    const ServiceDataList deviceServiceData =
-            qdbus_cast<ServiceDataList>(properties[QStringLiteral("ServiceData")]);
-    const QList<QString> keysService = deviceServiceData.keys();
-    for (QString key : keysService)
-        deviceInfo.setServiceData(QBluetoothUuid(key),
-                                  deviceServiceData.value(key).variant().toByteArray());
-
-    return deviceInfo;
-}
-
 void QBluetoothDeviceDiscoveryAgentPrivate::deviceFound(const QString &devicePath,
                                                         const QVariantMap &properties)
 {
@@ -272,36 +246,92 @@ void QBluetoothDeviceDiscoveryAgentPrivate::deviceFound(const QString &devicePat
     if (deviceAdapter.path() != adapter->path())
         return;
 
-    // read information
-    QBluetoothDeviceInfo deviceInfo = createDeviceInfoFromBluez5Device(properties);
-    if (!deviceInfo.isValid()) // no point reporting an empty address
+    // Devices known before the discovery started or found by the discovery of
+    // other processes did not pass the discovery filter
+    if (!matchesDiscoveryFilter(properties))
         return;
 
-    qCDebug(QT_BT_BLUEZ) << "Discovered: " << deviceInfo.name() << deviceInfo.address()
-                         << "Num UUIDs" << deviceInfo.serviceUuids().size()
-                         << "total device" << discoveredDevices.size() << "cached"
-                         << "RSSI" << deviceInfo.rssi()
-                         << "Num ManufacturerData" << deviceInfo.manufacturerData().size()
-                         << "Num ServiceData" << deviceInfo.serviceData().size();
-
-    // Cache the properties so we do not have to access dbus every time to get a value
-    devicesProperties[devicePath] = properties;
-
-    for (qsizetype i = 0; i < discoveredDevices.size(); ++i) {
-        if (discoveredDevices[i].address() == deviceInfo.address()) {
-            if (lowEnergySearchTimeout > 0 && discoveredDevices[i] == deviceInfo) {
-                qCDebug(QT_BT_BLUEZ) << "Duplicate: " << deviceInfo.address();
-                return;
-            }
-            discoveredDevices.replace(i, deviceInfo);
+    devices->deviceFound(devicePath, properties);
+}
 
-            emit q->deviceDiscovered(deviceInfo);
-            return; // this works if the list doesn't contain duplicates. Don't let it.
+// An evicted device is not announced by InterfacesAdded again, PropertiesChanged
+// lacks the properties to report it, read them all
+void QBluetoothDeviceDiscoveryAgentPrivate::fetchDeviceProperties(const QString &devicePath)
+{
+    Q_Q(QBluetoothDeviceDiscoveryAgent);
+
+    if (!q->isActive())
+        return;
+
+    OrgFreedesktopDBusPropertiesInterface properties(QStringLiteral("org.bluez"), devicePath,
+                                                     QDBusConnection::systemBus());
+    auto watcher = new QDBusPendingCallWatcher(
+            properties.GetAll(QStringLiteral("org.bluez.Device1")), q);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     q, [this, devicePath](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+        QDBusPendingReply<QVariantMap> reply = *watcher;
+        if (reply.isError()) {
+            qCDebug(QT_BT_BLUEZ) << "Cannot read the properties of" << devicePath
+                                 << reply.error().message();
+            return;
         }
+        deviceFound(devicePath, reply.value());
+    });
+}
+
+bool QBluetoothDeviceDiscoveryAgentPrivate::matchesDiscoveryFilter(
+        const QVariantMap &properties) const
+{
+    if (minimumRssi != 0) {
+        const auto rssi = properties.constFind(QStringLiteral("RSSI"));
+        if (rssi == properties.cend() || qvariant_cast<short>(*rssi) < minimumRssi)
+            return false;
     }
 
-    discoveredDevices.append(deviceInfo);
-    emit q->deviceDiscovered(deviceInfo);
+    if (!serviceUuidFilter.isEmpty()) {
+        const QStringList uuids =
+                qvariant_cast<QStringList>(properties.value(QStringLiteral("UUIDs")));
+        for (const QString &uuid : uuids) {
+            if (serviceUuidFilter.contains(QBluetoothUuid(uuid)))
+                return true;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/*
+    Opt-in via QT_BLUETOOTH_HCI_LE_SCAN: the LE advertising reports are read from a raw
+    HCI socket as well, so that every advertisement updates the RSSI and manufacturer
+    data of a device rather than the deduplicated view of BlueZ. Needs CAP_NET_RAW and
+    CAP_NET_ADMIN, without them only the D-Bus discovery is used.
+ */
+void QBluetoothDeviceDiscoveryAgentPrivate::startHciLeScan()
+{
+    hciScanner = new HciManager(QBluetoothAddress(adapter->address()));
+    if (!hciScanner->isValid()) {
+        qCWarning(QT_BT_BLUEZ) << "Cannot open the HCI socket for the LE advertising reports";
+        stopHciLeScan();
+        return;
+    }
+    hciScanner->setAdvertisingReportInterval(deviceBatchInterval);
+    QObject::connect(hciScanner, &HciManager::advertisingReportsReceived, devices,
+                     &QtBluezDiscoveredDevices::advertisingReportsReceived);
+    // bluetoothd scans already, this turns off the duplicate filtering of the controller
+    if (!hciScanner->startLeScan())
+        qCWarning(QT_BT_BLUEZ) << "Cannot start the passive LE scan, using the reports of BlueZ";
+}
+
+void QBluetoothDeviceDiscoveryAgentPrivate::stopHciLeScan()
+{
+    if (!hciScanner)
+        return;
+    // the scan itself ends with the discovery of bluetoothd
+    hciScanner->flushAdvertisingReports();
+    delete hciScanner;
+    hciScanner = nullptr;
 }
 
 void QBluetoothDeviceDiscoveryAgentPrivate::_q_InterfacesAdded(const QDBusObjectPath &object_path,
@@ -328,7 +358,7 @@ void QBluetoothDeviceDiscoveryAgentPrivate::_q_discoveryFinished()
         discoveryTimer->stop();
 
     QtBluezDiscoveryManager::instance()->disconnect(q);
-    QtBluezDiscoveryManager::instance()->unregisterDiscoveryInterest(adapter->path());
+    QtBluezDiscoveryManager::instance()->unregisterDiscoveryInterest(adapter->path(), q);
 
     qDeleteAll(propertyMonitors);
     propertyMonitors.clear();
@@ -336,6 +366,10 @@ void QBluetoothDeviceDiscoveryAgentPrivate::_q_discoveryFinished()
     delete adapter;
     adapter = nullptr;
 
+    // report the remainder before finished() or canceled()
+    stopHciLeScan();
+    devices->flush();
+
     if (pendingCancel && !pendingStart) {
         pendingCancel = false;
         emit q->canceled();
@@ -368,6 +402,7 @@ void QBluetoothDeviceDiscoveryAgentPrivate::_q_discoveryInterrupted(const QStrin
 
         delete adapter;
         adapter = nullptr;
+        stopHciLeScan();
 
         errorString = QBluetoothDeviceDiscoveryAgent::tr("Bluetooth adapter error");
         lastError = QBluetoothDeviceDiscoveryAgent::InputOutputError;
@@ -380,81 +415,9 @@ void QBluetoothDeviceDiscoveryAgentPrivate::_q_PropertiesChanged(const QString &
                                                                  const QVariantMap &changed_properties,
                                                                  const QStringList &invalidated_properties)
 {
-    Q_Q(QBluetoothDeviceDiscoveryAgent);
     if (interface != QStringLiteral("org.bluez.Device1"))
         return;
 
-    if (!devicesProperties.contains(path))
-        return;
-
-    // Update the cached properties before checking changed_properties for RSSI and ManufacturerData
-    // so the cached properties are always up to date.
-    QVariantMap & properties = devicesProperties[path];
-    for (QVariantMap::const_iterator it = changed_properties.constBegin();
-         it != changed_properties.constEnd(); ++it) {
-        properties[it.key()] = it.value();
-    }
-
-    for (const QString & property : invalidated_properties)
-        properties.remove(property);
-
-    const auto info = createDeviceInfoFromBluez5Device(properties);
-    if (!info.isValid())
-        return;
-
-    if (changed_properties.contains(QStringLiteral("RSSI"))
-        || changed_properties.contains(QStringLiteral("ManufacturerData"))) {
-
-        for (qsizetype i = 0; i < discoveredDevices.size(); ++i) {
-            if (discoveredDevices[i].address() == info.address()) {
-                QBluetoothDeviceInfo::Fields updatedFields = QBluetoothDeviceInfo::Field::None;
-                if (changed_properties.contains(QStringLiteral("RSSI"))) {
-                    qCDebug(QT_BT_BLUEZ) << "Updating RSSI for" << info.address()
-                                         << changed_properties.value(QStringLiteral("RSSI"));
-                    discoveredDevices[i].setRssi(
-                                changed_properties.value(QStringLiteral("RSSI")).toInt());
-                    updatedFields.setFlag(QBluetoothDeviceInfo::Field::RSSI);
-                }
-                if (changed_properties.contains(QStringLiteral("ManufacturerData"))) {
-                    qCDebug(QT_BT_BLUEZ) << "Updating ManufacturerData for" << info.address();
-                    ManufacturerDataList changedManufacturerData =
-                            qdbus_cast< ManufacturerDataList >(changed_properties.value(QStringLiteral("ManufacturerData")));
-
-                    const QList<quint16> keys = changedManufacturerData.keys();
-                    bool wasNewValue = false;
-                    for (quint16 key : keys) {
-                        bool added = discoveredDevices[i].setManufacturerData(key, changedManufacturerData.value(key).variant().toByteArray());
-                        wasNewValue = (wasNewValue || added);
-                    }
-
-                    if (wasNewValue)
-                        updatedFields.setFlag(QBluetoothDeviceInfo::Field::ManufacturerData);
-                }
-
-                if (lowEnergySearchTimeout > 0) {
-                    if (discoveredDevices[i] != info) { // field other than manufacturer or rssi changed
-                        if (discoveredDevices.at(i).name() == info.name()) {
-                            qCDebug(QT_BT_BLUEZ) << "Almost Duplicate " << info.address()
-                                                   << info.name() << "- replacing in place";
-                            discoveredDevices.replace(i, info);
-                            emit q->deviceDiscovered(info);
-                        }
-                    } else {
-                        if (!updatedFields.testFlag(QBluetoothDeviceInfo::Field::None))
-                            emit q->deviceUpdated(discoveredDevices[i], updatedFields);
-                    }
-
-                    return;
-                }
-
-                discoveredDevices.replace(i, info);
-                emit q_ptr->deviceDiscovered(discoveredDevices[i]);
-
-                if (!updatedFields.testFlag(QBluetoothDeviceInfo::Field::None))
-                    emit q->deviceUpdated(discoveredDevices[i], updatedFields);
-                return;
-            }
-        }
-    }
+    devices->propertiesChanged(path, changed_properties, invalidated_properties);
 }
 QT_END_NAMESPACE
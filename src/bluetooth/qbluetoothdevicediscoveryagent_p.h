@@ -45,6 +45,8 @@ class OrgBluezDevice1Interface;
 
 QT_BEGIN_NAMESPACE
 class QDBusVariant;
+class HciManager;
+class QtBluezDiscoveredDevices;
 QT_END_NAMESPACE
 #endif
 
@@ -136,8 +138,15 @@ private:
     QList<OrgFreedesktopDBusPropertiesInterface *> propertyMonitors;
 
     void deviceFound(const QString &devicePath, const QVariantMap &properties);
-
-    QMap<QString, QVariantMap> devicesProperties;
+    void fetchDeviceProperties(const QString &devicePath);
+    bool matchesDiscoveryFilter(const QVariantMap &properties) const;
+    void startHciLeScan();
+    void stopHciLeScan();
+
+    // replaces discoveredDevices on BlueZ
+    QtBluezDiscoveredDevices *devices = nullptr;
+    // reads the advertising reports, see QT_BLUETOOTH_HCI_LE_SCAN
+    HciManager *hciScanner = nullptr;
 #endif
 
 #ifdef QT_WINRT_BLUETOOTH
@@ -203,6 +212,15 @@ private:
 #endif // Q_OS_DARWIN
 
     int lowEnergySearchTimeout = 40000;
+    // -1 if the backend does not support batched signals
+    int deviceBatchInterval = -1;
+    // -1 if the backend does not support evicting devices, 0 for no limit
+    int maximumDeviceCount = -1;
+    int maximumDeviceAge = -1;
+    QList<QBluetoothUuid> serviceUuidFilter;
+    // 0 if any signal strength is accepted
+    int minimumRssi = 0;
+    bool duplicateFilterEnabled = false;
     QBluetoothDeviceDiscoveryAgent::DiscoveryMethods requestedMethods;
     QBluetoothDeviceDiscoveryAgent *q_ptr;
 };
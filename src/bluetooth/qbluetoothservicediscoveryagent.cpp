@@ -5,6 +5,9 @@
 #include "qbluetoothlocaldevice.h"
 #include "qbluetoothservicediscoveryagent.h"
 #include "qbluetoothservicediscoveryagent_p.h"
+#if QT_CONFIG(bluez)
+#include "bluez/sdpcache_p.h"
+#endif
 
 #include "qbluetoothdevicediscoveryagent.h"
 
@@ -290,6 +293,16 @@ void qt_test_iobluetooth_runloop();
 
     On some platforms, device discovery may lead to pairing requests.
 
+    \note On Linux, the \l FullDiscovery of several devices scans one device at
+    a time. The environment variable \c QT_BLUETOOTH_SDP_CONCURRENCY sets the
+    number of devices which are scanned in parallel. Setting
+    \c QT_BLUETOOTH_SDP_CACHE_TTL to a number of seconds enables a cache of
+    \l FullDiscovery results. Cached services are reported without querying
+    the remote device again until they are older than the given time. Older
+    services are reported as well while the device is scanned again.
+    \c QT_BLUETOOTH_SDP_CACHE_SIZE limits the number of cached devices and
+    \c QT_BLUETOOTH_SDP_CACHE_FILE sets the file the cache is kept in.
+
     \sa DiscoveryMode
 */
 void QBluetoothServiceDiscoveryAgent::start(DiscoveryMode mode)
@@ -523,6 +536,10 @@ void QBluetoothServiceDiscoveryAgentPrivate::startServiceDiscovery()
     Q_Q(QBluetoothServiceDiscoveryAgent);
 
     if (discoveredDevices.isEmpty()) {
+#if QT_CONFIG(bluez)
+        // persist the SDP records gathered by this discovery
+        SdpCache::instance()->sync();
+#endif
         setDiscoveryState(Inactive);
         emit q->finished();
         return;
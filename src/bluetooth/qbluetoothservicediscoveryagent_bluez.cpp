@@ -7,12 +7,17 @@
 #include "bluez/bluez5_helper_p.h"
 #include "bluez/objectmanager_p.h"
 #include "bluez/adapter1_bluez5_p.h"
+#include "bluez/sdpcache_p.h"
+#include "bluez/sdpscannerworker_p.h"
+
+#include <algorithm>
 
 #include <QtCore/QFile>
 #include <QtCore/QLibraryInfo>
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QProcess>
 #include <QtCore/QScopeGuard>
+#include <QtCore/QtEndian>
 
 #include <QtDBus/QDBusPendingCallWatcher>
 
@@ -20,6 +25,170 @@ QT_BEGIN_NAMESPACE
 
 Q_DECLARE_LOGGING_CATEGORY(QT_BT_BLUEZ)
 
+// Exit code of sdpscanner for unknown options
+static constexpr int sdpScannerUsageError = 1;
+// Upper bound for a single binary record, anything larger indicates a corrupt stream
+static constexpr quint32 maxSdpRecordSize = 1024 * 1024;
+
+// Value types of the binary record stream written by sdpscanner -b
+enum SdpBinaryValueType : quint8 {
+    SdpBinaryNil = 0x00,
+    SdpBinaryUInt8 = 0x01,
+    SdpBinaryUInt16 = 0x02,
+    SdpBinaryUInt32 = 0x03,
+    SdpBinaryUInt64 = 0x04,
+    SdpBinaryUInt128 = 0x05,
+    SdpBinaryInt8 = 0x06,
+    SdpBinaryInt16 = 0x07,
+    SdpBinaryInt32 = 0x08,
+    SdpBinaryInt64 = 0x09,
+    SdpBinaryInt128 = 0x0a,
+    SdpBinaryUuid16 = 0x0b,
+    SdpBinaryUuid32 = 0x0c,
+    SdpBinaryUuid128 = 0x0d,
+    SdpBinaryText = 0x0e,
+    SdpBinaryUrl = 0x0f,
+    SdpBinaryBool = 0x10,
+    SdpBinarySequence = 0x11,
+    SdpBinaryAlternate = 0x12
+};
+
+template <typename T>
+static bool takeBigEndian(QByteArrayView &data, T *value)
+{
+    if (data.size() < qsizetype(sizeof(T)))
+        return false;
+    *value = qFromBigEndian<T>(data.data());
+    data = data.sliced(sizeof(T));
+    return true;
+}
+
+// Decodes the next value of a binary record. Types which the XML based parser does
+// not support either result in an invalid QVariant. Returns false if data is malformed.
+static bool readBinaryAttributeValue(QByteArrayView &data, QVariant *value, int depth = 0)
+{
+    // SDP data elements cannot be nested arbitrarily deep within one record
+    if (depth > 32)
+        return false;
+
+    quint8 type;
+    if (!takeBigEndian(data, &type))
+        return false;
+
+    switch (type) {
+    case SdpBinaryNil:
+        *value = QVariant();
+        return true;
+    case SdpBinaryBool: {
+        quint8 v;
+        if (!takeBigEndian(data, &v))
+            return false;
+        *value = v != 0;
+        return true;
+    }
+    case SdpBinaryUInt8: {
+        quint8 v;
+        if (!takeBigEndian(data, &v))
+            return false;
+        *value = v;
+        return true;
+    }
+    case SdpBinaryUInt16: {
+        quint16 v;
+        if (!takeBigEndian(data, &v))
+            return false;
+        *value = v;
+        return true;
+    }
+    case SdpBinaryUInt32: {
+        quint32 v;
+        if (!takeBigEndian(data, &v))
+            return false;
+        *value = v;
+        return true;
+    }
+    case SdpBinaryUInt64: {
+        quint64 v;
+        if (!takeBigEndian(data, &v))
+            return false;
+        *value = v;
+        return true;
+    }
+    case SdpBinaryUuid16: {
+        quint16 v;
+        if (!takeBigEndian(data, &v))
+            return false;
+        *value = QVariant::fromValue(QBluetoothUuid(v));
+        return true;
+    }
+    case SdpBinaryUuid32: {
+        quint32 v;
+        if (!takeBigEndian(data, &v))
+            return false;
+        *value = QVariant::fromValue(QBluetoothUuid(v));
+        return true;
+    }
+    case SdpBinaryUuid128:
+        if (data.size() < 16)
+            return false;
+        *value = QVariant::fromValue(QBluetoothUuid(QUuid::fromRfc4122(data.first(16))));
+        data = data.sliced(16);
+        return true;
+    case SdpBinaryText:
+    case SdpBinaryUrl: {
+        quint32 size;
+        if (!takeBigEndian(data, &size) || data.size() < qsizetype(size))
+            return false;
+        *value = QString::fromUtf8(data.first(size));
+        data = data.sliced(size);
+        return true;
+    }
+    case SdpBinarySequence:
+    case SdpBinaryAlternate: {
+        quint32 count;
+        if (!takeBigEndian(data, &count))
+            return false;
+        QBluetoothServiceInfo::Sequence sequence;
+        for (quint32 i = 0; i < count; ++i) {
+            QVariant element;
+            if (!readBinaryAttributeValue(data, &element, depth + 1))
+                return false;
+            sequence.append(element);
+        }
+        // like the XML parser, alternates are not supported
+        if (type == SdpBinarySequence)
+            *value = QVariant::fromValue<QBluetoothServiceInfo::Sequence>(sequence);
+        else
+            *value = QVariant();
+        return true;
+    }
+    case SdpBinaryInt8:
+    case SdpBinaryInt16:
+    case SdpBinaryInt32:
+    case SdpBinaryInt64:
+    case SdpBinaryUInt128:
+    case SdpBinaryInt128: {
+        qsizetype size = 16;
+        if (type == SdpBinaryInt8)
+            size = 1;
+        else if (type == SdpBinaryInt16)
+            size = 2;
+        else if (type == SdpBinaryInt32)
+            size = 4;
+        else if (type == SdpBinaryInt64)
+            size = 8;
+        if (data.size() < size)
+            return false;
+        qCWarning(QT_BT_BLUEZ) << "unknown attribute type" << type;
+        *value = QVariant();
+        data = data.sliced(size);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 QBluetoothServiceDiscoveryAgentPrivate::QBluetoothServiceDiscoveryAgentPrivate(
     QBluetoothServiceDiscoveryAgent *qp, const QBluetoothAddress &deviceAdapter)
 :   error(QBluetoothServiceDiscoveryAgent::NoError), m_deviceAdapterAddress(deviceAdapter), state(Inactive),
@@ -30,10 +199,17 @@ QBluetoothServiceDiscoveryAgentPrivate::QBluetoothServiceDiscoveryAgentPrivate(
     manager = new OrgFreedesktopDBusObjectManagerInterface(
             QStringLiteral("org.bluez"), QStringLiteral("/"), QDBusConnection::systemBus());
     qRegisterMetaType<QBluetoothServiceDiscoveryAgent::Error>();
+
+    bool ok = false;
+    const int concurrency = qEnvironmentVariableIntValue("QT_BLUETOOTH_SDP_CONCURRENCY", &ok);
+    if (ok)
+        setSdpScanConcurrency(concurrency);
 }
 
 QBluetoothServiceDiscoveryAgentPrivate::~QBluetoothServiceDiscoveryAgentPrivate()
 {
+    for (auto it = sdpWorkerJobs.cbegin(); it != sdpWorkerJobs.cend(); ++it)
+        QtBluezSdpScannerWorker::instance()->cancel(it.key());
     delete manager;
 }
 
@@ -101,6 +277,42 @@ void QBluetoothServiceDiscoveryAgentPrivate::runExternalSdpScan(
 {
     Q_Q(QBluetoothServiceDiscoveryAgent);
 
+    // Prefer the shared long-lived sdpscanner over a process per device
+    QtBluezSdpScannerWorker *worker = QtBluezSdpScannerWorker::instance();
+    if (worker->isAvailable()) {
+        if (!sdpWorkerConnected) {
+            q->connect(worker, &QtBluezSdpScannerWorker::recordReceived,
+                       q, [this](quint64 jobId, const QByteArray &record){
+                this->_q_sdpWorkerRecordReceived(jobId, record);
+            });
+            q->connect(worker, &QtBluezSdpScannerWorker::scanFinished,
+                       q, [this](quint64 jobId, int exitCode){
+                this->_q_sdpWorkerScanFinished(jobId, exitCode);
+            });
+            sdpWorkerConnected = true;
+        }
+        if (worker->maximumProcessCount() < maxParallelSdpScans)
+            worker->setMaximumProcessCount(maxParallelSdpScans);
+
+        if (!sdpDiscoveryTimer.isValid()) {
+            sdpScanTimes.clear();
+            sdpDiscoveryTimer.start();
+        }
+        sdpScanLocalAddress = localAddress;
+        // remoteAddress is the first entry of discoveredDevices
+        startSdpWorkerScans();
+        return;
+    }
+
+    if (!discoveredDevices.isEmpty() && reportCachedSdpRecords(discoveredDevices.at(0))) {
+        // the reported services are queued, finish after them
+        QMetaObject::invokeMethod(q, [this]() {
+            if (discoveryState() != Inactive)
+                _q_serviceDiscoveryFinished();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
     if (!sdpScannerProcess) {
         const QString binPath = QLibraryInfo::path(QLibraryInfo::LibraryExecutablesPath);
         QFileInfo fileInfo(binPath, QStringLiteral("sdpscanner"));
@@ -118,6 +330,10 @@ void QBluetoothServiceDiscoveryAgentPrivate::runExternalSdpScan(
         if (QT_BT_BLUEZ().isDebugEnabled())
             sdpScannerProcess->setProcessChannelMode(QProcess::ForwardedErrorChannel);
         sdpScannerProcess->setProgram(fileInfo.canonicalFilePath());
+        q->connect(sdpScannerProcess, &QProcess::readyReadStandardOutput,
+                   q, [this](){
+            this->_q_sdpScannerReadyRead();
+        });
         q->connect(sdpScannerProcess,
                    QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
                    q, [this](int exitCode, QProcess::ExitStatus status){
@@ -125,9 +341,17 @@ void QBluetoothServiceDiscoveryAgentPrivate::runExternalSdpScan(
         });
     }
 
+    sdpScannerOutput.clear();
+    sdpScannerRecords.clear();
+
     QStringList arguments;
     arguments << remoteAddress.toString() << localAddress.toString();
 
+    // Binary records are reported while the scan is still running whereas
+    // the XML output is only available once the scan has finished
+    if (!sdpScannerXmlOutput)
+        arguments << QLatin1String("-b");
+
     // No filter implies PUBLIC_BROWSE_GROUP based SDP scan
     if (!uuidFilter.isEmpty()) {
         arguments << QLatin1String("-u"); // cmd line option for list of uuids
@@ -139,18 +363,245 @@ void QBluetoothServiceDiscoveryAgentPrivate::runExternalSdpScan(
     sdpScannerProcess->start();
 }
 
+void QBluetoothServiceDiscoveryAgentPrivate::_q_sdpScannerReadyRead()
+{
+    if (sdpScannerXmlOutput)
+        return; // the XML output is processed once sdpscanner has finished
+
+    sdpScannerOutput += sdpScannerProcess->readAllStandardOutput();
+
+    qsizetype offset = 0;
+    while (sdpScannerOutput.size() - offset >= qsizetype(sizeof(quint32))) {
+        const quint32 recordSize = qFromBigEndian<quint32>(sdpScannerOutput.constData() + offset);
+        if (recordSize > maxSdpRecordSize) {
+            qCWarning(QT_BT_BLUEZ) << "Discarding corrupt sdpscanner output";
+            sdpScannerOutput.clear();
+            return;
+        }
+        if (sdpScannerOutput.size() - offset - qsizetype(sizeof(quint32)) < recordSize)
+            break; // wait for the remainder of the record
+
+        const QByteArrayView record = QByteArrayView(sdpScannerOutput).sliced(
+                    offset + sizeof(quint32), recordSize);
+        offset += sizeof(quint32) + recordSize;
+
+        if (discoveryState() == Inactive || discoveredDevices.isEmpty())
+            continue;
+        sdpScannerRecords << record.toByteArray();
+        addServiceRecord(parseServiceRecord(record, discoveredDevices.at(0)));
+    }
+    sdpScannerOutput.remove(0, offset);
+}
+
+/*
+    Hands the pending devices to the sdpscanner worker until maxParallelSdpScans
+    scans are running. Devices are removed from discoveredDevices once their scan
+    has finished, any device without a running scan is therefore still pending.
+ */
+void QBluetoothServiceDiscoveryAgentPrivate::startSdpWorkerScans()
+{
+    Q_Q(QBluetoothServiceDiscoveryAgent);
+
+    QtBluezSdpScannerWorker *worker = QtBluezSdpScannerWorker::instance();
+    qsizetype i = 0;
+    while (i < discoveredDevices.size() && sdpWorkerJobs.size() < maxParallelSdpScans) {
+        const QBluetoothDeviceInfo device = discoveredDevices.at(i);
+        const QBluetoothAddress address = device.address();
+        const bool running = std::any_of(sdpWorkerJobs.cbegin(), sdpWorkerJobs.cend(),
+                                         [&address](const SdpWorkerScan &scan) {
+            return scan.device.address() == address;
+        });
+        if (running) {
+            ++i;
+            continue;
+        }
+
+        if (reportCachedSdpRecords(device)) {
+            discoveredDevices.removeAt(i);
+            continue;
+        }
+
+        SdpWorkerScan scan;
+        scan.device = device;
+        scan.timer.start();
+        sdpWorkerJobs.insert(worker->scan(address, sdpScanLocalAddress, uuidFilter), scan);
+        ++i;
+    }
+
+    if (sdpWorkerJobs.isEmpty()) {
+        // All remaining devices were served from the SDP cache. The reported
+        // services are queued, finish after them.
+        QMetaObject::invokeMethod(q, [this]() {
+            if (discoveryState() == Inactive)
+                return;
+            finishSdpDiscoveryTiming();
+            startServiceDiscovery();
+        }, Qt::QueuedConnection);
+    }
+}
+
+/*
+    Reports the cached services of device. Returns true if they are recent enough
+    to skip the SDP scan. Expired services are reported while the scan refreshes them.
+ */
+bool QBluetoothServiceDiscoveryAgentPrivate::reportCachedSdpRecords(
+        const QBluetoothDeviceInfo &device)
+{
+    SdpCache *cache = SdpCache::instance();
+    if (!cache->isEnabled())
+        return false;
+
+    const std::optional<SdpCache::Entry> entry = cache->find(device.address(), uuidFilter);
+    if (!entry)
+        return false;
+
+    for (const QByteArray &record : entry->records)
+        addServiceRecord(parseServiceRecord(record, device));
+
+    const bool expired = cache->isExpired(*entry);
+    qCDebug(QT_BT_BLUEZ) << "Reported" << entry->records.size() << "cached SDP records of"
+                         << device.address().toString() << (expired ? "(expired)" : "");
+    return !expired;
+}
+
+void QBluetoothServiceDiscoveryAgentPrivate::updateSdpCache(const QBluetoothAddress &address,
+                                                            const QList<QByteArray> &records,
+                                                            bool scanSucceeded)
+{
+    SdpCache *cache = SdpCache::instance();
+    if (!cache->isEnabled())
+        return;
+
+    if (scanSucceeded)
+        cache->insert(address, uuidFilter, records);
+    else
+        cache->remove(address); // do not report expired services of an unreachable device
+}
+
+void QBluetoothServiceDiscoveryAgentPrivate::finishSdpDiscoveryTiming()
+{
+    if (!sdpDiscoveryTimer.isValid())
+        return;
+
+    sdpDiscoveryTime = sdpDiscoveryTimer.elapsed();
+    sdpDiscoveryTimer.invalidate();
+    qCDebug(QT_BT_BLUEZ) << "SDP scan of" << sdpScanTimes.size() << "devices took"
+                         << sdpDiscoveryTime << "ms with up to" << maxParallelSdpScans
+                         << "parallel scans";
+}
+
+void QBluetoothServiceDiscoveryAgentPrivate::_q_sdpWorkerRecordReceived(
+        quint64 jobId, const QByteArray &record)
+{
+    const auto it = sdpWorkerJobs.find(jobId);
+    if (it == sdpWorkerJobs.end() || discoveryState() == Inactive)
+        return;
+
+    it->records << record;
+    addServiceRecord(parseServiceRecord(record, it->device));
+}
+
+void QBluetoothServiceDiscoveryAgentPrivate::_q_sdpWorkerScanFinished(quint64 jobId, int exitCode)
+{
+    const auto it = sdpWorkerJobs.constFind(jobId);
+    if (it == sdpWorkerJobs.cend())
+        return;
+
+    const SdpWorkerScan scan = it.value();
+    sdpWorkerJobs.erase(it);
+
+    if (exitCode == QtBluezSdpScannerWorker::WorkerUnavailable) {
+        // the worker fails all jobs, fall back to one sdpscanner process per device
+        sdpWorkerJobs.clear();
+        if (!discoveredDevices.isEmpty())
+            runExternalSdpScan(discoveredDevices.at(0).address(), sdpScanLocalAddress);
+        return;
+    }
+
+    const QBluetoothAddress address = scan.device.address();
+    const qint64 duration = scan.timer.elapsed();
+    sdpScanTimes.insert(address, duration);
+    qCDebug(QT_BT_BLUEZ) << "SDP scan of" << address.toString() << "took" << duration << "ms";
+
+    if (exitCode != 0)
+        qCWarning(QT_BT_BLUEZ) << "SDP scan failure" << address.toString() << exitCode;
+    updateSdpCache(address, scan.records, exitCode == 0);
+
+    if (singleDevice) {
+        finishSdpDiscoveryTiming();
+        if (exitCode != 0)
+            sdpScanFailed();
+        else
+            _q_finishSdpScan(QBluetoothServiceDiscoveryAgent::NoError, QString(), QStringList());
+        return;
+    }
+
+    // Scans of several devices may finish in any order. Failures skip the device.
+    for (qsizetype i = 0; i < discoveredDevices.size(); ++i) {
+        if (discoveredDevices.at(i).address() == address) {
+            discoveredDevices.removeAt(i);
+            break;
+        }
+    }
+
+    if (!sdpWorkerJobs.isEmpty()) {
+        startSdpWorkerScans();
+        return;
+    }
+
+    if (discoveredDevices.isEmpty())
+        finishSdpDiscoveryTiming();
+    // scans the next devices or finishes the discovery
+    startServiceDiscovery();
+}
+
+void QBluetoothServiceDiscoveryAgentPrivate::sdpScanFailed()
+{
+    if (singleDevice) {
+        _q_finishSdpScan(QBluetoothServiceDiscoveryAgent::InputOutputError,
+                         QBluetoothServiceDiscoveryAgent::tr("Unable to perform SDP scan"),
+                         QStringList());
+    } else {
+        // go to next device
+        _q_finishSdpScan(QBluetoothServiceDiscoveryAgent::NoError, QString(), QStringList());
+    }
+}
+
 void QBluetoothServiceDiscoveryAgentPrivate::_q_sdpScannerDone(int exitCode, QProcess::ExitStatus status)
 {
+    if (!sdpScannerXmlOutput) {
+        if (status == QProcess::NormalExit && exitCode == sdpScannerUsageError) {
+            qCDebug(QT_BT_BLUEZ) << "sdpscanner does not support binary output,"
+                                 << "falling back to XML";
+            sdpScannerXmlOutput = true;
+            QStringList arguments = sdpScannerProcess->arguments();
+            arguments.removeOne(QLatin1String("-b"));
+            sdpScannerProcess->setArguments(arguments);
+            sdpScannerProcess->start();
+            return;
+        }
+
+        // pick up records which arrived together with the exit notification
+        _q_sdpScannerReadyRead();
+    }
+
     if (status != QProcess::NormalExit || exitCode != 0) {
         qCWarning(QT_BT_BLUEZ) << "SDP scan failure" << status << exitCode;
-        if (singleDevice) {
-            _q_finishSdpScan(QBluetoothServiceDiscoveryAgent::InputOutputError,
-                             QBluetoothServiceDiscoveryAgent::tr("Unable to perform SDP scan"),
-                             QStringList());
-        } else {
-            // go to next device
-            _q_finishSdpScan(QBluetoothServiceDiscoveryAgent::NoError, QString(), QStringList());
+        if (!discoveredDevices.isEmpty())
+            updateSdpCache(discoveredDevices.at(0).address(), {}, false);
+        sdpScanFailed();
+        return;
+    }
+
+    if (!sdpScannerXmlOutput) {
+        if (!sdpScannerOutput.isEmpty()) {
+            qCWarning(QT_BT_BLUEZ) << "Incomplete SDP record from sdpscanner";
+            sdpScannerOutput.clear();
         }
+        if (!discoveredDevices.isEmpty())
+            updateSdpCache(discoveredDevices.at(0).address(), sdpScannerRecords, true);
+        // all records have been reported already
+        _q_finishSdpScan(QBluetoothServiceDiscoveryAgent::NoError, QString(), QStringList());
         return;
     }
 
@@ -193,62 +644,66 @@ void QBluetoothServiceDiscoveryAgentPrivate::_q_finishSdpScan(QBluetoothServiceD
         errorString = errorDescription;
         emit q->errorOccurred(error);
     } else if (!xmlRecords.isEmpty() && discoveryState() != Inactive) {
-        for (const QString &record : xmlRecords) {
-            QBluetoothServiceInfo serviceInfo = parseServiceXml(record);
-
-            //apply uuidFilter
-            if (!uuidFilter.isEmpty()) {
-                bool serviceNameMatched = uuidFilter.contains(serviceInfo.serviceUuid());
-                bool serviceClassMatched = false;
-                const QList<QBluetoothUuid> serviceClassUuids
-                        = serviceInfo.serviceClassUuids();
-                for (const QBluetoothUuid &id : serviceClassUuids) {
-                    if (uuidFilter.contains(id)) {
-                        serviceClassMatched = true;
-                        break;
-                    }
-                }
+        for (const QString &record : xmlRecords)
+            addServiceRecord(parseServiceXml(record));
+    }
 
-                if (!serviceNameMatched && !serviceClassMatched)
-                    continue;
-            }
+    _q_serviceDiscoveryFinished();
+}
 
-            if (!serviceInfo.isValid())
-                continue;
-
-            // Bluez sdpscanner declares custom uuids into the service class uuid list.
-            // Let's move a potential custom uuid from QBluetoothServiceInfo::serviceClassUuids()
-            // to QBluetoothServiceInfo::serviceUuid(). If there is more than one, just move the first uuid
-            const QList<QBluetoothUuid> serviceClassUuids = serviceInfo.serviceClassUuids();
-            for (const QBluetoothUuid &id : serviceClassUuids) {
-                if (id.minimumSize() == 16) {
-                    serviceInfo.setServiceUuid(id);
-                    if (serviceInfo.serviceName().isEmpty()) {
-                        serviceInfo.setServiceName(
-                                    QBluetoothServiceDiscoveryAgent::tr("Custom Service"));
-                    }
-                    QBluetoothServiceInfo::Sequence modSeq =
-                            serviceInfo.attribute(QBluetoothServiceInfo::ServiceClassIds).value<QBluetoothServiceInfo::Sequence>();
-                    modSeq.removeOne(QVariant::fromValue(id));
-                    serviceInfo.setAttribute(QBluetoothServiceInfo::ServiceClassIds, modSeq);
-                    break;
-                }
+void QBluetoothServiceDiscoveryAgentPrivate::addServiceRecord(QBluetoothServiceInfo serviceInfo)
+{
+    Q_Q(QBluetoothServiceDiscoveryAgent);
+
+    //apply uuidFilter
+    if (!uuidFilter.isEmpty()) {
+        bool serviceNameMatched = uuidFilter.contains(serviceInfo.serviceUuid());
+        bool serviceClassMatched = false;
+        const QList<QBluetoothUuid> serviceClassUuids
+                = serviceInfo.serviceClassUuids();
+        for (const QBluetoothUuid &id : serviceClassUuids) {
+            if (uuidFilter.contains(id)) {
+                serviceClassMatched = true;
+                break;
             }
+        }
 
-            if (!isDuplicatedService(serviceInfo)) {
-                discoveredServices.append(serviceInfo);
-                qCDebug(QT_BT_BLUEZ) << "Discovered services" << discoveredDevices.at(0).address().toString()
-                                     << serviceInfo.serviceName() << serviceInfo.serviceUuid()
-                                     << ">>>" << serviceInfo.serviceClassUuids();
-                // Use queued connection to allow us finish the service looping; the application
-                // might call stop() when it has detected the service-of-interest.
-                QMetaObject::invokeMethod(q, "serviceDiscovered", Qt::QueuedConnection,
-                                          Q_ARG(QBluetoothServiceInfo, serviceInfo));
+        if (!serviceNameMatched && !serviceClassMatched)
+            return;
+    }
+
+    if (!serviceInfo.isValid())
+        return;
+
+    // Bluez sdpscanner declares custom uuids into the service class uuid list.
+    // Let's move a potential custom uuid from QBluetoothServiceInfo::serviceClassUuids()
+    // to QBluetoothServiceInfo::serviceUuid(). If there is more than one, just move the first uuid
+    const QList<QBluetoothUuid> serviceClassUuids = serviceInfo.serviceClassUuids();
+    for (const QBluetoothUuid &id : serviceClassUuids) {
+        if (id.minimumSize() == 16) {
+            serviceInfo.setServiceUuid(id);
+            if (serviceInfo.serviceName().isEmpty()) {
+                serviceInfo.setServiceName(
+                            QBluetoothServiceDiscoveryAgent::tr("Custom Service"));
             }
+            QBluetoothServiceInfo::Sequence modSeq =
+                    serviceInfo.attribute(QBluetoothServiceInfo::ServiceClassIds).value<QBluetoothServiceInfo::Sequence>();
+            modSeq.removeOne(QVariant::fromValue(id));
+            serviceInfo.setAttribute(QBluetoothServiceInfo::ServiceClassIds, modSeq);
+            break;
         }
     }
 
-    _q_serviceDiscoveryFinished();
+    if (!isDuplicatedService(serviceInfo)) {
+        discoveredServices.append(serviceInfo);
+        qCDebug(QT_BT_BLUEZ) << "Discovered services" << serviceInfo.device().address().toString()
+                             << serviceInfo.serviceName() << serviceInfo.serviceUuid()
+                             << ">>>" << serviceInfo.serviceClassUuids();
+        // Use queued connection to allow us finish the service looping; the application
+        // might call stop() when it has detected the service-of-interest.
+        QMetaObject::invokeMethod(q, "serviceDiscovered", Qt::QueuedConnection,
+                                  Q_ARG(QBluetoothServiceInfo, serviceInfo));
+    }
 }
 
 void QBluetoothServiceDiscoveryAgentPrivate::stop()
@@ -258,6 +713,11 @@ void QBluetoothServiceDiscoveryAgentPrivate::stop()
     discoveredDevices.clear();
     setDiscoveryState(Inactive);
 
+    for (auto it = sdpWorkerJobs.cbegin(); it != sdpWorkerJobs.cend(); ++it)
+        QtBluezSdpScannerWorker::instance()->cancel(it.key());
+    sdpWorkerJobs.clear();
+    sdpDiscoveryTimer.invalidate();
+
     // must happen after discoveredDevices.clear() above to avoid retrigger of next scan
     // while waitForFinished() is waiting
     if (sdpScannerProcess) { // Bluez 5
@@ -297,6 +757,25 @@ QBluetoothServiceInfo QBluetoothServiceDiscoveryAgentPrivate::parseServiceXml(
     return serviceInfo;
 }
 
+QBluetoothServiceInfo QBluetoothServiceDiscoveryAgentPrivate::parseServiceRecord(
+                            QByteArrayView record, const QBluetoothDeviceInfo &device)
+{
+    QBluetoothServiceInfo serviceInfo;
+    serviceInfo.setDevice(device);
+
+    while (!record.isEmpty()) {
+        quint16 attributeId;
+        QVariant value;
+        if (!takeBigEndian(record, &attributeId) || !readBinaryAttributeValue(record, &value)) {
+            qCWarning(QT_BT_BLUEZ) << "Ignoring malformed SDP record";
+            return QBluetoothServiceInfo();
+        }
+        serviceInfo.setAttribute(attributeId, value);
+    }
+
+    return serviceInfo;
+}
+
 // Bluez 5
 void QBluetoothServiceDiscoveryAgentPrivate::performMinimalServiceDiscovery(const QBluetoothAddress &deviceAddress)
 {
@@ -28,6 +28,9 @@ class OrgBluezManagerInterface;
 class OrgBluezAdapterInterface;
 class OrgBluezDeviceInterface;
 class OrgFreedesktopDBusObjectManagerInterface;
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmap.h>
 #include <QtCore/qprocess.h>
 
 QT_BEGIN_NAMESPACE
@@ -62,7 +65,7 @@ class LocalDeviceBroadcastReceiver;
 class QWinRTBluetoothServiceDiscoveryWorker;
 #endif
 
-class QBluetoothServiceDiscoveryAgentPrivate
+class Q_AUTOTEST_EXPORT QBluetoothServiceDiscoveryAgentPrivate
 #if defined(QT_WINRT_BLUETOOTH)
         : public QObject
 {
@@ -86,6 +89,9 @@ public:
                                            const QBluetoothAddress &deviceAdapter);
     ~QBluetoothServiceDiscoveryAgentPrivate();
 
+    static QBluetoothServiceDiscoveryAgentPrivate *get(QBluetoothServiceDiscoveryAgent *q)
+    { return q->d_func(); }
+
     void startDeviceDiscovery();
     void stopDeviceDiscovery();
     void startServiceDiscovery();
@@ -102,6 +108,9 @@ public:
     void _q_serviceDiscoveryFinished();
     void _q_deviceDiscoveryError(QBluetoothDeviceDiscoveryAgent::Error);
 #if QT_CONFIG(bluez)
+    void _q_sdpScannerReadyRead();
+    void _q_sdpWorkerRecordReceived(quint64 jobId, const QByteArray &record);
+    void _q_sdpWorkerScanFinished(quint64 jobId, int exitCode);
     void _q_sdpScannerDone(int exitCode, QProcess::ExitStatus status);
     void _q_finishSdpScan(QBluetoothServiceDiscoveryAgent::Error errorCode,
                           const QString &errorDescription,
@@ -123,15 +132,37 @@ private:
 
 #if QT_CONFIG(bluez)
     void startBluez5(const QBluetoothAddress &address);
-    void runExternalSdpScan(const QBluetoothAddress &remoteAddress,
-                    const QBluetoothAddress &localAddress);
     void sdpScannerDone(int exitCode, QProcess::ExitStatus exitStatus);
+    void sdpScanFailed();
+    void startSdpWorkerScans();
+    void finishSdpDiscoveryTiming();
+    bool reportCachedSdpRecords(const QBluetoothDeviceInfo &device);
+    void updateSdpCache(const QBluetoothAddress &address, const QList<QByteArray> &records,
+                        bool scanSucceeded);
     QVariant readAttributeValue(QXmlStreamReader &xml);
     QBluetoothServiceInfo parseServiceXml(const QString& xml);
+    QBluetoothServiceInfo parseServiceRecord(QByteArrayView record,
+                                             const QBluetoothDeviceInfo &device);
+    void addServiceRecord(QBluetoothServiceInfo serviceInfo);
     void performMinimalServiceDiscovery(const QBluetoothAddress &deviceAddress);
 #endif
 
 public:
+#if QT_CONFIG(bluez)
+    // Scans the services of discoveredDevices, public for testing
+    void runExternalSdpScan(const QBluetoothAddress &remoteAddress,
+                    const QBluetoothAddress &localAddress);
+
+    // Maximum number of devices scanned in parallel by FullDiscovery, the default
+    // is set by QT_BLUETOOTH_SDP_CONCURRENCY
+    void setSdpScanConcurrency(int concurrency) { maxParallelSdpScans = qMax(1, concurrency); }
+    int sdpScanConcurrency() const { return maxParallelSdpScans; }
+    // scan time in ms of each device of the current or last FullDiscovery
+    QMap<QBluetoothAddress, qint64> sdpScanDurations() const { return sdpScanTimes; }
+    // time in ms spent for scanning all devices of the last FullDiscovery
+    qint64 sdpDiscoveryDuration() const { return sdpDiscoveryTime; }
+#endif
+
     QBluetoothServiceDiscoveryAgent::Error error;
     QString errorString;
     QBluetoothAddress deviceAddress;
@@ -152,6 +183,25 @@ private:
     QString foundHostAdapterPath;
     OrgFreedesktopDBusObjectManagerInterface *manager = nullptr;
     QProcess *sdpScannerProcess = nullptr;
+    // binary records received from sdpscanner which are not yet complete
+    QByteArray sdpScannerOutput;
+    // complete binary records of the running sdpscanner process, see SdpCache
+    QList<QByteArray> sdpScannerRecords;
+    // true if the installed sdpscanner does not support the binary record stream
+    bool sdpScannerXmlOutput = false;
+    struct SdpWorkerScan {
+        QBluetoothDeviceInfo device;
+        QElapsedTimer timer;
+        QList<QByteArray> records;
+    };
+    // running jobs of the shared sdpscanner worker
+    QHash<quint64, SdpWorkerScan> sdpWorkerJobs;
+    bool sdpWorkerConnected = false;
+    QBluetoothAddress sdpScanLocalAddress;
+    int maxParallelSdpScans = 1;
+    QMap<QBluetoothAddress, qint64> sdpScanTimes;
+    qint64 sdpDiscoveryTime = 0;
+    QElapsedTimer sdpDiscoveryTimer;
 #endif
 
 #ifdef QT_ANDROID_BLUETOOTH
@@ -13,6 +13,7 @@
 #include <QtCore/private/qcore_unix_p.h>
 
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QPointer>
 
 #include <errno.h>
 #include <unistd.h>
@@ -293,36 +294,42 @@ void QBluetoothSocketPrivateBluez::_q_writeNotify()
 
         connectWriteNotifier->setEnabled(false);
         connecting = false;
+        txChunkSize = 0; // MTU is known only now
     }
     else {
         if (txBuffer.size() == 0) {
             connectWriteNotifier->setEnabled(false);
+            if (unbufferedWriteBlocked) {
+                unbufferedWriteBlocked = false;
+                emit readyWrite();
+            }
             return;
         }
 
-        char buf[1024];
-
-        const auto size = txBuffer.read(buf, 1024);
-        const auto writtenBytes = qt_safe_write(socket, buf, size);
-        if (writtenBytes < 0) {
-            switch (errno) {
-            case EAGAIN:
-                txBuffer.ungetBlock(buf, size);
-                break;
-            default:
-                // every other case returns error
-                errorString = QBluetoothSocket::tr("Network Error: %1").arg(qt_error_string(errno)) ;
-                q->setSocketError(QBluetoothSocket::SocketError::NetworkError);
+        // Write straight out of the buffer until it is drained or the socket is full.
+        // Data which the kernel did not take stays in place.
+        const qint64 chunkSize = writeChunkSize();
+        qint64 totalWritten = 0;
+        int writeError = 0;
+        while (!txBuffer.isEmpty()) {
+            const qint64 size = (std::min)(qint64(txBuffer.size()), chunkSize);
+            const auto writtenBytes = qt_safe_write(socket, txBuffer.readPointer(), size);
+            if (writtenBytes < 0) {
+                if (errno != EAGAIN)
+                    writeError = errno;
                 break;
             }
-        } else {
-            if (writtenBytes < size) {
-                // add remainder back to buffer
-                char* remainder = buf + writtenBytes;
-                txBuffer.ungetBlock(remainder, size - writtenBytes);
-            }
-            if (writtenBytes > 0)
-                emit q->bytesWritten(writtenBytes);
+            txBuffer.skip(writtenBytes);
+            totalWritten += writtenBytes;
+            if (writtenBytes < size)
+                break;
+        }
+
+        if (totalWritten > 0)
+            emit q->bytesWritten(totalWritten);
+        if (writeError) {
+            errorString = QBluetoothSocket::tr("Network Error: %1").arg(qt_error_string(writeError));
+            q->setSocketError(QBluetoothSocket::SocketError::NetworkError);
         }
 
         if (txBuffer.size()) {
@@ -335,15 +342,87 @@ void QBluetoothSocketPrivateBluez::_q_writeNotify()
     }
 }
 
+/*!
+    \internal
+
+    Returns the number of bytes to pass to a single write() call.
+
+    Every write on an L2CAP socket creates one packet, which must not exceed the outgoing
+    MTU. Stream sockets accept as much as fits into their send buffer.
+ */
+qint64 QBluetoothSocketPrivateBluez::writeChunkSize()
+{
+    if (txChunkSize > 0)
+        return txChunkSize;
+
+    txChunkSize = 1024;
+    if (socketType == QBluetoothServiceInfo::L2capProtocol) {
+        quint16 mtu = 0;
+        socklen_t length = sizeof(mtu);
+        if (::getsockopt(socket, SOL_BLUETOOTH, BT_SNDMTU, &mtu, &length) == 0 && mtu > 0) {
+            txChunkSize = mtu;
+        } else {
+            l2cap_options options = {};
+            length = sizeof(options);
+            if (::getsockopt(socket, SOL_L2CAP, L2CAP_OPTIONS, &options, &length) == 0
+                    && options.omtu > 0) {
+                txChunkSize = options.omtu;
+            }
+        }
+    } else {
+        int sendBufferSize = 0;
+        socklen_t length = sizeof(sendBufferSize);
+        if (::getsockopt(socket, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, &length) == 0
+                && sendBufferSize > 0) {
+            txChunkSize = sendBufferSize;
+        }
+    }
+    qCDebug(QT_BT_BLUEZ) << "Socket write chunk size:" << txChunkSize;
+    return txChunkSize;
+}
+
 void QBluetoothSocketPrivateBluez::_q_readNotify()
 {
     Q_Q(QBluetoothSocket);
-    char *writePointer = rxBuffer.reserve(QPRIVATELINEARBUFFER_BUFFERSIZE);
-//    qint64 readFromDevice = q->readData(writePointer, QPRIVATELINEARBUFFER_BUFFERSIZE);
-    const auto readFromDevice = ::read(socket, writePointer, QPRIVATELINEARBUFFER_BUFFERSIZE);
-    rxBuffer.chop(QPRIVATELINEARBUFFER_BUFFERSIZE - (readFromDevice < 0 ? 0 : readFromDevice));
-    if(readFromDevice <= 0){
-        int errsv = errno;
+    ++readStats.notifications;
+
+    // Each read of an L2CAP (SEQPACKET) socket returns one datagram. It must neither be
+    // truncated by a small chunk nor be joined with the next one in rxBuffer.
+    const bool isDatagramSocket = socketType == QBluetoothServiceInfo::L2capProtocol;
+    const qint64 readChunkSize = isDatagramSocket ? QPRIVATELINEARBUFFER_BUFFERSIZE : rxChunkSize;
+    // Without coalescing a single read() is done per notification, also after a short read
+    const bool coalesce = coalesceReads && !isDatagramSocket;
+    const qint64 budget = coalesce ? rxReadBudget : readChunkSize;
+    qint64 totalRead = 0;
+    qint64 readFromDevice = 0;
+    int errsv = 0;
+    do {
+        const qint64 chunkSize = qMin(readChunkSize, budget - totalRead);
+        char *writePointer = rxBuffer.reserve(chunkSize);
+        readFromDevice = ::read(socket, writePointer, chunkSize);
+        errsv = errno;
+        rxBuffer.chop(chunkSize - (readFromDevice < 0 ? 0 : readFromDevice));
+        if (readFromDevice <= 0)
+            break;
+
+        ++readStats.reads;
+        totalRead += readFromDevice;
+    } while (coalesce && totalRead < budget);
+
+    // Running out of data after a successful read is the expected end of a batch
+    const bool failed = readFromDevice == 0
+            || (readFromDevice < 0 && (totalRead == 0 || errsv != EAGAIN));
+
+    if (totalRead > 0) {
+        readStats.bytesRead += totalRead;
+        ++readStats.readyReadSignals;
+        QPointer<QBluetoothSocket> guard(q);
+        emit q->readyRead();
+        if (!guard || !failed)
+            return;
+    }
+
+    if (failed) {
         readNotifier->setEnabled(false);
         connectWriteNotifier->setEnabled(false);
         errorString = qt_error_string(errsv);
@@ -357,9 +436,6 @@ void QBluetoothSocketPrivateBluez::_q_readNotify()
 
         q->disconnectFromService();
     }
-    else {
-        emit q->readyRead();
-    }
 }
 
 void QBluetoothSocketPrivateBluez::abort()
@@ -538,6 +614,9 @@ qint64 QBluetoothSocketPrivateBluez::writeData(const char *data, qint64 maxSize)
             switch (errno) {
             case EAGAIN:
                 sz = 0;
+                unbufferedWriteBlocked = true;
+                if (connectWriteNotifier)
+                    connectWriteNotifier->setEnabled(true);
                 break;
             default:
                 errorString = QBluetoothSocket::tr("Network Error: %1").arg(qt_error_string(errno));
@@ -607,6 +686,8 @@ bool QBluetoothSocketPrivateBluez::setSocketDescriptor(int socketDescriptor, QBl
         QT_CLOSE(socket);
 
     socket = socketDescriptor;
+    txChunkSize = 0;
+    unbufferedWriteBlocked = false;
 
     // ensure that O_NONBLOCK is set on new connections.
     int flags = fcntl(socket, F_GETFL, 0);
@@ -17,9 +17,11 @@
 
 #include "qbluetoothsocketbase_p.h"
 
+#include <QtCore/private/qglobal_p.h>
+
 QT_BEGIN_NAMESPACE
 
-class QBluetoothSocketPrivateBluez final: public QBluetoothSocketBasePrivate
+class Q_AUTOTEST_EXPORT QBluetoothSocketPrivateBluez final: public QBluetoothSocketBasePrivate
 {
     Q_OBJECT
 
@@ -62,9 +64,49 @@ public:
     bool canReadLine() const override;
     qint64 bytesToWrite() const override;
 
+    struct ReadStatistics {
+        // read notifications handled
+        quint64 notifications = 0;
+        // successful read() calls
+        quint64 reads = 0;
+        quint64 bytesRead = 0;
+        quint64 readyReadSignals = 0;
+    };
+    ReadStatistics readStatistics() const { return readStats; }
+    // If enabled, each read notification drains the socket until it would block or until
+    // the read budget is exhausted and emits a single readyRead() for the whole batch.
+    // Read coalescing and the read chunk size apply to RFCOMM only, an L2CAP socket is
+    // read one datagram at a time.
+    void setReadCoalescingEnabled(bool enabled) { coalesceReads = enabled; }
+    bool isReadCoalescingEnabled() const { return coalesceReads; }
+    // Largest amount of data requested from the kernel with a single read
+    void setReadChunkSize(qint64 size) { rxChunkSize = qMax(size, qint64(1)); }
+    qint64 readChunkSize() const { return rxChunkSize; }
+    // Largest amount of data read per notification if read coalescing is enabled
+    void setReadBudget(qint64 size) { rxReadBudget = qMax(size, qint64(1)); }
+    qint64 readBudget() const { return rxReadBudget; }
+
+signals:
+    // Emitted in Unbuffered mode once the socket takes data again after a write
+    // returned 0 because it would have blocked
+    void readyWrite();
+
 private slots:
     void _q_readNotify();
     void _q_writeNotify();
+
+private:
+    qint64 writeChunkSize();
+
+    // Largest amount of data handed to the kernel with a single write, 0 if not yet known
+    qint64 txChunkSize = 0;
+
+    qint64 rxChunkSize = QPRIVATELINEARBUFFER_BUFFERSIZE;
+    qint64 rxReadBudget = 16 * QPRIVATELINEARBUFFER_BUFFERSIZE;
+    bool coalesceReads = false;
+    ReadStatistics readStats;
+    // an unbuffered write would have blocked, see readyWrite()
+    bool unbufferedWriteBlocked = false;
 };
 
 QT_END_NAMESPACE
@@ -795,12 +795,21 @@ void QLowEnergyController::startAdvertising(const QLowEnergyAdvertisingParameter
    The controller has to be in the \l PeripheralRole for this function to work.
    It does not invalidate services which have previously been added via \l addService().
 
+   If the controller is in the \l ConnectedState and keeps advertising because
+   \l maximumCentralCount() permits further centrals, this function stops the
+   advertisement and no further centrals are accepted. The centrals which are
+   already connected remain connected.
+
    \since 5.7
-   \sa startAdvertising()
+   \sa startAdvertising(), setMaximumCentralCount()
  */
 void QLowEnergyController::stopAdvertising()
 {
     Q_D(QLowEnergyController);
+    if (state() == ConnectedState && role() == PeripheralRole) {
+        d->stopAcceptingCentrals();
+        return;
+    }
     if (state() != AdvertisingState) {
         qCDebug(QT_BT) << "stopAdvertising called in state" << state();
         return;
@@ -937,15 +946,92 @@ QLowEnergyController::Role QLowEnergyController::role() const
 
    If the controller is in the \l PeripheralRole, there might be several
    central devices connected to it. In those cases this function returns
-   the MTU of the last connection that was negotiated.
+   the MTU of the connection to \l remoteAddress().
 
    \since 6.2
+   \sa setMaximumCentralCount(), setPreferredMtu()
  */
 int QLowEnergyController::mtu() const
 {
     return d_ptr->mtu();
 }
 
+/*!
+   Sets the number of central devices which a controller in the
+   \l PeripheralRole serves at the same time to \a count.
+
+   Once a central has connected, the controller continues to advertise
+   until \a count centrals are connected. It resumes advertising when one
+   of them disconnects. The controller remains in the \l ConnectedState
+   while any central is connected, \l remoteAddress() and \l mtu() refer to
+   the first of them. Each central has its own client characteristic
+   configurations, and notifications and indications are sent to every
+   central which enabled them.
+
+   The value applies to centrals connecting after this call. Values less
+   than \c 1 are treated as \c 1, which is the default.
+
+   \note Only the BlueZ backend, when it uses the kernel ATT interface,
+   serves more than one central. The other backends ignore this value.
+
+   \since 6.9
+   \sa maximumCentralCount(), stopAdvertising()
+ */
+void QLowEnergyController::setMaximumCentralCount(int count)
+{
+    if (role() != PeripheralRole) {
+        qCWarning(QT_BT) << "The number of centrals can only be set in the peripheral role";
+        return;
+    }
+    d_ptr->maxCentralCount = qMax(1, count);
+}
+
+/*!
+   Returns the number of central devices which a controller in the
+   \l PeripheralRole serves at the same time.
+
+   \since 6.9
+   \sa setMaximumCentralCount()
+ */
+int QLowEnergyController::maximumCentralCount() const
+{
+    return d_ptr->maxCentralCount;
+}
+
+/*!
+   Sets the ATT MTU which the controller offers during the MTU exchange
+   to \a mtu.
+
+   The negotiated \l mtu() never exceeds this value. A smaller value
+   reduces the memory and air time per packet, a larger value permits
+   more data per packet. The value applies to the next MTU exchange,
+   hence it should be set before connecting or advertising. It is bound
+   to the range from \c 23 to \c 512, the default is \c 512 or the value
+   of the \c QT_BLUETOOTH_ATT_MTU environment variable.
+
+   \note Only the BlueZ backend, when it uses the kernel ATT interface,
+   negotiates the MTU itself. The other backends ignore this value.
+
+   \since 6.9
+   \sa preferredMtu(), mtu()
+ */
+void QLowEnergyController::setPreferredMtu(int mtu)
+{
+    d_ptr->setPreferredMtu(mtu);
+}
+
+/*!
+   Returns the ATT MTU which the controller offers during the MTU
+   exchange, or \c -1 if the platform negotiates the MTU itself.
+
+   \since 6.9
+   \sa setPreferredMtu()
+ */
+int QLowEnergyController::preferredMtu() const
+{
+    return d_ptr->preferredMtu();
+}
+
 /*!
     readRssi() reads RSSI (received signal strength indicator) for a connected remote device.
     If the read was successful, the RSSI is then reported by rssiRead() signal.
@@ -106,6 +106,12 @@ public:
     int mtu() const;
     void readRssi();
 
+    void setMaximumCentralCount(int count);
+    int maximumCentralCount() const;
+
+    void setPreferredMtu(int mtu);
+    int preferredMtu() const;
+
 Q_SIGNALS:
     void connected();
     void disconnected();
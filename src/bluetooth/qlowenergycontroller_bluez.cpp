@@ -7,15 +7,18 @@
 #include "qbluetoothsocketbase_p.h"
 #include "qbluetoothsocket_bluez_p.h"
 #include "qleadvertiser_bluez_p.h"
+#include "bluez/attpdu_p.h"
 #include "bluez/bluez_data_p.h"
 #include "bluez/hcimanager_p.h"
 #include "bluez/objectmanager_p.h"
 #include "bluez/remotedevicemanager_p.h"
 #include "bluez/bluez5_helper_p.h"
 #include "bluez/bluetoothmanagement_p.h"
+#include "bluez/bondstatecache_p.h"
 
 #include <QtCore/QFileInfo>
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QMutex>
 #include <QtCore/QSettings>
 #include <QtCore/QTimer>
 #include <QtBluetooth/QBluetoothLocalDevice>
@@ -40,6 +43,7 @@ constexpr quint16 ATT_MAX_LE_MTU = 0x200;
 #define GATT_SECONDARY_SERVICE  quint16(0x2801)
 #define GATT_INCLUDED_SERVICE   quint16(0x2802)
 #define GATT_CHARACTERISTIC     quint16(0x2803)
+#define GATT_DATABASE_HASH      quint16(0x2B2A)
 
 //GATT command sizes in bytes
 #define ERROR_RESPONSE_HEADER_SIZE 5
@@ -64,19 +68,17 @@ using namespace QBluetooth;
 
 const int maxPrepareQueueSize = 1024;
 
-static void dumpErrorInformation(const QByteArray &response)
+static void dumpErrorInformation(const AttPduView &response)
 {
-    const char *data = response.constData();
     if (response.size() != 5
-        || (static_cast<QBluezConst::AttCommand>(data[0])
-            != QBluezConst::AttCommand::ATT_OP_ERROR_RESPONSE)) {
+        || response.opcode() != QBluezConst::AttCommand::ATT_OP_ERROR_RESPONSE) {
         qCWarning(QT_BT_BLUEZ) << QLatin1String("Not a valid error response");
         return;
     }
 
-    QBluezConst::AttCommand lastCommand = static_cast<QBluezConst::AttCommand>(data[1]);
-    quint16 handle = bt_get_le16(&data[2]);
-    QBluezConst::AttError errorCode = static_cast<QBluezConst::AttError>(data[4]);
+    QBluezConst::AttCommand lastCommand = response.errorRequestOpcode();
+    quint16 handle = response.errorHandle();
+    QBluezConst::AttError errorCode = response.errorCode();
 
     QString errorString;
     switch (errorCode) {
@@ -162,6 +164,8 @@ QLowEnergyControllerPrivateBluez::QLowEnergyControllerPrivateBluez()
     : QLowEnergyControllerPrivate(),
       requestPending(false),
       mtuSize(ATT_DEFAULT_LE_MTU),
+      preferredMtuSize(ATT_MAX_LE_MTU),
+      requestMtuSize(ATT_DEFAULT_LE_MTU),
       securityLevelValue(-1),
       encryptionChangePending(false)
 {
@@ -171,6 +175,8 @@ QLowEnergyControllerPrivateBluez::QLowEnergyControllerPrivateBluez()
 
 void QLowEnergyControllerPrivateBluez::init()
 {
+    signCounterStore = new SignCounterStore(this);
+
     // The HCI manager is shared between this class and the advertiser
     hciManager = std::make_shared<HciManager>(localAdapter);
 
@@ -185,30 +191,59 @@ void QLowEnergyControllerPrivateBluez::init()
     hciManager->monitorEvent(HciManager::HciEvent::EVT_LE_META_EVENT);
     hciManager->monitorAclPackets();
     connect(hciManager.get(), &HciManager::connectionComplete, this, [this](quint16 handle) {
+        // in the peripheral role acceptCentral() prefers the handle of the central's socket
         connectionHandle = handle;
         qCDebug(QT_BT_BLUEZ) << "received connection complete event, handle:" << handle;
     });
     connect(hciManager.get(), &HciManager::connectionUpdate, this,
             [this](quint16 handle, const QLowEnergyConnectionParameters &params) {
-                if (handle == connectionHandle)
+                // connectionUpdated() refers to the primary central, see ClientSession
+                const ClientSession *primary = primaryCentral();
+                if (handle == (primary ? primary->connectionHandle : connectionHandle))
                     emit q_ptr->connectionUpdated(params);
             }
     );
     connect(hciManager.get(), &HciManager::signatureResolvingKeyReceived, this,
             [this](quint16 handle, bool remoteKey, const QUuid::Id128Bytes &csrk) {
-                if (handle != connectionHandle)
-                    return;
                 if ((remoteKey && role == QLowEnergyController::CentralRole)
                         || (!remoteKey && role == QLowEnergyController::PeripheralRole)) {
                     return;
                 }
+                QBluetoothAddress peer;
+                if (role == QLowEnergyController::CentralRole) {
+                    if (handle == connectionHandle)
+                        peer = remoteDevice;
+                } else if (const ClientSession *session = centralSession(handle)) {
+                    peer = session->remoteDevice;
+                }
+                if (peer.isNull())
+                    return;
                 qCDebug(QT_BT_BLUEZ) << "received new signature resolving key"
                                      << QByteArray(reinterpret_cast<const char *>(csrk.data),
                                                    sizeof csrk).toHex();
-                signingData.insert(remoteDevice.toUInt64(), SigningData(csrk));
+                signingData.insert(peer.toUInt64(), SigningData(csrk));
+                // the counter of the previous key must not be applied to the new one
+                signCounterStore->remove(keySettingsFilePath(peer), remoteKey
+                                         ? SignCounterStore::RemoteKey
+                                         : SignCounterStore::LocalKey);
         }
     );
 
+    if (Q_UNLIKELY(!qEnvironmentVariableIsEmpty("QT_BLUETOOTH_ATT_MTU"))) {
+        bool ok = false;
+        const int value = qEnvironmentVariableIntValue("QT_BLUETOOTH_ATT_MTU", &ok);
+        if (ok)
+            setPreferredMtu(value);
+    }
+
+    if (role == QLowEnergyController::PeripheralRole
+            && Q_UNLIKELY(!qEnvironmentVariableIsEmpty("QT_BLUETOOTH_MAX_CENTRALS"))) {
+        bool ok = false;
+        const int value = qEnvironmentVariableIntValue("QT_BLUETOOTH_MAX_CENTRALS", &ok);
+        if (ok)
+            maxCentralCount = qMax(1, value);
+    }
+
     if (role == QLowEnergyController::CentralRole) {
         if (Q_UNLIKELY(!qEnvironmentVariableIsEmpty("BLUETOOTH_GATT_TIMEOUT"))) {
             bool ok = false;
@@ -226,6 +261,7 @@ void QLowEnergyControllerPrivateBluez::init()
             connect(requestTimer, &QTimer::timeout,
                     this, &QLowEnergyControllerPrivateBluez::handleGattRequestTimeout);
         }
+        readMultipleVariableSupported = requestTimer != nullptr;
     }
 }
 
@@ -291,6 +327,12 @@ void QLowEnergyControllerPrivateBluez::handleGattRequestTimeout()
             processReply(currentRequest, createRequestErrorMessage(
                                             command, currentRequest.reference2.toUInt()));
             break;
+        case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST: // batched value reads
+        case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST:
+            // the batch is repeated with single reads
+            processReply(currentRequest, createRequestErrorMessage(
+                    command, bt_get_le16(currentRequest.payload.constData() + 1)));
+            break;
         case QBluezConst::AttCommand::ATT_OP_PREPARE_WRITE_REQUEST: // prepare to write long desc or
                                                                     // char
         case QBluezConst::AttCommand::ATT_OP_EXECUTE_WRITE_REQUEST: // execute long write of desc or
@@ -409,16 +451,25 @@ void QLowEnergyControllerPrivateBluez::stopAdvertising()
     advertiser->stopAdvertising();
 }
 
+void QLowEnergyControllerPrivateBluez::stopAcceptingCentrals()
+{
+    // the connected centrals are kept, see ClientSession
+    if (advertiser)
+        advertiser->stopAdvertising();
+    closeServerSocket();
+}
+
 void QLowEnergyControllerPrivateBluez::requestConnectionUpdate(const QLowEnergyConnectionParameters &params)
 {
     // The spec says that the connection update command can be used by both slave and master
     // devices, but BlueZ allows it only for master devices. So for slave devices, we have to use a
     // connection parameter update request, which we need to wrap in an ACL command, as BlueZ
     // does not allow user-space sockets for the signaling channel.
-    if (role == QLowEnergyController::CentralRole)
+    if (role == QLowEnergyController::CentralRole) {
         hciManager->sendConnectionUpdateCommand(connectionHandle, params);
-    else
-        hciManager->sendConnectionParameterUpdateRequest(connectionHandle, params);
+    } else if (const ClientSession *primary = primaryCentral()) {
+        hciManager->sendConnectionParameterUpdateRequest(primary->connectionHandle, params);
+    }
 }
 
 void QLowEnergyControllerPrivateBluez::connectToDevice()
@@ -542,7 +593,7 @@ void QLowEnergyControllerPrivateBluez::establishL2cpClientSocket()
     // Unbuffered mode required to separate each GATT packet
     l2cpSocket->connectToService(remoteDevice, ATTRIBUTE_CHANNEL_ID,
                                  QIODevice::ReadWrite | QIODevice::Unbuffered);
-    loadSigningDataIfNecessary(LocalSigningKey);
+    loadSigningDataIfNecessary(LocalSigningKey, remoteDevice);
 }
 
 void QLowEnergyControllerPrivateBluez::createServicesForCentralIfRequired()
@@ -615,7 +666,16 @@ void QLowEnergyControllerPrivateBluez::l2cpConnected()
 {
     Q_Q(QLowEnergyController);
 
-    securityLevelValue = securityLevel();
+    securityLevelValue = securityLevel(l2cpSocket);
+    // the remote device may use the local services, see createServicesForCentralIfRequired()
+    peerSession = std::make_shared<ClientSession>();
+    peerSession->socket = l2cpSocket;
+    peerSession->remoteDevice = remoteDevice;
+    peerSession->remoteName = remoteName;
+    peerSession->mtuSize = mtuSize;
+    // an unknown peer which ignores the request would stall the discovery without timeout
+    readMultipleVariableSupported =
+            knownReadMultipleVariableSupport(remoteDevice).value_or(requestTimer != nullptr);
     exchangeMTU();
 
     setState(QLowEnergyController::ConnectedState);
@@ -625,6 +685,11 @@ void QLowEnergyControllerPrivateBluez::l2cpConnected()
 void QLowEnergyControllerPrivateBluez::disconnectFromDevice()
 {
     setState(QLowEnergyController::ClosingState);
+    if (role == QLowEnergyController::PeripheralRole) {
+        // the sockets of the centrals no longer report their closure, see closeCentrals()
+        l2cpDisconnected();
+        return;
+    }
     if (l2cpSocket)
         l2cpSocket->close();
     resetController();
@@ -641,8 +706,10 @@ void QLowEnergyControllerPrivateBluez::l2cpDisconnected()
 {
     Q_Q(QLowEnergyController);
 
+    if (signCounterStore)
+        signCounterStore->flush();
     if (role == QLowEnergyController::PeripheralRole) {
-        storeClientConfigurations();
+        closeCentrals();
         remoteDevice.clear();
         remoteName.clear();
     }
@@ -674,7 +741,8 @@ void QLowEnergyControllerPrivateBluez::l2cpErrorChanged(QBluetoothSocket::Socket
     default:
         // these errors shouldn't happen -> as it means
         // the code in this file has bugs
-        qCDebug(QT_BT_BLUEZ) << "Unknown l2cp socket error: " << e << l2cpSocket->errorString();
+        qCDebug(QT_BT_BLUEZ) << "Unknown l2cp socket error: " << e
+                             << (l2cpSocket ? l2cpSocket->errorString() : QString());
         setError(QLowEnergyController::UnknownError);
         break;
     }
@@ -688,13 +756,20 @@ void QLowEnergyControllerPrivateBluez::l2cpErrorChanged(QBluetoothSocket::Socket
 void QLowEnergyControllerPrivateBluez::resetController()
 {
     openRequests.clear();
-    openPrepareWriteRequests.clear();
-    scheduledIndications.clear();
-    indicationInFlight = false;
+    if (peerSession) {
+        dropQueuedNotifications(*peerSession);
+        peerSession.reset();
+    }
+    gattCache = GattCache::Database();
+    gattCacheValid = false;
+    servicesFromGattCache.clear();
     requestPending = false;
+    commandsDuringPendingRequest = 0;
     encryptionChangePending = false;
-    receivedMtuExchangeRequest = false;
+    readMultipleSupported = true;
+    readMultipleVariableSupported = requestTimer != nullptr;
     mtuSize = ATT_DEFAULT_LE_MTU;
+    requestMtuSize = ATT_DEFAULT_LE_MTU;
     securityLevelValue = -1;
     connectionHandle = 0;
 
@@ -705,7 +780,13 @@ void QLowEnergyControllerPrivateBluez::resetController()
             delete advertiser;
             advertiser = nullptr;
         }
+        closeCentrals();
+        closeServerSocket();
         localAttributes.clear();
+        clientConfigCache.clear();
+        clientConfigCacheValid = false;
+        localAttributeTypeIndex.clear();
+        discoveryResponseCache.clear();
     }
 }
 
@@ -720,14 +801,51 @@ void QLowEnergyControllerPrivateBluez::restartRequestTimer()
 
 void QLowEnergyControllerPrivateBluez::l2cpReadyRead()
 {
-    const QByteArray incomingPacket = l2cpSocket->readAll();
-    qCDebug(QT_BT_BLUEZ) << "Received size:" << incomingPacket.size() << "data:"
-                         << incomingPacket.toHex();
-    if (incomingPacket.isEmpty())
+    readIncomingPdu(l2cpSocket, [this](const AttPduView &pdu) { dispatchIncomingPdu(pdu); });
+}
+
+void QLowEnergyControllerPrivateBluez::readIncomingPdu(
+        QBluetoothSocket *socket, const std::function<void(const AttPduView &)> &dispatch)
+{
+    // The PDU is read into a buffer which is reused for every packet and the
+    // handlers below decode it in place. Only values that need to be stored are copied.
+    // A nested call (e.g. via a user slot spinning the event loop) must not overwrite
+    // the PDU still being processed further up the stack, so it uses its own buffer.
+    QByteArray nestedBuffer;
+    QByteArray &buffer = rxPduBufferInUse ? nestedBuffer : rxPduBuffer;
+    if (buffer.size() < ATT_MAX_LE_MTU)
+        buffer.resize(ATT_MAX_LE_MTU);
+
+    const qint64 bytesRead = socket->read(buffer.data(), buffer.size());
+    if (bytesRead <= 0)
         return;
 
-    const QBluezConst::AttCommand command =
-            static_cast<QBluezConst::AttCommand>(incomingPacket.constData()[0]);
+    ++pduStats.pdusReceived;
+    pduStats.bytesReceived += bytesRead;
+
+    const AttPduView incomingPacket(QByteArrayView(buffer.constData(), bytesRead));
+    if (QT_BT_BLUEZ().isDebugEnabled()) {
+        qCDebug(QT_BT_BLUEZ) << "Received size:" << incomingPacket.size() << "data:"
+                             << incomingPacket.bytes().toByteArray().toHex();
+    }
+
+    const bool isOuterCall = !rxPduBufferInUse;
+    rxPduBufferInUse = true;
+    dispatch(incomingPacket);
+    if (isOuterCall)
+        rxPduBufferInUse = false;
+}
+
+void QLowEnergyControllerPrivateBluez::dispatchIncomingPdu(const AttPduView &incomingPacket)
+{
+    // requests of the remote device to the local services
+    if (peerSession) {
+        const std::shared_ptr<ClientSession> session = peerSession;
+        if (dispatchIncomingPdu(*session, incomingPacket))
+            return;
+    }
+
+    const QBluezConst::AttCommand command = incomingPacket.opcode();
     switch (command) {
     case QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION: {
         processUnsolicitedReply(incomingPacket);
@@ -742,68 +860,84 @@ void QLowEnergyControllerPrivateBluez::l2cpReadyRead()
         processUnsolicitedReply(incomingPacket);
         return;
     }
-    //--------------------------------------------------
-    // Peripheral side packet handling
-    case QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST:
-        handleExchangeMtuRequest(incomingPacket);
+    default:
+        //only solicited replies finish pending requests
+        requestPending = false;
+        break;
+    }
+
+    if (openRequests.isEmpty()) {
+        qCWarning(QT_BT_BLUEZ) << "Received unexpected packet from peer, disconnecting.";
+        disconnectFromDevice();
         return;
+    }
+
+    const Request request = openRequests.dequeue();
+    processReply(request, incomingPacket);
+
+    sendNextPendingRequest();
+}
+
+/*!
+    \internal
+
+    Handles \a incomingPacket if it is a request or command of the GATT client of
+    \a session to the local services, or the confirmation of an indication.
+    Returns \c false for any other PDU.
+ */
+bool QLowEnergyControllerPrivateBluez::dispatchIncomingPdu(ClientSession &session,
+                                                           const AttPduView &incomingPacket)
+{
+    switch (incomingPacket.opcode()) {
+    case QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST:
+        handleExchangeMtuRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_FIND_INFORMATION_REQUEST:
-        handleFindInformationRequest(incomingPacket);
-        return;
+        handleFindInformationRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_FIND_BY_TYPE_VALUE_REQUEST:
-        handleFindByTypeValueRequest(incomingPacket);
-        return;
+        handleFindByTypeValueRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_READ_BY_TYPE_REQUEST:
-        handleReadByTypeRequest(incomingPacket);
-        return;
+        handleReadByTypeRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_READ_REQUEST:
-        handleReadRequest(incomingPacket);
-        return;
+        handleReadRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_READ_BLOB_REQUEST:
-        handleReadBlobRequest(incomingPacket);
-        return;
+        handleReadBlobRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST:
-        handleReadMultipleRequest(incomingPacket);
-        return;
+        handleReadMultipleRequest(session, incomingPacket);
+        return true;
+    case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST:
+        handleReadMultipleVariableRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_READ_BY_GROUP_REQUEST:
-        handleReadByGroupTypeRequest(incomingPacket);
-        return;
+        handleReadByGroupTypeRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST:
     case QBluezConst::AttCommand::ATT_OP_WRITE_COMMAND:
     case QBluezConst::AttCommand::ATT_OP_SIGNED_WRITE_COMMAND:
-        handleWriteRequestOrCommand(incomingPacket);
-        return;
+        handleWriteRequestOrCommand(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_PREPARE_WRITE_REQUEST:
-        handlePrepareWriteRequest(incomingPacket);
-        return;
+        handlePrepareWriteRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_EXECUTE_WRITE_REQUEST:
-        handleExecuteWriteRequest(incomingPacket);
-        return;
+        handleExecuteWriteRequest(session, incomingPacket);
+        return true;
     case QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_CONFIRMATION:
-        if (indicationInFlight) {
-            indicationInFlight = false;
-            sendNextIndication();
+        if (session.indicationInFlight) {
+            session.indicationInFlight = false;
+            sendNextIndication(session);
         } else {
             qCWarning(QT_BT_BLUEZ) << "received unexpected handle value confirmation";
         }
-        return;
-    //--------------------------------------------------
+        return true;
     default:
-        //only solicited replies finish pending requests
-        requestPending = false;
-        break;
-    }
-
-    if (openRequests.isEmpty()) {
-        qCWarning(QT_BT_BLUEZ) << "Received unexpected packet from peer, disconnecting.";
-        disconnectFromDevice();
-        return;
+        return false;
     }
-
-    const Request request = openRequests.dequeue();
-    processReply(request, incomingPacket);
-
-    sendNextPendingRequest();
 }
 
 /*!
@@ -824,7 +958,7 @@ void QLowEnergyControllerPrivateBluez::encryptionChangedEvent(
     if (remoteDevice != address)
         return;
 
-    securityLevelValue = securityLevel();
+    securityLevelValue = securityLevel(l2cpSocket);
 
     // On success continue to process ATT command queue
     if (!wasSuccess) {
@@ -866,25 +1000,76 @@ void QLowEnergyControllerPrivateBluez::encryptionChangedEvent(
 
 void QLowEnergyControllerPrivateBluez::sendPacket(const QByteArray &packet)
 {
-    qint64 result = l2cpSocket->write(packet.constData(),
-                                      packet.size());
+    writePacket(l2cpSocket, packet);
+}
+
+void QLowEnergyControllerPrivateBluez::sendPacket(ClientSession &session, const QByteArray &packet)
+{
+    if (!session.socket)
+        return; // the client disconnected while its ATT handler ran, see closeCentral()
+    writePacket(session.socket, packet);
+}
+
+void QLowEnergyControllerPrivateBluez::writePacket(QBluetoothSocket *socket,
+                                                   const QByteArray &packet)
+{
+    qint64 result = socket->write(packet.constData(),
+                                  packet.size());
     // We ignore result == 0 which is likely to be caused by EAGAIN.
     // This packet is effectively discarded but the controller can still recover
 
     if (result == -1) {
         qCDebug(QT_BT_BLUEZ) << "Cannot write L2CP packet:" << Qt::hex
                              << packet.toHex()
-                             << l2cpSocket->errorString();
+                             << socket->errorString();
         setError(QLowEnergyController::NetworkError);
     } else if (result < packet.size()) {
         qCWarning(QT_BT_BLUEZ) << "L2CP write request incomplete:"
                                << result << "of" << packet.size();
     }
 
+    if (result > 0) {
+        ++pduStats.pdusSent;
+        pduStats.bytesSent += result;
+    }
+}
+
+static bool isAttCommandWithoutResponse(QBluezConst::AttCommand command)
+{
+    return command == QBluezConst::AttCommand::ATT_OP_WRITE_COMMAND
+            || command == QBluezConst::AttCommand::ATT_OP_SIGNED_WRITE_COMMAND;
 }
 
+/*!
+    \internal
+
+    Spins the openRequests queue.
+
+    ATT permits only one outstanding request per bearer (Spec v4.2, Vol 3, Part F, 3.3.2),
+    but commands do not expect a response and are not subject to this rule. Therefore
+    queued commands are sent right away, even if a request is still waiting for its
+    response. While requestPending is set the head of the queue is the request in flight.
+ */
 void QLowEnergyControllerPrivateBluez::sendNextPendingRequest()
 {
+    qsizetype i = requestPending ? 1 : 0;
+    while (i < openRequests.size()) {
+        if (!isAttCommandWithoutResponse(openRequests.at(i).command)) {
+            ++i;
+            continue;
+        }
+
+        const Request command = openRequests.takeAt(i);
+        ++pipelineStats.commandsSent;
+        if (requestPending) {
+            ++pipelineStats.pipelinedCommands;
+            ++commandsDuringPendingRequest;
+            pipelineStats.maxPipelinedCommands = (std::max)(pipelineStats.maxPipelinedCommands,
+                                                            commandsDuringPendingRequest);
+        }
+        sendPacket(command.payload);
+    }
+
     if (openRequests.isEmpty() || requestPending || encryptionChangePending)
         return;
 
@@ -893,6 +1078,25 @@ void QLowEnergyControllerPrivateBluez::sendNextPendingRequest()
 //             << request.payload.toHex();
 
     requestPending = true;
+    requestMtuSize = mtuSize;
+    commandsDuringPendingRequest = 0;
+    ++pipelineStats.requestsSent;
+    switch (request.command) {
+    case QBluezConst::AttCommand::ATT_OP_READ_REQUEST:
+        ++valueReadStats.readRequests;
+        break;
+    case QBluezConst::AttCommand::ATT_OP_READ_BLOB_REQUEST:
+        ++valueReadStats.readBlobRequests;
+        break;
+    case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST:
+        ++valueReadStats.readMultipleRequests;
+        break;
+    case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST:
+        ++valueReadStats.readMultipleVariableRequests;
+        break;
+    default:
+        break;
+    }
     restartRequestTimer();
     sendPacket(request.payload);
 }
@@ -950,17 +1154,17 @@ QLowEnergyHandle parseReadByTypeIncludeDiscovery(
 }
 
 void QLowEnergyControllerPrivateBluez::processReply(
-        const Request &request, const QByteArray &response)
+        const Request &request, const AttPduView &response)
 {
     Q_Q(QLowEnergyController);
 
-    QBluezConst::AttCommand command = static_cast<QBluezConst::AttCommand>(response.constData()[0]);
+    QBluezConst::AttCommand command = response.opcode();
 
     bool isErrorResponse = false;
     // if error occurred 2. byte is previous request type
     if (command == QBluezConst::AttCommand::ATT_OP_ERROR_RESPONSE) {
         dumpErrorInformation(response);
-        command = static_cast<QBluezConst::AttCommand>(response.constData()[1]);
+        command = response.errorRequestOpcode();
         isErrorResponse = true;
     }
 
@@ -968,20 +1172,15 @@ void QLowEnergyControllerPrivateBluez::processReply(
     case QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST: // in case of error
     case QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_RESPONSE: {
         Q_ASSERT(request.command == QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST);
-        quint16 oldMtuSize = mtuSize;
         if (isErrorResponse) {
-            mtuSize = ATT_DEFAULT_LE_MTU;
+            setMtuSize(ATT_DEFAULT_LE_MTU);
         } else {
-            const char *data = response.constData();
-            quint16 mtu = bt_get_le16(&data[1]);
-            mtuSize = mtu;
-            if (mtuSize < ATT_DEFAULT_LE_MTU)
-                mtuSize = ATT_DEFAULT_LE_MTU;
+            // Spec v4.2, Vol 3, Part F, 3.4.2: the smaller of both Rx MTUs applies
+            const quint16 mtu = response.mtu();
+            setMtuSize(std::clamp(mtu, ATT_DEFAULT_LE_MTU, preferredMtuSize));
 
             qCDebug(QT_BT_BLUEZ) << "Server MTU:" << mtu << "resulting mtu:" << mtuSize;
         }
-        if (oldMtuSize != mtuSize)
-            emit q->mtuChanged(mtuSize);
     } break;
     case QBluezConst::AttCommand::ATT_OP_READ_BY_GROUP_REQUEST: // in case of error
     case QBluezConst::AttCommand::ATT_OP_READ_BY_GROUP_RESPONSE: {
@@ -992,6 +1191,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
 
         if (isErrorResponse) {
             if (type == GATT_SECONDARY_SERVICE) {
+                storeServicesInGattCache();
                 setState(QLowEnergyController::DiscoveredState);
                 q->discoveryFinished();
             } else { // search for secondary services
@@ -1001,8 +1201,8 @@ void QLowEnergyControllerPrivateBluez::processReply(
         }
 
         QLowEnergyHandle start = 0, end = 0;
-        const quint16 elementLength = response.constData()[1];
-        const quint16 numElements = (response.size() - 2) / elementLength;
+        const quint16 elementLength = response.elementLength();
+        const quint16 numElements = response.elementCount(elementLength);
         quint16 offset = 2;
         const char *data = response.constData();
         for (int i = 0; i < numElements; i++) {
@@ -1040,6 +1240,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
             sendReadByGroupRequest(end+1, 0xFFFF, type);
         } else {
             if (type == GATT_SECONDARY_SERVICE) {
+                storeServicesInGattCache();
                 setState(QLowEnergyController::DiscoveredState);
                 emit q->discoveryFinished();
             } else { // search for secondary services
@@ -1052,9 +1253,21 @@ void QLowEnergyControllerPrivateBluez::processReply(
         // Discovering characteristics
         Q_ASSERT(request.command == QBluezConst::AttCommand::ATT_OP_READ_BY_TYPE_REQUEST);
 
+        const quint16 attributeType = request.reference2.toUInt();
+        if (attributeType == GATT_DATABASE_HASH) {
+            // <opcode><elementLength>[<handle><128 bit hash>]
+            QByteArray databaseHash;
+            if (!isErrorResponse && response.size() >= 2) {
+                const quint16 elementLength = response.elementLength();
+                if (elementLength == 2 + 16 && response.elementCount(elementLength) > 0)
+                    databaseHash = QByteArray(response.element(0, elementLength) + 2, 16);
+            }
+            processDatabaseHash(databaseHash);
+            break;
+        }
+
         QSharedPointer<QLowEnergyServicePrivate> p =
                 request.reference.value<QSharedPointer<QLowEnergyServicePrivate> >();
-        const quint16 attributeType = request.reference2.toUInt();
 
         if (isErrorResponse) {
             if (attributeType == GATT_CHARACTERISTIC) {
@@ -1066,6 +1279,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
                 } else {
                     // discovery finished since the service doesn't have any
                     // characteristics
+                    storeServiceDetailsInGattCache(p);
                     p->setState(QLowEnergyService::RemoteServiceDiscovered);
                 }
             } else if (attributeType == GATT_INCLUDED_SERVICE) {
@@ -1088,8 +1302,8 @@ void QLowEnergyControllerPrivateBluez::processReply(
          *  The uuid can be 16 or 128 bit.
          */
         QLowEnergyHandle lastHandle;
-        const quint16 elementLength = response.constData()[1];
-        const quint16 numElements = (response.size() - 2) / elementLength;
+        const quint16 elementLength = response.elementLength();
+        const quint16 numElements = response.elementCount(elementLength);
         quint16 offset = 2;
         const char *data = response.constData();
         for (int i = 0; i < numElements; i++) {
@@ -1136,7 +1350,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
 
         if (isErrorResponse) {
             Q_ASSERT(!encryptionChangePending);
-            QBluezConst::AttError err = static_cast<QBluezConst::AttError>(response.constData()[4]);
+            QBluezConst::AttError err = response.errorCode();
             encryptionChangePending = increaseEncryptLevelfRequired(err);
             if (encryptionChangePending) {
                 // Just requested a security level change.
@@ -1151,13 +1365,13 @@ void QLowEnergyControllerPrivateBluez::processReply(
                     service->setError(QLowEnergyService::DescriptorReadError);
             }
         } else {
+            const QByteArray value = response.responseValue().toByteArray();
             if (!descriptorHandle)
-                updateValueOfCharacteristic(charHandle, response.mid(1), NEW_VALUE);
+                updateValueOfCharacteristic(charHandle, value, NEW_VALUE);
             else
-                updateValueOfDescriptor(charHandle, descriptorHandle,
-                                        response.mid(1), NEW_VALUE);
+                updateValueOfDescriptor(charHandle, descriptorHandle, value, NEW_VALUE);
 
-            if (response.size() == mtuSize) {
+            if (isFullResponse(response)) {
                 qCDebug(QT_BT_BLUEZ) << "Switching to blob reads for"
                          << charHandle << descriptorHandle
                          << service->characteristicList[charHandle].uuid.toString();
@@ -1169,10 +1383,10 @@ void QLowEnergyControllerPrivateBluez::processReply(
                 // readCharacteristic() or readDescriptor() ongoing
                 if (!descriptorHandle) {
                     QLowEnergyCharacteristic ch(service, charHandle);
-                    emit service->characteristicRead(ch, response.mid(1));
+                    emit service->characteristicRead(ch, value);
                 } else {
                     QLowEnergyDescriptor descriptor(service, charHandle, descriptorHandle);
-                    emit service->descriptorRead(descriptor, response.mid(1));
+                    emit service->descriptorRead(descriptor, value);
                 }
                 break;
             }
@@ -1190,6 +1404,13 @@ void QLowEnergyControllerPrivateBluez::processReply(
                 service->setState(QLowEnergyService::RemoteServiceDiscovered);
         }
     } break;
+    case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST: // error case
+    case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_RESPONSE:
+    case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST: // error case
+    case QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_RESPONSE:
+        // Reading several values during service discovery
+        processReadMultipleReply(request, response, isErrorResponse);
+        break;
     case QBluezConst::AttCommand::ATT_OP_READ_BLOB_REQUEST: // error case
     case QBluezConst::AttCommand::ATT_OP_READ_BLOB_RESPONSE: {
         //Reading characteristic or descriptor with value longer value than MTU
@@ -1210,13 +1431,14 @@ void QLowEnergyControllerPrivateBluez::processReply(
          */
         if (!isErrorResponse) {
             quint16 length = 0;
+            const QByteArray value = response.responseValue().toByteArray();
             if (!descriptorHandle)
-                length = updateValueOfCharacteristic(charHandle, response.mid(1), APPEND_VALUE);
+                length = updateValueOfCharacteristic(charHandle, value, APPEND_VALUE);
             else
                 length = updateValueOfDescriptor(charHandle, descriptorHandle,
-                                        response.mid(1), APPEND_VALUE);
+                                        value, APPEND_VALUE);
 
-            if (response.size() == mtuSize) {
+            if (isFullResponse(response)) {
                 readServiceValuesByOffset(handleData, length,
                                           request.reference2.toBool());
                 break;
@@ -1283,7 +1505,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
             break;
         }
 
-        const quint8 format = response[1];
+        const quint8 format = response.u8(1);
         quint16 elementLength;
         switch (format) {
         case 0x01:
@@ -1297,7 +1519,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
             return;
         }
 
-        const quint16 numElements = (response.size() - 2) / elementLength;
+        const quint16 numElements = response.elementCount(elementLength);
 
         quint16 offset = 2;
         QLowEnergyHandle descriptorHandle {};
@@ -1379,7 +1601,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
 
         if (isErrorResponse) {
             Q_ASSERT(!encryptionChangePending);
-            QBluezConst::AttError err = static_cast<QBluezConst::AttError>(response.constData()[4]);
+            QBluezConst::AttError err = response.errorCode();
             encryptionChangePending = increaseEncryptLevelfRequired(err);
             if (encryptionChangePending) {
                 openRequests.prepend(request);
@@ -1417,7 +1639,7 @@ void QLowEnergyControllerPrivateBluez::processReply(
 
         if (isErrorResponse) {
             Q_ASSERT(!encryptionChangePending);
-            QBluezConst::AttError err = static_cast<QBluezConst::AttError>(response.constData()[4]);
+            QBluezConst::AttError err = response.errorCode();
             encryptionChangePending = increaseEncryptLevelfRequired(err);
             if (encryptionChangePending) {
                 openRequests.prepend(request);
@@ -1469,14 +1691,98 @@ void QLowEnergyControllerPrivateBluez::processReply(
         }
     } break;
     default:
-        qCDebug(QT_BT_BLUEZ) << "Unknown packet: " << response.toHex();
+        qCDebug(QT_BT_BLUEZ) << "Unknown packet: " << response.bytes().toByteArray().toHex();
         break;
     }
 }
 
 void QLowEnergyControllerPrivateBluez::discoverServices()
 {
-    sendReadByGroupRequest(0x0001, 0xFFFF, GATT_PRIMARY_SERVICE);
+    servicesFromGattCache.clear();
+    const QString cacheFilePath = gattCacheFilePath();
+    gattCache = GattCache::load(cacheFilePath);
+    gattCacheValid = false;
+
+    // Without a cache to validate and without means to create one, do not bother
+    // reading the Database Hash.
+    if (gattCache.isEmpty() && !QFileInfo(QFileInfo(cacheFilePath).absolutePath()).isWritable()) {
+        sendReadByGroupRequest(0x0001, 0xFFFF, GATT_PRIMARY_SERVICE);
+        return;
+    }
+    readDatabaseHash();
+}
+
+/*!
+    \internal
+
+    Reads the Database Hash characteristic of the remote device using a Read By Type
+    request over the whole handle range (Spec v5.1, Vol 3, Part G, 4.4.1 and 7.3).
+ */
+void QLowEnergyControllerPrivateBluez::readDatabaseHash()
+{
+    QByteArray data(READ_BY_TYPE_REQ_HEADER_SIZE, Qt::Uninitialized);
+    data[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_READ_BY_TYPE_REQUEST);
+    putBtData(QLowEnergyHandle(0x0001), data.data() + 1);
+    putBtData(QLowEnergyHandle(0xFFFF), data.data() + 3);
+    putBtData(GATT_DATABASE_HASH, data.data() + 5);
+    qCDebug(QT_BT_BLUEZ) << "Reading database hash";
+
+    Request request;
+    request.payload = data;
+    request.command = QBluezConst::AttCommand::ATT_OP_READ_BY_TYPE_REQUEST;
+    request.reference2 = GATT_DATABASE_HASH;
+    openRequests.enqueue(request);
+
+    sendNextPendingRequest();
+}
+
+/*!
+    \internal
+
+    Continues service discovery once the \a databaseHash of the remote device is known.
+    \a databaseHash is empty if the device does not expose the characteristic.
+
+    If the hash matches the one of the cached database, the services are taken from the
+    cache and no further requests are sent. Devices without a Database Hash must notify
+    bonded clients via Service Changed; therefore their cache is trusted only if the
+    device is bonded.
+ */
+void QLowEnergyControllerPrivateBluez::processDatabaseHash(const QByteArray &databaseHash)
+{
+    Q_Q(QLowEnergyController);
+
+    bool cacheMatches = false;
+    if (!gattCache.isEmpty()) {
+        if (!databaseHash.isEmpty())
+            cacheMatches = databaseHash == gattCache.databaseHash;
+        else
+            cacheMatches = gattCache.databaseHash.isEmpty() && isBonded(remoteDevice);
+    }
+    gattCacheValid = true;
+
+    if (!cacheMatches) {
+        qCDebug(QT_BT_BLUEZ) << "No valid GATT cache for" << remoteDevice;
+        gattCache = GattCache::Database();
+        gattCache.databaseHash = databaseHash;
+        sendReadByGroupRequest(0x0001, 0xFFFF, GATT_PRIMARY_SERVICE);
+        return;
+    }
+
+    qCDebug(QT_BT_BLUEZ) << "Using cached GATT database for" << remoteDevice;
+    for (const GattCache::Service &cached : std::as_const(gattCache.services)) {
+        QLowEnergyServicePrivate *priv = new QLowEnergyServicePrivate();
+        priv->uuid = cached.uuid;
+        priv->startHandle = cached.startHandle;
+        priv->endHandle = cached.endHandle;
+        priv->type = cached.type;
+        priv->includedServices = cached.includedServices;
+        priv->setController(this);
+
+        serviceList.insert(cached.uuid, QSharedPointer<QLowEnergyServicePrivate>(priv));
+        emit q->serviceDiscovered(cached.uuid);
+    }
+    setState(QLowEnergyController::DiscoveredState);
+    emit q->discoveryFinished();
 }
 
 void QLowEnergyControllerPrivateBluez::sendReadByGroupRequest(
@@ -1516,6 +1822,14 @@ void QLowEnergyControllerPrivateBluez::discoverServiceDetails(const QBluetoothUu
     QSharedPointer<QLowEnergyServicePrivate> serviceData = serviceList.value(service);
     serviceData->mode = mode;
     serviceData->characteristicList.clear();
+    if (restoreServiceDetailsFromGattCache(serviceData)) {
+        // Only the values remain to be read.
+        if (serviceData->characteristicList.isEmpty())
+            serviceData->setState(QLowEnergyService::RemoteServiceDiscovered);
+        else
+            readServiceValues(service, true);
+        return;
+    }
     sendReadByTypeRequest(serviceData, serviceData->startHandle, GATT_INCLUDED_SERVICE);
 }
 
@@ -1558,7 +1872,6 @@ void QLowEnergyControllerPrivateBluez::sendReadByTypeRequest(
 void QLowEnergyControllerPrivateBluez::readServiceValues(
         const QBluetoothUuid &serviceUuid, bool readCharacteristics)
 {
-    quint8 packet[READ_REQUEST_HEADER_SIZE];
     if (QT_BT_BLUEZ().isDebugEnabled()) {
         if (readCharacteristics)
             qCDebug(QT_BT_BLUEZ) << "Reading all characteristic values for"
@@ -1570,6 +1883,10 @@ void QLowEnergyControllerPrivateBluez::readServiceValues(
 
     QSharedPointer<QLowEnergyServicePrivate> service = serviceList.value(serviceUuid);
 
+    // All descriptors are known at this point.
+    if (!readCharacteristics)
+        storeServiceDetailsInGattCache(service);
+
     if (service->mode == QLowEnergyService::SkipValueDiscovery) {
         if (readCharacteristics) {
             // -> continue with descriptor discovery
@@ -1580,12 +1897,9 @@ void QLowEnergyControllerPrivateBluez::readServiceValues(
         return;
     }
 
-    // pair.first -> target attribute
-    // pair.second -> context information for read request
-    QPair<QLowEnergyHandle, quint32> pair;
-
-    // Create list of attribute handles which need to be read
-    QList<QPair<QLowEnergyHandle, quint32> > targetHandles;
+    // Create list of attributes which need to be read, in the format of Request::reference:
+    // characteristic handle in the lower and descriptor handle (if any) in the upper 16 bit
+    QList<uint> targetHandles;
 
     CharacteristicDataMap::const_iterator charIt = service->characteristicList.constBegin();
     for ( ; charIt != service->characteristicList.constEnd(); ++charIt) {
@@ -1599,19 +1913,14 @@ void QLowEnergyControllerPrivateBluez::readServiceValues(
             if (!(charDetails.properties & QLowEnergyCharacteristic::Read))
                 continue;
 
-            pair.first = charDetails.valueHandle;
-            pair.second  = charHandle;
-            targetHandles.append(pair);
+            targetHandles.append(charHandle);
 
         } else {
             // Collect handles of all descriptor attributes
             DescriptorDataMap::const_iterator descIt = charDetails.descriptorList.constBegin();
             for ( ; descIt != charDetails.descriptorList.constEnd(); ++descIt) {
                 const QLowEnergyHandle descriptorHandle = descIt.key();
-
-                pair.first = descriptorHandle;
-                pair.second = (charHandle | (descriptorHandle << 16));
-                targetHandles.append(pair);
+                targetHandles.append(charHandle | (descriptorHandle << 16));
             }
         }
     }
@@ -1629,22 +1938,9 @@ void QLowEnergyControllerPrivateBluez::readServiceValues(
         return;
     }
 
-    for (qsizetype i = 0; i < targetHandles.size(); i++) {
-        pair = targetHandles.at(i);
-        packet[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_READ_REQUEST);
-        putBtData(pair.first, &packet[1]);
-
-        QByteArray data(READ_REQUEST_HEADER_SIZE, Qt::Uninitialized);
-        memcpy(data.data(), packet,  READ_REQUEST_HEADER_SIZE);
-
-        Request request;
-        request.payload = data;
-        request.command = QBluezConst::AttCommand::ATT_OP_READ_REQUEST;
-        request.reference = pair.second;
-        // last entry?
-        request.reference2 = QVariant((bool)(i + 1 == targetHandles.size()));
+    const QList<Request> requests = valueReadRequests(service, targetHandles, true);
+    for (const Request &request : requests)
         openRequests.enqueue(request);
-    }
 
     sendNextPendingRequest();
 }
@@ -1661,6 +1957,12 @@ void QLowEnergyControllerPrivateBluez::readServiceValues(
  */
 void QLowEnergyControllerPrivateBluez::readServiceValuesByOffset(
         uint handleData, quint16 offset, bool isLastValue)
+{
+    openRequests.prepend(readBlobRequest(handleData, offset, isLastValue));
+}
+
+QLowEnergyControllerPrivateBluez::Request QLowEnergyControllerPrivateBluez::readBlobRequest(
+        uint handleData, quint16 offset, bool isLastValue)
 {
     const QLowEnergyHandle charHandle = (handleData & 0xffff);
     const QLowEnergyHandle descriptorHandle = ((handleData >> 16) & 0xffff);
@@ -1695,77 +1997,505 @@ void QLowEnergyControllerPrivateBluez::readServiceValuesByOffset(
     request.command = QBluezConst::AttCommand::ATT_OP_READ_BLOB_REQUEST;
     request.reference = handleData;
     request.reference2 = isLastValue;
-    openRequests.prepend(request);
+    return request;
 }
 
-void QLowEnergyControllerPrivateBluez::discoverServiceDescriptors(
-        const QBluetoothUuid &serviceUuid)
+QLowEnergyControllerPrivateBluez::Request QLowEnergyControllerPrivateBluez::readRequest(
+        QLowEnergyHandle attributeHandle, uint handleData)
 {
-    qCDebug(QT_BT_BLUEZ) << "Discovering descriptor values for"
-                         << serviceUuid.toString();
-    QSharedPointer<QLowEnergyServicePrivate> service = serviceList.value(serviceUuid);
-
-    if (service->characteristicList.isEmpty()) { // service has no characteristics
-        // implies that characteristic & descriptor discovery can be skipped
-        service->setState(QLowEnergyService::RemoteServiceDiscovered);
-        return;
-    }
+    QByteArray data(READ_REQUEST_HEADER_SIZE, Qt::Uninitialized);
+    data[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_READ_REQUEST);
+    putBtData(attributeHandle, data.data() + 1);
 
-    // start handle of all known characteristics
-    QList<QLowEnergyHandle> keys = service->characteristicList.keys();
-    std::sort(keys.begin(), keys.end());
+    Request request;
+    request.payload = data;
+    request.command = QBluezConst::AttCommand::ATT_OP_READ_REQUEST;
+    request.reference = handleData;
+    request.reference2 = false;
+    return request;
+}
 
-    discoverNextDescriptor(service, keys, keys[0]);
+namespace {
+// outcome of the Read Multiple Variable probe per peer, shared by all controllers
+struct ReadMultipleVariableProbes
+{
+    QMutex mutex;
+    QHash<QBluetoothAddress, bool> supported;
+};
 }
+Q_GLOBAL_STATIC(ReadMultipleVariableProbes, readMultipleVariableProbes)
+
+/*!
+    \internal
 
-void QLowEnergyControllerPrivateBluez::processUnsolicitedReply(const QByteArray &payload)
+    Returns whether \a peer answered a Read Multiple Variable request before, nothing if
+    it was not probed yet. The result is kept for later connections to the same peer.
+ */
+std::optional<bool> QLowEnergyControllerPrivateBluez::knownReadMultipleVariableSupport(
+        const QBluetoothAddress &peer)
 {
-    const char *data = payload.constData();
-    bool isNotification = (static_cast<QBluezConst::AttCommand>(data[0])
-                           == QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION);
-    const QLowEnergyHandle changedHandle = bt_get_le16(&data[1]);
+    ReadMultipleVariableProbes *probes = readMultipleVariableProbes();
+    QMutexLocker locker(&probes->mutex);
+    const auto it = probes->supported.constFind(peer);
+    if (it == probes->supported.cend())
+        return std::nullopt;
+    return *it;
+}
 
-    if (QT_BT_BLUEZ().isDebugEnabled()) {
-        if (isNotification)
-            qCDebug(QT_BT_BLUEZ) << "Change notification for handle" << Qt::hex << changedHandle;
-        else
-            qCDebug(QT_BT_BLUEZ) << "Change indication for handle" << Qt::hex << changedHandle;
-    }
+void QLowEnergyControllerPrivateBluez::storeReadMultipleVariableSupport(
+        const QBluetoothAddress &peer, bool supported)
+{
+    if (peer.isNull())
+        return;
+    ReadMultipleVariableProbes *probes = readMultipleVariableProbes();
+    QMutexLocker locker(&probes->mutex);
+    probes->supported.insert(peer, supported);
+}
 
-    const QLowEnergyCharacteristic ch = characteristicForHandle(changedHandle);
-    if (ch.isValid() && ch.handle() == changedHandle) {
-        if (ch.properties() & QLowEnergyCharacteristic::Read)
-            updateValueOfCharacteristic(ch.attributeHandle(), payload.mid(3), NEW_VALUE);
-        emit ch.d_ptr->characteristicChanged(ch, payload.mid(3));
-    } else {
-        qCWarning(QT_BT_BLUEZ) << "Cannot find matching characteristic for "
-                                  "notification/indication";
+// Size of descriptor values defined by the spec, 0 if the size is not fixed
+static qsizetype fixedValueSize(const QBluetoothUuid &descriptorType)
+{
+    using DescriptorType = QBluetoothUuid::DescriptorType;
+    if (descriptorType == DescriptorType::CharacteristicExtendedProperties
+            || descriptorType == DescriptorType::ClientCharacteristicConfiguration
+            || descriptorType == DescriptorType::ServerCharacteristicConfiguration) {
+        return 2;
     }
+    if (descriptorType == DescriptorType::CharacteristicPresentationFormat)
+        return 7;
+    return 0;
 }
 
-void QLowEnergyControllerPrivateBluez::exchangeMTU()
+static QLowEnergyHandle attributeHandle(const QLowEnergyServicePrivate &service, uint handleData)
 {
-    qCDebug(QT_BT_BLUEZ) << "Exchanging MTU";
+    const QLowEnergyHandle descriptorHandle = ((handleData >> 16) & 0xffff);
+    if (descriptorHandle)
+        return descriptorHandle;
+    const auto charIt = service.characteristicList.constFind(handleData & 0xffff);
+    Q_ASSERT(charIt != service.characteristicList.constEnd());
+    return charIt->valueHandle;
+}
 
-    quint8 packet[MTU_EXCHANGE_HEADER_SIZE];
-    packet[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST);
-    putBtData(ATT_MAX_LE_MTU, &packet[1]);
+static qsizetype fixedValueSize(const QLowEnergyServicePrivate &service, uint handleData)
+{
+    const QLowEnergyHandle descriptorHandle = ((handleData >> 16) & 0xffff);
+    if (!descriptorHandle)
+        return 0; // characteristic values may have any size
+    const auto charIt = service.characteristicList.constFind(handleData & 0xffff);
+    if (charIt == service.characteristicList.constEnd())
+        return 0;
+    return fixedValueSize(charIt->descriptorList.value(descriptorHandle).uuid);
+}
 
-    QByteArray data(MTU_EXCHANGE_HEADER_SIZE, Qt::Uninitialized);
-    memcpy(data.data(), packet, MTU_EXCHANGE_HEADER_SIZE);
+/*!
+    \internal
 
-    Request request;
-    request.payload = data;
-    request.command = QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST;
-    openRequests.enqueue(request);
+    Returns the requests for reading the values in \a handleData during service discovery.
 
-    sendNextPendingRequest();
-}
+    If the peer supports Read Multiple Variable Length (Spec v5.2, Vol 3, Part F, 3.4.4.11),
+    as many handles as fit are read with a single request. Otherwise descriptors of fixed
+    size are batched into Read Multiple requests, as their values can be told apart in
+    the response. All other values are read one by one.
 
-int QLowEnergyControllerPrivateBluez::securityLevel() const
+    \a isLastValue is set on the last request, see readServiceValues().
+ */
+QList<QLowEnergyControllerPrivateBluez::Request>
+QLowEnergyControllerPrivateBluez::valueReadRequests(
+        const QSharedPointer<QLowEnergyServicePrivate> &service,
+        const QList<uint> &handleData, bool isLastValue) const
 {
-    int socket = l2cpSocket->socketDescriptor();
-    if (socket < 0) {
+    QList<Request> requests;
+    const auto addReadMultipleRequest = [&](QBluezConst::AttCommand command,
+                                            const QList<uint> &batch) {
+        QByteArray data(1 + batch.size() * sizeof(QLowEnergyHandle), Qt::Uninitialized);
+        data[0] = static_cast<quint8>(command);
+        for (qsizetype i = 0; i < batch.size(); ++i) {
+            putBtData(attributeHandle(*service, batch.at(i)),
+                      data.data() + 1 + i * sizeof(QLowEnergyHandle));
+        }
+        Request request;
+        request.payload = data;
+        request.command = command;
+        request.reference = QVariant::fromValue(batch);
+        request.reference2 = false;
+        requests.append(request);
+    };
+    const auto addReadRequest = [&](uint handle) {
+        requests.append(readRequest(attributeHandle(*service, handle), handle));
+    };
+
+    // the request itself limits the number of handles, the response may hold fewer values
+    const qsizetype maxHandles = (mtuSize - 1) / qsizetype(sizeof(QLowEnergyHandle));
+    if (readMultipleVariableSupported && handleData.size() > 1) {
+        for (qsizetype i = 0; i < handleData.size(); i += maxHandles) {
+            const QList<uint> batch = handleData.mid(i, maxHandles);
+            if (batch.size() == 1) {
+                addReadRequest(batch.first());
+            } else {
+                addReadMultipleRequest(
+                        QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST, batch);
+            }
+        }
+    } else {
+        QList<uint> batch;
+        qsizetype batchValueSize = 0;
+        const auto flushBatch = [&]() {
+            if (batch.size() == 1)
+                addReadRequest(batch.first());
+            else if (batch.size() > 1)
+                addReadMultipleRequest(QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST,
+                                       batch);
+            batch.clear();
+            batchValueSize = 0;
+        };
+        for (const uint handle : handleData) {
+            const qsizetype valueSize = readMultipleSupported
+                    ? fixedValueSize(*service, handle) : 0;
+            if (!valueSize) {
+                addReadRequest(handle);
+                continue;
+            }
+            // all values have to fit into a single response
+            if (batch.size() == maxHandles || batchValueSize + valueSize > mtuSize - 1)
+                flushBatch();
+            batch.append(handle);
+            batchValueSize += valueSize;
+        }
+        flushBatch();
+    }
+
+    if (!requests.isEmpty())
+        requests.last().reference2 = isLastValue;
+    return requests;
+}
+
+/*!
+    \internal
+
+    Processes the response to a request created by valueReadRequests().
+
+    Any error repeats the batch with single reads, as the error response names only
+    the first failing attribute. Values which did not fit into a Read Multiple Variable
+    response are read by further requests.
+ */
+void QLowEnergyControllerPrivateBluez::processReadMultipleReply(
+        const Request &request, const AttPduView &response, bool isErrorResponse)
+{
+    const QList<uint> handleData = request.reference.value<QList<uint>>();
+    const bool isLastValue = request.reference2.toBool();
+    const bool isVariable = request.command
+            == QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST;
+    Q_ASSERT(isVariable
+             || request.command == QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST);
+    Q_ASSERT(!handleData.isEmpty());
+
+    QSharedPointer<QLowEnergyServicePrivate> service =
+            serviceForHandle(handleData.first() & 0xffff);
+    Q_ASSERT(!service.isNull());
+
+    // requests to be sent before any other queued request, in sending order
+    QList<Request> followUps;
+    const auto readOneByOne = [&]() {
+        ++valueReadStats.fallbacks;
+        for (const uint handle : handleData)
+            followUps.append(readRequest(attributeHandle(*service, handle), handle));
+    };
+    const auto updateValue = [this](uint handle, const QByteArray &value) {
+        const QLowEnergyHandle charHandle = (handle & 0xffff);
+        const QLowEnergyHandle descriptorHandle = ((handle >> 16) & 0xffff);
+        if (!descriptorHandle)
+            updateValueOfCharacteristic(charHandle, value, NEW_VALUE);
+        else
+            updateValueOfDescriptor(charHandle, descriptorHandle, value, NEW_VALUE);
+        ++valueReadStats.batchedValues;
+    };
+
+    if (isErrorResponse) {
+        Q_ASSERT(!encryptionChangePending);
+        const QBluezConst::AttError err = response.errorCode();
+        encryptionChangePending = increaseEncryptLevelfRequired(err);
+        if (encryptionChangePending) {
+            // Retry the same command again once the change has happened
+            openRequests.prepend(request);
+            return;
+        }
+
+        if (err == QBluezConst::AttError::ATT_ERROR_REQUEST_NOT_SUPPORTED
+                || err == QBluezConst::AttError::ATT_ERROR_REQUEST_STALLED) {
+            qCDebug(QT_BT_BLUEZ) << "Peer does not support" << request.command;
+            if (isVariable) {
+                readMultipleVariableSupported = false;
+                storeReadMultipleVariableSupport(remoteDevice, false);
+            } else {
+                readMultipleSupported = false;
+            }
+        }
+        if (isVariable && !readMultipleVariableSupported) {
+            ++valueReadStats.fallbacks;
+            followUps = valueReadRequests(service, handleData, false);
+        } else {
+            readOneByOne();
+        }
+    } else if (isVariable) {
+        storeReadMultipleVariableSupport(remoteDevice, true);
+        // <opcode>[<value length><value>]+, cut off after mtuSize bytes
+        const QByteArrayView values = response.responseValue();
+        qsizetype offset = 0;
+        qsizetype i = 0;
+        for ( ; i < handleData.size() && offset + 2 <= values.size(); ++i) {
+            const quint16 length = bt_get_le16(values.data() + offset);
+            offset += 2;
+            const qsizetype available = (std::min)(qsizetype(length), values.size() - offset);
+            updateValue(handleData.at(i), values.sliced(offset, available).toByteArray());
+            offset += available;
+            if (available < length) // the remainder is read like an overlong single value
+                followUps.append(readBlobRequest(handleData.at(i), available, false));
+        }
+        if (i == 0)
+            readOneByOne();
+        else if (i < handleData.size())
+            followUps += valueReadRequests(service, handleData.sliced(i), false);
+    } else {
+        // <opcode>[<value>]+ without any separation, hence only values of known size
+        const QByteArrayView values = response.responseValue();
+        qsizetype expectedSize = 0;
+        for (const uint handle : handleData)
+            expectedSize += fixedValueSize(*service, handle);
+        if (values.size() != expectedSize) {
+            qCDebug(QT_BT_BLUEZ) << "Unexpected size of read multiple response" << values.size()
+                                 << "expected:" << expectedSize;
+            readOneByOne();
+        } else {
+            qsizetype offset = 0;
+            for (const uint handle : handleData) {
+                const qsizetype size = fixedValueSize(*service, handle);
+                updateValue(handle, values.sliced(offset, size).toByteArray());
+                offset += size;
+            }
+        }
+    }
+
+    if (!followUps.isEmpty()) {
+        followUps.last().reference2 = isLastValue;
+        for (auto it = followUps.crbegin(); it != followUps.crend(); ++it)
+            openRequests.prepend(*it);
+        return;
+    }
+
+    if (isLastValue) {
+        //last characteristic -> progress to descriptor discovery
+        //last descriptor -> service discovery is done
+        if (!((handleData.first() >> 16) & 0xffff))
+            discoverServiceDescriptors(service->uuid);
+        else
+            service->setState(QLowEnergyService::RemoteServiceDiscovered);
+    }
+}
+
+void QLowEnergyControllerPrivateBluez::discoverServiceDescriptors(
+        const QBluetoothUuid &serviceUuid)
+{
+    qCDebug(QT_BT_BLUEZ) << "Discovering descriptor values for"
+                         << serviceUuid.toString();
+    QSharedPointer<QLowEnergyServicePrivate> service = serviceList.value(serviceUuid);
+
+    if (servicesFromGattCache.contains(serviceUuid)) {
+        // descriptors are known already
+        readServiceValues(serviceUuid, false);
+        return;
+    }
+
+    if (service->characteristicList.isEmpty()) { // service has no characteristics
+        storeServiceDetailsInGattCache(service);
+        // implies that characteristic & descriptor discovery can be skipped
+        service->setState(QLowEnergyService::RemoteServiceDiscovered);
+        return;
+    }
+
+    // start handle of all known characteristics
+    QList<QLowEnergyHandle> keys = service->characteristicList.keys();
+    std::sort(keys.begin(), keys.end());
+
+    discoverNextDescriptor(service, keys, keys[0]);
+}
+
+void QLowEnergyControllerPrivateBluez::processUnsolicitedReply(const AttPduView &payload)
+{
+    if (payload.size() < 3) {
+        qCWarning(QT_BT_BLUEZ) << "Received notification/indication of invalid size"
+                               << payload.size();
+        return;
+    }
+    bool isNotification = (payload.opcode()
+                           == QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION);
+    const QLowEnergyHandle changedHandle = payload.attributeHandle();
+
+    if (QT_BT_BLUEZ().isDebugEnabled()) {
+        if (isNotification)
+            qCDebug(QT_BT_BLUEZ) << "Change notification for handle" << Qt::hex << changedHandle;
+        else
+            qCDebug(QT_BT_BLUEZ) << "Change indication for handle" << Qt::hex << changedHandle;
+    }
+
+    const QLowEnergyCharacteristic ch = characteristicForHandle(changedHandle);
+    if (ch.isValid() && ch.handle() == changedHandle) {
+        if (ch.uuid() == QBluetoothUuid::CharacteristicType::ServiceChanged)
+            invalidateGattCache();
+        const QByteArray value = payload.handleValue().toByteArray();
+        if (ch.properties() & QLowEnergyCharacteristic::Read)
+            updateValueOfCharacteristic(ch.attributeHandle(), value, NEW_VALUE);
+        emit ch.d_ptr->characteristicChanged(ch, value);
+    } else {
+        qCWarning(QT_BT_BLUEZ) << "Cannot find matching characteristic for "
+                                  "notification/indication";
+    }
+}
+
+void QLowEnergyControllerPrivateBluez::exchangeMTU()
+{
+    qCDebug(QT_BT_BLUEZ) << "Exchanging MTU";
+
+    quint8 packet[MTU_EXCHANGE_HEADER_SIZE];
+    packet[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST);
+    putBtData(preferredMtuSize, &packet[1]);
+
+    QByteArray data(MTU_EXCHANGE_HEADER_SIZE, Qt::Uninitialized);
+    memcpy(data.data(), packet, MTU_EXCHANGE_HEADER_SIZE);
+
+    Request request;
+    request.payload = data;
+    request.command = QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST;
+    openRequests.enqueue(request);
+
+    sendNextPendingRequest();
+}
+
+void QLowEnergyControllerPrivateBluez::setPreferredMtu(int mtu)
+{
+    preferredMtuSize = quint16(std::clamp(mtu, int(ATT_DEFAULT_LE_MTU), int(ATT_MAX_LE_MTU)));
+}
+
+/*!
+    \internal
+
+    Applies the ATT MTU negotiated by the MTU exchange. Queued requests are
+    adjusted to the new MTU before mtuChanged() is emitted.
+ */
+void QLowEnergyControllerPrivateBluez::setMtuSize(quint16 newMtuSize)
+{
+    Q_Q(QLowEnergyController);
+
+    if (mtuSize == newMtuSize)
+        return;
+
+    mtuSize = newMtuSize;
+    // the MTU of the link applies to the requests of the remote device as well
+    if (peerSession)
+        peerSession->mtuSize = mtuSize;
+    replanQueuedRequests();
+    emit q->mtuChanged(mtuSize);
+}
+
+/*!
+    \internal
+
+    Rebuilds the queued requests which were sized for the previous mtuSize, so that
+    each PDU carries as much as the new MTU permits. The request in flight is not touched.
+
+    A long write whose first Prepare Write request is still queued becomes a single
+    Write request if the value fits now, otherwise the next part of the value is
+    enlarged. Consecutive Read Multiple requests of a service are batched anew.
+    Blob reads need no change, the server fills their responses up to the MTU.
+ */
+void QLowEnergyControllerPrivateBluez::replanQueuedRequests()
+{
+    const auto isReadMultiple = [](const Request &request) {
+        return request.command == QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST
+                || request.command
+                        == QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST;
+    };
+
+    qsizetype i = requestPending ? 1 : 0;
+    while (i < openRequests.size()) {
+        const Request &request = openRequests.at(i);
+        if (request.command == QBluezConst::AttCommand::ATT_OP_PREPARE_WRITE_REQUEST) {
+            const QLowEnergyHandle handle = (request.reference.toUInt() & 0xffff);
+            const QByteArray newValue = request.reference2.toByteArray();
+            const quint16 offset = bt_get_le16(request.payload.constData() + 3);
+
+            Request replanned;
+            if (offset == 0 && newValue.size() <= mtuSize - WRITE_REQUEST_HEADER_SIZE) {
+                // nothing has been prepared on the server yet
+                const QLowEnergyDescriptor descriptor = descriptorForHandle(handle);
+                if (descriptor.isValid()) {
+                    replanned = writeRequest(handle,
+                                             (descriptor.characteristicHandle() | (handle << 16)),
+                                             newValue);
+                } else {
+                    replanned = writeRequest(characteristicForHandle(handle).handle(), handle,
+                                             newValue);
+                }
+            } else {
+                replanned = prepareWriteRequest(handle, newValue, offset);
+            }
+
+            if (!replanned.payload.isEmpty() && replanned.payload != request.payload) {
+                openRequests[i] = replanned;
+                ++pduStats.replannedRequests;
+            }
+            ++i;
+        } else if (isReadMultiple(request)) {
+            // collect the batches of a single readServiceValues() run
+            const QSharedPointer<QLowEnergyServicePrivate> service =
+                    serviceForHandle(request.reference.value<QList<uint>>().first() & 0xffff);
+            QList<uint> handleData;
+            bool isLastValue = false;
+            qsizetype end = i;
+            while (end < openRequests.size() && !isLastValue
+                   && isReadMultiple(openRequests.at(end))) {
+                const QList<uint> batch = openRequests.at(end).reference.value<QList<uint>>();
+                if (serviceForHandle(batch.first() & 0xffff) != service)
+                    break;
+                handleData += batch;
+                isLastValue = openRequests.at(end).reference2.toBool();
+                ++end;
+            }
+
+            const QList<Request> replanned = service.isNull()
+                    ? QList<Request>() : valueReadRequests(service, handleData, isLastValue);
+            if (!replanned.isEmpty() && replanned.size() < end - i) {
+                pduStats.replannedRequests += end - i;
+                openRequests.remove(i, end - i);
+                for (qsizetype j = 0; j < replanned.size(); ++j)
+                    openRequests.insert(i + j, replanned.at(j));
+                i += replanned.size();
+            } else {
+                i = end;
+            }
+        } else {
+            ++i;
+        }
+    }
+}
+
+/*!
+    \internal
+
+    Returns \c true if \a response to the pending read request is as large as the
+    ATT MTU permits, i.e. the value may continue beyond it. An MTU exchange in the
+    meantime means that the server may have applied either MTU.
+ */
+bool QLowEnergyControllerPrivateBluez::isFullResponse(const AttPduView &response) const
+{
+    return response.size() == mtuSize || response.size() == requestMtuSize;
+}
+
+int QLowEnergyControllerPrivateBluez::securityLevel(const QBluetoothSocket *socket)
+{
+    if (!socket)
+        return -1;
+    const int descriptor = socket->socketDescriptor();
+    if (descriptor < 0) {
         qCWarning(QT_BT_BLUEZ) << "Invalid l2cp socket, aborting getting of sec level";
         return -1;
     }
@@ -1774,7 +2504,7 @@ int QLowEnergyControllerPrivateBluez::securityLevel() const
     socklen_t length = sizeof(secData);
     memset(&secData, 0, length);
 
-    if (getsockopt(socket, SOL_BLUETOOTH, BT_SECURITY, &secData, &length) == 0) {
+    if (getsockopt(descriptor, SOL_BLUETOOTH, BT_SECURITY, &secData, &length) == 0) {
         qCDebug(QT_BT_BLUEZ) << "Current l2cp sec level:" << secData.level;
         return secData.level;
     }
@@ -1785,7 +2515,7 @@ int QLowEnergyControllerPrivateBluez::securityLevel() const
     // cater for older kernels
     int optval;
     length = sizeof(optval);
-    if (getsockopt(socket, SOL_L2CAP, L2CAP_LM, &optval, &length) == 0) {
+    if (getsockopt(descriptor, SOL_L2CAP, L2CAP_LM, &optval, &length) == 0) {
         int level = BT_SECURITY_SDP;
         if (optval & L2CAP_LM_AUTH)
             level = BT_SECURITY_LOW;
@@ -1888,6 +2618,22 @@ void QLowEnergyControllerPrivateBluez::discoverNextDescriptor(
 void QLowEnergyControllerPrivateBluez::sendNextPrepareWriteRequest(
         const QLowEnergyHandle handle, const QByteArray &newValue,
         quint16 offset)
+{
+    const Request request = prepareWriteRequest(handle, newValue, offset);
+    if (request.payload.isEmpty())
+        return;
+    openRequests.enqueue(request);
+}
+
+/*!
+    \internal
+
+    Returns the Prepare Write request for the part of \a newValue starting at \a offset.
+    The part fills the PDU as far as the current mtuSize permits. An invalid
+    \a handle yields a request without payload.
+ */
+QLowEnergyControllerPrivateBluez::Request QLowEnergyControllerPrivateBluez::prepareWriteRequest(
+        QLowEnergyHandle handle, const QByteArray &newValue, quint16 offset)
 {
     // is it a descriptor or characteristic?
     QLowEnergyHandle targetHandle = 0;
@@ -1900,7 +2646,7 @@ void QLowEnergyControllerPrivateBluez::sendNextPrepareWriteRequest(
     if (!targetHandle) {
         qCWarning(QT_BT_BLUEZ) << "sendNextPrepareWriteRequest cancelled due to invalid handle"
                                << handle;
-        return;
+        return Request();
     }
 
     quint8 packet[PREPARE_WRITE_HEADER_SIZE];
@@ -1929,7 +2675,30 @@ void QLowEnergyControllerPrivateBluez::sendNextPrepareWriteRequest(
     request.command = QBluezConst::AttCommand::ATT_OP_PREPARE_WRITE_REQUEST;
     request.reference = (handle | ((offset + requiredPayload) << 16));
     request.reference2 = newValue;
-    openRequests.enqueue(request);
+    return request;
+}
+
+/*!
+    \internal
+
+    Returns the Write request of \a newValue to \a attributeHandle. \a handleData
+    identifies the characteristic and descriptor for processReply().
+ */
+QLowEnergyControllerPrivateBluez::Request QLowEnergyControllerPrivateBluez::writeRequest(
+        QLowEnergyHandle attributeHandle, uint handleData, const QByteArray &newValue)
+{
+    const qsizetype size = WRITE_REQUEST_HEADER_SIZE + newValue.size();
+    QByteArray data(size, Qt::Uninitialized);
+    data[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST);
+    putBtData(attributeHandle, data.data() + 1);
+    memcpy(&(data.data()[WRITE_REQUEST_HEADER_SIZE]), newValue.constData(), newValue.size());
+
+    Request request;
+    request.payload = data;
+    request.command = QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST;
+    request.reference = handleData;
+    request.reference2 = newValue;
+    return request;
 }
 
 /*!
@@ -2117,92 +2886,124 @@ bool QLowEnergyControllerPrivateBluez::increaseEncryptLevelfRequired(
 
 void QLowEnergyControllerPrivateBluez::handleAdvertisingError()
 {
+    if (state == QLowEnergyController::ConnectedState) {
+        // advertising for further centrals, the connected ones are not affected
+        qCWarning(QT_BT_BLUEZ) << "cannot advertise for further centrals";
+        return;
+    }
     qCWarning(QT_BT_BLUEZ) << "received advertising error";
     setError(QLowEnergyController::AdvertisingError);
     setState(QLowEnergyController::UnconnectedState);
 }
 
-bool QLowEnergyControllerPrivateBluez::checkPacketSize(const QByteArray &packet, int minSize,
-                                                  int maxSize)
+bool QLowEnergyControllerPrivateBluez::checkPacketSize(ClientSession &session,
+                                                       const AttPduView &packet, int minSize,
+                                                       int maxSize)
 {
     if (maxSize == -1)
         maxSize = minSize;
     if (Q_LIKELY(packet.size() >= minSize && packet.size() <= maxSize))
         return true;
-    qCWarning(QT_BT_BLUEZ) << "client request of type" << packet.at(0)
+    qCWarning(QT_BT_BLUEZ) << "client request of type" << packet.opcode()
                            << "has unexpected packet size" << packet.size();
-    sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), 0,
+    sendErrorResponse(session, packet.opcode(), 0,
                       QBluezConst::AttError::ATT_ERROR_INVALID_PDU);
     return false;
 }
 
-bool QLowEnergyControllerPrivateBluez::checkHandle(const QByteArray &packet, QLowEnergyHandle handle)
+bool QLowEnergyControllerPrivateBluez::checkHandle(ClientSession &session, const AttPduView &packet,
+                                                   QLowEnergyHandle handle)
 {
     if (handle != 0 && handle <= lastLocalHandle)
         return true;
-    sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+    sendErrorResponse(session, packet.opcode(), handle,
                       QBluezConst::AttError::ATT_ERROR_INVALID_HANDLE);
     return false;
 }
 
-bool QLowEnergyControllerPrivateBluez::checkHandlePair(QBluezConst::AttCommand request,
+bool QLowEnergyControllerPrivateBluez::checkHandlePair(ClientSession &session,
+                                                       QBluezConst::AttCommand request,
                                                        QLowEnergyHandle startingHandle,
                                                        QLowEnergyHandle endingHandle)
 {
     if (startingHandle == 0 || startingHandle > endingHandle) {
         qCDebug(QT_BT_BLUEZ) << "handle range invalid";
-        sendErrorResponse(request, startingHandle, QBluezConst::AttError::ATT_ERROR_INVALID_HANDLE);
+        sendErrorResponse(session, request, startingHandle,
+                          QBluezConst::AttError::ATT_ERROR_INVALID_HANDLE);
         return false;
     }
     return true;
 }
 
-void QLowEnergyControllerPrivateBluez::handleExchangeMtuRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleExchangeMtuRequest(ClientSession &session,
+                                                                const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.2
 
-    if (!checkPacketSize(packet, 3))
+    if (!checkPacketSize(session, packet, 3))
         return;
-    if (receivedMtuExchangeRequest) { // Client must only send this once per connection.
+    if (session.receivedMtuExchangeRequest) { // Client must only send this once per connection.
         qCDebug(QT_BT_BLUEZ) << "Client sent extraneous MTU exchange packet";
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), 0,
+        sendErrorResponse(session, packet.opcode(), 0,
                           QBluezConst::AttError::ATT_ERROR_REQUEST_NOT_SUPPORTED);
         return;
     }
-    receivedMtuExchangeRequest = true;
+    session.receivedMtuExchangeRequest = true;
 
     // Send reply.
     QByteArray reply(MTU_EXCHANGE_HEADER_SIZE, Qt::Uninitialized);
     reply[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_RESPONSE);
-    putBtData(ATT_MAX_LE_MTU, reply.data() + 1);
-    sendPacket(reply);
+    putBtData(preferredMtuSize, reply.data() + 1);
+    sendPacket(session, reply);
 
     // Apply requested MTU.
-    const quint16 clientRxMtu = bt_get_le16(packet.constData() + 1);
-    mtuSize = std::clamp(clientRxMtu, ATT_DEFAULT_LE_MTU, ATT_MAX_LE_MTU);
+    const quint16 clientRxMtu = packet.mtu();
+    const quint16 newMtuSize = std::clamp(clientRxMtu, ATT_DEFAULT_LE_MTU, preferredMtuSize);
+    if (role == QLowEnergyController::CentralRole) {
+        // the MTU of the link, it applies to the requests of the local client as well
+        setMtuSize(newMtuSize);
+    } else if (session.mtuSize != newMtuSize) {
+        session.mtuSize = newMtuSize;
+        if (isPrimarySession(session)) {
+            Q_Q(QLowEnergyController);
+            emit q->mtuChanged(newMtuSize);
+        }
+    }
     qCDebug(QT_BT_BLUEZ) << "MTU request from client:" << clientRxMtu
-                         << "effective client RX MTU:" << mtuSize;
-    qCDebug(QT_BT_BLUEZ) << "Sending server RX MTU" << ATT_MAX_LE_MTU;
+                         << "effective client RX MTU:" << session.mtuSize;
+    qCDebug(QT_BT_BLUEZ) << "Sending server RX MTU" << preferredMtuSize;
 }
 
-void QLowEnergyControllerPrivateBluez::handleFindInformationRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleFindInformationRequest(ClientSession &session,
+                                                                    const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.3.1-2
 
-    if (!checkPacketSize(packet, 5))
+    if (!checkPacketSize(session, packet, 5))
         return;
-    const QLowEnergyHandle startingHandle = bt_get_le16(packet.constData() + 1);
-    const QLowEnergyHandle endingHandle = bt_get_le16(packet.constData() + 3);
+    const QLowEnergyHandle startingHandle = packet.startingHandle();
+    const QLowEnergyHandle endingHandle = packet.endingHandle();
     qCDebug(QT_BT_BLUEZ) << "client sends find information request; start:" << startingHandle
                          << "end:" << endingHandle;
-    if (!checkHandlePair(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
+    if (!checkHandlePair(session, packet.opcode(), startingHandle,
                          endingHandle))
         return;
 
-    QList<Attribute> results = getAttributes(startingHandle, endingHandle);
+    const DiscoveryResponseKey cacheKey{ packet.opcode(), startingHandle, endingHandle,
+                                         QBluetoothUuid(), session.mtuSize };
+    if (sendCachedDiscoveryResponse(session, cacheKey))
+        return;
+
+    // Local handles are contiguous, so no more than this many attributes can be part of
+    // the response, even if all of them have 16 bit UUIDs.
+    const int maxElements = (session.mtuSize - 2) / (sizeof(QLowEnergyHandle) + 2);
+    const QLowEnergyHandle lastHandle = quint16(qMin<int>(endingHandle,
+                                                          startingHandle + maxElements - 1));
+    QList<Attribute> results = getAttributes(startingHandle, lastHandle);
     if (results.isEmpty()) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
-                          QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND);
+        sendDiscoveryResponse(session, cacheKey,
+                              errorResponse(packet.opcode(), startingHandle,
+                                            QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND));
         return;
     }
     ensureUniformUuidSizes(results);
@@ -2217,91 +3018,105 @@ void QLowEnergyControllerPrivateBluez::handleFindInformationRequest(const QByteA
         putDataAndIncrement(attr.handle, data);
         putDataAndIncrement(attr.type, data);
     };
-    sendListResponse(responsePrefix, elementSize, results, elemWriter);
+    sendDiscoveryResponse(session, cacheKey,
+                          listResponse(session, responsePrefix, elementSize, results, elemWriter));
 
 }
 
-void QLowEnergyControllerPrivateBluez::handleFindByTypeValueRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleFindByTypeValueRequest(ClientSession &session,
+                                                                    const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.3.3-4
 
-    if (!checkPacketSize(packet, 7, mtuSize))
+    if (!checkPacketSize(session, packet, 7, session.mtuSize))
         return;
-    const QLowEnergyHandle startingHandle = bt_get_le16(packet.constData() + 1);
-    const QLowEnergyHandle endingHandle = bt_get_le16(packet.constData() + 3);
-    const quint16 type = bt_get_le16(packet.constData() + 5);
-    const QByteArray value = QByteArray::fromRawData(packet.constData() + 7, packet.size() - 7);
+    const QLowEnergyHandle startingHandle = packet.startingHandle();
+    const QLowEnergyHandle endingHandle = packet.endingHandle();
+    const quint16 type = packet.attributeType16();
+    const QByteArrayView value = packet.findByTypeValue();
     qCDebug(QT_BT_BLUEZ) << "client sends find by type value request; start:" << startingHandle
                          << "end:" << endingHandle << "type:" << type
-                         << "value:" << value.toHex();
-    if (!checkHandlePair(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
+                         << "value:" << value.toByteArray().toHex();
+    if (!checkHandlePair(session, packet.opcode(), startingHandle,
                          endingHandle))
         return;
 
-    const auto predicate = [value, this, type](const Attribute &attr) {
-        return attr.type == QBluetoothUuid(type) && attr.value == value
-                && checkReadPermissions(attr) == QBluezConst::AttError::ATT_ERROR_NO_ERROR;
+    const auto predicate = [value, &session, this](const Attribute &attr) {
+        return QByteArrayView(attributeValue(session, attr)) == value
+                && checkReadPermissions(session, attr) == QBluezConst::AttError::ATT_ERROR_NO_ERROR;
     };
-    const QList<Attribute> results = getAttributes(startingHandle, endingHandle, predicate);
+    const int elemSize = 2 * sizeof(QLowEnergyHandle);
+    const QList<Attribute> results = getAttributesOfType(startingHandle, endingHandle,
+                                                         QBluetoothUuid(type), predicate,
+                                                         (session.mtuSize - 1) / elemSize);
     if (results.isEmpty()) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
+        sendErrorResponse(session, packet.opcode(), startingHandle,
                           QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND);
         return;
     }
 
     QByteArray responsePrefix(
             1, static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_FIND_BY_TYPE_VALUE_RESPONSE));
-    const int elemSize = 2 * sizeof(QLowEnergyHandle);
     const auto elemWriter = [](const Attribute &attr, char *&data) {
         putDataAndIncrement(attr.handle, data);
         putDataAndIncrement(attr.groupEndHandle, data);
     };
-    sendListResponse(responsePrefix, elemSize, results, elemWriter);
+    sendListResponse(session, responsePrefix, elemSize, results, elemWriter);
 }
 
-void QLowEnergyControllerPrivateBluez::handleReadByTypeRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleReadByTypeRequest(ClientSession &session,
+                                                               const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.4.1-2
 
-    if (!checkPacketSize(packet, 7, 21))
-        return;
-    const QLowEnergyHandle startingHandle = bt_get_le16(packet.constData() + 1);
-    const QLowEnergyHandle endingHandle = bt_get_le16(packet.constData() + 3);
-    const void * const typeStart = packet.constData() + 5;
-    const bool is16BitUuid = packet.size() == 7;
-    const bool is128BitUuid = packet.size() == 21;
-    QBluetoothUuid type;
-    if (is16BitUuid) {
-        type = QBluetoothUuid(bt_get_le16(typeStart));
-    } else if (is128BitUuid) {
-        type = QUuid::fromBytes(typeStart, QSysInfo::LittleEndian);
-    } else {
+    if (!checkPacketSize(session, packet, 7, 21))
+        return;
+    const QLowEnergyHandle startingHandle = packet.startingHandle();
+    const QLowEnergyHandle endingHandle = packet.endingHandle();
+    const QBluetoothUuid type = packet.attributeType();
+    if (type.isNull()) {
         qCWarning(QT_BT_BLUEZ) << "read by type request has invalid packet size" << packet.size();
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), 0,
+        sendErrorResponse(session, packet.opcode(), 0,
                           QBluezConst::AttError::ATT_ERROR_INVALID_PDU);
         return;
     }
     qCDebug(QT_BT_BLUEZ) << "client sends read by type request, start:" << startingHandle
                          << "end:" << endingHandle << "type:" << type;
-    if (!checkHandlePair(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
+    if (!checkHandlePair(session, packet.opcode(), startingHandle,
                          endingHandle))
         return;
 
-    // Get all attributes with matching type.
-    QList<Attribute> results =
-            getAttributes(startingHandle, endingHandle,
-                          [type](const Attribute &attr) { return attr.type == type; });
-    ensureUniformValueSizes(results);
+    // The values of declarations never change, unlike those of characteristics and descriptors.
+    const bool isDeclarationType =
+            type == QBluetoothUuid(static_cast<quint16>(GATT_INCLUDED_SERVICE))
+            || type == QBluetoothUuid(static_cast<quint16>(GATT_CHARACTERISTIC));
+    const DiscoveryResponseKey cacheKey{ packet.opcode(), startingHandle, endingHandle, type,
+                                         session.mtuSize };
+    if (isDeclarationType && sendCachedDiscoveryResponse(session, cacheKey))
+        return;
+
+    // Get the attributes with matching type that fit into the response.
+    QList<Attribute> results = getUniformAttributesOfType(startingHandle, endingHandle, type,
+                                                          session.mtuSize, 2,
+                                                          sizeof(QLowEnergyHandle));
+    applyClientConfigurations(session, results);
 
     if (results.isEmpty()) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
-                          QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND);
+        if (isDeclarationType) {
+            const QByteArray response = errorResponse(
+                    packet.opcode(), startingHandle,
+                    QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND);
+            sendDiscoveryResponse(session, cacheKey, response);
+        } else {
+            sendErrorResponse(session, packet.opcode(), startingHandle,
+                              QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND);
+        }
         return;
     }
 
-    const QBluezConst::AttError error = checkReadPermissions(results);
+    const QBluezConst::AttError error = checkReadPermissions(session, results);
     if (error != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)),
+        sendErrorResponse(session, packet.opcode(),
                           results.first().handle, error);
         return;
     }
@@ -2314,96 +3129,105 @@ void QLowEnergyControllerPrivateBluez::handleReadByTypeRequest(const QByteArray
         putDataAndIncrement(attr.handle, data);
         putDataAndIncrement(attr.value, data);
     };
-    sendListResponse(responsePrefix, elementSize, results, elemWriter);
+    if (isDeclarationType) {
+        sendDiscoveryResponse(session, cacheKey, listResponse(session, responsePrefix, elementSize,
+                                                              results, elemWriter));
+    } else {
+        sendListResponse(session, responsePrefix, elementSize, results, elemWriter);
+    }
 }
 
-void QLowEnergyControllerPrivateBluez::handleReadRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleReadRequest(ClientSession &session,
+                                                         const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.4.3-4
 
-    if (!checkPacketSize(packet, 3))
+    if (!checkPacketSize(session, packet, 3))
         return;
-    const QLowEnergyHandle handle = bt_get_le16(packet.constData() + 1);
+    const QLowEnergyHandle handle = packet.attributeHandle();
     qCDebug(QT_BT_BLUEZ) << "client sends read request; handle:" << handle;
 
-    if (!checkHandle(packet, handle))
+    if (!checkHandle(session, packet, handle))
         return;
     const Attribute &attribute = localAttributes.at(handle);
-    const QBluezConst::AttError permissionsError = checkReadPermissions(attribute);
+    const QBluezConst::AttError permissionsError = checkReadPermissions(session, attribute);
     if (permissionsError != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+        sendErrorResponse(session, packet.opcode(), handle,
                           permissionsError);
         return;
     }
 
-    const qsizetype sentValueLength = (std::min)(attribute.value.size(), qsizetype(mtuSize) - 1);
+    const QByteArray value = attributeValue(session, attribute);
+    const qsizetype sentValueLength = (std::min)(value.size(), qsizetype(session.mtuSize) - 1);
     QByteArray response(1 + sentValueLength, Qt::Uninitialized);
     response[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_READ_RESPONSE);
     using namespace std;
-    memcpy(response.data() + 1, attribute.value.constData(), sentValueLength);
+    memcpy(response.data() + 1, value.constData(), sentValueLength);
     qCDebug(QT_BT_BLUEZ) << "sending response:" << response.toHex();
-    sendPacket(response);
+    sendPacket(session, response);
 }
 
-void QLowEnergyControllerPrivateBluez::handleReadBlobRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleReadBlobRequest(ClientSession &session,
+                                                             const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.4.5-6
 
-    if (!checkPacketSize(packet, 5))
+    if (!checkPacketSize(session, packet, 5))
         return;
-    const QLowEnergyHandle handle = bt_get_le16(packet.constData() + 1);
-    const quint16 valueOffset = bt_get_le16(packet.constData() + 3);
+    const QLowEnergyHandle handle = packet.attributeHandle();
+    const quint16 valueOffset = packet.valueOffset();
     qCDebug(QT_BT_BLUEZ) << "client sends read blob request; handle:" << handle
                          << "offset:" << valueOffset;
 
-    if (!checkHandle(packet, handle))
+    if (!checkHandle(session, packet, handle))
         return;
     const Attribute &attribute = localAttributes.at(handle);
-    const QBluezConst::AttError permissionsError = checkReadPermissions(attribute);
+    const QBluezConst::AttError permissionsError = checkReadPermissions(session, attribute);
     if (permissionsError != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+        sendErrorResponse(session, packet.opcode(), handle,
                           permissionsError);
         return;
     }
-    if (valueOffset > attribute.value.size()) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+    const QByteArray value = attributeValue(session, attribute);
+    if (valueOffset > value.size()) {
+        sendErrorResponse(session, packet.opcode(), handle,
                           QBluezConst::AttError::ATT_ERROR_INVALID_OFFSET);
         return;
     }
-    if (attribute.value.size() <= mtuSize - 3) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+    if (value.size() <= session.mtuSize - 3) {
+        sendErrorResponse(session, packet.opcode(), handle,
                           QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_LONG);
         return;
     }
 
     // Yes, this value can be zero.
-    const qsizetype sentValueLength = (std::min)(attribute.value.size() - valueOffset,
-                                                 qsizetype(mtuSize) - 1);
+    const qsizetype sentValueLength = (std::min)(value.size() - valueOffset,
+                                                 qsizetype(session.mtuSize) - 1);
 
     QByteArray response(1 + sentValueLength, Qt::Uninitialized);
     response[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_READ_BLOB_RESPONSE);
     using namespace std;
-    memcpy(response.data() + 1, attribute.value.constData() + valueOffset, sentValueLength);
+    memcpy(response.data() + 1, value.constData() + valueOffset, sentValueLength);
     qCDebug(QT_BT_BLUEZ) << "sending response:" << response.toHex();
-    sendPacket(response);
+    sendPacket(session, response);
 }
 
-void QLowEnergyControllerPrivateBluez::handleReadMultipleRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleReadMultipleRequest(ClientSession &session,
+                                                                 const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.4.7-8
 
-    if (!checkPacketSize(packet, 5, mtuSize))
+    if (!checkPacketSize(session, packet, 5, session.mtuSize))
         return;
-    QList<QLowEnergyHandle> handles((packet.size() - 1) / sizeof(QLowEnergyHandle));
-    auto *packetPtr = reinterpret_cast<const QLowEnergyHandle *>(packet.constData() + 1);
-    for (qsizetype i = 0; i < handles.size(); ++i, ++packetPtr)
-        handles[i] = bt_get_le16(packetPtr);
+    QList<QLowEnergyHandle> handles(packet.handleCount());
+    for (qsizetype i = 0; i < handles.size(); ++i)
+        handles[i] = packet.handleAt(i);
     qCDebug(QT_BT_BLUEZ) << "client sends read multiple request for handles" << handles;
 
     const auto it = std::find_if(handles.constBegin(), handles.constEnd(),
             [this](QLowEnergyHandle handle) { return handle >= lastLocalHandle; });
     if (it != handles.constEnd()) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), *it,
+        sendErrorResponse(session, packet.opcode(), *it,
                           QBluezConst::AttError::ATT_ERROR_INVALID_HANDLE);
         return;
     }
@@ -2411,75 +3235,108 @@ void QLowEnergyControllerPrivateBluez::handleReadMultipleRequest(const QByteArra
     QByteArray response(
             1, static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_RESPONSE));
     for (const Attribute &attr : results) {
-        const QBluezConst::AttError error = checkReadPermissions(attr);
+        const QBluezConst::AttError error = checkReadPermissions(session, attr);
         if (error != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
-            sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), attr.handle,
+            sendErrorResponse(session, packet.opcode(), attr.handle,
                               error);
             return;
         }
 
         // Note: We do not abort if no more values fit into the packet, because we still have to
         //       report possible permission errors for the other handles.
-        response += attr.value.left(mtuSize - response.size());
+        response += attributeValue(session, attr).left(session.mtuSize - response.size());
+    }
+
+    qCDebug(QT_BT_BLUEZ) << "sending response:" << response.toHex();
+    sendPacket(session, response);
+}
+
+void QLowEnergyControllerPrivateBluez::handleReadMultipleVariableRequest(ClientSession &session,
+                                                                         const AttPduView &packet)
+{
+    // Spec v5.2, Vol 3, Part F, 3.4.4.11-12
+
+    if (!checkPacketSize(session, packet, 5, session.mtuSize))
+        return;
+    QByteArray response(1, static_cast<quint8>(
+            QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_RESPONSE));
+    for (qsizetype i = 0; i < packet.handleCount(); ++i) {
+        const QLowEnergyHandle handle = packet.handleAt(i);
+        if (!checkHandle(session, packet, handle))
+            return;
+        const Attribute &attribute = localAttributes.at(handle);
+        const QBluezConst::AttError error = checkReadPermissions(session, attribute);
+        if (error != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
+            sendErrorResponse(session, packet.opcode(), handle, error);
+            return;
+        }
+
+        // The length is the one of the complete value, even if the value is cut off.
+        // As for read multiple, the permissions of all handles are checked.
+        if (response.size() + 2 > session.mtuSize)
+            continue;
+        const QByteArray value = attributeValue(session, attribute);
+        char length[2];
+        putBtData(quint16(value.size()), length);
+        response.append(length, 2);
+        response += value.left(session.mtuSize - response.size());
     }
 
     qCDebug(QT_BT_BLUEZ) << "sending response:" << response.toHex();
-    sendPacket(response);
+    sendPacket(session, response);
 }
 
-void QLowEnergyControllerPrivateBluez::handleReadByGroupTypeRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleReadByGroupTypeRequest(ClientSession &session,
+                                                                    const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.4.9-10
 
-    if (!checkPacketSize(packet, 7, 21))
-        return;
-    const QLowEnergyHandle startingHandle = bt_get_le16(packet.constData() + 1);
-    const QLowEnergyHandle endingHandle = bt_get_le16(packet.constData() + 3);
-    const bool is16BitUuid = packet.size() == 7;
-    const bool is128BitUuid = packet.size() == 21;
-    const void * const typeStart = packet.constData() + 5;
-    QBluetoothUuid type;
-    if (is16BitUuid) {
-        type = QBluetoothUuid(bt_get_le16(typeStart));
-    } else if (is128BitUuid) {
-        type = QUuid::fromBytes(typeStart, QSysInfo::LittleEndian);
-    } else {
+    if (!checkPacketSize(session, packet, 7, 21))
+        return;
+    const QLowEnergyHandle startingHandle = packet.startingHandle();
+    const QLowEnergyHandle endingHandle = packet.endingHandle();
+    const QBluetoothUuid type = packet.attributeType();
+    if (type.isNull()) {
         qCWarning(QT_BT_BLUEZ) << "read by group type request has invalid packet size"
                                << packet.size();
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), 0,
+        sendErrorResponse(session, packet.opcode(), 0,
                           QBluezConst::AttError::ATT_ERROR_INVALID_PDU);
         return;
     }
     qCDebug(QT_BT_BLUEZ) << "client sends read by group type request, start:" << startingHandle
                          << "end:" << endingHandle << "type:" << type;
 
-    if (!checkHandlePair(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
+    if (!checkHandlePair(session, packet.opcode(), startingHandle,
                          endingHandle))
         return;
     if (type != QBluetoothUuid(static_cast<quint16>(GATT_PRIMARY_SERVICE))
             && type != QBluetoothUuid(static_cast<quint16>(GATT_SECONDARY_SERVICE))) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
+        sendErrorResponse(session, packet.opcode(), startingHandle,
                           QBluezConst::AttError::ATT_ERROR_UNSUPPRTED_GROUP_TYPE);
         return;
     }
 
-    QList<Attribute> results =
-            getAttributes(startingHandle, endingHandle,
-                          [type](const Attribute &attr) { return attr.type == type; });
+    const DiscoveryResponseKey cacheKey{ packet.opcode(), startingHandle, endingHandle, type,
+                                         session.mtuSize };
+    if (sendCachedDiscoveryResponse(session, cacheKey))
+        return;
+
+    QList<Attribute> results = getUniformAttributesOfType(startingHandle, endingHandle, type,
+                                                          session.mtuSize, 2,
+                                                          2 * sizeof(QLowEnergyHandle));
     if (results.isEmpty()) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), startingHandle,
-                          QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND);
+        sendDiscoveryResponse(session, cacheKey,
+                              errorResponse(packet.opcode(), startingHandle,
+                                            QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND));
         return;
     }
-    const QBluezConst::AttError error = checkReadPermissions(results);
+    const QBluezConst::AttError error = checkReadPermissions(session, results);
     if (error != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)),
+        sendErrorResponse(session, packet.opcode(),
                           results.first().handle, error);
         return;
     }
 
-    ensureUniformValueSizes(results);
-
     const qsizetype elementSize = 2 * sizeof(QLowEnergyHandle) + results.first().value.size();
     QByteArray responsePrefix(2, Qt::Uninitialized);
     responsePrefix[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_READ_BY_GROUP_RESPONSE);
@@ -2489,16 +3346,28 @@ void QLowEnergyControllerPrivateBluez::handleReadByGroupTypeRequest(const QByteA
         putDataAndIncrement(attr.groupEndHandle, data);
         putDataAndIncrement(attr.value, data);
     };
-    sendListResponse(responsePrefix, elementSize, results, elemWriter);
+    sendDiscoveryResponse(session, cacheKey,
+                          listResponse(session, responsePrefix, elementSize, results, elemWriter));
+}
+
+static bool isClientConfiguration(const QLowEnergyControllerPrivateBluez::Attribute &attribute)
+{
+    return attribute.type == QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration;
 }
 
 void QLowEnergyControllerPrivateBluez::updateLocalAttributeValue(
+        ClientSession &session,
         QLowEnergyHandle handle,
         const QByteArray &value,
         QLowEnergyCharacteristic &characteristic,
         QLowEnergyDescriptor &descriptor)
 {
-    localAttributes[handle].value = value;
+    Attribute &attribute = localAttributes[handle];
+    const bool isClientConfig = isClientConfiguration(attribute);
+    if (isClientConfig)
+        setClientConfiguration(session, handle, value);
+    else
+        attribute.value = value;
     for (const auto &service : std::as_const(localServices)) {
         if (handle < service->startHandle || handle > service->endHandle)
             continue;
@@ -2513,7 +3382,9 @@ void QLowEnergyControllerPrivateBluez::updateLocalAttributeValue(
             for (auto descIt = charData.descriptorList.begin();
                  descIt != charData.descriptorList.end(); ++descIt) {
                 if (handle == descIt.key()) {
-                    descIt.value().value = value;
+                    // the CCCD values of other centrals stay internal, see ClientSession
+                    if (!isClientConfig || isPrimarySession(session))
+                        descIt.value().value = value;
                     descriptor = QLowEnergyDescriptor(service, charIt.key(), handle);
                     return;
                 }
@@ -2545,28 +3416,32 @@ void QLowEnergyControllerPrivateBluez::writeCharacteristicForPeripheral(
             = attribute.properties & QLowEnergyCharacteristic::Indicate;
     if (!hasNotifyProperty && !hasIndicateProperty)
         return;
-    for (const QLowEnergyServicePrivate::DescData &desc : std::as_const(charData.descriptorList)) {
-        if (desc.uuid != QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration)
+    for (auto descIt = charData.descriptorList.cbegin(); descIt != charData.descriptorList.cend();
+         ++descIt) {
+        if (descIt.value().uuid != QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration)
             continue;
 
-        // Notify/indicate currently connected client.
+        // Notify/indicate currently connected clients.
         const bool isConnected = state == QLowEnergyController::ConnectedState;
         if (isConnected) {
-            Q_ASSERT(desc.value.size() == 2);
-            quint16 configValue = bt_get_le16(desc.value.constData());
-            if (isNotificationEnabled(configValue) && hasNotifyProperty) {
-                sendNotification(valueHandle);
-            } else if (isIndicationEnabled(configValue) && hasIndicateProperty) {
-                if (indicationInFlight)
-                    scheduledIndications << valueHandle;
-                else
-                    sendIndication(valueHandle);
+            // a copy, a slot connected to errorOccurred() may close the connections
+            const QList<std::shared_ptr<ClientSession>> sessions = centrals;
+            for (const std::shared_ptr<ClientSession> &session : sessions) {
+                const quint16 configValue = session->clientConfigs.value(descIt.key());
+                if (isNotificationEnabled(configValue) && hasNotifyProperty) {
+                    sendNotification(*session, valueHandle);
+                } else if (isIndicationEnabled(configValue) && hasIndicateProperty) {
+                    if (session->indicationInFlight)
+                        session->scheduledIndications << valueHandle;
+                    else
+                        sendIndication(*session, valueHandle);
+                }
             }
         }
 
         // Prepare notification/indication of unconnected, bonded clients.
         for (auto it = clientConfigData.begin(); it != clientConfigData.end(); ++it) {
-            if (isConnected && it.key() == remoteDevice.toUInt64())
+            if (isConnected && isConnectedCentral(it.key()))
                 continue;
             QList<ClientConfigurationData> &configDataList = it.value();
             for (ClientConfigurationData &configData : configDataList) {
@@ -2609,12 +3484,12 @@ void QLowEnergyControllerPrivateBluez::writeCharacteristicForCentral(const QShar
         break;
     case QLowEnergyService::WriteSigned:
         packet[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_SIGNED_WRITE_COMMAND);
-        if (!isBonded()) {
+        if (!isBonded(remoteDevice)) {
             qCWarning(QT_BT_BLUEZ) << "signed write not possible: requires bond between devices";
             service->setError(QLowEnergyService::CharacteristicWriteError);
             return;
         }
-        if (securityLevel() >= BT_SECURITY_MEDIUM) {
+        if (securityLevel(l2cpSocket) >= BT_SECURITY_MEDIUM) {
             qCWarning(QT_BT_BLUEZ) << "signed write not possible: not allowed on encrypted link";
             service->setError(QLowEnergyService::CharacteristicWriteError);
             return;
@@ -2627,10 +3502,12 @@ void QLowEnergyControllerPrivateBluez::writeCharacteristicForCentral(const QShar
         }
         ++signingDataIt.value().counter;
         packet = LeCmacCalculator::createFullMessage(packet, signingDataIt.value().counter);
-        const quint64 mac = LeCmacCalculator().calculateMac(packet, signingDataIt.value().key);
+        if (!cmacCalculator)
+            cmacCalculator = new LeCmacCalculator;
+        const quint64 mac = cmacCalculator->calculateMac(packet, signingDataIt.value().key);
         packet.resize(packet.size() + sizeof mac);
         putBtData(mac, packet.data() + packet.size() - sizeof mac);
-        storeSignCounter(LocalSigningKey);
+        storeSignCounter(LocalSigningKey, remoteDevice);
         break;
     }
 
@@ -2641,17 +3518,13 @@ void QLowEnergyControllerPrivateBluez::writeCharacteristicForCentral(const QShar
 
     // Advantage of write without response is the quick turnaround.
     // It can be sent at any time and does not produce responses.
-    // Therefore we will not put them into the openRequest queue at all.
-    if (!writeWithResponse) {
-        sendPacket(packet);
-        return;
-    }
-
+    // sendNextPendingRequest() sends it right away, even if a request is pending.
     Request request;
     request.payload = packet;
-    request.command = QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST;
+    request.command = static_cast<QBluezConst::AttCommand>(packet.at(0));
     request.reference = charHandle;
-    request.reference2 = newValue;
+    if (writeWithResponse)
+        request.reference2 = newValue;
     openRequests.enqueue(request);
 
     sendNextPendingRequest();
@@ -2670,7 +3543,11 @@ void QLowEnergyControllerPrivateBluez::writeDescriptorForPeripheral(
                                << "for attribute" << descriptorHandle;
         return;
     }
-    attribute.value = newValue;
+    // the public API reports the CCCD values of the primary central
+    if (!isClientConfiguration(attribute))
+        attribute.value = newValue;
+    else if (!centrals.isEmpty())
+        setClientConfiguration(*centrals.first(), descriptorHandle, newValue);
     service->characteristicList[charHandle].descriptorList[descriptorHandle].value = newValue;
 }
 
@@ -2685,73 +3562,61 @@ void QLowEnergyControllerPrivateBluez::writeDescriptorForCentral(
         return;
     }
 
-    quint8 packet[WRITE_REQUEST_HEADER_SIZE];
-    packet[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST);
-    putBtData(descriptorHandle, &packet[1]);
-
-    const qsizetype size = WRITE_REQUEST_HEADER_SIZE + newValue.size();
-    QByteArray data(size, Qt::Uninitialized);
-    memcpy(data.data(), packet, WRITE_REQUEST_HEADER_SIZE);
-    memcpy(&(data.data()[WRITE_REQUEST_HEADER_SIZE]), newValue.constData(), newValue.size());
-
     qCDebug(QT_BT_BLUEZ) << "Writing descriptor" << Qt::hex << descriptorHandle
-                         << "(size:" << size << ")";
+                         << "(size:" << WRITE_REQUEST_HEADER_SIZE + newValue.size() << ")";
 
-    Request request;
-    request.payload = data;
-    request.command = QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST;
-    request.reference = (charHandle | (descriptorHandle << 16));
-    request.reference2 = newValue;
-    openRequests.enqueue(request);
+    openRequests.enqueue(writeRequest(descriptorHandle, (charHandle | (descriptorHandle << 16)),
+                                      newValue));
 
     sendNextPendingRequest();
 }
 
-void QLowEnergyControllerPrivateBluez::handleWriteRequestOrCommand(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleWriteRequestOrCommand(ClientSession &session,
+                                                                   const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.5.1-3
 
-    const bool isRequest = static_cast<QBluezConst::AttCommand>(packet.at(0))
+    const bool isRequest = packet.opcode()
             == QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST;
-    const bool isSigned = static_cast<QBluezConst::AttCommand>(packet.at(0))
+    const bool isSigned = packet.opcode()
             == QBluezConst::AttCommand::ATT_OP_SIGNED_WRITE_COMMAND;
-    if (!checkPacketSize(packet, isSigned ? 15 : 3, mtuSize))
+    if (!checkPacketSize(session, packet, isSigned ? 15 : 3, session.mtuSize))
         return;
-    const QLowEnergyHandle handle = bt_get_le16(packet.constData() + 1);
+    const QLowEnergyHandle handle = packet.attributeHandle();
     qCDebug(QT_BT_BLUEZ) << "client sends" << (isSigned ? "signed" : "") << "write"
                          << (isRequest ? "request" : "command") << "for handle" << handle;
 
-    if (!checkHandle(packet, handle))
+    if (!checkHandle(session, packet, handle))
         return;
 
     Attribute &attribute = localAttributes[handle];
     const QLowEnergyCharacteristic::PropertyType type = isRequest
             ? QLowEnergyCharacteristic::Write : isSigned
               ? QLowEnergyCharacteristic::WriteSigned : QLowEnergyCharacteristic::WriteNoResponse;
-    const QBluezConst::AttError permissionsError = checkPermissions(attribute, type);
+    const QBluezConst::AttError permissionsError = checkPermissions(session, attribute, type);
     if (permissionsError != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+        sendErrorResponse(session, packet.opcode(), handle,
                           permissionsError);
         return;
     }
 
     int valueLength;
     if (isSigned) {
-        if (!isBonded()) {
+        if (!isBonded(session.remoteDevice)) {
             qCWarning(QT_BT_BLUEZ) << "Ignoring signed write from non-bonded device.";
             return;
         }
-        if (securityLevel() >= BT_SECURITY_MEDIUM) {
+        if (securityLevel(session.socket) >= BT_SECURITY_MEDIUM) {
             qCWarning(QT_BT_BLUEZ) << "Ignoring signed write on encrypted link.";
             return;
         }
-        const auto signingDataIt = signingData.find(remoteDevice.toUInt64());
+        const auto signingDataIt = signingData.find(session.remoteDevice.toUInt64());
         if (signingDataIt == signingData.constEnd()) {
             qCWarning(QT_BT_BLUEZ) << "No CSRK found for peer device, ignoring signed write";
             return;
         }
 
-        const quint32 signCounter = getBtData<quint32>(packet.data() + packet.size() - 12);
+        const quint32 signCounter = packet.get<quint32>(packet.size() - 12);
         if (signCounter < signingDataIt.value().counter + 1) {
             qCWarning(QT_BT_BLUEZ) << "Client's' sign counter" << signCounter
                                    << "not greater than local sign counter"
@@ -2760,42 +3625,47 @@ void QLowEnergyControllerPrivateBluez::handleWriteRequestOrCommand(const QByteAr
             return;
         }
 
-        const quint64 macFromClient = getBtData<quint64>(packet.data() + packet.size() - 8);
-        const bool signatureCorrect = verifyMac(packet.left(packet.size() - 12),
+        const quint64 macFromClient = packet.get<quint64>(packet.size() - 8);
+        const bool signatureCorrect = verifyMac(packet.bytes().first(packet.size() - 12).toByteArray(),
                 signingDataIt.value().key, signCounter, macFromClient);
         if (!signatureCorrect) {
             qCWarning(QT_BT_BLUEZ) << "Signed Write packet has wrong signature, disconnecting";
-            disconnectFromDevice(); // Recommended by spec v4.2, Vol 3, part C, 10.4.2
+            // Recommended by spec v4.2, Vol 3, part C, 10.4.2
+            if (role == QLowEnergyController::PeripheralRole)
+                closeCentral(session);
+            else
+                disconnectFromDevice();
             return;
         }
 
         signingDataIt.value().counter = signCounter;
-        storeSignCounter(RemoteSigningKey);
+        storeSignCounter(RemoteSigningKey, session.remoteDevice);
         valueLength = packet.size() - 15;
     } else {
         valueLength = packet.size() - 3;
     }
 
     if (valueLength > attribute.maxLength) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+        sendErrorResponse(session, packet.opcode(), handle,
                           QBluezConst::AttError::ATT_ERROR_INVAL_ATTR_VALUE_LEN);
         return;
     }
 
     // If the attribute value has a fixed size and the value in the packet is shorter,
     // then we overwrite only the start of the attribute value and keep the rest.
-    QByteArray value = packet.mid(3, valueLength);
+    QByteArray value = packet.handleValue().first(valueLength).toByteArray();
     if (attribute.minLength == attribute.maxLength && valueLength < attribute.minLength)
-        value += attribute.value.mid(valueLength, attribute.maxLength - valueLength);
+        value += attributeValue(session, attribute).mid(valueLength,
+                                                        attribute.maxLength - valueLength);
 
     QLowEnergyCharacteristic characteristic;
     QLowEnergyDescriptor descriptor;
-    updateLocalAttributeValue(handle, value, characteristic, descriptor);
+    updateLocalAttributeValue(session, handle, value, characteristic, descriptor);
 
     if (isRequest) {
         const QByteArray response =
                 QByteArray(1, static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_WRITE_RESPONSE));
-        sendPacket(response);
+        sendPacket(session, response);
     }
 
     if (characteristic.isValid()) {
@@ -2806,65 +3676,68 @@ void QLowEnergyControllerPrivateBluez::handleWriteRequestOrCommand(const QByteAr
     }
 }
 
-void QLowEnergyControllerPrivateBluez::handlePrepareWriteRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handlePrepareWriteRequest(ClientSession &session,
+                                                                 const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.6.1
 
-    if (!checkPacketSize(packet, 5, mtuSize))
+    if (!checkPacketSize(session, packet, 5, session.mtuSize))
         return;
-    const quint16 handle = bt_get_le16(packet.constData() + 1);
+    const quint16 handle = packet.attributeHandle();
     qCDebug(QT_BT_BLUEZ) << "client sends prepare write request for handle" << handle;
 
-    if (!checkHandle(packet, handle))
+    if (!checkHandle(session, packet, handle))
         return;
     const Attribute &attribute = localAttributes.at(handle);
     const QBluezConst::AttError permissionsError =
-            checkPermissions(attribute, QLowEnergyCharacteristic::Write);
+            checkPermissions(session, attribute, QLowEnergyCharacteristic::Write);
     if (permissionsError != QBluezConst::AttError::ATT_ERROR_NO_ERROR) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+        sendErrorResponse(session, packet.opcode(), handle,
                           permissionsError);
         return;
     }
-    if (openPrepareWriteRequests.size() >= maxPrepareQueueSize) {
-        sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)), handle,
+    if (session.openPrepareWriteRequests.size() >= maxPrepareQueueSize) {
+        sendErrorResponse(session, packet.opcode(), handle,
                           QBluezConst::AttError::ATT_ERROR_PREPARE_QUEUE_FULL);
         return;
     }
 
     // The value is not checked here, but on the Execute request.
-    openPrepareWriteRequests << WriteRequest(handle, bt_get_le16(packet.constData() + 3),
-                                                    packet.mid(5));
+    session.openPrepareWriteRequests << WriteRequest(handle, packet.valueOffset(),
+                                             packet.partValue().toByteArray());
 
-    QByteArray response = packet;
+    QByteArray response = packet.bytes().toByteArray();
     response[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_PREPARE_WRITE_RESPONSE);
-    sendPacket(response);
+    sendPacket(session, response);
 }
 
-void QLowEnergyControllerPrivateBluez::handleExecuteWriteRequest(const QByteArray &packet)
+void QLowEnergyControllerPrivateBluez::handleExecuteWriteRequest(ClientSession &session,
+                                                                 const AttPduView &packet)
 {
     // Spec v4.2, Vol 3, Part F, 3.4.6.3
 
-    if (!checkPacketSize(packet, 2))
+    if (!checkPacketSize(session, packet, 2))
         return;
-    const bool cancel = packet.at(1) == 0;
+    const bool cancel = packet.isExecuteWriteCancel();
     qCDebug(QT_BT_BLUEZ) << "client sends execute write request; flag is"
                          << (cancel ? "cancel" : "flush");
 
-    QList<WriteRequest> requests = openPrepareWriteRequests;
-    openPrepareWriteRequests.clear();
+    QList<WriteRequest> requests = session.openPrepareWriteRequests;
+    session.openPrepareWriteRequests.clear();
     QList<QLowEnergyCharacteristic> characteristics;
     QList<QLowEnergyDescriptor> descriptors;
     if (!cancel) {
         for (const WriteRequest &request : std::as_const(requests)) {
-            Attribute &attribute = localAttributes[request.handle];
-            if (request.valueOffset > attribute.value.size()) {
-                sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)),
+            const Attribute &attribute = localAttributes.at(request.handle);
+            const QByteArray value = attributeValue(session, attribute);
+            if (request.valueOffset > value.size()) {
+                sendErrorResponse(session, packet.opcode(),
                                   request.handle, QBluezConst::AttError::ATT_ERROR_INVALID_OFFSET);
                 return;
             }
-            const QByteArray newValue = attribute.value.left(request.valueOffset) + request.value;
+            const QByteArray newValue = value.left(request.valueOffset) + request.value;
             if (newValue.size() > attribute.maxLength) {
-                sendErrorResponse(static_cast<QBluezConst::AttCommand>(packet.at(0)),
+                sendErrorResponse(session, packet.opcode(),
                                   request.handle,
                                   QBluezConst::AttError::ATT_ERROR_INVAL_ATTR_VALUE_LEN);
                 return;
@@ -2873,7 +3746,8 @@ void QLowEnergyControllerPrivateBluez::handleExecuteWriteRequest(const QByteArra
             QLowEnergyDescriptor descriptor;
             // TODO: Redundant attribute lookup for the case of the same handle appearing
             //       more than once.
-            updateLocalAttributeValue(request.handle, newValue, characteristic, descriptor);
+            updateLocalAttributeValue(session, request.handle, newValue, characteristic,
+                                      descriptor);
             if (characteristic.isValid()) {
                 characteristics << characteristic;
             } else if (descriptor.isValid()) {
@@ -2883,7 +3757,7 @@ void QLowEnergyControllerPrivateBluez::handleExecuteWriteRequest(const QByteArra
         }
     }
 
-    sendPacket(QByteArray(
+    sendPacket(session, QByteArray(
             1, static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_EXECUTE_WRITE_RESPONSE)));
 
     for (const QLowEnergyCharacteristic &characteristic : std::as_const(characteristics))
@@ -2892,7 +3766,8 @@ void QLowEnergyControllerPrivateBluez::handleExecuteWriteRequest(const QByteArra
         emit descriptor.d_ptr->descriptorWritten(descriptor, descriptor.value());
 }
 
-void QLowEnergyControllerPrivateBluez::sendErrorResponse(QBluezConst::AttCommand request,
+void QLowEnergyControllerPrivateBluez::sendErrorResponse(ClientSession &session,
+                                                         QBluezConst::AttCommand request,
                                                          quint16 handle, QBluezConst::AttError code)
 {
     // An ATT command never receives an error response.
@@ -2900,24 +3775,45 @@ void QLowEnergyControllerPrivateBluez::sendErrorResponse(QBluezConst::AttCommand
         || request == QBluezConst::AttCommand::ATT_OP_SIGNED_WRITE_COMMAND)
         return;
 
+    qCWarning(QT_BT_BLUEZ) << "sending error response; request:"
+                           << request << "handle:" << handle
+                           << "code:" << code;
+    sendPacket(session, errorResponse(request, handle, code));
+}
+
+QByteArray QLowEnergyControllerPrivateBluez::errorResponse(QBluezConst::AttCommand request,
+                                                           quint16 handle,
+                                                           QBluezConst::AttError code)
+{
     QByteArray packet(ERROR_RESPONSE_HEADER_SIZE, Qt::Uninitialized);
     packet[0] = static_cast<quint8>(QBluezConst::AttCommand::ATT_OP_ERROR_RESPONSE);
     packet[1] = static_cast<quint8>(request);
     putBtData(handle, packet.data() + 2);
     packet[4] = static_cast<quint8>(code);
-    qCWarning(QT_BT_BLUEZ) << "sending error response; request:"
-                           << request << "handle:" << handle
-                           << "code:" << code;
-    sendPacket(packet);
+    return packet;
 }
 
-void QLowEnergyControllerPrivateBluez::sendListResponse(const QByteArray &packetStart,
+void QLowEnergyControllerPrivateBluez::sendListResponse(ClientSession &session,
+                                                        const QByteArray &packetStart,
                                                         qsizetype elemSize,
                                                         const QList<Attribute> &attributes,
                                                         const ElemWriter &elemWriter)
+{
+    const QByteArray response = listResponse(session, packetStart, elemSize, attributes,
+                                             elemWriter);
+    qCDebug(QT_BT_BLUEZ) << "sending response:" << response.toHex();
+    sendPacket(session, response);
+}
+
+QByteArray QLowEnergyControllerPrivateBluez::listResponse(const ClientSession &session,
+                                                          const QByteArray &packetStart,
+                                                          qsizetype elemSize,
+                                                          const QList<Attribute> &attributes,
+                                                          const ElemWriter &elemWriter)
 {
     const qsizetype offset = packetStart.size();
-    const qsizetype elemCount = (std::min)(attributes.size(), (mtuSize - offset) / elemSize);
+    const qsizetype elemCount = (std::min)(attributes.size(),
+                                           (session.mtuSize - offset) / elemSize);
     const qsizetype totalPacketSize = offset + elemCount * elemSize;
     QByteArray response(totalPacketSize, Qt::Uninitialized);
     using namespace std;
@@ -2925,41 +3821,167 @@ void QLowEnergyControllerPrivateBluez::sendListResponse(const QByteArray &packet
     char *data = response.data() + offset;
     for_each(attributes.constBegin(), attributes.constBegin() + elemCount,
              [&data, elemWriter](const Attribute &attr) { elemWriter(attr, data); });
+    return response;
+}
+
+/*!
+    \internal
+
+    Sends the cached response to the discovery request identified by \a key, if there is one.
+    Returns \c true if a response was sent.
+
+    Every central runs through the same sequence of Read By Group Type, Read By Type and
+    Find Information requests. As long as the attribute table does not change, the responses
+    only depend on the request parameters and the MTU.
+ */
+bool QLowEnergyControllerPrivateBluez::sendCachedDiscoveryResponse(ClientSession &session,
+                                                                   const DiscoveryResponseKey &key)
+{
+    const auto it = discoveryResponseCache.constFind(key);
+    if (it == discoveryResponseCache.constEnd()) {
+        ++discoveryCacheStats.misses;
+        return false;
+    }
+    ++discoveryCacheStats.hits;
+    qCDebug(QT_BT_BLUEZ) << "sending cached response:" << it->toHex();
+    sendPacket(session, *it);
+    return true;
+}
+
+void QLowEnergyControllerPrivateBluez::sendDiscoveryResponse(ClientSession &session,
+                                                             const DiscoveryResponseKey &key,
+                                                             const QByteArray &response)
+{
+    // A misbehaving client could walk arbitrary handle ranges; do not let the cache grow
+    // without bounds.
+    constexpr qsizetype maxCachedDiscoveryResponses = 1024;
+    if (discoveryResponseCache.size() < maxCachedDiscoveryResponses)
+        discoveryResponseCache.insert(key, response);
     qCDebug(QT_BT_BLUEZ) << "sending response:" << response.toHex();
-    sendPacket(response);
+    sendPacket(session, response);
 }
 
-void QLowEnergyControllerPrivateBluez::sendNotification(QLowEnergyHandle handle)
+void QLowEnergyControllerPrivateBluez::sendNotification(ClientSession &session,
+                                                        QLowEnergyHandle handle)
 {
-    sendNotificationOrIndication(QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION, handle);
+    sendNotificationOrIndication(session, QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION,
+                                 handle);
 }
 
-void QLowEnergyControllerPrivateBluez::sendIndication(QLowEnergyHandle handle)
+void QLowEnergyControllerPrivateBluez::sendIndication(ClientSession &session,
+                                                      QLowEnergyHandle handle)
 {
-    Q_ASSERT(!indicationInFlight);
-    indicationInFlight = true;
-    sendNotificationOrIndication(QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_INDICATION, handle);
+    Q_ASSERT(!session.indicationInFlight);
+    session.indicationInFlight = true;
+    sendNotificationOrIndication(session, QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_INDICATION,
+                                 handle);
 }
 
-void QLowEnergyControllerPrivateBluez::sendNotificationOrIndication(QBluezConst::AttCommand opCode,
+void QLowEnergyControllerPrivateBluez::sendNotificationOrIndication(ClientSession &session,
+                                                                    QBluezConst::AttCommand opCode,
                                                                     QLowEnergyHandle handle)
 {
     Q_ASSERT(handle <= lastLocalHandle);
     const Attribute &attribute = localAttributes.at(handle);
-    const qsizetype maxValueLength = (std::min)(attribute.value.size(), qsizetype(mtuSize) - 3);
+    const qsizetype maxValueLength = (std::min)(attribute.value.size(),
+                                                qsizetype(session.mtuSize) - 3);
     QByteArray packet(3 + maxValueLength, Qt::Uninitialized);
     packet[0] = static_cast<quint8>(opCode);
     putBtData(handle, packet.data() + 1);
     using namespace std;
     memcpy(packet.data() + 3, attribute.value.constData(), maxValueLength);
-    qCDebug(QT_BT_BLUEZ) << "sending notification/indication:" << packet.toHex();
-    sendPacket(packet);
+
+    QQueue<OutgoingNotification> &notificationQueue = session.notificationQueue;
+    if (opCode == QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION
+            && coalesceNotifications) {
+        const auto it = std::find_if(notificationQueue.begin(), notificationQueue.end(),
+                                     [handle, &packet](const OutgoingNotification &notification) {
+            return notification.handle == handle
+                    && notification.packet.at(0) == packet.at(0);
+        });
+        if (it != notificationQueue.end()) {
+            qCDebug(QT_BT_BLUEZ) << "coalescing notification for handle" << handle;
+            it->packet = packet;
+            ++notificationStats.coalesced;
+            return;
+        }
+    }
+
+    // sendQueuedNotifications() leaves packets queued only while the socket cannot take them
+    const bool waitingForSocket = !notificationQueue.isEmpty();
+
+    // Keep the queue bounded if the central does not keep up. Indications are rate-limited by
+    // their confirmations already, so the oldest notification has to go.
+    constexpr qsizetype maxQueuedNotifications = 256;
+    if (notificationQueue.size() >= maxQueuedNotifications) {
+        const auto it = std::find_if(notificationQueue.begin(), notificationQueue.end(),
+                                     [](const OutgoingNotification &notification) {
+            return notification.packet.at(0) == static_cast<char>(
+                        QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION);
+        });
+        if (it != notificationQueue.end()) {
+            qCWarning(QT_BT_BLUEZ) << "notification queue full, dropping notification for handle"
+                                   << it->handle;
+            notificationQueue.erase(it);
+            ++notificationStats.dropped;
+        }
+    }
+
+    notificationQueue.enqueue({ handle, packet });
+    if (!waitingForSocket)
+        sendQueuedNotifications(session);
 }
 
-void QLowEnergyControllerPrivateBluez::sendNextIndication()
+/*!
+    \internal
+
+    Writes the queued notifications and indications of \a session to its L2CAP socket.
+
+    If the socket cannot take any more data, the remaining packets stay queued and are sent
+    once the socket emits QBluetoothSocketPrivateBluez::readyWrite(), rather than being
+    discarded as sendPacket() does.
+ */
+void QLowEnergyControllerPrivateBluez::sendQueuedNotifications(ClientSession &session)
 {
-    if (!scheduledIndications.isEmpty())
-        sendIndication(scheduledIndications.takeFirst());
+    if (!session.socket)
+        return;
+
+    while (!session.notificationQueue.isEmpty()) {
+        const QByteArray &packet = session.notificationQueue.head().packet;
+        const qint64 result = session.socket->write(packet.constData(), packet.size());
+        if (result == 0) { // EAGAIN, the socket emits readyWrite() once it has room again
+            ++notificationStats.deferred;
+            return;
+        }
+        if (result == -1) {
+            qCDebug(QT_BT_BLUEZ) << "Cannot write L2CP notification:" << packet.toHex()
+                                 << session.socket->errorString();
+            dropQueuedNotifications(session);
+            setError(QLowEnergyController::NetworkError);
+            return;
+        }
+        qCDebug(QT_BT_BLUEZ) << "sent notification/indication:" << packet.toHex();
+        ++pduStats.pdusSent;
+        pduStats.bytesSent += result;
+        session.notificationQueue.dequeue();
+        ++notificationStats.sent;
+    }
+}
+
+void QLowEnergyControllerPrivateBluez::dropQueuedNotifications(ClientSession &session)
+{
+    // a dropped indication is never confirmed, so the scheduled ones would wait forever
+    notificationStats.dropped += session.notificationQueue.size()
+            + session.scheduledIndications.size();
+    session.notificationQueue.clear();
+    session.scheduledIndications.clear();
+    session.indicationInFlight = false;
+}
+
+void QLowEnergyControllerPrivateBluez::sendNextIndication(ClientSession &session)
+{
+    if (!session.scheduledIndications.isEmpty())
+        sendIndication(session, session.scheduledIndications.takeFirst());
 }
 
 static QString nameOfRemoteCentral(const QBluetoothAddress &peerAddress)
@@ -2993,7 +4015,8 @@ static QString nameOfRemoteCentral(const QBluetoothAddress &peerAddress)
 
 void QLowEnergyControllerPrivateBluez::handleConnectionRequest()
 {
-    if (state != QLowEnergyController::AdvertisingState) {
+    if (state != QLowEnergyController::AdvertisingState
+            && state != QLowEnergyController::ConnectedState) {
         qCWarning(QT_BT_BLUEZ) << "Incoming connection request in unexpected state" << state;
         return;
     }
@@ -3010,41 +4033,111 @@ void QLowEnergyControllerPrivateBluez::handleConnectionRequest()
         return;
     }
 
-    remoteDevice = QBluetoothAddress(convertAddress(clientAddr.l2_bdaddr.b));
-    remoteName = nameOfRemoteCentral(remoteDevice);
-    qCDebug(QT_BT_BLUEZ) << "GATT connection from device" << remoteDevice << remoteName;
+    acceptCentral(clientSocket, QBluetoothAddress(convertAddress(clientAddr.l2_bdaddr.b)));
+}
 
-    if (connectionHandle == 0)
-        qCWarning(QT_BT_BLUEZ) << "Received client connection, but no connection complete event";
+/*!
+    \internal
 
-    if (l2cpSocket) {
-        disconnect(l2cpSocket);
-        if (l2cpSocket->isOpen())
-            l2cpSocket->close();
+    Serves the central \a address over the connected ATT socket \a socketDescriptor.
+    Further centrals are accepted while connected, if maxCentralCount permits.
 
-        l2cpSocket->deleteLater();
-        l2cpSocket = nullptr;
+    Returns \c false and closes \a socketDescriptor if the central is refused.
+ */
+bool QLowEnergyControllerPrivateBluez::acceptCentral(int socketDescriptor,
+                                                     const QBluetoothAddress &address)
+{
+    if (state != QLowEnergyController::AdvertisingState
+            && state != QLowEnergyController::ConnectedState) {
+        qCWarning(QT_BT_BLUEZ) << "Refusing central" << address << "in state" << state;
+        close(socketDescriptor);
+        return false;
     }
-    closeServerSocket();
+    if (state == QLowEnergyController::ConnectedState && centralCount() >= maxCentralCount) {
+        qCWarning(QT_BT_BLUEZ) << "Refusing central" << address << "already serving"
+                               << centralCount() << "centrals";
+        close(socketDescriptor);
+        return false;
+    }
+
+    const auto session = std::make_shared<ClientSession>();
+    session->remoteDevice = address;
+    session->remoteName = nameOfRemoteCentral(address);
+    qCDebug(QT_BT_BLUEZ) << "GATT connection from device" << address << session->remoteName;
+
+    l2cap_conninfo connInfo;
+    socklen_t connInfoSize = sizeof connInfo;
+    if (getsockopt(socketDescriptor, SOL_L2CAP, L2CAP_CONNINFO, &connInfo, &connInfoSize) == 0)
+        session->connectionHandle = connInfo.hci_handle;
+    else
+        session->connectionHandle = connectionHandle; // of the last connection complete event
+    if (session->connectionHandle == 0)
+        qCWarning(QT_BT_BLUEZ) << "Received client connection, but no connection complete event";
 
     QBluetoothSocketPrivateBluez *rawSocketPrivate = new QBluetoothSocketPrivateBluez();
-    l2cpSocket = new QBluetoothSocket(
+    session->socket = new QBluetoothSocket(
                 rawSocketPrivate, QBluetoothServiceInfo::L2capProtocol, this);
-    connect(l2cpSocket, &QBluetoothSocket::disconnected,
-            this, &QLowEnergyControllerPrivateBluez::l2cpDisconnected);
-    connect(l2cpSocket, &QBluetoothSocket::errorOccurred, this,
-            &QLowEnergyControllerPrivateBluez::l2cpErrorChanged);
-    connect(l2cpSocket, &QIODevice::readyRead, this, &QLowEnergyControllerPrivateBluez::l2cpReadyRead);
-    l2cpSocket->d_ptr->lowEnergySocketType = addressType == QLowEnergyController::PublicAddress
+    // closeCentral() disconnects these, the locked session outlives its removal from centrals
+    const std::weak_ptr<ClientSession> weakSession = session;
+    connect(session->socket, &QBluetoothSocket::disconnected, this, [this, weakSession]() {
+        if (const std::shared_ptr<ClientSession> session = weakSession.lock())
+            closeCentral(*session);
+    });
+    connect(session->socket, &QBluetoothSocket::errorOccurred, this,
+            [this, weakSession](QBluetoothSocket::SocketError error) {
+        if (const std::shared_ptr<ClientSession> session = weakSession.lock())
+            centralErrorOccurred(*session, error);
+    });
+    connect(session->socket, &QIODevice::readyRead, this, [this, weakSession]() {
+        const std::shared_ptr<ClientSession> session = weakSession.lock();
+        if (!session || !session->socket)
+            return;
+        readIncomingPdu(session->socket, [this, &session](const AttPduView &pdu) {
+            if (dispatchIncomingPdu(*session, pdu))
+                return;
+            qCWarning(QT_BT_BLUEZ) << "Received unexpected packet from central"
+                                   << session->remoteDevice << ", disconnecting.";
+            closeCentral(*session);
+        });
+    });
+    connect(rawSocketPrivate, &QBluetoothSocketPrivateBluez::readyWrite, this,
+            [this, weakSession]() {
+        if (const std::shared_ptr<ClientSession> session = weakSession.lock())
+            sendQueuedNotifications(*session);
+    });
+    session->socket->d_ptr->lowEnergySocketType = addressType == QLowEnergyController::PublicAddress
             ? BDADDR_LE_PUBLIC : BDADDR_LE_RANDOM;
-    l2cpSocket->setSocketDescriptor(clientSocket, QBluetoothServiceInfo::L2capProtocol,
+    session->socket->setSocketDescriptor(socketDescriptor, QBluetoothServiceInfo::L2capProtocol,
             QBluetoothSocket::SocketState::ConnectedState, QIODevice::ReadWrite | QIODevice::Unbuffered);
-    restoreClientConfigurations();
-    loadSigningDataIfNecessary(RemoteSigningKey);
+
+    const bool isFirstCentral = centrals.isEmpty();
+    centrals.append(session);
+    if (isFirstCentral) {
+        remoteDevice = address;
+        remoteName = session->remoteName;
+    }
+    restoreClientConfigurations(*session);
+    loadSigningDataIfNecessary(RemoteSigningKey, address);
+
+    // serverSocketNotifier is gone if stopAdvertising() was called while connected
+    if (serverSocketNotifier && centrals.size() < maxCentralCount) {
+        // The controller stops advertising once a central connects.
+        serverSocketNotifier->setEnabled(true);
+        if (advertiser)
+            advertiser->startAdvertising();
+    } else if (maxCentralCount == 1) {
+        closeServerSocket();
+    } // else closeCentral() resumes accepting centrals
+
+    if (!isFirstCentral) {
+        qCDebug(QT_BT_BLUEZ) << "Serving" << centrals.size() << "centrals";
+        return true;
+    }
 
     Q_Q(QLowEnergyController);
     setState(QLowEnergyController::ConnectedState);
     emit q->connected();
+    return true;
 }
 
 void QLowEnergyControllerPrivateBluez::closeServerSocket()
@@ -3057,18 +4150,135 @@ void QLowEnergyControllerPrivateBluez::closeServerSocket()
     serverSocketNotifier = nullptr;
 }
 
-bool QLowEnergyControllerPrivateBluez::isBonded() const
+qsizetype QLowEnergyControllerPrivateBluez::centralCount() const
+{
+    if (role != QLowEnergyController::PeripheralRole
+            || state != QLowEnergyController::ConnectedState) {
+        return 0;
+    }
+    return centrals.size();
+}
+
+// Returns nullptr if no central is connected via connectionHandle
+QLowEnergyControllerPrivateBluez::ClientSession *
+QLowEnergyControllerPrivateBluez::centralSession(quint16 connectionHandle) const
+{
+    for (const std::shared_ptr<ClientSession> &session : centrals) {
+        if (session->connectionHandle == connectionHandle)
+            return session.get();
+    }
+    return nullptr;
+}
+
+// The central reported by the public API, see ClientSession
+const QLowEnergyControllerPrivateBluez::ClientSession *
+QLowEnergyControllerPrivateBluez::primaryCentral() const
+{
+    return centrals.isEmpty() ? nullptr : centrals.constFirst().get();
+}
+
+bool QLowEnergyControllerPrivateBluez::isPrimarySession(const ClientSession &session) const
+{
+    return role == QLowEnergyController::CentralRole || primaryCentral() == &session;
+}
+
+void QLowEnergyControllerPrivateBluez::centralErrorOccurred(ClientSession &session,
+                                                            QBluetoothSocket::SocketError error)
+{
+    if (centrals.size() == 1) {
+        l2cpErrorChanged(error);
+        return;
+    }
+    qCWarning(QT_BT_BLUEZ) << "Closing GATT connection of" << session.remoteDevice
+                           << "due to socket error" << error;
+    closeCentral(session);
+}
+
+/*!
+    \internal
+
+    Closes the connection of the central of \a session. The controller disconnects
+    if no other central is connected.
+ */
+void QLowEnergyControllerPrivateBluez::closeCentral(ClientSession &session)
+{
+    if (!session.socket)
+        return;
+    if (centrals.size() == 1) {
+        l2cpDisconnected();
+        return;
+    }
+
+    const bool wasPrimary = isPrimarySession(session);
+    storeClientConfigurations(session);
+    dropQueuedNotifications(session);
+    session.socket->disconnect(this);
+    session.socket->close();
+    session.socket->deleteLater();
+    session.socket = nullptr;
+    centrals.removeIf([&session](const std::shared_ptr<ClientSession> &central) {
+        return central.get() == &session;
+    });
+    qCDebug(QT_BT_BLUEZ) << "GATT connection of" << session.remoteDevice << "closed,"
+                         << centrals.size() << "centrals remain connected";
+
+    if (wasPrimary) {
+        const ClientSession *primary = primaryCentral();
+        qCDebug(QT_BT_BLUEZ) << "Primary central is now" << primary->remoteDevice;
+        remoteDevice = primary->remoteDevice;
+        remoteName = primary->remoteName;
+        publishClientConfigurations();
+        if (primary->mtuSize != session.mtuSize) {
+            Q_Q(QLowEnergyController);
+            emit q->mtuChanged(primary->mtuSize);
+        }
+    }
+
+    // accepting centrals was paused once maxCentralCount had been reached
+    if (serverSocketNotifier && !serverSocketNotifier->isEnabled()) {
+        serverSocketNotifier->setEnabled(true);
+        if (advertiser)
+            advertiser->startAdvertising();
+    }
+}
+
+void QLowEnergyControllerPrivateBluez::closeCentrals()
+{
+    const QList<std::shared_ptr<ClientSession>> closedCentrals = std::exchange(centrals, {});
+    for (const std::shared_ptr<ClientSession> &session : closedCentrals) {
+        storeClientConfigurations(*session);
+        dropQueuedNotifications(*session);
+        session->socket->disconnect(this);
+        session->socket->close();
+        session->socket->deleteLater();
+        session->socket = nullptr;
+    }
+}
+
+bool QLowEnergyControllerPrivateBluez::isConnectedCentral(quint64 address) const
+{
+    for (const std::shared_ptr<ClientSession> &session : centrals) {
+        if (session->remoteDevice.toUInt64() == address)
+            return true;
+    }
+    return false;
+}
+
+bool QLowEnergyControllerPrivateBluez::isBonded(const QBluetoothAddress &peer) const
 {
     // Pairing does not necessarily imply bonding, but we don't know whether the
     // bonding flag was set in the original pairing request.
-    return QBluetoothLocalDevice(localAdapter).pairingStatus(remoteDevice)
-            != QBluetoothLocalDevice::Unpaired;
+    return QtBluezBondStateCache::instance()->isBonded(localAdapter, peer);
 }
 
-QList<QLowEnergyControllerPrivateBluez::TempClientConfigurationData>
+// The CCCDs of localServices, cached until services are added or removed
+const QList<QLowEnergyControllerPrivateBluez::TempClientConfigurationData> &
 QLowEnergyControllerPrivateBluez::gatherClientConfigData()
 {
-    QList<TempClientConfigurationData> data;
+    if (clientConfigCacheValid)
+        return clientConfigCache;
+
+    clientConfigCache.clear();
     for (const auto &service : std::as_const(localServices)) {
         for (auto charIt = service->characteristicList.begin();
              charIt != service->characteristicList.end(); ++charIt) {
@@ -3077,76 +4287,92 @@ QLowEnergyControllerPrivateBluez::gatherClientConfigData()
                  descIt != charData.descriptorList.end(); ++descIt) {
                 QLowEnergyServicePrivate::DescData &descData = descIt.value();
                 if (descData.uuid == QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration) {
-                    data << TempClientConfigurationData(&descData, charData.valueHandle,
-                                                        descIt.key());
+                    clientConfigCache << TempClientConfigurationData(&descData,
+                                                                     charData.valueHandle,
+                                                                     descIt.key());
                     break;
                 }
             }
         }
     }
-    return data;
+    clientConfigCacheValid = true;
+    return clientConfigCache;
+}
+
+// Copies the CCCD values of the primary central to the local services seen by the application
+void QLowEnergyControllerPrivateBluez::publishClientConfigurations()
+{
+    const ClientSession *primary = role == QLowEnergyController::CentralRole
+            ? peerSession.get() : primaryCentral();
+    const QList<TempClientConfigurationData> &tempConfigList = gatherClientConfigData();
+    for (const auto &tempConfigData : tempConfigList) {
+        const quint16 value = primary ? primary->clientConfigs.value(tempConfigData.configHandle)
+                                      : 0;
+        QByteArray configValue(2, Qt::Uninitialized);
+        putBtData(value, configValue.data());
+        tempConfigData.descData->value = configValue;
+    }
 }
 
-void QLowEnergyControllerPrivateBluez::storeClientConfigurations()
+void QLowEnergyControllerPrivateBluez::storeClientConfigurations(const ClientSession &session)
 {
-    if (!isBonded()) {
-        clientConfigData.remove(remoteDevice.toUInt64());
+    const quint64 address = session.remoteDevice.toUInt64();
+    if (!isBonded(session.remoteDevice)) {
+        clientConfigData.remove(address);
         return;
     }
+
     QList<ClientConfigurationData> clientConfigs;
     const QList<TempClientConfigurationData> &tempConfigList = gatherClientConfigData();
     for (const auto &tempConfigData : tempConfigList) {
-        Q_ASSERT(tempConfigData.descData->value.size() == 2);
-        const quint16 value = bt_get_le16(tempConfigData.descData->value.constData());
+        const quint16 value = session.clientConfigs.value(tempConfigData.configHandle);
         if (value != 0) {
             clientConfigs << ClientConfigurationData(tempConfigData.charValueHandle,
                                                      tempConfigData.configHandle, value);
         }
     }
-    clientConfigData.insert(remoteDevice.toUInt64(), clientConfigs);
+    clientConfigData.insert(address, clientConfigs);
 }
 
-void QLowEnergyControllerPrivateBluez::restoreClientConfigurations()
+void QLowEnergyControllerPrivateBluez::restoreClientConfigurations(ClientSession &session)
 {
-    const QList<TempClientConfigurationData> &tempConfigList = gatherClientConfigData();
-    const QList<ClientConfigurationData> &restoredClientConfigs = isBonded()
-            ? clientConfigData.value(remoteDevice.toUInt64())
+    const QList<ClientConfigurationData> restoredClientConfigs = isBonded(session.remoteDevice)
+            ? clientConfigData.value(session.remoteDevice.toUInt64())
             : QList<ClientConfigurationData>();
+    session.clientConfigs.clear();
+
     QList<QLowEnergyHandle> notifications;
+    const QList<TempClientConfigurationData> &tempConfigList = gatherClientConfigData();
     for (const auto &tempConfigData : tempConfigList) {
-        bool wasRestored = false;
         for (const auto &restoredData : restoredClientConfigs) {
-            if (restoredData.charValueHandle == tempConfigData.charValueHandle) {
-                Q_ASSERT(tempConfigData.descData->value.size() == 2);
-                putBtData(restoredData.configValue, tempConfigData.descData->value.data());
-                wasRestored = true;
-                if (restoredData.charValueWasUpdated) {
-                    if (isNotificationEnabled(restoredData.configValue))
-                        notifications << restoredData.charValueHandle;
-                    else if (isIndicationEnabled(restoredData.configValue))
-                        scheduledIndications << restoredData.charValueHandle;
-                }
-                break;
+            if (restoredData.charValueHandle != tempConfigData.charValueHandle)
+                continue;
+            if (restoredData.configValue != 0)
+                session.clientConfigs.insert(tempConfigData.configHandle, restoredData.configValue);
+            if (restoredData.charValueWasUpdated) {
+                if (isNotificationEnabled(restoredData.configValue))
+                    notifications << restoredData.charValueHandle;
+                else if (isIndicationEnabled(restoredData.configValue))
+                    session.scheduledIndications << restoredData.charValueHandle;
             }
+            break;
         }
-        if (!wasRestored)
-            tempConfigData.descData->value = QByteArray(2, 0); // Default value.
-        Q_ASSERT(lastLocalHandle >= tempConfigData.configHandle);
-        Q_ASSERT(tempConfigData.configHandle > tempConfigData.charValueHandle);
-        localAttributes[tempConfigData.configHandle].value = tempConfigData.descData->value;
     }
+    if (isPrimarySession(session))
+        publishClientConfigurations();
 
     for (const QLowEnergyHandle handle : std::as_const(notifications))
-        sendNotification(handle);
-    sendNextIndication();
+        sendNotification(session, handle);
+    sendNextIndication(session);
 }
 
-void QLowEnergyControllerPrivateBluez::loadSigningDataIfNecessary(SigningKeyType keyType)
+void QLowEnergyControllerPrivateBluez::loadSigningDataIfNecessary(SigningKeyType keyType,
+                                                                  const QBluetoothAddress &peer)
 {
-    const auto signingDataIt = signingData.constFind(remoteDevice.toUInt64());
+    const auto signingDataIt = signingData.constFind(peer.toUInt64());
     if (signingDataIt != signingData.constEnd())
         return; // We are up to date for this device.
-    const QString settingsFilePath = keySettingsFilePath();
+    const QString settingsFilePath = keySettingsFilePath(peer);
     if (!QFileInfo(settingsFilePath).exists()) {
         qCDebug(QT_BT_BLUEZ) << "No settings found for peer device.";
         return;
@@ -3166,43 +4392,149 @@ void QLowEnergyControllerPrivateBluez::loadSigningDataIfNecessary(SigningKeyType
         return;
     }
     qCDebug(QT_BT_BLUEZ) << "CSRK of peer device is" << keyString;
-    const quint32 counter = settings.value(QLatin1String("Counter"), 0).toUInt();
+    const quint32 counter = signCounterStore->nextCounter(
+                settingsFilePath, signCounterKeyType(keyType),
+                settings.value(QLatin1String("Counter"), 0).toUInt());
     using namespace std;
     BluezUint128 csrk;
     memcpy(csrk.data, keyData.constData(), keyData.size());
-    signingData.insert(remoteDevice.toUInt64(), SigningData(csrk, counter - 1));
+    signingData.insert(peer.toUInt64(), SigningData(csrk, counter - 1));
 }
 
-void QLowEnergyControllerPrivateBluez::storeSignCounter(SigningKeyType keyType) const
+void QLowEnergyControllerPrivateBluez::storeSignCounter(SigningKeyType keyType,
+                                                        const QBluetoothAddress &peer) const
 {
-    const auto signingDataIt = signingData.constFind(remoteDevice.toUInt64());
+    const auto signingDataIt = signingData.constFind(peer.toUInt64());
     if (signingDataIt == signingData.constEnd())
         return;
-    const QString settingsFilePath = keySettingsFilePath();
-    if (!QFileInfo(settingsFilePath).exists())
-        return;
-    QSettings settings(settingsFilePath, QSettings::IniFormat);
-    if (!settings.isWritable())
+    // Written behind, respectively reserved in blocks for the local key
+    signCounterStore->setNextCounter(keySettingsFilePath(peer), signCounterKeyType(keyType),
+                                     signingDataIt.value().counter + 1);
+}
+
+SignCounterStore::KeyType
+QLowEnergyControllerPrivateBluez::signCounterKeyType(SigningKeyType keyType)
+{
+    return keyType == LocalSigningKey ? SignCounterStore::LocalKey : SignCounterStore::RemoteKey;
+}
+
+QString QLowEnergyControllerPrivateBluez::signingKeySettingsGroup(SigningKeyType keyType) const
+{
+    return SignCounterStore::settingsGroup(signCounterKeyType(keyType));
+}
+
+QString QLowEnergyControllerPrivateBluez::keySettingsFilePath(const QBluetoothAddress &peer) const
+{
+    return QString::fromLatin1("/var/lib/bluetooth/%1/%2/info")
+            .arg(localAdapter.toString(), peer.toString());
+}
+
+QString QLowEnergyControllerPrivateBluez::gattCacheFilePath() const
+{
+    return QFileInfo(keySettingsFilePath(remoteDevice)).absolutePath()
+            + QLatin1String("/qt_gatt_cache");
+}
+
+void QLowEnergyControllerPrivateBluez::storeServicesInGattCache()
+{
+    if (!gattCacheValid)
         return;
-    settings.beginGroup(signingKeySettingsGroup(keyType));
-    const QString counterKey = QLatin1String("Counter");
-    if (!settings.allKeys().contains(counterKey))
+
+    gattCache.services.clear();
+    for (const auto &service : std::as_const(serviceList)) {
+        GattCache::Service cached;
+        cached.uuid = service->uuid;
+        cached.startHandle = service->startHandle;
+        cached.endHandle = service->endHandle;
+        cached.type = service->type;
+        gattCache.services << cached;
+    }
+    if (!GattCache::save(gattCacheFilePath(), gattCache))
+        qCDebug(QT_BT_BLUEZ) << "Cannot store GATT cache for" << remoteDevice;
+}
+
+void QLowEnergyControllerPrivateBluez::storeServiceDetailsInGattCache(
+        const QSharedPointer<QLowEnergyServicePrivate> &service)
+{
+    if (!gattCacheValid || servicesFromGattCache.contains(service->uuid))
         return;
-    const quint32 counterValue = signingDataIt.value().counter + 1;
-    if (counterValue == settings.value(counterKey).toUInt())
+    GattCache::Service *cached = gattCache.service(service->uuid);
+    if (!cached)
         return;
-    settings.setValue(counterKey, counterValue);
+
+    cached->includedServices = service->includedServices;
+    cached->characteristics.clear();
+    QList<QLowEnergyHandle> charHandles = service->characteristicList.keys();
+    std::sort(charHandles.begin(), charHandles.end());
+    for (const QLowEnergyHandle charHandle : std::as_const(charHandles)) {
+        const QLowEnergyServicePrivate::CharData &charData =
+                service->characteristicList[charHandle];
+        GattCache::Characteristic characteristic;
+        characteristic.handle = charHandle;
+        characteristic.valueHandle = charData.valueHandle;
+        characteristic.uuid = charData.uuid;
+        characteristic.properties = charData.properties;
+        QList<QLowEnergyHandle> descHandles = charData.descriptorList.keys();
+        std::sort(descHandles.begin(), descHandles.end());
+        for (const QLowEnergyHandle descHandle : std::as_const(descHandles))
+            characteristic.descriptors << GattCache::Descriptor{
+                descHandle, charData.descriptorList[descHandle].uuid };
+        cached->characteristics << characteristic;
+    }
+    cached->hasDetails = true;
+
+    // Discovering includes may have marked other services as included ones.
+    for (GattCache::Service &other : gattCache.services) {
+        const auto it = serviceList.constFind(other.uuid);
+        if (it != serviceList.constEnd())
+            other.type = it.value()->type;
+    }
+
+    if (!GattCache::save(gattCacheFilePath(), gattCache))
+        qCDebug(QT_BT_BLUEZ) << "Cannot store GATT cache for" << remoteDevice;
 }
 
-QString QLowEnergyControllerPrivateBluez::signingKeySettingsGroup(SigningKeyType keyType) const
+/*!
+    \internal
+
+    Fills the characteristics and descriptors of \a service from the cached database.
+    Returns \c false if the cache does not know them.
+ */
+bool QLowEnergyControllerPrivateBluez::restoreServiceDetailsFromGattCache(
+        const QSharedPointer<QLowEnergyServicePrivate> &service)
 {
-    return QLatin1String(keyType == LocalSigningKey ? "LocalSignatureKey" : "RemoteSignatureKey");
+    servicesFromGattCache.remove(service->uuid);
+    if (!gattCacheValid)
+        return false;
+    const GattCache::Service *cached = gattCache.service(service->uuid);
+    if (!cached || !cached->hasDetails)
+        return false;
+
+    qCDebug(QT_BT_BLUEZ) << "Using cached characteristics for" << service->uuid;
+    service->includedServices = cached->includedServices;
+    for (const GattCache::Characteristic &characteristic : cached->characteristics) {
+        QLowEnergyServicePrivate::CharData charData;
+        charData.valueHandle = characteristic.valueHandle;
+        charData.uuid = characteristic.uuid;
+        charData.properties = characteristic.properties;
+        for (const GattCache::Descriptor &descriptor : characteristic.descriptors) {
+            QLowEnergyServicePrivate::DescData descData;
+            descData.uuid = descriptor.uuid;
+            charData.descriptorList.insert(descriptor.handle, descData);
+        }
+        service->characteristicList.insert(characteristic.handle, charData);
+    }
+    servicesFromGattCache.insert(service->uuid);
+    return true;
 }
 
-QString QLowEnergyControllerPrivateBluez::keySettingsFilePath() const
+void QLowEnergyControllerPrivateBluez::invalidateGattCache()
 {
-    return QString::fromLatin1("/var/lib/bluetooth/%1/%2/info")
-            .arg(localAdapter.toString(), remoteDevice.toString());
+    qCDebug(QT_BT_BLUEZ) << "Remote GATT database changed, dropping cache for" << remoteDevice;
+    GattCache::remove(gattCacheFilePath());
+    gattCache = GattCache::Database();
+    gattCacheValid = false;
+    servicesFromGattCache.clear();
 }
 
 static QByteArray uuidToByteArray(const QBluetoothUuid &uuid)
@@ -3325,10 +4657,35 @@ void QLowEnergyControllerPrivateBluez::addToGenericAttributeList(const QLowEnerg
     }
     serviceAttribute.groupEndHandle = currentHandle;
     localAttributes[serviceAttribute.handle] = serviceAttribute;
+    indexLocalAttributes(startHandle, currentHandle);
+    discoveryResponseCache.clear();
+    clientConfigCacheValid = false;
+}
+
+/*!
+    \internal
+
+    Adds the local attributes in the handle range [\a startHandle, \a endHandle]
+    to the type index. Attributes are added in ascending handle order; therefore
+    each per-type handle list remains sorted.
+ */
+void QLowEnergyControllerPrivateBluez::indexLocalAttributes(QLowEnergyHandle startHandle,
+                                                            QLowEnergyHandle endHandle)
+{
+    for (QLowEnergyHandle handle = startHandle; handle <= endHandle; ++handle) {
+        QList<QLowEnergyHandle> &handles = localAttributeTypeIndex[localAttributes.at(handle).type];
+        Q_ASSERT(handles.isEmpty() || handles.last() < handle);
+        handles.append(handle);
+        if (handle == endHandle) // avoid overflow at 0xffff
+            break;
+    }
 }
 
 int QLowEnergyControllerPrivateBluez::mtu() const
 {
+    // in the peripheral role each central has its own MTU, see ClientSession
+    if (const ClientSession *primary = primaryCentral())
+        return primary->mtuSize;
     return mtuSize;
 }
 
@@ -3351,12 +4708,6 @@ void QLowEnergyControllerPrivateBluez::ensureUniformUuidSizes(QList<Attribute> &
                             [](const Attribute &attr) { return getUuidSize(attr.type); });
 }
 
-void QLowEnergyControllerPrivateBluez::ensureUniformValueSizes(QList<Attribute> &attributes)
-{
-    ensureUniformAttributes(attributes,
-                            [](const Attribute &attr) { return attr.value.size(); });
-}
-
 QList<QLowEnergyControllerPrivateBluez::Attribute>
 QLowEnergyControllerPrivateBluez::getAttributes(QLowEnergyHandle startHandle,
                                                 QLowEnergyHandle endHandle,
@@ -3378,8 +4729,116 @@ QLowEnergyControllerPrivateBluez::getAttributes(QLowEnergyHandle startHandle,
     return results;
 }
 
+/*!
+    \internal
+
+    Returns the attributes of type \a type in the handle range [\a startHandle, \a endHandle]
+    which satisfy \a attributePredicate. At most \a maxCount attributes are returned.
+
+    Unlike getAttributes() this function does not visit every attribute in the range, but
+    only those of the requested type as found in localAttributeTypeIndex.
+ */
+QList<QLowEnergyControllerPrivateBluez::Attribute>
+QLowEnergyControllerPrivateBluez::getAttributesOfType(QLowEnergyHandle startHandle,
+                                                      QLowEnergyHandle endHandle,
+                                                      const QBluetoothUuid &type,
+                                                      const AttributePredicate &attributePredicate,
+                                                      qsizetype maxCount)
+{
+    QList<Attribute> results;
+    const auto indexIt = localAttributeTypeIndex.constFind(type);
+    if (indexIt == localAttributeTypeIndex.constEnd())
+        return results;
+
+    Q_ASSERT(startHandle <= endHandle); // Must have been checked before.
+    const QList<QLowEnergyHandle> &handles = indexIt.value();
+    for (auto it = std::lower_bound(handles.cbegin(), handles.cend(), startHandle);
+         it != handles.cend() && *it <= endHandle && results.size() < maxCount; ++it) {
+        const Attribute &attr = localAttributes.at(*it);
+        if (attributePredicate(attr))
+            results << attr;
+    }
+    return results;
+}
+
+/*!
+    \internal
+
+    Returns the attributes of type \a type in the handle range [\a startHandle, \a endHandle]
+    which fit into a single list response, as used by the Read By Type and Read By Group Type
+    responses.
+
+    All elements of such a response must have the same length. Therefore collection stops at
+    the first attribute whose value size differs from the one of the first match. It also
+    stops once the response cannot take any more elements. Each element consists of
+    \a elementHeaderSize bytes followed by the attribute value; the response starts with
+    \a responsePrefixSize bytes.
+ */
+QList<QLowEnergyControllerPrivateBluez::Attribute>
+QLowEnergyControllerPrivateBluez::getUniformAttributesOfType(QLowEnergyHandle startHandle,
+                                                             QLowEnergyHandle endHandle,
+                                                             const QBluetoothUuid &type,
+                                                             quint16 mtu,
+                                                             qsizetype responsePrefixSize,
+                                                             qsizetype elementHeaderSize)
+{
+    QList<Attribute> results;
+    const auto indexIt = localAttributeTypeIndex.constFind(type);
+    if (indexIt == localAttributeTypeIndex.constEnd())
+        return results;
+
+    Q_ASSERT(startHandle <= endHandle); // Must have been checked before.
+    const QList<QLowEnergyHandle> &handles = indexIt.value();
+    qsizetype valueSize = -1;
+    qsizetype maxCount = 0;
+    for (auto it = std::lower_bound(handles.cbegin(), handles.cend(), startHandle);
+         it != handles.cend() && *it <= endHandle; ++it) {
+        const Attribute &attr = localAttributes.at(*it);
+        if (valueSize == -1) {
+            valueSize = attr.value.size();
+            maxCount = (std::max)(qsizetype(1), (mtu - responsePrefixSize)
+                                                    / (elementHeaderSize + valueSize));
+        } else if (attr.value.size() != valueSize || results.size() >= maxCount) {
+            break;
+        }
+        results << attr;
+    }
+    return results;
+}
+
+// The value of attribute as seen by the client of session, see ClientSession::clientConfigs
+QByteArray QLowEnergyControllerPrivateBluez::attributeValue(const ClientSession &session,
+                                                            const Attribute &attribute)
+{
+    if (attribute.type != QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration)
+        return attribute.value;
+    QByteArray value(2, Qt::Uninitialized);
+    putBtData(session.clientConfigs.value(attribute.handle), value.data());
+    return value;
+}
+
+void QLowEnergyControllerPrivateBluez::applyClientConfigurations(const ClientSession &session,
+                                                                 QList<Attribute> &attributes)
+{
+    for (Attribute &attribute : attributes)
+        attribute.value = attributeValue(session, attribute);
+}
+
+void QLowEnergyControllerPrivateBluez::setClientConfiguration(ClientSession &session,
+                                                              QLowEnergyHandle configHandle,
+                                                              const QByteArray &value)
+{
+    const QByteArray configValue = value.leftJustified(2, '\0', true);
+    const quint16 newValue = bt_get_le16(configValue.constData());
+    if (newValue != 0)
+        session.clientConfigs.insert(configHandle, newValue);
+    else
+        session.clientConfigs.remove(configHandle);
+}
+
 QBluezConst::AttError
-QLowEnergyControllerPrivateBluez::checkPermissions(const Attribute &attr,
+QLowEnergyControllerPrivateBluez::checkPermissions(const ClientSession &session,
+                                                   const Attribute &attr,
                                                    QLowEnergyCharacteristic::PropertyType type)
 {
     const bool isReadAccess = type == QLowEnergyCharacteristic::Read;
@@ -3396,7 +4855,7 @@ QLowEnergyControllerPrivateBluez::checkPermissions(const Attribute &attr,
         // can also be used if the link is encrypted.
         const bool unsignedWriteOk = isWriteCommand
                 && (attr.properties & QLowEnergyCharacteristic::WriteSigned)
-                && securityLevel() >= BT_SECURITY_MEDIUM;
+                && securityLevel(session.socket) >= BT_SECURITY_MEDIUM;
         if (!unsignedWriteOk)
             return QBluezConst::AttError::ATT_ERROR_WRITE_NOT_PERM;
     }
@@ -3406,23 +4865,26 @@ QLowEnergyControllerPrivateBluez::checkPermissions(const Attribute &attr,
         return QBluezConst::AttError::ATT_ERROR_INSUF_AUTHORIZATION; // TODO: emit signal (and offer
                                                                      // authorization function)?
     if (constraints.testFlag(AttAccessConstraint::AttEncryptionRequired)
-        && securityLevel() < BT_SECURITY_MEDIUM)
+        && securityLevel(session.socket) < BT_SECURITY_MEDIUM)
         return QBluezConst::AttError::ATT_ERROR_INSUF_ENCRYPTION;
     if (constraints.testFlag(AttAccessConstraint::AttAuthenticationRequired)
-        && securityLevel() < BT_SECURITY_HIGH)
+        && securityLevel(session.socket) < BT_SECURITY_HIGH)
         return QBluezConst::AttError::ATT_ERROR_INSUF_AUTHENTICATION;
     if (false)
         return QBluezConst::AttError::ATT_ERROR_INSUF_ENCR_KEY_SIZE;
     return QBluezConst::AttError::ATT_ERROR_NO_ERROR;
 }
 
-QBluezConst::AttError QLowEnergyControllerPrivateBluez::checkReadPermissions(const Attribute &attr)
+QBluezConst::AttError
+QLowEnergyControllerPrivateBluez::checkReadPermissions(const ClientSession &session,
+                                                       const Attribute &attr)
 {
-    return checkPermissions(attr, QLowEnergyCharacteristic::Read);
+    return checkPermissions(session, attr, QLowEnergyCharacteristic::Read);
 }
 
 QBluezConst::AttError
-QLowEnergyControllerPrivateBluez::checkReadPermissions(QList<Attribute> &attributes)
+QLowEnergyControllerPrivateBluez::checkReadPermissions(const ClientSession &session,
+                                                       QList<Attribute> &attributes)
 {
     if (attributes.isEmpty())
         return QBluezConst::AttError::ATT_ERROR_NO_ERROR;
@@ -3432,13 +4894,13 @@ QLowEnergyControllerPrivateBluez::checkReadPermissions(QList<Attribute> &attribu
     //       then that error is returned via an error response.
     //    2) If any other element of that list would cause a permissions error, then all
     //       attributes from this one on are not part of the result set, but no error is returned.
-    const QBluezConst::AttError error = checkReadPermissions(attributes.first());
+    const QBluezConst::AttError error = checkReadPermissions(session, attributes.first());
     if (error != QBluezConst::AttError::ATT_ERROR_NO_ERROR)
         return error;
-    const auto it =
-            std::find_if(attributes.begin() + 1, attributes.end(), [this](const Attribute &attr) {
-                return checkReadPermissions(attr) != QBluezConst::AttError::ATT_ERROR_NO_ERROR;
-            });
+    const auto it = std::find_if(attributes.begin() + 1, attributes.end(),
+                                 [this, &session](const Attribute &attr) {
+        return checkReadPermissions(session, attr) != QBluezConst::AttError::ATT_ERROR_NO_ERROR;
+    });
     if (it != attributes.end())
         attributes.erase(it, attributes.end());
     return QBluezConst::AttError::ATT_ERROR_NO_ERROR;
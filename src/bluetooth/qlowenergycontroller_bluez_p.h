@@ -16,22 +16,29 @@
 //
 
 #include <qglobal.h>
+#include <QtCore/private/qglobal_p.h>
 #include <QtCore/QList>
 #include <QtCore/QQueue>
+#include <QtCore/QSet>
 #include <QtBluetooth/qbluetooth.h>
 #include <QtBluetooth/qlowenergycharacteristic.h>
 #include "qlowenergycontroller.h"
 #include "qlowenergycontrollerbase_p.h"
 #include "bluez/bluez_data_p.h"
+#include "bluez/gattcache_p.h"
+#include "bluez/signcounterstore_p.h"
 
 #include <QtBluetooth/QBluetoothSocket>
 #include <functional>
+#include <memory>
+#include <optional>
 
 QT_BEGIN_NAMESPACE
 
 class QLowEnergyServiceData;
 class QTimer;
 
+class AttPduView;
 class HciManager;
 class LeCmacCalculator;
 class QSocketNotifier;
@@ -41,7 +48,7 @@ extern void registerQLowEnergyControllerMetaType();
 
 class QLeAdvertiser;
 
-class QLowEnergyControllerPrivateBluez final: public QLowEnergyControllerPrivate
+class Q_AUTOTEST_EXPORT QLowEnergyControllerPrivateBluez final: public QLowEnergyControllerPrivate
 {
     Q_OBJECT
 public:
@@ -61,6 +68,7 @@ public:
                           const QLowEnergyAdvertisingData &advertisingData,
                           const QLowEnergyAdvertisingData &scanResponseData) override;
     void stopAdvertising() override;
+    void stopAcceptingCentrals() override;
 
     void requestConnectionUpdate(const QLowEnergyConnectionParameters &params) override;
 
@@ -85,6 +93,69 @@ public:
 
     int mtu() const override;
 
+    struct PipelineStatistics {
+        quint64 requestsSent = 0;
+        quint64 commandsSent = 0;
+        // commands which went out while a request was still awaiting its response
+        quint64 pipelinedCommands = 0;
+        // highest number of commands sent during a single outstanding request
+        quint64 maxPipelinedCommands = 0;
+    };
+    PipelineStatistics pipelineStatistics() const { return pipelineStats; }
+
+    struct DiscoveryCacheStatistics {
+        // discovery requests answered from discoveryResponseCache
+        quint64 hits = 0;
+        // discovery requests whose response had to be built from localAttributes
+        quint64 misses = 0;
+    };
+    DiscoveryCacheStatistics discoveryCacheStatistics() const { return discoveryCacheStats; }
+
+    struct NotificationStatistics {
+        quint64 sent = 0;
+        // notifications superseded by a newer value of the same attribute before being sent
+        quint64 coalesced = 0;
+        // notifications and indications discarded due to queue overflow or connection loss
+        quint64 dropped = 0;
+        // number of times the queue had to wait for the socket to become writable
+        quint64 deferred = 0;
+    };
+    NotificationStatistics notificationStatistics() const { return notificationStats; }
+
+    struct ValueReadStatistics {
+        // requests sent to read characteristic and descriptor values, by type
+        quint64 readRequests = 0;
+        quint64 readBlobRequests = 0;
+        quint64 readMultipleRequests = 0;
+        quint64 readMultipleVariableRequests = 0;
+        // values received through read multiple and read multiple variable responses
+        quint64 batchedValues = 0;
+        // batched reads which failed and were repeated as single reads
+        quint64 fallbacks = 0;
+    };
+    ValueReadStatistics valueReadStatistics() const { return valueReadStats; }
+
+    struct PduStatistics {
+        // ATT PDUs and their bytes, bytes / PDUs yields the average PDU size
+        quint64 pdusSent = 0;
+        quint64 bytesSent = 0;
+        quint64 pdusReceived = 0;
+        quint64 bytesReceived = 0;
+        // queued requests which were rebuilt for a changed ATT MTU
+        quint64 replannedRequests = 0;
+    };
+    PduStatistics pduStatistics() const { return pduStats; }
+    // ATT MTU offered by the MTU exchange, the effective mtu() never exceeds it.
+    // Changes apply to the next MTU exchange.
+    void setPreferredMtu(int mtu) override;
+    int preferredMtu() const override { return preferredMtuSize; }
+    // Number of centrals served at the same time, bounded by maxCentralCount
+    qsizetype centralCount() const;
+    bool acceptCentral(int socketDescriptor, const QBluetoothAddress &address);
+    // If enabled, a queued notification is replaced by a newer value of the same attribute.
+    void setNotificationCoalescingEnabled(bool enabled) { coalesceNotifications = enabled; }
+    bool isNotificationCoalescingEnabled() const { return coalesceNotifications; }
+
     struct Attribute {
         Attribute() : handle(0) {}
 
@@ -99,10 +170,32 @@ public:
         int maxLength;
     };
     QList<Attribute> localAttributes;
+    // Handles of localAttributes per attribute type, in ascending order
+    QHash<QBluetoothUuid, QList<QLowEnergyHandle>> localAttributeTypeIndex;
+
+    // Identifies a discovery request whose response only depends on the attribute table
+    struct DiscoveryResponseKey {
+        QBluezConst::AttCommand request;
+        QLowEnergyHandle startHandle;
+        QLowEnergyHandle endHandle;
+        QBluetoothUuid type;
+        quint16 mtu;
+
+        friend bool operator==(const DiscoveryResponseKey &a, const DiscoveryResponseKey &b)
+        {
+            return a.request == b.request && a.startHandle == b.startHandle
+                    && a.endHandle == b.endHandle && a.type == b.type && a.mtu == b.mtu;
+        }
+        friend size_t qHash(const DiscoveryResponseKey &key, size_t seed = 0) noexcept
+        {
+            return qHashMulti(seed, static_cast<quint8>(key.request), key.startHandle,
+                              key.endHandle, key.type, key.mtu);
+        }
+    };
+    // Serialized responses to discovery requests, valid until localAttributes changes
+    QHash<DiscoveryResponseKey, QByteArray> discoveryResponseCache;
 
-private:
-    quint16 connectionHandle = 0;
-    QBluetoothSocket *l2cpSocket = nullptr;
+    // Requests of the GATT client, the auto tests drive them without a remote device
     struct Request {
         QBluezConst::AttCommand command;
         QByteArray payload;
@@ -112,6 +205,35 @@ private:
         QVariant reference2;
     };
     QQueue<Request> openRequests;
+    bool requestPending;
+    // No GATT characteristic announces Read Multiple Variable support, so it is probed once
+    // per peer, see knownReadMultipleVariableSupport().
+    bool readMultipleVariableSupported = true;
+
+    void processReply(const Request &request, const AttPduView &reply);
+    void setMtuSize(quint16 newMtuSize);
+    Request prepareWriteRequest(QLowEnergyHandle handle, const QByteArray &newValue,
+                                quint16 offset);
+    QList<Request> valueReadRequests(const QSharedPointer<QLowEnergyServicePrivate> &service,
+                                     const QList<uint> &handleData, bool isLastValue) const;
+    static std::optional<bool> knownReadMultipleVariableSupport(const QBluetoothAddress &peer);
+    static void storeReadMultipleVariableSupport(const QBluetoothAddress &peer, bool supported);
+
+    // Layout of the remote GATT database as stored on disk
+    GattCache::Database gattCache;
+    // true if gattCache describes the database of the connected device
+    bool gattCacheValid = false;
+
+    void processDatabaseHash(const QByteArray &databaseHash);
+    bool restoreServiceDetailsFromGattCache(
+            const QSharedPointer<QLowEnergyServicePrivate> &service);
+
+private:
+    quint16 connectionHandle = 0;
+    QBluetoothSocket *l2cpSocket = nullptr;
+    // Reused receive buffer for incoming ATT PDUs, see l2cpReadyRead()
+    QByteArray rxPduBuffer;
+    bool rxPduBufferInUse = false;
 
     struct WriteRequest {
         WriteRequest() {}
@@ -121,11 +243,12 @@ private:
         quint16 valueOffset;
         QByteArray value;
     };
-    QList<WriteRequest> openPrepareWriteRequests;
 
-    // Invariant: !scheduledIndications.isEmpty => indicationInFlight == true
-    QList<QLowEnergyHandle> scheduledIndications;
-    bool indicationInFlight = false;
+    struct OutgoingNotification {
+        QLowEnergyHandle handle;
+        QByteArray packet;
+    };
+    bool coalesceNotifications = false;
 
     struct TempClientConfigurationData {
         TempClientConfigurationData(QLowEnergyServicePrivate::DescData *dd = nullptr,
@@ -148,6 +271,43 @@ private:
         bool charValueWasUpdated = false;
     };
     QHash<quint64, QList<ClientConfigurationData>> clientConfigData;
+    // CCCDs of localServices, see gatherClientConfigData()
+    QList<TempClientConfigurationData> clientConfigCache;
+    bool clientConfigCacheValid = false;
+
+    /*
+        Connection of a GATT client to the local services.
+
+        The ATT server handlers and the send functions operate on the session they are
+        passed, so that the peripheral role serves several centrals at once. The CCCD
+        values are kept per client in clientConfigs, the CCCDs of localAttributes only
+        hold their initial value.
+
+        The first session in centrals is the primary central, which the public API
+        reports: remoteAddress(), remoteName(), mtu(), requestConnectionUpdate() and the
+        CCCD values of the local services. Once it disconnects, the next one takes its place.
+        In the central role, peerSession serves the remote device.
+     */
+    struct ClientSession {
+        // nullptr once the connection is closed
+        QBluetoothSocket *socket = nullptr;
+        QBluetoothAddress remoteDevice;
+        QString remoteName;
+        quint16 connectionHandle = 0;
+        quint16 mtuSize = 23; // ATT_DEFAULT_LE_MTU
+        bool receivedMtuExchangeRequest = false;
+        QList<WriteRequest> openPrepareWriteRequests;
+        // Invariant: !scheduledIndications.isEmpty => indicationInFlight == true
+        QList<QLowEnergyHandle> scheduledIndications;
+        bool indicationInFlight = false;
+        // Outgoing notifications and indications, in sending order
+        QQueue<OutgoingNotification> notificationQueue;
+        // CCCD values other than zero, by CCCD handle
+        QHash<QLowEnergyHandle, quint16> clientConfigs;
+    };
+    // An ATT handler keeps its session alive in case the client disconnects meanwhile
+    QList<std::shared_ptr<ClientSession>> centrals;
+    std::shared_ptr<ClientSession> peerSession;
 
     struct SigningData {
         SigningData() = default;
@@ -159,12 +319,26 @@ private:
     };
     QHash<quint64, SigningData> signingData;
     LeCmacCalculator *cmacCalculator = nullptr;
-
-    bool requestPending;
+    // child object created by init(), flushes pending sign counters on destruction
+    SignCounterStore *signCounterStore = nullptr;
+
+    // services whose characteristics and descriptors were taken from gattCache
+    QSet<QBluetoothUuid> servicesFromGattCache;
+
+    quint64 commandsDuringPendingRequest = 0;
+    PipelineStatistics pipelineStats;
+    DiscoveryCacheStatistics discoveryCacheStats;
+    NotificationStatistics notificationStats;
+    ValueReadStatistics valueReadStats;
+    PduStatistics pduStats;
+    // cleared once the peer rejects the respective request
+    bool readMultipleSupported = true;
     quint16 mtuSize;
+    quint16 preferredMtuSize;
+    // mtuSize at the time the pending request was sent
+    quint16 requestMtuSize;
     int securityLevelValue;
     bool encryptionChangePending;
-    bool receivedMtuExchangeRequest = false;
 
     std::shared_ptr<HciManager> hciManager;
     QLeAdvertiser *advertiser = nullptr;
@@ -192,20 +366,42 @@ private:
     void handleConnectionRequest();
     void closeServerSocket();
 
-    bool isBonded() const;
-    QList<TempClientConfigurationData> gatherClientConfigData();
-    void storeClientConfigurations();
-    void restoreClientConfigurations();
+    bool isBonded(const QBluetoothAddress &peer) const;
+    const QList<TempClientConfigurationData> &gatherClientConfigData();
+    void publishClientConfigurations();
+    void storeClientConfigurations(const ClientSession &session);
+    void restoreClientConfigurations(ClientSession &session);
+
+    ClientSession *centralSession(quint16 connectionHandle) const;
+    const ClientSession *primaryCentral() const;
+    bool isPrimarySession(const ClientSession &session) const;
+    void centralErrorOccurred(ClientSession &session, QBluetoothSocket::SocketError error);
+    void closeCentral(ClientSession &session);
+    void closeCentrals();
+    bool isConnectedCentral(quint64 address) const;
 
     enum SigningKeyType { LocalSigningKey, RemoteSigningKey };
-    void loadSigningDataIfNecessary(SigningKeyType keyType);
-    void storeSignCounter(SigningKeyType keyType) const;
+    void loadSigningDataIfNecessary(SigningKeyType keyType, const QBluetoothAddress &peer);
+    void storeSignCounter(SigningKeyType keyType, const QBluetoothAddress &peer) const;
+    static SignCounterStore::KeyType signCounterKeyType(SigningKeyType keyType);
     QString signingKeySettingsGroup(SigningKeyType keyType) const;
-    QString keySettingsFilePath() const;
-
+    QString keySettingsFilePath(const QBluetoothAddress &peer) const;
+    QString gattCacheFilePath() const;
+    void readDatabaseHash();
+    void storeServicesInGattCache();
+    void storeServiceDetailsInGattCache(const QSharedPointer<QLowEnergyServicePrivate> &service);
+    void invalidateGattCache();
+
+    void readIncomingPdu(QBluetoothSocket *socket,
+                         const std::function<void(const AttPduView &)> &dispatch);
+    void dispatchIncomingPdu(const AttPduView &pdu);
+    bool dispatchIncomingPdu(ClientSession &session, const AttPduView &pdu);
     void sendPacket(const QByteArray &packet);
+    void sendPacket(ClientSession &session, const QByteArray &packet);
+    void writePacket(QBluetoothSocket *socket, const QByteArray &packet);
     void sendNextPendingRequest();
-    void processReply(const Request &request, const QByteArray &reply);
+    void replanQueuedRequests();
+    bool isFullResponse(const AttPduView &response) const;
 
     void sendReadByGroupRequest(QLowEnergyHandle start, QLowEnergyHandle end,
                                 quint16 type);
@@ -216,74 +412,112 @@ private:
                            bool readCharacteristics);
     void readServiceValuesByOffset(uint handleData, quint16 offset,
                                    bool isLastValue);
+    static Request readRequest(QLowEnergyHandle attributeHandle, uint handleData);
+    Request readBlobRequest(uint handleData, quint16 offset, bool isLastValue);
+    void processReadMultipleReply(const Request &request, const AttPduView &response,
+                                  bool isErrorResponse);
 
     void discoverServiceDescriptors(const QBluetoothUuid &serviceUuid);
     void discoverNextDescriptor(QSharedPointer<QLowEnergyServicePrivate> serviceData,
                                 const QList<QLowEnergyHandle> pendingCharHandles,
                                 QLowEnergyHandle startingHandle);
-    void processUnsolicitedReply(const QByteArray &msg);
+    void processUnsolicitedReply(const AttPduView &msg);
     void exchangeMTU();
     bool setSecurityLevel(int level);
-    int securityLevel() const;
+    static int securityLevel(const QBluetoothSocket *socket);
     void sendExecuteWriteRequest(const QLowEnergyHandle attrHandle,
                                  const QByteArray &newValue,
                                  bool isCancelation);
     void sendNextPrepareWriteRequest(const QLowEnergyHandle handle,
                                      const QByteArray &newValue, quint16 offset);
+    static Request writeRequest(QLowEnergyHandle attributeHandle, uint handleData,
+                                const QByteArray &newValue);
     bool increaseEncryptLevelfRequired(QBluezConst::AttError errorCode);
 
     void resetController();
 
     void handleAdvertisingError();
 
-    bool checkPacketSize(const QByteArray &packet, int minSize, int maxSize = -1);
-    bool checkHandle(const QByteArray &packet, QLowEnergyHandle handle);
-    bool checkHandlePair(QBluezConst::AttCommand request, QLowEnergyHandle startingHandle,
-                         QLowEnergyHandle endingHandle);
-
-    void handleExchangeMtuRequest(const QByteArray &packet);
-    void handleFindInformationRequest(const QByteArray &packet);
-    void handleFindByTypeValueRequest(const QByteArray &packet);
-    void handleReadByTypeRequest(const QByteArray &packet);
-    void handleReadRequest(const QByteArray &packet);
-    void handleReadBlobRequest(const QByteArray &packet);
-    void handleReadMultipleRequest(const QByteArray &packet);
-    void handleReadByGroupTypeRequest(const QByteArray &packet);
-    void handleWriteRequestOrCommand(const QByteArray &packet);
-    void handlePrepareWriteRequest(const QByteArray &packet);
-    void handleExecuteWriteRequest(const QByteArray &packet);
-
-    void sendErrorResponse(QBluezConst::AttCommand request, quint16 handle,
-                           QBluezConst::AttError code);
-
+    bool checkPacketSize(ClientSession &session, const AttPduView &packet, int minSize,
+                         int maxSize = -1);
+    bool checkHandle(ClientSession &session, const AttPduView &packet, QLowEnergyHandle handle);
+    bool checkHandlePair(ClientSession &session, QBluezConst::AttCommand request,
+                         QLowEnergyHandle startingHandle, QLowEnergyHandle endingHandle);
+
+    void handleExchangeMtuRequest(ClientSession &session, const AttPduView &packet);
+    void handleFindInformationRequest(ClientSession &session, const AttPduView &packet);
+    void handleFindByTypeValueRequest(ClientSession &session, const AttPduView &packet);
+    void handleReadByTypeRequest(ClientSession &session, const AttPduView &packet);
+    void handleReadRequest(ClientSession &session, const AttPduView &packet);
+    void handleReadBlobRequest(ClientSession &session, const AttPduView &packet);
+    void handleReadMultipleRequest(ClientSession &session, const AttPduView &packet);
+    void handleReadMultipleVariableRequest(ClientSession &session, const AttPduView &packet);
+    void handleReadByGroupTypeRequest(ClientSession &session, const AttPduView &packet);
+    void handleWriteRequestOrCommand(ClientSession &session, const AttPduView &packet);
+    void handlePrepareWriteRequest(ClientSession &session, const AttPduView &packet);
+    void handleExecuteWriteRequest(ClientSession &session, const AttPduView &packet);
+
+    void sendErrorResponse(ClientSession &session, QBluezConst::AttCommand request,
+                           quint16 handle, QBluezConst::AttError code);
+
+    static QByteArray errorResponse(QBluezConst::AttCommand request, quint16 handle,
+                                    QBluezConst::AttError code);
     using ElemWriter = std::function<void(const Attribute &, char *&)>;
-    void sendListResponse(const QByteArray &packetStart, qsizetype elemSize,
-                          const QList<Attribute> &attributes, const ElemWriter &elemWriter);
-
-    void sendNotification(QLowEnergyHandle handle);
-    void sendIndication(QLowEnergyHandle handle);
-    void sendNotificationOrIndication(QBluezConst::AttCommand opCode, QLowEnergyHandle handle);
-    void sendNextIndication();
+    void sendListResponse(ClientSession &session, const QByteArray &packetStart,
+                          qsizetype elemSize, const QList<Attribute> &attributes,
+                          const ElemWriter &elemWriter);
+    static QByteArray listResponse(const ClientSession &session, const QByteArray &packetStart,
+                                   qsizetype elemSize, const QList<Attribute> &attributes,
+                                   const ElemWriter &elemWriter);
+    bool sendCachedDiscoveryResponse(ClientSession &session, const DiscoveryResponseKey &key);
+    void sendDiscoveryResponse(ClientSession &session, const DiscoveryResponseKey &key,
+                               const QByteArray &response);
+
+    void sendNotification(ClientSession &session, QLowEnergyHandle handle);
+    void sendIndication(ClientSession &session, QLowEnergyHandle handle);
+    void sendNotificationOrIndication(ClientSession &session, QBluezConst::AttCommand opCode,
+                                      QLowEnergyHandle handle);
+    void sendQueuedNotifications(ClientSession &session);
+    void sendNextIndication(ClientSession &session);
+    void dropQueuedNotifications(ClientSession &session);
 
     void ensureUniformAttributes(QList<Attribute> &attributes,
                                  const std::function<int(const Attribute &)> &getSize);
     void ensureUniformUuidSizes(QList<Attribute> &attributes);
-    void ensureUniformValueSizes(QList<Attribute> &attributes);
 
     using AttributePredicate = std::function<bool(const Attribute &)>;
     QList<Attribute> getAttributes(
             QLowEnergyHandle startHandle, QLowEnergyHandle endHandle,
             const AttributePredicate &attributePredicate = [](const Attribute &) { return true; });
-
-    QBluezConst::AttError checkPermissions(const Attribute &attr,
+    QList<Attribute> getAttributesOfType(QLowEnergyHandle startHandle, QLowEnergyHandle endHandle,
+                                         const QBluetoothUuid &type,
+                                         const AttributePredicate &attributePredicate,
+                                         qsizetype maxCount);
+    QList<Attribute> getUniformAttributesOfType(QLowEnergyHandle startHandle,
+                                                QLowEnergyHandle endHandle,
+                                                const QBluetoothUuid &type,
+                                                quint16 mtu,
+                                                qsizetype responsePrefixSize,
+                                                qsizetype elementHeaderSize);
+    static QByteArray attributeValue(const ClientSession &session, const Attribute &attribute);
+    static void applyClientConfigurations(const ClientSession &session,
+                                          QList<Attribute> &attributes);
+    static void setClientConfiguration(ClientSession &session, QLowEnergyHandle configHandle,
+                                       const QByteArray &value);
+    void indexLocalAttributes(QLowEnergyHandle startHandle, QLowEnergyHandle endHandle);
+
+    QBluezConst::AttError checkPermissions(const ClientSession &session, const Attribute &attr,
                                            QLowEnergyCharacteristic::PropertyType type);
-    QBluezConst::AttError checkReadPermissions(const Attribute &attr);
-    QBluezConst::AttError checkReadPermissions(QList<Attribute> &attributes);
+    QBluezConst::AttError checkReadPermissions(const ClientSession &session,
+                                               const Attribute &attr);
+    QBluezConst::AttError checkReadPermissions(const ClientSession &session,
+                                               QList<Attribute> &attributes);
 
     bool verifyMac(const QByteArray &message, BluezUint128 csrk, quint32 signCounter,
                    quint64 expectedMac);
 
     void updateLocalAttributeValue(
+            ClientSession &session,
             QLowEnergyHandle handle,
             const QByteArray &value,
             QLowEnergyCharacteristic &characteristic,
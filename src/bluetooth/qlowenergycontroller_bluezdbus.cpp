@@ -5,7 +5,6 @@
 #include "bluez/adapter1_bluez5_p.h"
 #include "bluez/bluez5_helper_p.h"
 #include "bluez/device1_bluez5_p.h"
-#include "bluez/gattservice1_p.h"
 #include "bluez/gattchar1_p.h"
 #include "bluez/gattdesc1_p.h"
 #include "bluez/battery1_p.h"
@@ -234,6 +233,10 @@ void QLowEnergyControllerPrivateBluezDBus::interfacesRemoved(const QDBusObjectPa
 
 void QLowEnergyControllerPrivateBluezDBus::resetController()
 {
+    // cancels a pending service discovery
+    delete serviceDiscoveryWatcher;
+    serviceDiscoveryWatcher = nullptr;
+
     if (managerBluez) {
         delete managerBluez;
         managerBluez = nullptr;
@@ -430,8 +433,22 @@ void QLowEnergyControllerPrivateBluezDBus::disconnectFromDevice()
 
 void QLowEnergyControllerPrivateBluezDBus::discoverServices()
 {
-    QDBusPendingReply<ManagedObjectList> reply = managerBluez->GetManagedObjects();
-    reply.waitForFinished();
+    // The object tree can be large and many controllers may discover at the same
+    // time, do not block the event loop while bluetoothd assembles the reply
+    delete serviceDiscoveryWatcher;
+    serviceDiscoveryWatcher = new QDBusPendingCallWatcher(managerBluez->GetManagedObjects(), this);
+    connect(serviceDiscoveryWatcher, &QDBusPendingCallWatcher::finished,
+            this, &QLowEnergyControllerPrivateBluezDBus::onServiceDiscoveryFinished);
+}
+
+void QLowEnergyControllerPrivateBluezDBus::onServiceDiscoveryFinished(
+        QDBusPendingCallWatcher *call)
+{
+    Q_ASSERT(call == serviceDiscoveryWatcher);
+    serviceDiscoveryWatcher = nullptr;
+    call->deleteLater();
+
+    const QDBusPendingReply<ManagedObjectList> reply = *call;
     if (reply.isError()) {
         qCWarning(QT_BT_BLUEZ) << "Cannot discover services";
         setError(QLowEnergyController::UnknownError);
@@ -441,18 +458,18 @@ void QLowEnergyControllerPrivateBluezDBus::discoverServices()
 
     Q_Q(QLowEnergyController);
 
-    auto setupServicePrivate = [&, q](
-            QLowEnergyService::ServiceType type, const QBluetoothUuid &uuid,
-            const QString &path, const bool battery1Interface = false){
+    const QList<DiscoveredService> services =
+            servicesFromManagedObjects(reply.value(), device->path());
+    for (const DiscoveredService &service : services) {
         QSharedPointer<QLowEnergyServicePrivate> priv = QSharedPointer<QLowEnergyServicePrivate>::create();
-        priv->uuid = uuid;
-        priv->type = type; // we make a guess we cannot validate
+        priv->uuid = service.uuid;
+        priv->type = service.type; // we make a guess we cannot validate
         priv->setController(this);
 
         GattService serviceContainer;
-        serviceContainer.servicePath = path;
+        serviceContainer.servicePath = service.path;
 
-        if (battery1Interface) {
+        if (service.hasBatteryService) {
             qCDebug(QT_BT_BLUEZ) << "Using Battery1 interface to emulate generic interface";
             serviceContainer.hasBatteryService = true;
         }
@@ -461,10 +478,18 @@ void QLowEnergyControllerPrivateBluezDBus::discoverServices()
         dbusServices.insert(priv->uuid, serviceContainer);
 
         emit q->serviceDiscovered(priv->uuid);
-    };
+    }
 
-    const ManagedObjectList managedObjectList = reply.value();
-    const QString servicePathPrefix = device->path().append(QStringLiteral("/service"));
+    setState(QLowEnergyController::DiscoveredState);
+    emit q->discoveryFinished();
+}
+
+QList<QLowEnergyControllerPrivateBluezDBus::DiscoveredService>
+QLowEnergyControllerPrivateBluezDBus::servicesFromManagedObjects(
+        const ManagedObjectList &managedObjectList, const QString &devicePath)
+{
+    QList<DiscoveredService> services;
+    const QString servicePathPrefix = devicePath + QStringLiteral("/service");
 
     // The Bluez battery service (0x180f) support has evolved over time and needs additional logic:
     //
@@ -488,10 +513,10 @@ void QLowEnergyControllerPrivateBluezDBus::discoverServices()
     for (ManagedObjectList::const_iterator it = managedObjectList.constBegin(); it != managedObjectList.constEnd(); ++it) {
         const InterfaceList &ifaceList = it.value();
 
-        if (!it.key().path().startsWith(device->path()))
+        if (!it.key().path().startsWith(devicePath))
             continue;
 
-        if (it.key().path() == device->path())  {
+        if (it.key().path() == devicePath)  {
             // See if the battery service is available or is assumed to be available later
             for (InterfaceList::const_iterator battIter = ifaceList.constBegin(); battIter != ifaceList.constEnd(); ++battIter) {
                 const QString &iface = battIter.key();
@@ -517,34 +542,32 @@ void QLowEnergyControllerPrivateBluezDBus::discoverServices()
         if (!it.key().path().startsWith(servicePathPrefix))
             continue;
 
-        for (InterfaceList::const_iterator jt = ifaceList.constBegin(); jt != ifaceList.constEnd(); ++jt) {
-            const QString &iface = jt.key();
+        const auto serviceIface = ifaceList.constFind(QStringLiteral("org.bluez.GattService1"));
+        if (serviceIface == ifaceList.constEnd())
+            continue;
 
-            if (iface == QStringLiteral("org.bluez.GattService1")) {
-                QScopedPointer<OrgBluezGattService1Interface> service(new OrgBluezGattService1Interface(
-                                    QStringLiteral("org.bluez"),it.key().path(),
-                                    QDBusConnection::systemBus(), this));
-                if (QBluetoothUuid(service->uUID()) ==
-                        QBluetoothUuid::ServiceClassUuid::BatteryService) {
-                    qCDebug(QT_BT_BLUEZ) << "Using battery service via GattService1 interface";
-                    gattBatteryService = true;
-                }
-                setupServicePrivate(service->primary()
-                                    ? QLowEnergyService::PrimaryService
-                                    : QLowEnergyService::IncludedService,
-                                    QBluetoothUuid(service->uUID()), it.key().path());
-            }
+        DiscoveredService service;
+        service.uuid = QBluetoothUuid(serviceIface->value(QStringLiteral("UUID")).toString());
+        service.path = it.key().path();
+        service.type = serviceIface->value(QStringLiteral("Primary")).toBool()
+                ? QLowEnergyService::PrimaryService
+                : QLowEnergyService::IncludedService;
+        if (service.uuid == QBluetoothUuid::ServiceClassUuid::BatteryService) {
+            qCDebug(QT_BT_BLUEZ) << "Using battery service via GattService1 interface";
+            gattBatteryService = true;
         }
+        services.append(service);
     }
 
     if (!gattBatteryService && !batteryServicePath.isEmpty()) {
-        setupServicePrivate(QLowEnergyService::PrimaryService,
-                            QBluetoothUuid::ServiceClassUuid::BatteryService,
-                            batteryServicePath, true);
+        DiscoveredService service;
+        service.uuid = QBluetoothUuid::ServiceClassUuid::BatteryService;
+        service.path = batteryServicePath;
+        service.hasBatteryService = true;
+        services.append(service);
     }
 
-    setState(QLowEnergyController::DiscoveredState);
-    emit q->discoveryFinished();
+    return services;
 }
 
 void QLowEnergyControllerPrivateBluezDBus::discoverBatteryServiceDetails(
@@ -628,6 +651,8 @@ void QLowEnergyControllerPrivateBluezDBus::discoverServiceDetails(
 
     GattService &dbusData = dbusServices[service];
     dbusData.characteristics.clear();
+    dbusData.charProxies.clear();
+    dbusData.descProxies.clear();
 
     if (dbusData.hasBatteryService) {
         qCDebug(QT_BT_BLUEZ) << "Triggering Battery1 service discovery on " << dbusData.servicePath;
@@ -715,6 +740,7 @@ void QLowEnergyControllerPrivateBluezDBus::discoverServiceDetails(
         }
 
         charData.uuid = QBluetoothUuid(dbusChar.characteristic->uUID());
+        dbusData.charProxies.insert(indexHandle, dbusChar.characteristic);
 
         // schedule read for initial char value
         if (mode == QLowEnergyService::FullDiscovery
@@ -732,6 +758,7 @@ void QLowEnergyControllerPrivateBluezDBus::discoverServiceDetails(
             QLowEnergyServicePrivate::DescData descData;
             descData.uuid = QBluetoothUuid(descEntry->uUID());
             charData.descriptorList.insert(descriptorHandle, descData);
+            dbusData.descProxies.insert(descriptorHandle, descEntry);
 
 
             // every ClientCharacteristicConfiguration needs to track property changes
@@ -1015,27 +1042,17 @@ void QLowEnergyControllerPrivateBluezDBus::scheduleNextJob()
             return;
         }
 
-        const QLowEnergyServicePrivate::CharData &charData =
-                            service->characteristicList.value(nextJob.handle);
-        bool foundChar = false;
-        for (const auto &gattChar : std::as_const(dbusServiceData.characteristics)) {
-            if (charData.uuid != QBluetoothUuid(gattChar.characteristic->uUID()))
-                continue;
-
-            QDBusPendingReply<QByteArray> reply = gattChar.characteristic->ReadValue(QVariantMap());
-            QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
-            connect(watcher, &QDBusPendingCallWatcher::finished,
-                    this, &QLowEnergyControllerPrivateBluezDBus::onCharReadFinished);
-
-            foundChar = true;
-            break;
-        }
-
-        if (!foundChar) {
+        const auto gattChar = dbusServiceData.charProxies.value(nextJob.handle);
+        if (gattChar.isNull()) {
             qCWarning(QT_BT_BLUEZ) << "Cannot find char for reading. Skipping.";
             prepareNextJob();
             return;
         }
+
+        QDBusPendingReply<QByteArray> reply = gattChar->ReadValue(QVariantMap());
+        QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
+        connect(watcher, &QDBusPendingCallWatcher::finished,
+                this, &QLowEnergyControllerPrivateBluezDBus::onCharReadFinished);
     } else if (nextJob.flags.testFlag(GattJob::CharWrite)) {
         // characteristic writing ***************************************
         if (!service->characteristicList.contains(nextJob.handle)) {
@@ -1044,32 +1061,22 @@ void QLowEnergyControllerPrivateBluezDBus::scheduleNextJob()
             return;
         }
 
-        const QLowEnergyServicePrivate::CharData &charData =
-                            service->characteristicList.value(nextJob.handle);
-        bool foundChar = false;
-        for (const auto &gattChar : std::as_const(dbusServiceData.characteristics)) {
-            if (charData.uuid != QBluetoothUuid(gattChar.characteristic->uUID()))
-                continue;
-
-            QVariantMap options;
-            // The "type" option only works with BlueZ >= 5.50, older versions always write with response
-            options[QStringLiteral("type")] = nextJob.writeMode == QLowEnergyService::WriteWithoutResponse ?
-                QStringLiteral("command") : QStringLiteral("request");
-            QDBusPendingReply<> reply = gattChar.characteristic->WriteValue(nextJob.value, options);
-
-            QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
-            connect(watcher, &QDBusPendingCallWatcher::finished,
-                    this, &QLowEnergyControllerPrivateBluezDBus::onCharWriteFinished);
-
-            foundChar = true;
-            break;
-        }
-
-        if (!foundChar) {
+        const auto gattChar = dbusServiceData.charProxies.value(nextJob.handle);
+        if (gattChar.isNull()) {
             qCWarning(QT_BT_BLUEZ) << "Cannot find char for writing. Skipping.";
             prepareNextJob();
             return;
         }
+
+        QVariantMap options;
+        // The "type" option only works with BlueZ >= 5.50, older versions always write with response
+        options[QStringLiteral("type")] = nextJob.writeMode == QLowEnergyService::WriteWithoutResponse ?
+            QStringLiteral("command") : QStringLiteral("request");
+        QDBusPendingReply<> reply = gattChar->WriteValue(nextJob.value, options);
+
+        QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
+        connect(watcher, &QDBusPendingCallWatcher::finished,
+                this, &QLowEnergyControllerPrivateBluezDBus::onCharWriteFinished);
     } else if (nextJob.flags.testFlag(GattJob::DescRead)) {
         // descriptor reading ***************************************
         QLowEnergyCharacteristic ch = characteristicForHandle(nextJob.handle);
@@ -1087,33 +1094,17 @@ void QLowEnergyControllerPrivateBluezDBus::scheduleNextJob()
             return;
         }
 
-        const QBluetoothUuid descUuid = charData.descriptorList[nextJob.handle].uuid;
-        bool foundDesc = false;
-        for (const auto &gattChar : std::as_const(dbusServiceData.characteristics)) {
-            if (charData.uuid != QBluetoothUuid(gattChar.characteristic->uUID()))
-                continue;
-
-            for (const auto &gattDesc : std::as_const(gattChar.descriptors)) {
-                if (descUuid != QBluetoothUuid(gattDesc->uUID()))
-                    continue;
-
-                QDBusPendingReply<QByteArray> reply = gattDesc->ReadValue(QVariantMap());
-                QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
-                connect(watcher, &QDBusPendingCallWatcher::finished,
-                        this, &QLowEnergyControllerPrivateBluezDBus::onDescReadFinished);
-                foundDesc = true;
-                break;
-            }
-
-            if (foundDesc)
-                break;
-        }
-
-        if (!foundDesc) {
+        const auto gattDesc = dbusServiceData.descProxies.value(nextJob.handle);
+        if (gattDesc.isNull()) {
             qCWarning(QT_BT_BLUEZ) << "Cannot find descriptor for reading. Skipping.";
             prepareNextJob();
             return;
         }
+
+        QDBusPendingReply<QByteArray> reply = gattDesc->ReadValue(QVariantMap());
+        QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
+        connect(watcher, &QDBusPendingCallWatcher::finished,
+                this, &QLowEnergyControllerPrivateBluezDBus::onDescReadFinished);
     } else if (nextJob.flags.testFlag(GattJob::DescWrite)) {
         // descriptor writing ***************************************
         const QLowEnergyCharacteristic ch = characteristicForHandle(nextJob.handle);
@@ -1132,51 +1123,35 @@ void QLowEnergyControllerPrivateBluezDBus::scheduleNextJob()
         }
 
         const QBluetoothUuid descUuid = charData.descriptorList[nextJob.handle].uuid;
-        bool foundDesc = false;
-        for (const auto &gattChar : std::as_const(dbusServiceData.characteristics)) {
-            if (charData.uuid != QBluetoothUuid(gattChar.characteristic->uUID()))
-                continue;
-
-            for (const auto &gattDesc : std::as_const(gattChar.descriptors)) {
-                if (descUuid != QBluetoothUuid(gattDesc->uUID()))
-                    continue;
-
-                //notifications enabled via characteristics Start/StopNotify() functions
-                //otherwise regular WriteValue() calls on descriptor interface
-                if (descUuid == QBluetoothUuid(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration)) {
-                    const QByteArray value = nextJob.value;
-
-                    QDBusPendingReply<> reply;
-                    qCDebug(QT_BT_BLUEZ) << "Init CCC change to" << value.toHex()
-                                         << charData.uuid << service->uuid;
-                    if (value == QByteArray::fromHex("0100") || value == QByteArray::fromHex("0200"))
-                        reply = gattChar.characteristic->StartNotify();
-                    else
-                        reply = gattChar.characteristic->StopNotify();
-                    QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
-                    connect(watcher, &QDBusPendingCallWatcher::finished,
-                            this, &QLowEnergyControllerPrivateBluezDBus::onDescWriteFinished);
-                } else {
-                    QDBusPendingReply<> reply = gattDesc->WriteValue(nextJob.value, QVariantMap());
-                    QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
-                    connect(watcher, &QDBusPendingCallWatcher::finished,
-                            this, &QLowEnergyControllerPrivateBluezDBus::onDescWriteFinished);
-
-                }
-
-                foundDesc = true;
-                break;
-            }
-
-            if (foundDesc)
-                break;
-        }
-
-        if (!foundDesc) {
+        const auto gattChar = dbusServiceData.charProxies.value(ch.attributeHandle());
+        const auto gattDesc = dbusServiceData.descProxies.value(nextJob.handle);
+        if (gattChar.isNull() || gattDesc.isNull()) {
             qCWarning(QT_BT_BLUEZ) << "Cannot find descriptor for writing. Skipping.";
             prepareNextJob();
             return;
         }
+
+        //notifications enabled via characteristics Start/StopNotify() functions
+        //otherwise regular WriteValue() calls on descriptor interface
+        if (descUuid == QBluetoothUuid(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration)) {
+            const QByteArray value = nextJob.value;
+
+            QDBusPendingReply<> reply;
+            qCDebug(QT_BT_BLUEZ) << "Init CCC change to" << value.toHex()
+                                 << charData.uuid << service->uuid;
+            if (value == QByteArray::fromHex("0100") || value == QByteArray::fromHex("0200"))
+                reply = gattChar->StartNotify();
+            else
+                reply = gattChar->StopNotify();
+            QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
+            connect(watcher, &QDBusPendingCallWatcher::finished,
+                    this, &QLowEnergyControllerPrivateBluezDBus::onDescWriteFinished);
+        } else {
+            QDBusPendingReply<> reply = gattDesc->WriteValue(nextJob.value, QVariantMap());
+            QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(reply, this);
+            connect(watcher, &QDBusPendingCallWatcher::finished,
+                    this, &QLowEnergyControllerPrivateBluezDBus::onDescWriteFinished);
+        }
     } else {
         qCWarning(QT_BT_BLUEZ) << "Unknown gatt job type. Skipping.";
         prepareNextJob();
@@ -19,15 +19,16 @@
 #include "qlowenergycontroller.h"
 #include "qlowenergycontrollerbase_p.h"
 #include "qleadvertiser_bluezdbus_p.h"
+#include "bluez/bluez5_helper_p.h"
 
 #include <QtDBus/QDBusObjectPath>
+#include <QtCore/private/qglobal_p.h>
 
 class OrgBluezAdapter1Interface;
 class OrgBluezBattery1Interface;
 class OrgBluezDevice1Interface;
 class OrgBluezGattCharacteristic1Interface;
 class OrgBluezGattDescriptor1Interface;
-class OrgBluezGattService1Interface;
 class OrgFreedesktopDBusObjectManagerInterface;
 class OrgFreedesktopDBusPropertiesInterface;
 
@@ -37,7 +38,8 @@ class QtBluezPeripheralApplication;
 class QtBluezPeripheralConnectionManager;
 class QDBusPendingCallWatcher;
 
-class QLowEnergyControllerPrivateBluezDBus final : public QLowEnergyControllerPrivate
+class Q_AUTOTEST_EXPORT QLowEnergyControllerPrivateBluezDBus final
+        : public QLowEnergyControllerPrivate
 {
     Q_OBJECT
 public:
@@ -85,6 +87,19 @@ public:
 
     int mtu() const override;
 
+    struct DiscoveredService
+    {
+        QBluetoothUuid uuid;
+        QString path;
+        QLowEnergyService::ServiceType type = QLowEnergyService::PrimaryService;
+        // the service has to be emulated via the org.bluez.Battery1 interface
+        bool hasBatteryService = false;
+    };
+    // Extracts the services of devicePath from an org.bluez object tree. Only the
+    // properties contained in the tree are used, no further D-Bus calls are made.
+    static QList<DiscoveredService> servicesFromManagedObjects(
+            const ManagedObjectList &managedObjectList, const QString &devicePath);
+
 private:
     void connectToDeviceHelper();
     void resetController();
@@ -99,6 +114,7 @@ private slots:
                                     const QStringList &invalidatedProperties);
     void interfacesRemoved(const QDBusObjectPath &objectPath, const QStringList &interfaces);
 
+    void onServiceDiscoveryFinished(QDBusPendingCallWatcher *call);
     void onCharReadFinished(QDBusPendingCallWatcher *call);
     void onDescReadFinished(QDBusPendingCallWatcher *call);
     void onCharWriteFinished(QDBusPendingCallWatcher *call);
@@ -109,6 +125,7 @@ private:
     OrgBluezDevice1Interface* device{};
     OrgFreedesktopDBusObjectManagerInterface* managerBluez{};
     OrgFreedesktopDBusPropertiesInterface* deviceMonitor{};
+    QDBusPendingCallWatcher *serviceDiscoveryWatcher{};
     QString adapterPathWithPeripheralSupport;
 
     int remoteMtu{-1};
@@ -141,6 +158,9 @@ private:
     {
         QString servicePath;
         QList<GattCharacteristic> characteristics;
+        // proxies indexed by the handles assigned during service detail discovery
+        QHash<QLowEnergyHandle, QSharedPointer<OrgBluezGattCharacteristic1Interface>> charProxies;
+        QHash<QLowEnergyHandle, QSharedPointer<OrgBluezGattDescriptor1Interface>> descProxies;
 
         bool hasBatteryService = false;
         QSharedPointer<OrgBluezBattery1Interface> batteryInterface;
@@ -304,6 +304,23 @@ void QLowEnergyControllerPrivate::readRssi()
     setError(QLowEnergyController::RssiReadError);
 }
 
+void QLowEnergyControllerPrivate::setPreferredMtu(int mtu)
+{
+    // the platform negotiates the MTU itself
+    qCDebug(QT_BT) << "Ignoring preferred MTU" << mtu;
+}
+
+int QLowEnergyControllerPrivate::preferredMtu() const
+{
+    return -1;
+}
+
+void QLowEnergyControllerPrivate::stopAcceptingCentrals()
+{
+    // the backend does not advertise while connected
+    qCDebug(QT_BT) << "stopAdvertising called in state" << state;
+}
+
 QT_END_NAMESPACE
 
 #include "moc_qlowenergycontrollerbase_p.cpp"
@@ -79,11 +79,18 @@ public:
                         QLowEnergyHandle startHandle) = 0;
 
     virtual int mtu() const = 0;
+    // ATT MTU offered by the MTU exchange, -1 if the platform negotiates it
+    virtual void setPreferredMtu(int mtu);
+    virtual int preferredMtu() const;
     virtual void readRssi();
+    // stopAdvertising() in the ConnectedState of the peripheral role
+    virtual void stopAcceptingCentrals();
 
     virtual QLowEnergyService *addServiceHelper(
                         const QLowEnergyServiceData &service);
 
+    static QLowEnergyControllerPrivate *get(QLowEnergyController *q) { return q->d_func(); }
+
     // common backend methods
     bool isValidLocalAdapter();
     void setError(QLowEnergyController::Error newError);
@@ -92,6 +99,8 @@ public:
     // public variables
     QLowEnergyController::Role role;
     QLowEnergyController::RemoteAddressType addressType;
+    // centrals served at the same time in the peripheral role
+    int maxCentralCount = 1;
 
     // list of all found service uuids on remote device
     ServiceDataMap serviceList;
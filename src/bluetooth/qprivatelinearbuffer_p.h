@@ -35,6 +35,11 @@ public:
     bool isEmpty() const {
         return len == 0;
     }
+    // start of the unread data, valid until the next modification of the buffer
+    const char *readPointer() const
+    {
+        return first;
+    }
     void skip(qsizetype n)
     {
         if (n >= len) {
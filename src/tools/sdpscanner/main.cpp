@@ -4,13 +4,20 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QDebug>
 #include <QtCore/QUrl>
+#include <QtCore/qendian.h>
 #include <stdio.h>
+#include <functional>
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/sdp.h>
 #include <bluetooth/sdp_lib.h>
 
 #include <cstdio>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
 
 #define RETURN_SUCCESS      0
 #define RETURN_USAGE        1
@@ -20,10 +27,13 @@
 void usage()
 {
     fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "\tsdpscanner <remote bdaddr> <local bdaddr> [Options] ({uuids})\n\n");
+    fprintf(stderr, "\tsdpscanner <remote bdaddr> <local bdaddr> [Options] ({uuids})\n");
+    fprintf(stderr, "\tsdpscanner -w\n\n");
     fprintf(stderr, "Performs an SDP scan on remote device, using the SDP server\n"
-                    "represented by the local Bluetooth device.\n\n"
+                    "represented by the local Bluetooth device.\n"
+                    "With -w scan jobs are read from stdin until it is closed.\n\n"
                     "Options:\n"
+                    "   -b                  Write scan results as binary record stream\n"
                     "   -p                  Show scan results in human-readable form\n"
                     "   -u [list of uuids]  List of uuids which should be scanned for.\n"
                     "                       Each uuid must be enclosed in {}.\n"
@@ -232,106 +242,291 @@ QByteArray parseSdpRecord(sdp_record_t *record)
 }
 
 
-int main(int argc, char **argv)
+/*
+    Binary record stream
+
+    Every record is written as soon as it was received. It consists of the
+    record size (quint32) followed by its attributes. Each attribute is written
+    as attribute id (quint16) followed by its value. A value starts with one of
+    the type tags below. Integers and UUIDs follow in big endian byte order,
+    text and url strings are prefixed with their size (quint32), sequences and
+    alternates with the number of contained values (quint32).
+
+    The tags must match the decoder in QBluetoothServiceDiscoveryAgentPrivate.
+ */
+enum BinaryValueType : quint8 {
+    BinaryNil = 0x00,
+    BinaryUInt8 = 0x01,
+    BinaryUInt16 = 0x02,
+    BinaryUInt32 = 0x03,
+    BinaryUInt64 = 0x04,
+    BinaryUInt128 = 0x05,
+    BinaryInt8 = 0x06,
+    BinaryInt16 = 0x07,
+    BinaryInt32 = 0x08,
+    BinaryInt64 = 0x09,
+    BinaryInt128 = 0x0a,
+    BinaryUuid16 = 0x0b,
+    BinaryUuid32 = 0x0c,
+    BinaryUuid128 = 0x0d,
+    BinaryText = 0x0e,
+    BinaryUrl = 0x0f,
+    BinaryBool = 0x10,
+    BinarySequence = 0x11,
+    BinaryAlternate = 0x12
+};
+
+template <typename T>
+static void appendBigEndian(QByteArray &output, T value)
 {
-    if (argc < 3) {
-        usage();
-        return RETURN_USAGE;
-    }
+    const T bigEndian = qToBigEndian(value);
+    output.append(reinterpret_cast<const char *>(&bigEndian), sizeof(T));
+}
 
-    fprintf(stderr, "SDP for %s %s\n", argv[1], argv[2]);
+static void appendBinaryBytes(QByteArray &output, BinaryValueType type, const QByteArray &bytes)
+{
+    output.append(char(type));
+    appendBigEndian<quint32>(output, bytes.size());
+    output.append(bytes);
+}
 
-    bdaddr_t remote;
-    bdaddr_t local;
-    int result = str2ba(argv[1], &remote);
-    if (result < 0) {
-        fprintf(stderr, "Invalid remote address: %s\n", argv[1]);
-        return RETURN_INVALPARAM;
+static void appendBinaryValue(sdp_data_t *data, QByteArray &output)
+{
+    switch (data->dtd) {
+    case SDP_UINT8:
+        output.append(char(BinaryUInt8));
+        output.append(char(data->val.uint8));
+        break;
+    case SDP_UINT16:
+        output.append(char(BinaryUInt16));
+        appendBigEndian<quint16>(output, data->val.uint16);
+        break;
+    case SDP_UINT32:
+        output.append(char(BinaryUInt32));
+        appendBigEndian<quint32>(output, data->val.uint32);
+        break;
+    case SDP_UINT64:
+        output.append(char(BinaryUInt64));
+        appendBigEndian<quint64>(output, data->val.uint64);
+        break;
+    case SDP_UINT128:
+        output.append(char(BinaryUInt128));
+        output.append(reinterpret_cast<const char *>(data->val.uint128.data), 16);
+        break;
+    case SDP_INT8:
+        output.append(char(BinaryInt8));
+        output.append(char(data->val.int8));
+        break;
+    case SDP_INT16:
+        output.append(char(BinaryInt16));
+        appendBigEndian<qint16>(output, data->val.int16);
+        break;
+    case SDP_INT32:
+        output.append(char(BinaryInt32));
+        appendBigEndian<qint32>(output, data->val.int32);
+        break;
+    case SDP_INT64:
+        output.append(char(BinaryInt64));
+        appendBigEndian<qint64>(output, data->val.int64);
+        break;
+    case SDP_INT128:
+        output.append(char(BinaryInt128));
+        output.append(reinterpret_cast<const char *>(data->val.int128.data), 16);
+        break;
+    case SDP_UUID16:
+        output.append(char(BinaryUuid16));
+        appendBigEndian<quint16>(output, data->val.uuid.value.uuid16);
+        break;
+    case SDP_UUID32:
+        output.append(char(BinaryUuid32));
+        appendBigEndian<quint32>(output, data->val.uuid.value.uuid32);
+        break;
+    case SDP_UUID128:
+        // already stored in network byte order
+        output.append(char(BinaryUuid128));
+        output.append(reinterpret_cast<const char *>(data->val.uuid.value.uuid128.data), 16);
+        break;
+    case SDP_TEXT_STR8:
+    case SDP_TEXT_STR16:
+    case SDP_TEXT_STR32:
+    {
+        // cut trailing content, same as for the XML output
+        const QByteArray text = QByteArray(data->val.str,
+                                           qstrnlen(data->val.str, data->unitSize));
+        appendBinaryBytes(output, BinaryText, text);
+        break;
     }
-
-    result = str2ba(argv[2], &local);
-    if (result < 0) {
-        fprintf(stderr, "Invalid local address: %s\n", argv[2]);
-        return RETURN_INVALPARAM;
+    case SDP_URL_STR8:
+    case SDP_URL_STR16:
+    case SDP_URL_STR32:
+    {
+        const QByteArray urlData =
+                QByteArray::fromRawData(data->val.str, qstrnlen(data->val.str, data->unitSize));
+        appendBinaryBytes(output, BinaryUrl, QUrl::fromEncoded(urlData).toEncoded());
+        break;
     }
+    case SDP_BOOL:
+        output.append(char(BinaryBool));
+        output.append(char(data->val.uint8 ? 1 : 0));
+        break;
+    case SDP_SEQ8:
+    case SDP_SEQ16:
+    case SDP_SEQ32:
+    case SDP_ALT8:
+    case SDP_ALT16:
+    case SDP_ALT32:
+    {
+        const bool isSequence = data->dtd == SDP_SEQ8 || data->dtd == SDP_SEQ16
+                || data->dtd == SDP_SEQ32;
+        output.append(char(isSequence ? BinarySequence : BinaryAlternate));
+        const qsizetype countOffset = output.size();
+        appendBigEndian<quint32>(output, 0);
+
+        quint32 count = 0;
+        for (sdp_data_t *child = data->val.dataseq; child; child = child->next) {
+            appendBinaryValue(child, output);
+            ++count;
+        }
+        qToBigEndian(count, output.data() + countOffset);
+        break;
+    }
+    case SDP_DATA_NIL:
+        output.append(char(BinaryNil));
+        break;
+    default:
+        fprintf(stderr, "Unknown dtd type\n");
+        output.append(char(BinaryNil));
+    }
+}
 
-    bool showHumanReadable = false;
-    std::vector<std::string> targetServices;
+static void appendBinaryAttribute(void *value, void *extraData)
+{
+    sdp_data_t *data = static_cast<sdp_data_t *>(value);
+    QByteArray *output = static_cast<QByteArray *>(extraData);
 
-    for (int i = 3; i < argc; i++) {
-        if (argv[i][0] != '-') {
-            usage();
-            return RETURN_USAGE;
-        }
+    appendBigEndian<quint16>(*output, data->attrId);
+    appendBinaryValue(data, *output);
+}
 
-        switch (argv[i][1])
-        {
-        case 'p':
-            showHumanReadable = true;
-            break;
-        case 'u':
-            i++;
+static void writeFrame(const QByteArray &frame)
+{
+    fwrite(frame.constData(), 1, frame.size(), stdout);
+    // hand the frame to the reader right away
+    fflush(stdout);
+}
 
-            for ( ; i < argc && argv[i][0] == '{'; i++)
-                targetServices.push_back(argv[i]);
+static void writeBinaryRecord(sdp_record_t *record)
+{
+    if (!record || !record->attrlist)
+        return;
 
-            i--; // outer loop increments again
-            break;
-        default:
-            fprintf(stderr, "Wrong argument: %s\n", argv[i]);
-            usage();
-            return RETURN_USAGE;
-        }
-    }
+    QByteArray output;
+    appendBigEndian<quint32>(output, 0);
+    sdp_list_foreach(record->attrlist, appendBinaryAttribute, &output);
+    qToBigEndian<quint32>(output.size() - sizeof(quint32), output.data());
 
-    std::vector<uuid_t> uuids;
-    for (std::vector<std::string>::const_iterator iter = targetServices.cbegin();
-         iter != targetServices.cend(); ++iter) {
+    writeFrame(output);
+}
 
-        uint128_t temp128;
-        uint16_t field1, field2, field3, field5;
-        uint32_t field0, field4;
+/*
+    Worker mode
+
+    Scan jobs are read line by line from stdin, each line being
+    "<remote bdaddr> <local bdaddr> ({uuids})". The process terminates once
+    stdin is closed. Every frame written to stdout consists of the frame
+    size (quint32), the frame type (quint8) and the address of the remote
+    device (6 bytes, big endian) followed by the payload. A record frame
+    carries a binary record without its size prefix, the job finished frame
+    the exit code the scan would have had in single device mode (quint8).
+
+    The frame types must match QtBluezSdpScannerWorker.
+ */
+enum WorkerFrameType : quint8 {
+    WorkerRecordFrame = 0x01,
+    WorkerFinishedFrame = 0x02
+};
+
+static QByteArray workerFrameHeader(WorkerFrameType type, const bdaddr_t &remote)
+{
+    QByteArray frame;
+    appendBigEndian<quint32>(frame, 0);
+    frame.append(char(type));
+    for (int i = 5; i >= 0; --i)
+        frame.append(char(remote.b[i]));
+    return frame;
+}
 
-        fprintf(stderr, "Target scan for %s\n", (*iter).c_str());
-        if (sscanf((*iter).c_str(), "{%08x-%04hx-%04hx-%04hx-%08x%04hx}", &field0,
-                   &field1, &field2, &field3, &field4, &field5) != 6) {
-            fprintf(stderr, "Skipping invalid uuid: %s\n", ((*iter).c_str()));
-            continue;
-        }
+static void writeWorkerFrame(QByteArray &frame)
+{
+    qToBigEndian<quint32>(frame.size() - sizeof(quint32), frame.data());
+    writeFrame(frame);
+}
+
+static bool parseUuid(const std::string &text, uuid_t *sdpUuid)
+{
+    uint128_t temp128;
+    uint16_t field1, field2, field3, field5;
+    uint32_t field0, field4;
 
-        // we need uuid_t conversion based on
-        // http://www.spinics.net/lists/linux-bluetooth/msg20356.html
-        field0 = htonl(field0);
-        field4 = htonl(field4);
-        field1 = htons(field1);
-        field2 = htons(field2);
-        field3 = htons(field3);
-        field5 = htons(field5);
-
-        uint8_t* temp = (uint8_t*) &temp128;
-        memcpy(&temp[0], &field0, 4);
-        memcpy(&temp[4], &field1, 2);
-        memcpy(&temp[6], &field2, 2);
-        memcpy(&temp[8], &field3, 2);
-        memcpy(&temp[10], &field4, 4);
-        memcpy(&temp[14], &field5, 2);
+    if (sscanf(text.c_str(), "{%08x-%04hx-%04hx-%04hx-%08x%04hx}", &field0,
+               &field1, &field2, &field3, &field4, &field5) != 6) {
+        return false;
+    }
 
+    // we need uuid_t conversion based on
+    // http://www.spinics.net/lists/linux-bluetooth/msg20356.html
+    field0 = htonl(field0);
+    field4 = htonl(field4);
+    field1 = htons(field1);
+    field2 = htons(field2);
+    field3 = htons(field3);
+    field5 = htons(field5);
+
+    uint8_t* temp = (uint8_t*) &temp128;
+    memcpy(&temp[0], &field0, 4);
+    memcpy(&temp[4], &field1, 2);
+    memcpy(&temp[6], &field2, 2);
+    memcpy(&temp[8], &field3, 2);
+    memcpy(&temp[10], &field4, 4);
+    memcpy(&temp[14], &field5, 2);
+
+    sdp_uuid128_create(sdpUuid, &temp128);
+    return true;
+}
+
+static std::vector<uuid_t> parseUuids(const std::vector<std::string> &targetServices)
+{
+    std::vector<uuid_t> uuids;
+    for (const std::string &target : targetServices) {
+        fprintf(stderr, "Target scan for %s\n", target.c_str());
         uuid_t sdpUuid;
-        sdp_uuid128_create(&sdpUuid, &temp128);
+        if (!parseUuid(target, &sdpUuid)) {
+            fprintf(stderr, "Skipping invalid uuid: %s\n", target.c_str());
+            continue;
+        }
         uuids.push_back(sdpUuid);
     }
+    return uuids;
+}
 
+static sdp_session_t *connectSdp(const bdaddr_t &remote, const bdaddr_t &local)
+{
     sdp_session_t *session = sdp_connect( &local, &remote, SDP_RETRY_IF_BUSY);
     if (!session) {
         //try one more time if first time failed
         session = sdp_connect( &local, &remote, SDP_RETRY_IF_BUSY);
     }
 
-    if (!session) {
+    if (!session)
         fprintf(stderr, "Cannot establish sdp session\n");
-        return RETURN_SDP_ERROR;
-    }
+    return session;
+}
 
+// Searches the records on an established session and passes every found record
+// to recordHandler, which takes ownership of the record.
+static int searchRecords(sdp_session_t *session, std::vector<uuid_t> uuids,
+                         const std::function<void(sdp_record_t *)> &recordHandler)
+{
     // set the filter for service matches
     if (uuids.empty()) {
         fprintf(stderr, "Using PUBLIC_BROWSE_GROUP for SDP search\n");
@@ -345,54 +540,217 @@ int main(int argc, char **argv)
     attributes = sdp_list_append(nullptr, &attributeRange);
 
     sdp_list_t *sdpResults, *sdpIter;
-    sdp_list_t *totalResults = nullptr;
     sdp_list_t* serviceFilter;
 
     for (uuid_t &uuid : uuids) { // can't be const, d/t sdp_list_append signature
         serviceFilter = sdp_list_append(nullptr, &uuid);
-        result = sdp_service_search_attr_req(session, serviceFilter,
-                                         SDP_ATTR_REQ_RANGE,
-                                         attributes, &sdpResults);
+        int result = sdp_service_search_attr_req(session, serviceFilter,
+                                                 SDP_ATTR_REQ_RANGE,
+                                                 attributes, &sdpResults);
         sdp_list_free(serviceFilter, nullptr);
         if (result != 0) {
             fprintf(stderr, "sdp_service_search_attr_req failed\n");
             sdp_list_free(attributes, nullptr);
-            sdp_close(session);
             return RETURN_SDP_ERROR;
         }
 
-        if (!sdpResults)
-            continue;
+        // hand out the records of this search instead of collecting all of them
+        while (sdpResults) {
+            recordHandler(static_cast<sdp_record_t *>(sdpResults->data));
 
-        if (!totalResults) {
-            totalResults = sdpResults;
-            sdpIter = totalResults;
+            sdpIter = sdpResults;
+            sdpResults = sdpResults->next;
+            free(sdpIter);
+        }
+    }
+    sdp_list_free(attributes, nullptr);
+
+    return RETURN_SUCCESS;
+}
+
+// Performs the SDP scan and passes every found record to recordHandler,
+// which takes ownership of the record.
+static int scanDevice(bdaddr_t remote, bdaddr_t local, std::vector<uuid_t> uuids,
+                      const std::function<void(sdp_record_t *)> &recordHandler)
+{
+    sdp_session_t *session = connectSdp(remote, local);
+    if (!session)
+        return RETURN_SDP_ERROR;
+
+    const int result = searchRecords(session, std::move(uuids), recordHandler);
+    sdp_close(session);
+    return result;
+}
+
+// Time in ms the worker keeps an idle SDP session open for further jobs of the same device
+#define WORKER_SESSION_IDLE_TIME 2000
+
+// Returns true if another job arrives on stdin within msecs. Qt sends the next job
+// only after the previous one has finished, it is therefore not buffered already.
+static bool waitForJob(int msecs)
+{
+    if (std::cin.rdbuf()->in_avail() > 0)
+        return true;
+
+    pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    int result;
+    do {
+        result = poll(&input, 1, msecs);
+    } while (result < 0 && errno == EINTR);
+    return result > 0;
+}
+
+static int runWorker()
+{
+    // SDP session of the last scanned device, reused by the next job for the same device
+    sdp_session_t *session = nullptr;
+    bdaddr_t sessionRemote;
+    bdaddr_t sessionLocal;
+    const auto closeSession = [&session]() {
+        if (session)
+            sdp_close(session);
+        session = nullptr;
+    };
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream job(line);
+        std::string remoteString, localString, token;
+        job >> remoteString >> localString;
+
+        std::vector<std::string> targetServices;
+        while (job >> token)
+            targetServices.push_back(token);
+
+        bdaddr_t remote;
+        bdaddr_t local;
+        int result = RETURN_INVALPARAM;
+        if (str2ba(remoteString.c_str(), &remote) < 0) {
+            fprintf(stderr, "Invalid remote address: %s\n", remoteString.c_str());
+            memset(&remote, 0, sizeof(remote));
+        } else if (str2ba(localString.c_str(), &local) < 0) {
+            fprintf(stderr, "Invalid local address: %s\n", localString.c_str());
         } else {
-            // attach each new result list to the end of totalResults
-            sdpIter->next = sdpResults;
+            fprintf(stderr, "SDP for %s %s\n", remoteString.c_str(), localString.c_str());
+            if (session && (bacmp(&sessionRemote, &remote) || bacmp(&sessionLocal, &local)))
+                closeSession();
+
+            int recordCount = 0;
+            const auto recordHandler = [&remote, &recordCount](sdp_record_t *record) {
+                if (record->attrlist) {
+                    QByteArray frame = workerFrameHeader(WorkerRecordFrame, remote);
+                    sdp_list_foreach(record->attrlist, appendBinaryAttribute, &frame);
+                    writeWorkerFrame(frame);
+                    ++recordCount;
+                }
+                sdp_record_free(record);
+            };
+            const std::vector<uuid_t> uuids = parseUuids(targetServices);
+
+            const bool reused = session != nullptr;
+            if (!session) {
+                session = connectSdp(remote, local);
+                sessionRemote = remote;
+                sessionLocal = local;
+            }
+            result = session ? searchRecords(session, uuids, recordHandler) : RETURN_SDP_ERROR;
+            if (result != RETURN_SUCCESS) {
+                closeSession();
+                // the device may have closed the idle session
+                if (reused && recordCount == 0) {
+                    session = connectSdp(remote, local);
+                    if (session)
+                        result = searchRecords(session, uuids, recordHandler);
+                    if (result != RETURN_SUCCESS)
+                        closeSession();
+                }
+            }
         }
 
-        while (sdpIter->next) // skip to end of list
-            sdpIter = sdpIter->next;
+        QByteArray frame = workerFrameHeader(WorkerFinishedFrame, remote);
+        frame.append(char(result));
+        writeWorkerFrame(frame);
+
+        // an open session keeps the link to the device up
+        if (session && !waitForJob(WORKER_SESSION_IDLE_TIME))
+            closeSession();
     }
-    sdp_list_free(attributes, nullptr);
 
-    // start XML generation from the front
-    sdpResults = totalResults;
+    closeSession();
+    return RETURN_SUCCESS;
+}
 
-    QByteArray total;
-    while (sdpResults) {
-        sdp_record_t *record = (sdp_record_t *) sdpResults->data;
+int main(int argc, char **argv)
+{
+    if (argc == 2 && qstrcmp(argv[1], "-w") == 0)
+        return runWorker();
 
-        const QByteArray xml = parseSdpRecord(record);
-        total += xml;
+    if (argc < 3) {
+        usage();
+        return RETURN_USAGE;
+    }
 
-        sdpIter = sdpResults;
-        sdpResults = sdpResults->next;
-        free(sdpIter);
-        sdp_record_free(record);
+    fprintf(stderr, "SDP for %s %s\n", argv[1], argv[2]);
+
+    bdaddr_t remote;
+    bdaddr_t local;
+    int result = str2ba(argv[1], &remote);
+    if (result < 0) {
+        fprintf(stderr, "Invalid remote address: %s\n", argv[1]);
+        return RETURN_INVALPARAM;
+    }
+
+    result = str2ba(argv[2], &local);
+    if (result < 0) {
+        fprintf(stderr, "Invalid local address: %s\n", argv[2]);
+        return RETURN_INVALPARAM;
+    }
+
+    bool showHumanReadable = false;
+    bool binaryOutput = false;
+    std::vector<std::string> targetServices;
+
+    for (int i = 3; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            usage();
+            return RETURN_USAGE;
+        }
+
+        switch (argv[i][1])
+        {
+        case 'b':
+            binaryOutput = true;
+            break;
+        case 'p':
+            showHumanReadable = true;
+            break;
+        case 'u':
+            i++;
+
+            for ( ; i < argc && argv[i][0] == '{'; i++)
+                targetServices.push_back(argv[i]);
+
+            i--; // outer loop increments again
+            break;
+        default:
+            fprintf(stderr, "Wrong argument: %s\n", argv[i]);
+            usage();
+            return RETURN_USAGE;
+        }
     }
 
+    QByteArray total;
+    result = scanDevice(remote, local, parseUuids(targetServices),
+                        [binaryOutput, &total](sdp_record_t *record) {
+        if (binaryOutput)
+            writeBinaryRecord(record);
+        else
+            total += parseSdpRecord(record);
+        sdp_record_free(record);
+    });
+    if (result != RETURN_SUCCESS)
+        return result;
+
     if (!total.isEmpty()) {
         if (showHumanReadable)
             printf("%s", total.constData());
@@ -400,7 +758,5 @@ int main(int argc, char **argv)
             printf("%s", total.toBase64().constData());
     }
 
-    sdp_close(session);
-
     return RETURN_SUCCESS;
 }
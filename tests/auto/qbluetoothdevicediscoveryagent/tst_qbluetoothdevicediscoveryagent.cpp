@@ -20,6 +20,15 @@
 #include <QtCore/qnamespace.h>
 #endif // permissions
 
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+#include <QtBluetooth/private/bluez5_helper_p.h>
+#include <QtBluetooth/private/discovereddevices_p.h>
+#include <QtBluetooth/private/hcimanager_p.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 #include <memory>
 
 QT_USE_NAMESPACE
@@ -68,6 +77,23 @@ private slots:
     void tst_discoveryTimeout();
 
     void tst_discoveryMethods();
+
+    void tst_deviceBatchInterval();
+
+    void tst_deviceLimits();
+
+    void tst_discoveryFilter();
+    void tst_discoveryFilterMerge();
+
+    void tst_discoveredDevicesBatching();
+
+    void tst_discoveredDevicesEviction();
+
+    void tst_discoveredDevicesBenchmark_data();
+    void tst_discoveredDevicesBenchmark();
+
+    void tst_hciAdvertisingReports();
+    void tst_hciBatchedRead();
 private:
     qsizetype noOfLocalDevices;
     using DiscoveryAgentPtr = std::unique_ptr<QBluetoothDeviceDiscoveryAgent>;
@@ -582,6 +608,513 @@ void tst_QBluetoothDeviceDiscoveryAgent::tst_discoveryMethods()
     }
 }
 
+void tst_QBluetoothDeviceDiscoveryAgent::tst_deviceBatchInterval()
+{
+    QBluetoothDeviceDiscoveryAgent agent;
+
+#if QT_CONFIG(bluez)
+    QCOMPARE(agent.deviceBatchInterval(), 0);
+    agent.setDeviceBatchInterval(-1); // negative ignored
+    QCOMPARE(agent.deviceBatchInterval(), 0);
+    agent.setDeviceBatchInterval(100);
+    QCOMPARE(agent.deviceBatchInterval(), 100);
+#else
+    QCOMPARE(agent.deviceBatchInterval(), -1);
+    agent.setDeviceBatchInterval(100); // feature not supported -> ignored
+    QCOMPARE(agent.deviceBatchInterval(), -1);
+#endif
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_deviceLimits()
+{
+    QBluetoothDeviceDiscoveryAgent agent;
+
+#if QT_CONFIG(bluez)
+    QCOMPARE(agent.maximumDeviceCount(), 0);
+    agent.setMaximumDeviceCount(-1); // negative ignored
+    QCOMPARE(agent.maximumDeviceCount(), 0);
+    agent.setMaximumDeviceCount(500);
+    QCOMPARE(agent.maximumDeviceCount(), 500);
+
+    QCOMPARE(agent.maximumDeviceAge(), 0);
+    agent.setMaximumDeviceAge(-1);
+    QCOMPARE(agent.maximumDeviceAge(), 0);
+    agent.setMaximumDeviceAge(60000);
+    QCOMPARE(agent.maximumDeviceAge(), 60000);
+#else
+    QCOMPARE(agent.maximumDeviceCount(), -1);
+    agent.setMaximumDeviceCount(500); // feature not supported -> ignored
+    QCOMPARE(agent.maximumDeviceCount(), -1);
+    QCOMPARE(agent.maximumDeviceAge(), -1);
+    agent.setMaximumDeviceAge(60000);
+    QCOMPARE(agent.maximumDeviceAge(), -1);
+#endif
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_discoveryFilter()
+{
+    QBluetoothDeviceDiscoveryAgent agent;
+    QVERIFY(agent.serviceUuidFilter().isEmpty());
+    QCOMPARE(agent.minimumRssi(), 0);
+    QVERIFY(!agent.isDuplicateFilterEnabled());
+
+    const QList<QBluetoothUuid> uuids = {
+        QBluetoothUuid(QBluetoothUuid::ServiceClassUuid::HeartRate),
+        QBluetoothUuid(QBluetoothUuid::ServiceClassUuid::BatteryService)
+    };
+    agent.setServiceUuidFilter(uuids);
+    QCOMPARE(agent.serviceUuidFilter(), uuids);
+
+    agent.setMinimumRssi(-70);
+    QCOMPARE(agent.minimumRssi(), -70);
+    agent.setMinimumRssi(-200); // out of range -> ignored
+    QCOMPARE(agent.minimumRssi(), -70);
+    agent.setMinimumRssi(0);
+    QCOMPARE(agent.minimumRssi(), 0);
+
+    agent.setDuplicateFilterEnabled(true);
+    QVERIFY(agent.isDuplicateFilterEnabled());
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_discoveryFilterMerge()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    const QBluetoothUuid heartRate(QBluetoothUuid::ServiceClassUuid::HeartRate);
+    const QBluetoothUuid battery(QBluetoothUuid::ServiceClassUuid::BatteryService);
+
+    QtBluezDiscoveryFilter le;
+    le.transport = QStringLiteral("le");
+    le.uuids = { heartRate };
+    le.rssi = -60;
+    le.duplicateData = false;
+
+    QCOMPARE(QtBluezDiscoveryFilter::merged({ le }), le);
+
+    // UUIDs are united, the weakest signal passes
+    QtBluezDiscoveryFilter le2 = le;
+    le2.uuids = { battery, heartRate };
+    le2.rssi = -80;
+    QtBluezDiscoveryFilter merged = QtBluezDiscoveryFilter::merged({ le, le2 });
+    QCOMPARE(merged.transport, QStringLiteral("le"));
+    QCOMPARE(merged.uuids.size(), 2);
+    QVERIFY(merged.uuids.contains(heartRate));
+    QVERIFY(merged.uuids.contains(battery));
+    QCOMPARE(merged.rssi.value_or(0), qint16(-80));
+    QVERIFY(!merged.duplicateData);
+    // the merge does not depend on the order
+    QCOMPARE(QtBluezDiscoveryFilter::merged({ le2, le }), merged);
+
+    // a filter without UUIDs or RSSI lets pass any device
+    QtBluezDiscoveryFilter classic;
+    classic.transport = QStringLiteral("bredr");
+    merged = QtBluezDiscoveryFilter::merged({ le, classic, le2 });
+    QCOMPARE(merged.transport, QStringLiteral("auto"));
+    QVERIFY(merged.uuids.isEmpty());
+    QVERIFY(!merged.rssi);
+    QVERIFY(merged.duplicateData);
+
+    QVariantMap map = le.toDBusMap();
+    QCOMPARE(map.value(QStringLiteral("Transport")).toString(), QStringLiteral("le"));
+    QCOMPARE(map.value(QStringLiteral("UUIDs")).toStringList(),
+             QStringList(heartRate.toString(QUuid::WithoutBraces)));
+    QCOMPARE(map.value(QStringLiteral("RSSI")).metaType(), QMetaType::fromType<qint16>());
+    QCOMPARE(map.value(QStringLiteral("RSSI")).value<qint16>(), qint16(-60));
+    QCOMPARE(map.value(QStringLiteral("DuplicateData")), QVariant(false));
+
+    // defaults are not sent, older BlueZ versions do not know all keys
+    map = classic.toDBusMap();
+    QCOMPARE(map.keys(), QStringList(QStringLiteral("Transport")));
+
+    // a client without filter counts as the default filter, the transport is still sent
+    merged = QtBluezDiscoveryFilter::merged({ le, QtBluezDiscoveryFilter() });
+    QCOMPARE(merged, QtBluezDiscoveryFilter());
+    QCOMPARE(merged.toDBusMap().value(QStringLiteral("Transport")).toString(),
+             QStringLiteral("auto"));
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+static QString devicePath(int i)
+{
+    return QStringLiteral("/org/bluez/hci0/dev_%1").arg(i);
+}
+
+// org.bluez.Device1 properties of a synthetic LE advertiser
+static QVariantMap deviceProperties(int i)
+{
+    QVariantMap properties;
+    properties.insert(QStringLiteral("Address"), QBluetoothAddress(quint64(0xC0000000) + i)
+                      .toString());
+    properties.insert(QStringLiteral("Alias"), QStringLiteral("Device %1").arg(i));
+    properties.insert(QStringLiteral("RSSI"), QVariant::fromValue<short>(-40 - i % 50));
+    return properties;
+}
+#endif
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_discoveredDevicesBatching()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    QtBluezDiscoveredDevices devices;
+    QSignalSpy discoveredSpy(&devices, &QtBluezDiscoveredDevices::deviceDiscovered);
+    QSignalSpy updatedSpy(&devices, &QtBluezDiscoveredDevices::deviceUpdated);
+    QSignalSpy batchDiscoveredSpy(&devices, &QtBluezDiscoveredDevices::devicesDiscovered);
+    QSignalSpy batchUpdatedSpy(&devices, &QtBluezDiscoveredDevices::devicesUpdated);
+    const QVariantMap rssiChange = { { QStringLiteral("RSSI"), QVariant::fromValue<short>(-90) } };
+
+    // unbatched, unchanged devices are not reported again
+    devices.deviceFound(devicePath(0), deviceProperties(0));
+    devices.deviceFound(devicePath(0), deviceProperties(0));
+    QCOMPARE(discoveredSpy.size(), 1);
+    devices.propertiesChanged(devicePath(0), rssiChange, {});
+    QCOMPARE(updatedSpy.size(), 1);
+    QCOMPARE(updatedSpy.at(0).at(0).value<QBluetoothDeviceInfo>().rssi(), -90);
+    QCOMPARE(devices.devices().size(), 1);
+    QCOMPARE(devices.devices().at(0).rssi(), -90);
+    // other properties are applied with the next RSSI change, which reports the device again
+    const QBluetoothUuid heartRate(QBluetoothUuid::ServiceClassUuid::HeartRate);
+    devices.propertiesChanged(devicePath(0),
+                              { { QStringLiteral("UUIDs"), QStringList(heartRate.toString()) } },
+                              {});
+    QCOMPARE(discoveredSpy.size(), 1);
+    QVERIFY(devices.devices().at(0).serviceUuids().isEmpty());
+    devices.propertiesChanged(devicePath(0), rssiChange, {});
+    QCOMPARE(discoveredSpy.size(), 2);
+    QCOMPARE(devices.devices().at(0).serviceUuids(), QList<QBluetoothUuid>{ heartRate });
+    QCOMPARE(updatedSpy.size(), 1);
+    // unknown devices are ignored
+    devices.propertiesChanged(devicePath(1), rssiChange, {});
+    QCOMPARE(updatedSpy.size(), 1);
+
+    devices.clear();
+    discoveredSpy.clear();
+    updatedSpy.clear();
+    devices.setBatchInterval(50);
+    for (int i = 0; i < 3; ++i)
+        devices.deviceFound(devicePath(i), deviceProperties(i));
+    // the pending discovery covers the update
+    devices.propertiesChanged(devicePath(1), rssiChange, {});
+    QVERIFY(discoveredSpy.isEmpty());
+    QVERIFY(updatedSpy.isEmpty());
+
+    QTRY_COMPARE(batchDiscoveredSpy.size(), 1);
+    QVERIFY(batchUpdatedSpy.isEmpty());
+    auto infos = batchDiscoveredSpy.at(0).at(0).value<QList<QBluetoothDeviceInfo>>();
+    QCOMPARE(infos.size(), 3);
+    QCOMPARE(infos.at(1).rssi(), -90);
+
+    // updates of several devices and repeated updates are reported once
+    devices.propertiesChanged(devicePath(0), rssiChange, {});
+    devices.propertiesChanged(devicePath(2), rssiChange, {});
+    devices.propertiesChanged(devicePath(2),
+                              { { QStringLiteral("RSSI"), QVariant::fromValue<short>(-70) } },
+                              {});
+    devices.flush();
+    QCOMPARE(batchUpdatedSpy.size(), 1);
+    infos = batchUpdatedSpy.at(0).at(0).value<QList<QBluetoothDeviceInfo>>();
+    QCOMPARE(infos.size(), 2);
+    QCOMPARE(infos.at(1).address(), devices.devices().at(2).address());
+    QCOMPARE(infos.at(1).rssi(), -70);
+    QCOMPARE(batchDiscoveredSpy.size(), 1);
+    QVERIFY(discoveredSpy.isEmpty());
+    QVERIFY(updatedSpy.isEmpty());
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_discoveredDevicesEviction()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    const auto contains = [](const QtBluezDiscoveredDevices &devices, int i) {
+        const QBluetoothAddress address(deviceProperties(i).value(QStringLiteral("Address"))
+                                        .toString());
+        for (const QBluetoothDeviceInfo &info : devices.devices()) {
+            if (info.address() == address)
+                return true;
+        }
+        return false;
+    };
+    const QVariantMap rssiChange = { { QStringLiteral("RSSI"), QVariant::fromValue<short>(-90) } };
+
+    {
+        QtBluezDiscoveredDevices devices;
+        QSignalSpy discoveredSpy(&devices, &QtBluezDiscoveredDevices::deviceDiscovered);
+        QSignalSpy updatedSpy(&devices, &QtBluezDiscoveredDevices::deviceUpdated);
+        QSignalSpy evictedSpy(&devices, &QtBluezDiscoveredDevices::evictedDeviceChanged);
+        devices.setMaximumDeviceCount(10);
+        for (int i = 0; i < 10; ++i)
+            devices.deviceFound(devicePath(i), deviceProperties(i));
+        QCOMPARE(devices.devices().size(), 10);
+
+        // device 0 was seen again, 1 and 2 are evicted to make room
+        devices.propertiesChanged(devicePath(0), rssiChange, {});
+        devices.deviceFound(devicePath(10), deviceProperties(10));
+        QCOMPARE(devices.devices().size(), 9);
+        QVERIFY(contains(devices, 0));
+        QVERIFY(!contains(devices, 1));
+        QVERIFY(!contains(devices, 2));
+        QVERIFY(contains(devices, 3));
+        QVERIFY(contains(devices, 10));
+
+        // evicted devices are unknown until found again, a change asks for their properties
+        // once the refetch delay has passed
+        updatedSpy.clear();
+        QCOMPARE(devices.evictedRefetchDelay(), 10000);
+        devices.propertiesChanged(devicePath(1), rssiChange, {});
+        QVERIFY(updatedSpy.isEmpty());
+        QVERIFY(evictedSpy.isEmpty());
+        devices.setEvictedRefetchDelay(0);
+        devices.propertiesChanged(devicePath(1), rssiChange, {});
+        QVERIFY(updatedSpy.isEmpty());
+        QCOMPARE(evictedSpy.size(), 1);
+        QCOMPARE(evictedSpy.at(0).at(0).toString(), devicePath(1));
+        devices.propertiesChanged(devicePath(1), rssiChange, {});
+        QCOMPARE(evictedSpy.size(), 1);
+        devices.propertiesChanged(devicePath(10), rssiChange, {});
+        QCOMPARE(updatedSpy.size(), 1);
+
+        // removed BlueZ objects are forgotten
+        devices.deviceRemoved(devicePath(2));
+        devices.propertiesChanged(devicePath(2), rssiChange, {});
+        QCOMPARE(evictedSpy.size(), 1);
+
+        discoveredSpy.clear();
+        devices.deviceFound(devicePath(1), deviceProperties(1));
+        QCOMPARE(discoveredSpy.size(), 1);
+        QVERIFY(contains(devices, 1));
+        QCOMPARE(devices.devices().size(), 10);
+
+        // lowering the limit evicts right away
+        devices.setMaximumDeviceCount(5);
+        QCOMPARE(devices.devices().size(), 5);
+        QVERIFY(contains(devices, 1));
+        QVERIFY(contains(devices, 10));
+    }
+
+    {
+        QtBluezDiscoveredDevices devices;
+        devices.setMaximumDeviceAge(50);
+        devices.deviceFound(devicePath(0), deviceProperties(0));
+        devices.deviceFound(devicePath(1), deviceProperties(1));
+        QTest::qWait(100);
+        devices.deviceFound(devicePath(2), deviceProperties(2));
+        QCOMPARE(devices.devices().size(), 1);
+        QVERIFY(contains(devices, 2));
+    }
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_discoveredDevicesBenchmark_data()
+{
+    QTest::addColumn<int>("batchInterval");
+
+    QTest::newRow("unbatched") << 0;
+    QTest::newRow("batched") << 100;
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_discoveredDevicesBenchmark()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    QFETCH(int, batchInterval);
+
+    // a busy environment with many advertisers, each with a few RSSI changes
+    const int deviceCount = 3000;
+    const int updatesPerDevice = 5;
+    QList<QVariantMap> properties;
+    QList<QVariantMap> changes;
+    for (int i = 0; i < deviceCount; ++i) {
+        properties << deviceProperties(i);
+        changes << QVariantMap{ { QStringLiteral("RSSI"),
+                                  QVariant::fromValue<short>(-100 + i % 60) } };
+    }
+
+    QtBluezDiscoveredDevices devices;
+    devices.setBatchInterval(batchInterval);
+    qsizetype signalCount = 0;
+    const auto countSignal = [&signalCount]() { ++signalCount; };
+    connect(&devices, &QtBluezDiscoveredDevices::deviceDiscovered, this, countSignal);
+    connect(&devices, &QtBluezDiscoveredDevices::deviceUpdated, this, countSignal);
+    connect(&devices, &QtBluezDiscoveredDevices::devicesDiscovered, this, countSignal);
+    connect(&devices, &QtBluezDiscoveredDevices::devicesUpdated, this, countSignal);
+
+    QBENCHMARK {
+        devices.clear();
+        signalCount = 0;
+        for (int i = 0; i < deviceCount; ++i)
+            devices.deviceFound(devicePath(i), properties.at(i));
+        for (int round = 0; round < updatesPerDevice; ++round) {
+            for (int i = 0; i < deviceCount; ++i)
+                devices.propertiesChanged(devicePath(i), changes.at((i + round) % deviceCount),
+                                          {});
+        }
+        devices.flush();
+    }
+
+    QCOMPARE(devices.devices().size(), deviceCount);
+    if (batchInterval > 0)
+        QCOMPARE(signalCount, 1); // everything fits into a single interval
+    else
+        QVERIFY(signalCount > deviceCount);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_hciAdvertisingReports()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    // HCI_LE_Advertising_Report with an ADV_IND and a SCAN_RSP
+    const QByteArray legacyReports = QByteArray::fromHex(
+                "043e23" "0202"
+                "00" "01" "5d5a2e3c1ae0" "07" "02010603 03aafe" "c5"
+                "04" "00" "010203040506" "06" "0509 54657374" "b0");
+    // HCI_LE_Extended_Advertising_Report of a legacy ADV_IND
+    const QByteArray extendedReport = QByteArray::fromHex(
+                "043e1d" "0d01"
+                "1300" "01" "5d5a2e3c1ae0" "01" "00" "ff" "7f" "c4" "0000" "00" "000000000000"
+                "03" "020106");
+    // announces two reports but contains only one
+    const QByteArray truncatedReports = QByteArray::fromHex(
+                "043e0e" "0202"
+                "03" "01" "5d5a2e3c1ae0" "02" "0201" "c5");
+
+    // not bound to any adapter, the packets are injected
+    HciManager manager(QBluetoothAddress(QStringLiteral("00:00:00:00:00:01")));
+    QList<QList<HciManager::AdvertisingReport>> received;
+    connect(&manager, &HciManager::advertisingReportsReceived, this,
+            [&received](const QList<HciManager::AdvertisingReport> &reports) {
+        received.append(reports);
+    });
+    const auto inject = [&manager](const QByteArray &packet) {
+        manager.handleHciPacket(reinterpret_cast<const quint8 *>(packet.constData()),
+                                int(packet.size()));
+    };
+
+    inject(legacyReports);
+    QCOMPARE(received.size(), 1);
+    QCOMPARE(received.at(0).size(), 2);
+    HciManager::AdvertisingReport report = received.at(0).at(0);
+    QCOMPARE(report.address, QBluetoothAddress(QStringLiteral("E0:1A:3C:2E:5A:5D")));
+    QCOMPARE(report.addressType, quint8(1));
+    QCOMPARE(report.eventType, quint16(0));
+    QCOMPARE(report.rssi, qint8(-59));
+    QCOMPARE(report.data, QByteArray::fromHex("0201060303aafe"));
+    report = received.at(0).at(1);
+    QCOMPARE(report.address, QBluetoothAddress(QStringLiteral("06:05:04:03:02:01")));
+    QCOMPARE(report.eventType, quint16(4));
+    QCOMPARE(report.rssi, qint8(-80));
+    QCOMPARE(report.data, QByteArray("\x05\x09" "Test"));
+
+    inject(extendedReport);
+    QCOMPARE(received.size(), 2);
+    QCOMPARE(received.at(1).size(), 1);
+    report = received.at(1).at(0);
+    QCOMPARE(report.address, QBluetoothAddress(QStringLiteral("E0:1A:3C:2E:5A:5D")));
+    QCOMPARE(report.eventType, quint16(0x13));
+    QCOMPARE(report.rssi, qint8(-60));
+    QCOMPARE(report.data, QByteArray::fromHex("020106"));
+
+    // the complete reports of a damaged event are kept
+    inject(truncatedReports);
+    QCOMPARE(received.size(), 3);
+    QCOMPARE(received.at(2).size(), 1);
+    QCOMPARE(received.at(2).at(0).data, QByteArray::fromHex("0201"));
+
+    // events of other types do not produce reports
+    inject(QByteArray::fromHex("040e0401030c00")); // Command Complete of HCI_Reset
+    QCOMPARE(received.size(), 3);
+
+    // batched delivery
+    received.clear();
+    manager.setAdvertisingReportInterval(50);
+    inject(legacyReports);
+    inject(extendedReport);
+    inject(legacyReports);
+    QVERIFY(received.isEmpty());
+    QTRY_COMPARE(received.size(), 1);
+    QCOMPARE(received.at(0).size(), 5);
+    QCOMPARE(received.at(0).at(2).eventType, quint16(0x13));
+
+    // with QT_BLUETOOTH_HCI_LE_SCAN, the reports update the devices announced by BlueZ
+    manager.setAdvertisingReportInterval(0);
+    QtBluezDiscoveredDevices devices;
+    QSignalSpy updatedSpy(&devices, &QtBluezDiscoveredDevices::deviceUpdated);
+    QVariantMap properties = deviceProperties(0);
+    properties.insert(QStringLiteral("Address"), QStringLiteral("E0:1A:3C:2E:5A:5D"));
+    devices.deviceFound(devicePath(0), properties);
+    connect(&manager, &HciManager::advertisingReportsReceived,
+            &devices, &QtBluezDiscoveredDevices::advertisingReportsReceived);
+    // ADV_IND with Manufacturer Specific Data of company 0x004c
+    inject(QByteArray::fromHex("043e1b" "0201"
+                               "00" "01" "5d5a2e3c1ae0" "0f" "020106 0bff4c00 0215010203040506"
+                               "b5"));
+    QCOMPARE(updatedSpy.size(), 1);
+    QBluetoothDeviceInfo info = updatedSpy.at(0).at(0).value<QBluetoothDeviceInfo>();
+    QCOMPARE(info.rssi(), -75);
+    QCOMPARE(info.manufacturerData(0x004c), QByteArray::fromHex("0215010203040506"));
+    QCOMPARE(updatedSpy.at(0).at(1).value<QBluetoothDeviceInfo::Fields>(),
+             QBluetoothDeviceInfo::Field::RSSI | QBluetoothDeviceInfo::Field::ManufacturerData);
+    // the report of the unknown device is dropped
+    inject(legacyReports);
+    QCOMPARE(updatedSpy.size(), 2);
+    QCOMPARE(updatedSpy.at(1).at(0).value<QBluetoothDeviceInfo>().rssi(), -59);
+    QCOMPARE(devices.devices().size(), 1);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothDeviceDiscoveryAgent::tst_hciBatchedRead()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    int sockets[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+    const auto closePeer = qScopeGuard([&sockets] { ::close(sockets[1]); });
+    // HciManager closes its end
+    HciManager manager(sockets[0]);
+    QList<QByteArray> completions;
+    connect(&manager, &HciManager::commandCompleted, this,
+            [&completions](quint16, quint8, const QByteArray &data) {
+        completions.append(data);
+    });
+
+    // HCI_Command_Complete events, more than a single recvmmsg() call reads
+    constexpr int packetCount = 40;
+    for (int i = 0; i < packetCount; ++i) {
+        const QByteArray packet = QByteArray::fromHex("040e05" "01" "0c20" "00")
+                + char(i);
+        QCOMPARE(::send(sockets[1], packet.constData(), packet.size(), 0), packet.size());
+    }
+    QTRY_COMPARE(completions.size(), packetCount);
+    // the data outlives the read buffer, which later packets overwrote
+    for (int i = 0; i < packetCount; ++i)
+        QCOMPARE(completions.at(i), QByteArray(1, char(i)));
+
+    HciManager::ReadStatistics statistics = manager.readStatistics();
+    QCOMPARE(statistics.packets, quint64(packetCount));
+    QCOMPARE(statistics.wakeups, quint64(1));
+    QCOMPARE(statistics.maxPacketsPerWakeup, packetCount);
+
+    // a single packet per wakeup
+    manager.resetReadStatistics();
+    for (int i = 0; i < 2; ++i) {
+        const QByteArray packet = QByteArray::fromHex("040e05" "01" "0c20" "00" "ff");
+        QCOMPARE(::send(sockets[1], packet.constData(), packet.size(), 0), packet.size());
+        QTRY_COMPARE(completions.size(), packetCount + i + 1);
+    }
+    statistics = manager.readStatistics();
+    QCOMPARE(statistics.packets, quint64(2));
+    QCOMPARE(statistics.wakeups, quint64(2));
+    QCOMPARE(statistics.maxPacketsPerWakeup, 1);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
 QTEST_MAIN(tst_QBluetoothDeviceDiscoveryAgent)
 
 #include "tst_qbluetoothdevicediscoveryagent.moc"
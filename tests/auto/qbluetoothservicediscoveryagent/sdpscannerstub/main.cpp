@@ -0,0 +1,78 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QByteArray>
+#include <QtCore/QtEndian>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/*
+    Replacement of the worker mode of src/tools/sdpscanner without Bluetooth access.
+
+    Every scan takes as many 10 ms steps as the last byte of the remote address
+    and reports one record with the SerialPort service class. A remote address
+    ending in 0xff makes the stub exit like an sdpscanner without the worker mode.
+ */
+
+static bool parseAddress(const std::string &text, quint8 *address)
+{
+    return sscanf(text.c_str(), "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx", &address[0],
+                  &address[1], &address[2], &address[3], &address[4], &address[5]) == 6;
+}
+
+static void writeFrame(quint8 type, const quint8 *address, const QByteArray &payload)
+{
+    QByteArray frame(4, '\0');
+    frame.append(char(type));
+    frame.append(reinterpret_cast<const char *>(address), 6);
+    frame.append(payload);
+    qToBigEndian<quint32>(frame.size() - 4, frame.data());
+    fwrite(frame.constData(), 1, frame.size(), stdout);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2 || qstrcmp(argv[1], "-w") != 0)
+        return 1;
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream job(line);
+        std::string remote, local;
+        job >> remote >> local;
+
+        // like sdpscanner, echo the requested address and only report a null
+        // address if the remote address itself cannot be parsed
+        quint8 address[6] = {};
+        quint8 localAddress[6] = {};
+        if (!parseAddress(remote, address)) {
+            const quint8 nullAddress[6] = {};
+            writeFrame(0x02, nullAddress, QByteArray(1, char(2)));
+            continue;
+        }
+        if (!parseAddress(local, localAddress)) {
+            writeFrame(0x02, address, QByteArray(1, char(2)));
+            continue;
+        }
+        if (address[5] == 0xff)
+            return 1;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10 * address[5]));
+
+        // ServiceClassIds: sequence of one UUID16
+        QByteArray record;
+        record.append("\x00\x01", 2);
+        record.append("\x11\x00\x00\x00\x01", 5);
+        record.append("\x0b\x11\x01", 3);
+        writeFrame(0x01, address, record);
+        writeFrame(0x02, address, QByteArray(1, '\0'));
+    }
+
+    return 0;
+}
@@ -16,6 +16,14 @@
 #include <qbluetoothserver.h>
 #include <qbluetoothserviceinfo.h>
 
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+#include <QtBluetooth/private/qbluetoothservicediscoveryagent_p.h>
+#include <QtBluetooth/private/sdpcache_p.h>
+#include <QtBluetooth/private/sdpscannerworker_p.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qthread.h>
+#endif
+
 QT_USE_NAMESPACE
 
 // Maximum time to for bluetooth device scan
@@ -42,6 +50,12 @@ private slots:
     void tst_serviceDiscovery();
     void tst_serviceDiscoveryStop();
     void tst_serviceDiscoveryAdapters();
+    void tst_concurrentSdpScans_data();
+    void tst_concurrentSdpScans();
+    void tst_sdpScannerFailure();
+    void tst_sdpCache();
+    void tst_sdpScanStatistics();
+    void tst_sdpCacheDiscovery();
 
 private:
     QList<QBluetoothDeviceInfo> devices;
@@ -458,6 +472,321 @@ void tst_QBluetoothServiceDiscoveryAgent::tst_serviceDiscovery()
     QVERIFY(!discoveryAgent.isActive());
 }
 
+void tst_QBluetoothServiceDiscoveryAgent::tst_concurrentSdpScans_data()
+{
+    QTest::addColumn<int>("processCount");
+
+    QTest::newRow("sequential") << 1;
+    QTest::newRow("parallel") << 3;
+}
+
+void tst_QBluetoothServiceDiscoveryAgent::tst_concurrentSdpScans()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    QFETCH(int, processCount);
+
+    const QString stub = QCoreApplication::applicationDirPath()
+            + QStringLiteral("/sdpscannerstub");
+    if (!QFileInfo(stub).isExecutable())
+        QSKIP("sdpscanner stub is not available");
+
+    QtBluezSdpScannerWorker worker;
+    worker.setProgram(stub);
+    worker.setMaximumProcessCount(processCount);
+    QCOMPARE(worker.maximumProcessCount(), processCount);
+
+    QSignalSpy recordSpy(&worker, &QtBluezSdpScannerWorker::recordReceived);
+    QSignalSpy finishedSpy(&worker, &QtBluezSdpScannerWorker::scanFinished);
+
+    // the stub takes 10 ms per unit of the last address byte
+    const QBluetoothAddress local(QStringLiteral("00:00:00:00:00:01"));
+    const int deviceCount = 6;
+    QList<quint64> jobs;
+    for (int i = 1; i <= deviceCount; ++i) {
+        const QBluetoothAddress remote((quint64(i) << 8) | 0x05);
+        jobs << worker.scan(remote, local, {});
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.size(), deviceCount, 10000);
+
+    // one record per device, results of parallel scans arrive in any order
+    QCOMPARE(recordSpy.size(), deviceCount);
+    QList<quint64> finishedJobs;
+    for (const QList<QVariant> &arguments : std::as_const(finishedSpy)) {
+        finishedJobs << arguments.at(0).toULongLong();
+        QCOMPARE(arguments.at(1).toInt(), 0);
+    }
+    std::sort(finishedJobs.begin(), finishedJobs.end());
+    QCOMPARE(finishedJobs, jobs);
+
+    const QByteArray expectedRecord("\x00\x01\x11\x00\x00\x00\x01\x0b\x11\x01", 10);
+    for (const QList<QVariant> &arguments : std::as_const(recordSpy)) {
+        QVERIFY(jobs.contains(arguments.at(0).toULongLong()));
+        QCOMPARE(arguments.at(1).toByteArray(), expectedRecord);
+    }
+
+    // all queued jobs are handed out at once, so every allowed process was used
+    QCOMPARE(worker.findChildren<QProcess *>().size(), processCount);
+
+    // the pool restarts its processes after they were stopped
+    worker.stopWorkers();
+    QVERIFY(worker.findChildren<QProcess *>().isEmpty());
+    finishedSpy.clear();
+    const quint64 restartedJob = worker.scan(QBluetoothAddress(Q_UINT64_C(0x105)), local, {});
+    QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.size(), 1, 10000);
+    QCOMPARE(finishedSpy.at(0).at(0).toULongLong(), restartedJob);
+    QCOMPARE(finishedSpy.at(0).at(1).toInt(), 0);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothServiceDiscoveryAgent::tst_sdpScannerFailure()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    const QString stub = QCoreApplication::applicationDirPath()
+            + QStringLiteral("/sdpscannerstub");
+    if (!QFileInfo(stub).isExecutable())
+        QSKIP("sdpscanner stub is not available");
+
+    QtBluezSdpScannerWorker worker;
+    worker.setProgram(stub);
+    worker.setMaximumProcessCount(3);
+    QSignalSpy finishedSpy(&worker, &QtBluezSdpScannerWorker::scanFinished);
+
+    // the stub exits for the first device while the others are still scanned
+    const QBluetoothAddress local(QStringLiteral("00:00:00:00:00:01"));
+    const quint64 failingJob = worker.scan(QBluetoothAddress(Q_UINT64_C(0x1ff)), local, {});
+    const quint64 secondJob = worker.scan(QBluetoothAddress(Q_UINT64_C(0x205)), local, {});
+    const quint64 thirdJob = worker.scan(QBluetoothAddress(Q_UINT64_C(0x305)), local, {});
+
+    QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.size(), 3, 10000);
+    QHash<quint64, int> results;
+    for (const QList<QVariant> &arguments : std::as_const(finishedSpy))
+        results.insert(arguments.at(0).toULongLong(), arguments.at(1).toInt());
+    QVERIFY(results.value(failingJob) != 0);
+    QCOMPARE(results.value(secondJob, -1), 0);
+    QCOMPARE(results.value(thirdJob, -1), 0);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothServiceDiscoveryAgent::tst_sdpCache()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    using namespace std::chrono_literals;
+
+    SdpCache cache;
+    QVERIFY(!cache.isEnabled());
+    cache.setTimeToLive(60s);
+    QVERIFY(cache.isEnabled());
+    cache.setMaximumSize(2);
+
+    const QBluetoothAddress first(QStringLiteral("00:11:22:33:44:55"));
+    const QBluetoothAddress second(QStringLiteral("00:11:22:33:44:56"));
+    const QBluetoothAddress third(QStringLiteral("00:11:22:33:44:57"));
+    const QBluetoothUuid serialPort(QBluetoothUuid::ServiceClassUuid::SerialPort);
+    const QBluetoothUuid obex(QBluetoothUuid::ServiceClassUuid::ObexObjectPush);
+    const QList<QByteArray> records = {
+        QByteArray("\x00\x01\x11\x00\x00\x00\x01\x0b\x11\x01", 10),
+        QByteArray("\x01\x00\x0e\x00\x00\x00\x03" "COM", 10)
+    };
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+
+    QVERIFY(!cache.find(first, {}));
+    cache.insert(first, { serialPort, obex }, records, now);
+    QVERIFY(cache.isModified());
+
+    // the results of each UUID filter are cached separately, its order is irrelevant
+    QVERIFY(!cache.find(first, {}));
+    std::optional<SdpCache::Entry> entry = cache.find(first, { obex, serialPort });
+    QVERIFY(entry);
+    QCOMPARE(entry->records, records);
+    QVERIFY(!cache.isExpired(*entry, now.addSecs(59)));
+    QVERIFY(cache.isExpired(*entry, now.addSecs(60)));
+
+    // least recently used entries are evicted
+    cache.insert(second, {}, { records.first() }, now.addSecs(-120));
+    QVERIFY(cache.find(first, { serialPort, obex }));
+    cache.insert(third, {}, {}, now);
+    QCOMPARE(cache.size(), 2);
+    QVERIFY(!cache.find(second, {}));
+    QVERIFY(cache.find(third, {}));
+
+    // results survive a restart, including their age
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filePath = dir.filePath(QStringLiteral("cache/qt_sdp_cache"));
+    QVERIFY(cache.save(filePath));
+    QVERIFY(!cache.isModified());
+
+    SdpCache restored;
+    restored.setTimeToLive(60s);
+    QVERIFY(restored.load(filePath));
+    QCOMPARE(restored.size(), 2);
+    entry = restored.find(first, { serialPort, obex });
+    QVERIFY(entry);
+    QCOMPARE(entry->records, records);
+    QCOMPARE(entry->timestamp.toMSecsSinceEpoch(), now.toMSecsSinceEpoch());
+    entry = restored.find(third, {});
+    QVERIFY(entry);
+    QVERIFY(entry->records.isEmpty());
+
+    // explicit invalidation drops the results of all filters
+    restored.insert(first, {}, records, now);
+    QCOMPARE(restored.size(), 3);
+    restored.remove(first);
+    QCOMPARE(restored.size(), 1);
+    QVERIFY(!restored.find(first, {}));
+    restored.clear();
+    QCOMPARE(restored.size(), 0);
+
+    // a smaller size limit applies to loaded caches as well
+    SdpCache small;
+    small.setMaximumSize(1);
+    QVERIFY(small.load(filePath));
+    QCOMPARE(small.size(), 1);
+    QVERIFY(small.find(third, {}));
+
+    // the cache is shared by the agents of all threads
+    SdpCache shared;
+    shared.setTimeToLive(60s);
+    shared.setMaximumSize(64);
+    QList<QThread *> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads << QThread::create([&shared, &records, t]() {
+            for (int i = 0; i < 1000; ++i) {
+                const QBluetoothAddress address((quint64(t) << 8) | (i % 32));
+                shared.insert(address, {}, records);
+                shared.find(address, {});
+                if (i % 3 == 0)
+                    shared.remove(address);
+            }
+        });
+        threads.last()->start();
+    }
+    for (QThread *thread : std::as_const(threads)) {
+        QVERIFY(thread->wait(10000));
+        delete thread;
+    }
+    QVERIFY(shared.size() <= 64);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothServiceDiscoveryAgent::tst_sdpScanStatistics()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    const QString stub = QCoreApplication::applicationDirPath()
+            + QStringLiteral("/sdpscannerstub");
+    if (!QFileInfo(stub).isExecutable())
+        QSKIP("sdpscanner stub is not available");
+    QtBluezSdpScannerWorker::instance()->setProgram(stub);
+
+    {
+        qputenv("QT_BLUETOOTH_SDP_CONCURRENCY", "0");
+        QBluetoothServiceDiscoveryAgent agent;
+        QCOMPARE(QBluetoothServiceDiscoveryAgentPrivate::get(&agent)->sdpScanConcurrency(), 1);
+    }
+    qputenv("QT_BLUETOOTH_SDP_CONCURRENCY", "3");
+    QBluetoothServiceDiscoveryAgent agent;
+    qunsetenv("QT_BLUETOOTH_SDP_CONCURRENCY");
+    auto *d = QBluetoothServiceDiscoveryAgentPrivate::get(&agent);
+    QCOMPARE(d->sdpScanConcurrency(), 3);
+    d->setSdpScanConcurrency(2);
+    QCOMPARE(d->sdpScanConcurrency(), 2);
+
+    // the stub takes 10 ms per unit of the last address byte
+    QList<QBluetoothAddress> addresses;
+    for (int i = 1; i <= 4; ++i) {
+        addresses << QBluetoothAddress((quint64(i) << 8) | 0x05);
+        d->discoveredDevices << QBluetoothDeviceInfo(addresses.last(), QString(), 0);
+    }
+    QSignalSpy serviceSpy(&agent, &QBluetoothServiceDiscoveryAgent::serviceDiscovered);
+    QSignalSpy finishedSpy(&agent, &QBluetoothServiceDiscoveryAgent::finished);
+    d->setDiscoveryMode(QBluetoothServiceDiscoveryAgent::FullDiscovery);
+    d->setDiscoveryState(QBluetoothServiceDiscoveryAgentPrivate::ServiceDiscovery);
+    d->runExternalSdpScan(addresses.first(),
+                          QBluetoothAddress(QStringLiteral("00:00:00:00:00:01")));
+
+    QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.size(), 1, 10000);
+    QCOMPARE(serviceSpy.size(), addresses.size());
+    const QMap<QBluetoothAddress, qint64> durations = d->sdpScanDurations();
+    QCOMPARE(durations.keys(), addresses);
+    qint64 longestScan = 0;
+    for (const qint64 duration : durations) {
+        QVERIFY(duration >= 0);
+        longestScan = qMax(longestScan, duration);
+    }
+    QVERIFY(d->sdpDiscoveryDuration() >= longestScan);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
+void tst_QBluetoothServiceDiscoveryAgent::tst_sdpCacheDiscovery()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    using namespace std::chrono_literals;
+
+    const QString stub = QCoreApplication::applicationDirPath()
+            + QStringLiteral("/sdpscannerstub");
+    if (!QFileInfo(stub).isExecutable())
+        QSKIP("sdpscanner stub is not available");
+    QtBluezSdpScannerWorker::instance()->setProgram(stub);
+
+    SdpCache *cache = SdpCache::instance();
+    const std::chrono::seconds previousTimeToLive = cache->timeToLive();
+    const QString previousFilePath = cache->filePath();
+    cache->clear();
+    cache->setFilePath(QString());
+    cache->setTimeToLive(60s);
+
+    // hit: reported from the cache without a scan
+    const QBluetoothAddress cached(QStringLiteral("00:00:00:00:01:05"));
+    // expired: reported from the cache and refreshed by a scan
+    const QBluetoothAddress expired(QStringLiteral("00:00:00:00:02:05"));
+    // miss: scanned
+    const QBluetoothAddress unknown(QStringLiteral("00:00:00:00:03:05"));
+    const QByteArray serialPortRecord("\x00\x01\x11\x00\x00\x00\x01\x0b\x11\x01", 10);
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    cache->insert(cached, {}, { serialPortRecord }, now);
+    cache->insert(expired, {}, { serialPortRecord }, now.addSecs(-120));
+
+    QBluetoothServiceDiscoveryAgent agent;
+    auto *d = QBluetoothServiceDiscoveryAgentPrivate::get(&agent);
+    d->setSdpScanConcurrency(2);
+    for (const QBluetoothAddress &address : { cached, expired, unknown })
+        d->discoveredDevices << QBluetoothDeviceInfo(address, QString(), 0);
+    QSignalSpy serviceSpy(&agent, &QBluetoothServiceDiscoveryAgent::serviceDiscovered);
+    QSignalSpy finishedSpy(&agent, &QBluetoothServiceDiscoveryAgent::finished);
+    d->setDiscoveryMode(QBluetoothServiceDiscoveryAgent::FullDiscovery);
+    d->setDiscoveryState(QBluetoothServiceDiscoveryAgentPrivate::ServiceDiscovery);
+    d->runExternalSdpScan(cached, QBluetoothAddress(QStringLiteral("00:00:00:00:00:01")));
+
+    QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.size(), 1, 10000);
+    // the rescanned service of the expired entry is not reported twice
+    QCOMPARE(serviceSpy.size(), 3);
+    const QList<QBluetoothAddress> scanned = { expired, unknown };
+    QCOMPARE(d->sdpScanDurations().keys(), scanned);
+
+    for (const QBluetoothAddress &address : { cached, expired, unknown }) {
+        const std::optional<SdpCache::Entry> entry = cache->find(address, {});
+        QVERIFY(entry);
+        QVERIFY(!cache->isExpired(*entry));
+        QCOMPARE(entry->records, QList<QByteArray>{ serialPortRecord });
+    }
+
+    cache->clear();
+    cache->setTimeToLive(previousTimeToLive);
+    cache->setFilePath(previousFilePath);
+#else
+    QSKIP("Test requires BlueZ and a developer build");
+#endif
+}
+
 QTEST_MAIN(tst_QBluetoothServiceDiscoveryAgent)
 
 #include "tst_qbluetoothservicediscoveryagent.moc"
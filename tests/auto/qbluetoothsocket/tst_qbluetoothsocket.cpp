@@ -13,6 +13,12 @@
 #if QT_CONFIG(bluez)
 #include <QtBluetooth/private/bluez5_helper_p.h>
 #endif
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+#include <QtBluetooth/private/qbluetoothsocket_bluez_p.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 QT_USE_NAMESPACE
 
@@ -58,6 +64,10 @@ private slots:
 
     void tst_unsupportedProtocolError();
 
+    void tst_bulkWriteBenchmark();
+    void tst_readCoalescing();
+    void tst_unbufferedWriteBlocked();
+
 public slots:
     void serviceDiscovered(const QBluetoothServiceInfo &info);
     void finished();
@@ -568,6 +578,177 @@ void tst_QBluetoothSocket::tst_unsupportedProtocolError()
     QCOMPARE(socket.state(), QBluetoothSocket::SocketState::UnconnectedState);
 }
 
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+// Gives access to the constructor taking a specific backend
+class BluezSocket : public QBluetoothSocket
+{
+public:
+    BluezSocket()
+        : QBluetoothSocket(new QBluetoothSocketPrivateBluez(),
+                           QBluetoothServiceInfo::RfcommProtocol)
+    {
+    }
+
+    QBluetoothSocketPrivateBluez *backend() const
+    {
+        return static_cast<QBluetoothSocketPrivateBluez *>(d_ptr);
+    }
+};
+#endif
+
+void tst_QBluetoothSocket::tst_bulkWriteBenchmark()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    // Measures the buffered write path of the raw socket backend. A local
+    // socket pair stands in for the RFCOMM connection.
+    int fds[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ::fcntl(fds[1], F_SETFL, ::fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+
+    BluezSocket socket;
+    QVERIFY(socket.setSocketDescriptor(fds[0], QBluetoothServiceInfo::RfcommProtocol,
+                                       QBluetoothSocket::SocketState::ConnectedState,
+                                       QIODevice::ReadWrite));
+
+    const QByteArray payload(2 * 1024 * 1024, 'x');
+    QByteArray sink(64 * 1024, Qt::Uninitialized);
+
+    QBENCHMARK {
+        QCOMPARE(socket.write(payload), qint64(payload.size()));
+        qint64 received = 0;
+        QDeadlineTimer deadline(MaxReadWriteTime);
+        while (received < payload.size() && !deadline.hasExpired()) {
+            QCoreApplication::processEvents();
+            const auto n = ::read(fds[1], sink.data(), sink.size());
+            if (n > 0)
+                received += n;
+        }
+        QCOMPARE(received, qint64(payload.size()));
+    }
+
+    QCOMPARE(socket.bytesToWrite(), qint64(0));
+    socket.abort();
+    ::close(fds[1]);
+#else
+    QSKIP("Requires the BlueZ socket backend and a developer build");
+#endif
+}
+
+void tst_QBluetoothSocket::tst_readCoalescing()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    int fds[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    BluezSocket socket;
+    QVERIFY(socket.setSocketDescriptor(fds[0], QBluetoothServiceInfo::RfcommProtocol,
+                                       QBluetoothSocket::SocketState::ConnectedState,
+                                       QIODevice::ReadWrite));
+    QBluetoothSocketPrivateBluez *backend = socket.backend();
+    QSignalSpy readyReadSpy(&socket, &QIODevice::readyRead);
+
+    // Without coalescing every notification reads at most one chunk
+    backend->setReadChunkSize(16);
+    QCOMPARE(backend->readChunkSize(), qint64(16));
+    const QByteArray payload(64, 'x');
+    QCOMPARE(::write(fds[1], payload.constData(), payload.size()), ssize_t(payload.size()));
+    QTRY_COMPARE(socket.bytesAvailable(), qint64(payload.size()));
+    QCOMPARE(readyReadSpy.size(), 4);
+    QCOMPARE(socket.readAll(), payload);
+    // one read() per notification
+    QCOMPARE(backend->readStatistics().reads, backend->readStatistics().notifications);
+
+    // With coalescing the socket is drained in one go, limited by the budget
+    backend->setReadCoalescingEnabled(true);
+    backend->setReadBudget(48);
+    QVERIFY(backend->isReadCoalescingEnabled());
+    readyReadSpy.clear();
+    const auto before = backend->readStatistics();
+    QCOMPARE(::write(fds[1], payload.constData(), payload.size()), ssize_t(payload.size()));
+    QTRY_COMPARE(socket.bytesAvailable(), qint64(payload.size()));
+    QCOMPARE(readyReadSpy.size(), 2);
+    QCOMPARE(socket.readAll(), payload);
+
+    const auto after = backend->readStatistics();
+    QCOMPARE(after.bytesRead - before.bytesRead, quint64(payload.size()));
+    QCOMPARE(after.readyReadSignals - before.readyReadSignals, quint64(2));
+    QCOMPARE(after.reads - before.reads, quint64(4));
+
+    socket.abort();
+    ::close(fds[1]);
+
+    // An L2CAP socket is read one whole datagram at a time regardless of both settings
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds), 0);
+    BluezSocket l2capSocket;
+    QVERIFY(l2capSocket.setSocketDescriptor(fds[0], QBluetoothServiceInfo::L2capProtocol,
+                                            QBluetoothSocket::SocketState::ConnectedState,
+                                            QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QBluetoothSocketPrivateBluez *l2capBackend = l2capSocket.backend();
+    l2capBackend->setReadChunkSize(16);
+    l2capBackend->setReadCoalescingEnabled(true);
+    QList<QByteArray> received;
+    connect(&l2capSocket, &QIODevice::readyRead, this, [&]() {
+        received.append(l2capSocket.read(1024));
+    });
+    const QByteArray datagram1(64, 'a');
+    const QByteArray datagram2(64, 'b');
+    QCOMPARE(::send(fds[1], datagram1.constData(), datagram1.size(), 0),
+             ssize_t(datagram1.size()));
+    QCOMPARE(::send(fds[1], datagram2.constData(), datagram2.size(), 0),
+             ssize_t(datagram2.size()));
+    QTRY_COMPARE(received.size(), 2);
+    QCOMPARE(received.at(0), datagram1);
+    QCOMPARE(received.at(1), datagram2);
+    QCOMPARE(l2capBackend->readStatistics().reads, quint64(2));
+    QCOMPARE(l2capBackend->readStatistics().readyReadSignals, quint64(2));
+
+    l2capSocket.abort();
+    ::close(fds[1]);
+#else
+    QSKIP("Requires the BlueZ socket backend and a developer build");
+#endif
+}
+
+void tst_QBluetoothSocket::tst_unbufferedWriteBlocked()
+{
+#if QT_CONFIG(bluez) && defined(QT_BUILD_INTERNAL)
+    // A SEQPACKET socket pair stands in for an L2CAP connection
+    int fds[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds), 0);
+
+    BluezSocket socket;
+    QVERIFY(socket.setSocketDescriptor(fds[0], QBluetoothServiceInfo::L2capProtocol,
+                                       QBluetoothSocket::SocketState::ConnectedState,
+                                       QIODevice::ReadWrite | QIODevice::Unbuffered));
+    QSignalSpy readyWriteSpy(socket.backend(), &QBluetoothSocketPrivateBluez::readyWrite);
+
+    // an unbuffered write returns 0 once the kernel buffer is full
+    const QByteArray packet(256, 'x');
+    qint64 written = 0;
+    int packets = 0;
+    while ((written = socket.write(packet)) > 0 && packets < 100000)
+        ++packets;
+    QCOMPARE(written, qint64(0));
+    QVERIFY(packets > 0);
+    QCoreApplication::processEvents();
+    QCOMPARE(readyWriteSpy.size(), 0);
+
+    // readyWrite() is emitted once the socket takes data again
+    QByteArray sink(packet.size(), Qt::Uninitialized);
+    while (::recv(fds[1], sink.data(), sink.size(), MSG_DONTWAIT) > 0)
+        ;
+    QTRY_COMPARE(readyWriteSpy.size(), 1);
+    QCOMPARE(socket.write(packet), qint64(packet.size()));
+    QCoreApplication::processEvents();
+    QCOMPARE(readyWriteSpy.size(), 1);
+
+    socket.abort();
+    ::close(fds[1]);
+#else
+    QSKIP("Requires the BlueZ socket backend and a developer build");
+#endif
+}
+
 QTEST_MAIN(tst_QBluetoothSocket)
 
 #include "tst_qbluetoothsocket.moc"
@@ -22,6 +22,8 @@ typedef QSharedPointer<QLowEnergyService> ServicePtr;
 static QHash<QBluetoothUuid, ServicePtr> services;
 static int descriptorWriteCount = 0;
 static int disconnectCount = 0;
+// keep serving the centrals of repeatedDiscoveryBenchmark after serverCommunication
+static bool keepServing = false;
 static QBluetoothAddress remoteDevice;
 
 void addService(const QLowEnergyServiceData &serviceData)
@@ -151,6 +153,7 @@ void startAdvertising()
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
+    keepServing = qEnvironmentVariableIntValue("QT_BT_GATTSERVER_TEST_CENTRALS") > 0;
     leController.reset(QLowEnergyController::createPeripheral());
     addRunningSpeedService();
     addGenericAccessService();
@@ -166,8 +169,11 @@ int main(int argc, char *argv[])
             remoteDevice = leController->remoteAddress();
             break;
         case QLowEnergyController::UnconnectedState: {
-            if (++disconnectCount == 2) {
-                qApp->quit();
+            if (++disconnectCount >= 2) {
+                if (keepServing)
+                    startAdvertising();
+                else
+                    qApp->quit();
                 break;
             }
             Q_ASSERT(disconnectCount == 1);
@@ -21,6 +21,19 @@
 #ifdef Q_OS_LINUX
 #include <QtBluetooth/private/lecmaccalculator_p.h>
 #endif
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+#include <QtBluetooth/private/attpdu_p.h>
+#include <QtBluetooth/private/bondstatecache_p.h>
+#include <QtBluetooth/private/gattcache_p.h>
+#include <QtBluetooth/private/qlowenergycontroller_bluez_p.h>
+#include <QtBluetooth/private/signcounterstore_p.h>
+#include <QtCore/qscopeguard.h>
+#include <QtCore/qsettings.h>
+#include <QtCore/qtemporarydir.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 #include <algorithm>
 #include <cstring>
@@ -37,15 +50,26 @@ private slots:
     // Static, local stuff goes here.
     void advertisingParameters();
     void advertisingData();
+    void attPduView();
+    void attPduViewBenchmark();
     void cmacVerifier();
     void cmacVerifier_data();
+    void cmacBenchmark();
     void connectionParameters();
     void controllerType();
+    void gattCache();
     void serviceData();
+    void signCounterStore();
+    void bondStateCache();
+    void multipleCentrals();
+    void notificationQueue();
+    void attMtu();
+    void readMultiple();
 
     // Interaction with actual GATT server goes here. Order is relevant.
     void advertisedData();
     void serverCommunication();
+    void repeatedDiscoveryBenchmark();
 
 private:
     QBluetoothAddress m_serverAddress;
@@ -138,6 +162,140 @@ void TestQLowEnergyControllerGattServer::advertisingData()
     QVERIFY(data != QLowEnergyAdvertisingData());
 }
 
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+// Reads the next ATT PDU which the controller sent to a central, if any
+static QByteArray receivePdu(int peerSocket)
+{
+    char buffer[512];
+    const ssize_t size = ::recv(peerSocket, buffer, sizeof buffer, MSG_DONTWAIT);
+    return size > 0 ? QByteArray(buffer, size) : QByteArray();
+}
+#endif
+
+void TestQLowEnergyControllerGattServer::attPduView()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    const QByteArray mtuResponse = QByteArray::fromHex("031700");
+    const AttPduView mtu(mtuResponse);
+    QCOMPARE(mtu.opcode(), QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_RESPONSE);
+    QCOMPARE(mtu.mtu(), quint16(23));
+    // the view must not copy
+    QVERIFY(mtu.constData() == mtuResponse.constData());
+
+    const QByteArray groupResponseData = QByteArray::fromHex("1106010007000018080011000118");
+    const AttPduView groupResponse(groupResponseData);
+    QCOMPARE(groupResponse.elementLength(), quint8(6));
+    QCOMPARE(groupResponse.elementCount(groupResponse.elementLength()), qsizetype(2));
+    const char *second = groupResponse.element(1, 6);
+    QCOMPARE(bt_get_le16(second), quint16(0x0008));
+    QCOMPARE(bt_get_le16(second + 2), quint16(0x0011));
+    QCOMPARE(bt_get_le16(second + 4), quint16(0x1801));
+
+    const QByteArray groupRequestData = QByteArray::fromHex("10010010ff0028");
+    const AttPduView groupRequest(groupRequestData);
+    QCOMPARE(groupRequest.startingHandle(), QLowEnergyHandle(0x0001));
+    QCOMPARE(groupRequest.endingHandle(), QLowEnergyHandle(0xff10));
+    QCOMPARE(groupRequest.attributeType(), QBluetoothUuid(quint16(0x2800)));
+    const QByteArray invalidTypeRequestData = QByteArray::fromHex("10010010ff002800");
+    const AttPduView invalidTypeRequest(invalidTypeRequestData);
+    QVERIFY(invalidTypeRequest.attributeType().isNull());
+
+    const QByteArray notificationData = QByteArray::fromHex("1b0e00164a01");
+    const AttPduView notification(notificationData);
+    QCOMPARE(notification.opcode(), QBluezConst::AttCommand::ATT_OP_HANDLE_VAL_NOTIFICATION);
+    QCOMPARE(notification.attributeHandle(), QLowEnergyHandle(0x000e));
+    QCOMPARE(notification.handleValue().toByteArray(), QByteArray::fromHex("164a01"));
+
+    const QByteArray blobData = QByteArray::fromHex("0c0f000400");
+    const AttPduView blob(blobData);
+    QCOMPARE(blob.attributeHandle(), QLowEnergyHandle(0x000f));
+    QCOMPARE(blob.valueOffset(), quint16(4));
+
+    const QByteArray errorData = QByteArray::fromHex("010a0f000a");
+    const AttPduView error(errorData);
+    QCOMPARE(error.errorRequestOpcode(), QBluezConst::AttCommand::ATT_OP_READ_REQUEST);
+    QCOMPARE(error.errorHandle(), QLowEnergyHandle(0x000f));
+    QCOMPARE(error.errorCode(), QBluezConst::AttError::ATT_ERROR_ATTRIBUTE_NOT_FOUND);
+
+    const QByteArray writeRequestData = QByteArray::fromHex("120f00");
+    const AttPduView writeRequest(writeRequestData);
+    QVERIFY(writeRequest.handleValue().isEmpty());
+#else
+    QSKIP("ATT PDU parser test only applicable for developer builds with BlueZ");
+#endif
+}
+
+void TestQLowEnergyControllerGattServer::attPduViewBenchmark()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    // The requests of a central reach the controller through a SEQPACKET socket pair, so
+    // each of them passes the receive buffer, AttPduView and dispatchIncomingPdu().
+    qputenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL", "1");
+    const QScopedPointer<QLowEnergyController> controller(QLowEnergyController::createPeripheral());
+    qunsetenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL");
+    QVERIFY(!controller.isNull());
+    auto *d = qobject_cast<QLowEnergyControllerPrivateBluez *>(
+            QLowEnergyControllerPrivate::get(controller.data()));
+    QVERIFY(d);
+
+    // handles: service 1, characteristic declaration 2, value 3, CCCD 4
+    QLowEnergyCharacteristicData charData;
+    charData.setUuid(QBluetoothUuid::CharacteristicType::HeartRateMeasurement);
+    charData.setProperties(QLowEnergyCharacteristic::Read | QLowEnergyCharacteristic::Write
+                           | QLowEnergyCharacteristic::Notify);
+    charData.setValue(QByteArray::fromHex("164a01"));
+    charData.setValueLength(1, 50);
+    charData.addDescriptor(QLowEnergyDescriptorData(
+            QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration,
+            QByteArray(2, 0)));
+    QLowEnergyServiceData serviceData;
+    serviceData.setUuid(QBluetoothUuid::ServiceClassUuid::HeartRate);
+    serviceData.addCharacteristic(charData);
+    const QScopedPointer<QLowEnergyService> service(controller->addService(serviceData));
+    QVERIFY(!service.isNull());
+
+    int central[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, central), 0);
+    const auto closePeer = qScopeGuard([&] { ::close(central[1]); });
+    d->setState(QLowEnergyController::AdvertisingState);
+    QVERIFY(d->acceptCentral(central[0], QBluetoothAddress(QStringLiteral("AA:BB:CC:DD:EE:01"))));
+
+    // the requests of a client discovering and accessing the service, one response each
+    const QList<QByteArray> requests = {
+        QByteArray::fromHex("10010010ff0028"), // read by group type request
+        QByteArray::fromHex("08010010ff0328"), // read by type request
+        QByteArray::fromHex("04010010ff"), // find information request
+        QByteArray::fromHex("0a0300"), // read request
+        QByteArray::fromHex("0c03000100"), // read blob request
+        QByteArray::fromHex("120300164b01"), // write request
+        QByteArray::fromHex("1204000000"), // write request (CCCD, no notifications)
+    };
+    const quint64 receivedBefore = d->pduStatistics().pdusReceived;
+    quint64 iterations = 0;
+    quint64 responses = 0;
+    QBENCHMARK {
+        for (const QByteArray &request : requests)
+            QCOMPARE(::send(central[1], request.constData(), request.size(), 0),
+                     ssize_t(request.size()));
+        qsizetype received = 0;
+        QDeadlineTimer deadline(5000);
+        while (received < requests.size() && !deadline.hasExpired()) {
+            QCoreApplication::processEvents();
+            while (!receivePdu(central[1]).isEmpty())
+                ++received;
+        }
+        QCOMPARE(received, requests.size());
+        ++iterations;
+        responses += received;
+    }
+    QCOMPARE(d->pduStatistics().pdusReceived - receivedBefore, iterations * requests.size());
+    QCOMPARE(responses, iterations * requests.size());
+    QCOMPARE(controller->state(), QLowEnergyController::ConnectedState);
+#else
+    QSKIP("ATT PDU dispatch benchmark only applicable for developer builds with BlueZ");
+#endif
+}
+
 void TestQLowEnergyControllerGattServer::cmacVerifier()
 {
 #if defined(CONFIG_LINUX_CRYPTO_API) && defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
@@ -157,6 +315,18 @@ void TestQLowEnergyControllerGattServer::cmacVerifier()
 
     const bool success = LeCmacCalculator().verify(message, csrk, expectedMac);
     QVERIFY(success);
+
+    // the cached crypto sockets must yield the same result for repeated and interleaved keys
+    const QUuid::Id128Bytes otherCsrk = {
+        { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+          0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10 }
+    };
+    const LeCmacCalculator calculator;
+    QVERIFY(calculator.verify(message, csrk, expectedMac));
+    const quint64 otherMac = calculator.calculateMac(message, otherCsrk);
+    QVERIFY(otherMac != expectedMac);
+    QVERIFY(calculator.verify(message, csrk, expectedMac));
+    QCOMPARE(calculator.calculateMac(message, otherCsrk), otherMac);
 #else // CONFIG_LINUX_CRYPTO_API
     QSKIP("CMAC verification test only applicable for developer builds on Linux "
           "with BlueZ and crypto API");
@@ -220,6 +390,39 @@ void TestQLowEnergyControllerGattServer::cmacVerifier_data()
     QTest::newRow("D1.4") << messageD14 << Q_UINT64_C(0x51f0bebf7e3b9d92);
 }
 
+void TestQLowEnergyControllerGattServer::cmacBenchmark()
+{
+#if defined(CONFIG_LINUX_CRYPTO_API) && defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    // Test data comes from spec v4.2, Vol 3, Part H, Appendix D.1
+    const QUuid::Id128Bytes csrk = {
+        { 0x3c, 0x4f, 0xcf, 0x09, 0x88, 0x15, 0xf7, 0xab,
+          0xa6, 0xd2, 0xae, 0x28, 0x16, 0x15, 0x7e, 0x2b }
+    };
+#if defined(CHECK_CMAC_SUPPORT)
+    if (!checkCmacSupport(csrk)) {
+        QSKIP("Needed socket options not available. Running qemu?");
+    }
+#endif
+
+    // signed write of a 20 byte value: opcode, handle, value and sign counter
+    const QByteArray message = LeCmacCalculator::createFullMessage(
+                QByteArray::fromHex("d21200") + QByteArray(20, 'x'), 1);
+    const quint64 expectedMac = LeCmacCalculator().calculateMac(message, csrk);
+    QVERIFY(expectedMac != 0);
+
+    const LeCmacCalculator calculator;
+    bool success = true;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i)
+            success &= calculator.verify(message, csrk, expectedMac);
+    }
+    QVERIFY(success);
+#else
+    QSKIP("CMAC benchmark only applicable for developer builds on Linux "
+          "with BlueZ and crypto API");
+#endif
+}
+
 void TestQLowEnergyControllerGattServer::connectionParameters()
 {
     QLowEnergyConnectionParameters connParams;
@@ -526,6 +729,58 @@ void TestQLowEnergyControllerGattServer::serverCommunication()
     }
 }
 
+// Simulates a burst of centrals reconnecting and running full discovery, as happens
+// after the server device power-cycles. QT_BT_GATTSERVER_TEST_CENTRALS sets their number.
+// It has to be set for the server application as well, so that it keeps advertising
+// after serverCommunication.
+void TestQLowEnergyControllerGattServer::repeatedDiscoveryBenchmark()
+{
+    if (m_serverAddress.isNull())
+        QSKIP("No server address provided");
+    const int centralCount = qEnvironmentVariableIntValue("QT_BT_GATTSERVER_TEST_CENTRALS");
+    if (centralCount <= 0)
+        QSKIP("QT_BT_GATTSERVER_TEST_CENTRALS is not set");
+
+    // the server accepts one central at a time and advertises again once it is gone
+    if (m_leController && m_leController->state() != QLowEnergyController::UnconnectedState) {
+        m_leController->disconnectFromDevice();
+        QTRY_COMPARE_WITH_TIMEOUT(m_leController->state(),
+                                  QLowEnergyController::UnconnectedState, 5000);
+    }
+
+    QBENCHMARK {
+        for (int i = 0; i < centralCount; ++i) {
+            const QScopedPointer<QLowEnergyController> controller(
+                        QLowEnergyController::createCentral(m_serverInfo));
+            QVERIFY(!controller.isNull());
+            QSignalSpy connectedSpy(controller.data(), &QLowEnergyController::connected);
+            controller->connectToDevice();
+            QVERIFY(connectedSpy.wait(30000));
+            QSignalSpy discoverySpy(controller.data(), &QLowEnergyController::discoveryFinished);
+            controller->discoverServices();
+            QVERIFY(discoverySpy.wait(30000));
+
+            const QList<QBluetoothUuid> serviceUuids = controller->services();
+            QList<QLowEnergyService *> services;
+            for (const QBluetoothUuid &uuid : serviceUuids) {
+                QLowEnergyService * const service = controller->createServiceObject(uuid);
+                QVERIFY(service);
+                services << service;
+                service->discoverDetails(QLowEnergyService::SkipValueDiscovery);
+            }
+            for (QLowEnergyService * const service : std::as_const(services)) {
+                QTRY_COMPARE_WITH_TIMEOUT(service->state(),
+                                          QLowEnergyService::RemoteServiceDiscovered, 10000);
+            }
+            qDeleteAll(services);
+
+            controller->disconnectFromDevice();
+            QTRY_COMPARE_WITH_TIMEOUT(controller->state(),
+                                      QLowEnergyController::UnconnectedState, 5000);
+        }
+    }
+}
+
 void TestQLowEnergyControllerGattServer::controllerType()
 {
     const QScopedPointer<QLowEnergyController> controller(QLowEnergyController::createPeripheral());
@@ -533,6 +788,777 @@ void TestQLowEnergyControllerGattServer::controllerType()
     QCOMPARE(controller->role(), QLowEnergyController::PeripheralRole);
 }
 
+void TestQLowEnergyControllerGattServer::gattCache()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filePath = dir.filePath(QStringLiteral("device/qt_gatt_cache"));
+    QVERIFY(GattCache::load(filePath).isEmpty());
+
+    GattCache::Database database;
+    database.databaseHash = QByteArray::fromHex("f1ca3e63b5cd2bbd33bf3f7a8cf3d1e6");
+    GattCache::Service gap;
+    gap.uuid = QBluetoothUuid(QBluetoothUuid::ServiceClassUuid::GenericAccess);
+    gap.startHandle = 0x0001;
+    gap.endHandle = 0x0005;
+    database.services << gap;
+    GattCache::Service custom;
+    custom.uuid = QBluetoothUuid(QStringLiteral("c47774c7-f237-4523-8968-e4ae75431daf"));
+    custom.startHandle = 0x0006;
+    custom.endHandle = 0xffff;
+    custom.type = QLowEnergyService::PrimaryService | QLowEnergyService::IncludedService;
+    custom.includedServices << gap.uuid;
+    custom.hasDetails = true;
+    GattCache::Characteristic characteristic;
+    characteristic.handle = 0x0007;
+    characteristic.valueHandle = 0x0008;
+    characteristic.uuid = QBluetoothUuid(quint16(0x5000));
+    characteristic.properties = QLowEnergyCharacteristic::Read | QLowEnergyCharacteristic::Notify;
+    characteristic.descriptors << GattCache::Descriptor{
+        0x0009, QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration };
+    custom.characteristics << characteristic;
+    database.services << custom;
+
+    QVERIFY(GattCache::save(filePath, database));
+    GattCache::Database loaded = GattCache::load(filePath);
+    QCOMPARE(loaded.databaseHash, database.databaseHash);
+    QCOMPARE(loaded.services.size(), qsizetype(2));
+    QVERIFY(!loaded.service(gap.uuid)->hasDetails);
+    const GattCache::Service *loadedCustom = loaded.service(custom.uuid);
+    QVERIFY(loadedCustom);
+    QCOMPARE(loadedCustom->startHandle, custom.startHandle);
+    QCOMPARE(loadedCustom->endHandle, custom.endHandle);
+    QCOMPARE(loadedCustom->type, custom.type);
+    QCOMPARE(loadedCustom->includedServices, custom.includedServices);
+    QVERIFY(loadedCustom->hasDetails);
+    QCOMPARE(loadedCustom->characteristics.size(), qsizetype(1));
+    const GattCache::Characteristic &loadedChar = loadedCustom->characteristics.first();
+    QCOMPARE(loadedChar.handle, characteristic.handle);
+    QCOMPARE(loadedChar.valueHandle, characteristic.valueHandle);
+    QCOMPARE(loadedChar.uuid, characteristic.uuid);
+    QCOMPARE(loadedChar.properties, characteristic.properties);
+    QCOMPARE(loadedChar.descriptors.size(), qsizetype(1));
+    QCOMPARE(loadedChar.descriptors.first().handle, QLowEnergyHandle(0x0009));
+    QCOMPARE(loadedChar.descriptors.first().uuid, characteristic.descriptors.first().uuid);
+
+    // the controller drops a cache whose Database Hash differs from the one of the device
+    qputenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL", "1");
+    const QScopedPointer<QLowEnergyController> controller(QLowEnergyController::createPeripheral());
+    qunsetenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL");
+    QVERIFY(!controller.isNull());
+    auto *d = qobject_cast<QLowEnergyControllerPrivateBluez *>(
+            QLowEnergyControllerPrivate::get(controller.data()));
+    QVERIFY(d);
+    QSignalSpy serviceSpy(controller.data(), &QLowEnergyController::serviceDiscovered);
+    QSignalSpy finishedSpy(controller.data(), &QLowEnergyController::discoveryFinished);
+    // without a remote device, the requests stay queued
+    d->requestPending = true;
+    const QByteArray changedHash = QByteArray::fromHex("00112233445566778899aabbccddeeff");
+    d->gattCache = GattCache::load(filePath);
+    d->processDatabaseHash(changedHash);
+    QVERIFY(d->gattCacheValid);
+    QVERIFY(d->gattCache.isEmpty());
+    QCOMPARE(d->gattCache.databaseHash, changedHash);
+    QCOMPARE(d->openRequests.size(), qsizetype(1));
+    QCOMPARE(d->openRequests.head().command,
+             QBluezConst::AttCommand::ATT_OP_READ_BY_GROUP_REQUEST);
+    QCOMPARE(serviceSpy.size(), 0);
+    QCOMPARE(finishedSpy.size(), 0);
+    d->openRequests.clear();
+
+    // a matching hash restores the services without any request, their details on demand
+    d->gattCache = GattCache::load(filePath);
+    d->processDatabaseHash(database.databaseHash);
+    QVERIFY(d->openRequests.isEmpty());
+    QCOMPARE(serviceSpy.size(), 2);
+    QCOMPARE(finishedSpy.size(), 1);
+    QCOMPARE(controller->services().size(), qsizetype(2));
+    const QSharedPointer<QLowEnergyServicePrivate> restoredCustom = d->serviceList.value(custom.uuid);
+    QVERIFY(restoredCustom);
+    QCOMPARE(restoredCustom->startHandle, custom.startHandle);
+    QCOMPARE(restoredCustom->endHandle, custom.endHandle);
+    QCOMPARE(restoredCustom->type, custom.type);
+    QVERIFY(d->restoreServiceDetailsFromGattCache(restoredCustom));
+    QCOMPARE(restoredCustom->includedServices, custom.includedServices);
+    QCOMPARE(restoredCustom->characteristicList.size(), qsizetype(1));
+    const QLowEnergyServicePrivate::CharData restoredChar
+            = restoredCustom->characteristicList.value(characteristic.handle);
+    QCOMPARE(restoredChar.valueHandle, characteristic.valueHandle);
+    QCOMPARE(restoredChar.uuid, characteristic.uuid);
+    QCOMPARE(restoredChar.properties, characteristic.properties);
+    QVERIFY(restoredChar.descriptorList.contains(0x0009));
+    // only the declaration of the GAP service is cached
+    QVERIFY(!d->restoreServiceDetailsFromGattCache(d->serviceList.value(gap.uuid)));
+
+    GattCache::remove(filePath);
+    QVERIFY(GattCache::load(filePath).isEmpty());
+#else
+    QSKIP("GATT cache test only applicable for developer builds with BlueZ");
+#endif
+}
+
+void TestQLowEnergyControllerGattServer::signCounterStore()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filePath = dir.filePath(QStringLiteral("info"));
+    const QString localCounter = QStringLiteral("LocalSignatureKey/Counter");
+    const QString remoteCounter = QStringLiteral("RemoteSignatureKey/Counter");
+    const auto storedCounter = [&filePath](const QString &key) {
+        return QSettings(filePath, QSettings::IniFormat).value(key).toUInt();
+    };
+    {
+        QSettings settings(filePath, QSettings::IniFormat);
+        settings.setValue(localCounter, 5);
+        settings.setValue(remoteCounter, 10);
+    }
+
+    {
+        SignCounterStore store;
+        store.setReservationSize(16);
+        store.setFlushInterval(50);
+
+        // local counters are reserved ahead of use
+        QCOMPARE(store.nextCounter(filePath, SignCounterStore::LocalKey, 5), 5u);
+        store.setNextCounter(filePath, SignCounterStore::LocalKey, 6);
+        QCOMPARE(storedCounter(localCounter), 22u);
+        for (quint32 counter = 7; counter <= 22; ++counter)
+            store.setNextCounter(filePath, SignCounterStore::LocalKey, counter);
+        QCOMPARE(store.statistics().reservations, quint64(1));
+        store.setNextCounter(filePath, SignCounterStore::LocalKey, 23);
+        QCOMPARE(storedCounter(localCounter), 39u);
+        QCOMPARE(store.statistics().reservations, quint64(2));
+
+        // remote counters are written behind
+        QCOMPARE(store.nextCounter(filePath, SignCounterStore::RemoteKey, 10), 10u);
+        store.setNextCounter(filePath, SignCounterStore::RemoteKey, 11);
+        store.setNextCounter(filePath, SignCounterStore::RemoteKey, 12);
+        QCOMPARE(storedCounter(remoteCounter), 10u);
+        QCOMPARE(store.nextCounter(filePath, SignCounterStore::RemoteKey, 10), 12u);
+        QTRY_COMPARE(storedCounter(remoteCounter), 12u);
+        QCOMPARE(store.statistics().flushes, quint64(1));
+
+        store.setNextCounter(filePath, SignCounterStore::RemoteKey, 13);
+        store.flush();
+        QCOMPARE(storedCounter(remoteCounter), 13u);
+        QCOMPARE(store.statistics().flushes, quint64(2));
+        QCOMPARE(store.statistics().failedWrites, quint64(0));
+
+        // a failed write stays pending and is repeated (root may write anyway)
+        QVERIFY(QFile::setPermissions(filePath, QFile::ReadOwner));
+        if (!QSettings(filePath, QSettings::IniFormat).isWritable()) {
+            store.setNextCounter(filePath, SignCounterStore::RemoteKey, 14);
+            store.flush();
+            QCOMPARE(store.statistics().failedWrites, quint64(1));
+            QCOMPARE(storedCounter(remoteCounter), 13u);
+            QVERIFY(QFile::setPermissions(filePath, QFile::ReadOwner | QFile::WriteOwner));
+            QTRY_COMPARE(storedCounter(remoteCounter), 14u);
+        }
+        QVERIFY(QFile::setPermissions(filePath, QFile::ReadOwner | QFile::WriteOwner));
+
+        // pending counters are written on destruction
+        store.setNextCounter(filePath, SignCounterStore::RemoteKey, 15);
+    }
+    QCOMPARE(storedCounter(remoteCounter), 15u);
+
+    // a restart continues behind all local counters that may have been used
+    SignCounterStore store;
+    QVERIFY(store.nextCounter(filePath, SignCounterStore::LocalKey,
+                              storedCounter(localCounter)) > 23u);
+#else
+    QSKIP("Sign counter store test only applicable for developer builds with BlueZ");
+#endif
+}
+
+void TestQLowEnergyControllerGattServer::bondStateCache()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    const QString adapter1 = QStringLiteral("org.bluez.Adapter1");
+    const QString device1 = QStringLiteral("org.bluez.Device1");
+    const QBluetoothAddress localAdapter(QStringLiteral("00:11:22:33:44:55"));
+    const QBluetoothAddress otherAdapter(QStringLiteral("00:11:22:33:44:66"));
+    const QBluetoothAddress remote(QStringLiteral("AA:BB:CC:DD:EE:01"));
+    const QDBusObjectPath adapterPath(QStringLiteral("/org/bluez/hci0"));
+    const QString devicePath = QStringLiteral("/org/bluez/hci0/dev_AA_BB_CC_DD_EE_01");
+    const QVariantMap deviceProperties = {
+        { QStringLiteral("Adapter"), QVariant::fromValue(adapterPath) },
+        { QStringLiteral("Address"), remote.toString() },
+        { QStringLiteral("Paired"), false }
+    };
+
+    QtBluezBondStateCache cache;
+    // a device announced before its adapter is indexed once the adapter is known
+    cache.interfacesAdded(QDBusObjectPath(devicePath), { { device1, deviceProperties } });
+    QVERIFY(!cache.isBonded(localAdapter, remote));
+    cache.interfacesAdded(adapterPath, { { adapter1, {
+        { QStringLiteral("Address"), localAdapter.toString() } } } });
+    QVERIFY(!cache.isBonded(localAdapter, remote));
+
+    // unpaired devices are not kept, the pairing is picked up from the object path
+    cache.propertiesChanged(devicePath, device1, { { QStringLiteral("RSSI"), -50 } }, {});
+    QVERIFY(!cache.isBonded(localAdapter, remote));
+    cache.propertiesChanged(devicePath, device1, { { QStringLiteral("Paired"), true } }, {});
+    QVERIFY(cache.isBonded(localAdapter, remote));
+    QVERIFY(!cache.isBonded(otherAdapter, remote));
+    // only Paired and Bonded matter
+    cache.propertiesChanged(devicePath, device1, { { QStringLiteral("RSSI"), -60 } },
+                            { QStringLiteral("Alias") });
+    QVERIFY(cache.isBonded(localAdapter, remote));
+    // other interfaces do not change the bond state
+    cache.propertiesChanged(devicePath, QStringLiteral("org.bluez.Battery1"),
+                            { { QStringLiteral("Paired"), false } }, {});
+    QVERIFY(cache.isBonded(localAdapter, remote));
+
+    // BlueZ 5.70 and later report bonding separately
+    cache.propertiesChanged(devicePath, device1, { { QStringLiteral("Paired"), false },
+                                                   { QStringLiteral("Bonded"), true } }, {});
+    QVERIFY(cache.isBonded(localAdapter, remote));
+    cache.propertiesChanged(devicePath, device1, {}, { QStringLiteral("Bonded") });
+    QVERIFY(!cache.isBonded(localAdapter, remote));
+
+    cache.propertiesChanged(devicePath, device1, { { QStringLiteral("Paired"), true } }, {});
+    QVERIFY(cache.isBonded(localAdapter, remote));
+    cache.interfacesRemoved(QDBusObjectPath(devicePath), { device1 });
+    QVERIFY(!cache.isBonded(localAdapter, remote));
+
+    QVariantMap pairedProperties = deviceProperties;
+    pairedProperties.insert(QStringLiteral("Paired"), true);
+    cache.interfacesAdded(QDBusObjectPath(devicePath), { { device1, pairedProperties } });
+    QVERIFY(cache.isBonded(localAdapter, remote));
+    cache.interfacesRemoved(adapterPath, { adapter1 });
+    QVERIFY(!cache.isBonded(localAdapter, remote));
+#else
+    QSKIP("Bond state cache test only applicable for developer builds with BlueZ");
+#endif
+}
+
+void TestQLowEnergyControllerGattServer::multipleCentrals()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    // Only the kernel ATT backend serves several centrals. A SEQPACKET socket pair keeps the
+    // PDU boundaries, so the controller gets one end as the connection of each central.
+    qputenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL", "1");
+    const QScopedPointer<QLowEnergyController> controller(QLowEnergyController::createPeripheral());
+    qunsetenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL");
+    QVERIFY(!controller.isNull());
+    auto *d = qobject_cast<QLowEnergyControllerPrivateBluez *>(
+            QLowEnergyControllerPrivate::get(controller.data()));
+    QVERIFY(d);
+
+    QCOMPARE(controller->maximumCentralCount(), 1);
+    controller->setMaximumCentralCount(0);
+    QCOMPARE(controller->maximumCentralCount(), 1);
+    controller->setMaximumCentralCount(2);
+    QCOMPARE(controller->maximumCentralCount(), 2);
+
+    // handles: service 1, characteristic declaration 2, value 3, CCCD 4
+    QLowEnergyCharacteristicData charData;
+    charData.setUuid(QBluetoothUuid::CharacteristicType::BatteryLevel);
+    charData.setProperties(QLowEnergyCharacteristic::Read | QLowEnergyCharacteristic::Notify);
+    charData.setValue(QByteArray(1, 0));
+    charData.setValueLength(1, 50);
+    charData.addDescriptor(QLowEnergyDescriptorData(
+            QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration,
+            QByteArray(2, 0)));
+    QLowEnergyServiceData serviceData;
+    serviceData.setUuid(QBluetoothUuid::ServiceClassUuid::BatteryService);
+    serviceData.addCharacteristic(charData);
+    const QScopedPointer<QLowEnergyService> service(controller->addService(serviceData));
+    QVERIFY(!service.isNull());
+    const QLowEnergyCharacteristic characteristic
+            = service->characteristic(QBluetoothUuid::CharacteristicType::BatteryLevel);
+    QVERIFY(characteristic.isValid());
+    const QLowEnergyDescriptor cccd = characteristic.clientCharacteristicConfiguration();
+    QVERIFY(cccd.isValid());
+
+    int centralA[2];
+    int centralB[2];
+    int centralC[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, centralA), 0);
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, centralB), 0);
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, centralC), 0);
+    const auto closePeers = qScopeGuard([&] {
+        ::close(centralA[1]);
+        ::close(centralB[1]);
+        ::close(centralC[1]);
+    });
+    const auto sendPdu = [](int peerSocket, const QByteArray &pdu) {
+        return ::send(peerSocket, pdu.constData(), pdu.size(), 0) == pdu.size();
+    };
+    QByteArray pdu;
+
+    // the first central becomes the one reported by the public API
+    QSignalSpy connectedSpy(controller.data(), &QLowEnergyController::connected);
+    d->setState(QLowEnergyController::AdvertisingState);
+    const QBluetoothAddress addressA(QStringLiteral("AA:BB:CC:DD:EE:01"));
+    QVERIFY(d->acceptCentral(centralA[0], addressA));
+    QCOMPARE(connectedSpy.size(), 1);
+    QCOMPARE(controller->state(), QLowEnergyController::ConnectedState);
+    QCOMPARE(controller->remoteAddress(), addressA);
+    QCOMPARE(d->centralCount(), 1);
+
+    // MTU exchange and subscription of central A
+    QSignalSpy mtuSpy(controller.data(), &QLowEnergyController::mtuChanged);
+    QVERIFY(sendPdu(centralA[1], QByteArray::fromHex("026400")));
+    QTRY_VERIFY(!(pdu = receivePdu(centralA[1])).isEmpty());
+    QCOMPARE(pdu.size(), 3);
+    QCOMPARE(quint8(pdu.at(0)), quint8(0x03));
+    QCOMPARE(controller->mtu(), 100);
+    QCOMPARE(mtuSpy.size(), 1);
+    QVERIFY(sendPdu(centralA[1], QByteArray::fromHex("1204000100")));
+    QTRY_VERIFY(!(pdu = receivePdu(centralA[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("13"));
+    QTRY_COMPARE(service->characteristic(characteristic.uuid())
+                         .clientCharacteristicConfiguration().value(),
+                 QByteArray::fromHex("0100"));
+
+    // a second central while connected, it has the default MTU and no subscription
+    const QBluetoothAddress addressB(QStringLiteral("AA:BB:CC:DD:EE:02"));
+    QVERIFY(d->acceptCentral(centralB[0], addressB));
+    QCOMPARE(connectedSpy.size(), 1);
+    QCOMPARE(d->centralCount(), 2);
+    QCOMPARE(controller->remoteAddress(), addressA);
+    QCOMPARE(controller->mtu(), 100);
+    QVERIFY(sendPdu(centralB[1], QByteArray::fromHex("0a0400")));
+    QTRY_VERIFY(!(pdu = receivePdu(centralB[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("0b0000"));
+    QVERIFY(sendPdu(centralA[1], QByteArray::fromHex("0a0400")));
+    QTRY_VERIFY(!(pdu = receivePdu(centralA[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("0b0100"));
+
+    // a notification goes to the subscribed central only
+    const QByteArray longValue(30, 'x');
+    service->writeCharacteristic(characteristic, longValue);
+    QTRY_VERIFY(!(pdu = receivePdu(centralA[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("1b0300") + longValue);
+    QTest::qWait(50);
+    QVERIFY(receivePdu(centralB[1]).isEmpty());
+
+    // once subscribed, central B gets the value truncated to its own MTU
+    QVERIFY(sendPdu(centralB[1], QByteArray::fromHex("1204000100")));
+    QTRY_VERIFY(!(pdu = receivePdu(centralB[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("13"));
+    QCOMPARE(controller->mtu(), 100);
+    QCOMPARE(mtuSpy.size(), 1);
+    const QByteArray nextValue(30, 'y');
+    service->writeCharacteristic(characteristic, nextValue);
+    QTRY_VERIFY(!(pdu = receivePdu(centralA[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("1b0300") + nextValue);
+    QTRY_VERIFY(!(pdu = receivePdu(centralB[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("1b0300") + nextValue.left(20));
+
+    // beyond the limit a central is refused, its connection is closed
+    const QBluetoothAddress addressC(QStringLiteral("AA:BB:CC:DD:EE:03"));
+    QVERIFY(!d->acceptCentral(centralC[0], addressC));
+    QCOMPARE(d->centralCount(), 2);
+    char byte;
+    QCOMPARE(::recv(centralC[1], &byte, sizeof byte, MSG_DONTWAIT), ssize_t(0));
+    ::close(centralC[1]);
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, centralC), 0);
+
+    // stopping the advertisement while connected keeps the centrals
+    controller->stopAdvertising();
+    QCOMPARE(controller->state(), QLowEnergyController::ConnectedState);
+    QCOMPARE(d->centralCount(), 2);
+
+    // a disconnected central makes room for another one
+    QSignalSpy disconnectedSpy(controller.data(), &QLowEnergyController::disconnected);
+    ::shutdown(centralB[1], SHUT_RDWR);
+    QTRY_COMPARE(d->centralCount(), 1);
+    QCOMPARE(disconnectedSpy.size(), 0);
+    QCOMPARE(controller->state(), QLowEnergyController::ConnectedState);
+    QCOMPARE(controller->remoteAddress(), addressA);
+    QVERIFY(d->acceptCentral(centralC[0], addressC));
+    QCOMPARE(d->centralCount(), 2);
+    QVERIFY(sendPdu(centralC[1], QByteArray::fromHex("0a0400")));
+    QTRY_VERIFY(!(pdu = receivePdu(centralC[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("0b0000"));
+#else
+    QSKIP("Multiple central test only applicable for developer builds with BlueZ");
+#endif
+}
+
+void TestQLowEnergyControllerGattServer::notificationQueue()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    qputenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL", "1");
+    const QScopedPointer<QLowEnergyController> controller(QLowEnergyController::createPeripheral());
+    qunsetenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL");
+    QVERIFY(!controller.isNull());
+    auto *d = qobject_cast<QLowEnergyControllerPrivateBluez *>(
+            QLowEnergyControllerPrivate::get(controller.data()));
+    QVERIFY(d);
+
+    // handles: service 1, notified value 3 with CCCD 4, indicated value 6 with CCCD 7
+    QLowEnergyServiceData serviceData;
+    serviceData.setUuid(QBluetoothUuid::ServiceClassUuid::BatteryService);
+    for (const auto property : { QLowEnergyCharacteristic::Notify,
+                                 QLowEnergyCharacteristic::Indicate }) {
+        QLowEnergyCharacteristicData charData;
+        charData.setUuid(QBluetoothUuid(quint16(0xff00 + property)));
+        charData.setProperties(property);
+        charData.setValue(QByteArray(2, 0));
+        charData.setValueLength(2, 2);
+        charData.addDescriptor(QLowEnergyDescriptorData(
+                QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration,
+                QByteArray(2, 0)));
+        serviceData.addCharacteristic(charData);
+    }
+    const QScopedPointer<QLowEnergyService> service(controller->addService(serviceData));
+    QVERIFY(!service.isNull());
+    const QLowEnergyCharacteristic notified = service->characteristic(
+            QBluetoothUuid(quint16(0xff00 + QLowEnergyCharacteristic::Notify)));
+    const QLowEnergyCharacteristic indicated = service->characteristic(
+            QBluetoothUuid(quint16(0xff00 + QLowEnergyCharacteristic::Indicate)));
+    QVERIFY(notified.isValid());
+    QVERIFY(indicated.isValid());
+    const auto valueOf = [](int i) {
+        QByteArray value(2, Qt::Uninitialized);
+        qToLittleEndian<quint16>(i, value.data());
+        return value;
+    };
+
+    int central[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, central), 0);
+    const auto closePeer = qScopeGuard([&] { ::close(central[1]); });
+    // the smallest send buffer lets the controller run out of socket space quickly
+    const int bufferSize = 1;
+    QCOMPARE(::setsockopt(central[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof bufferSize), 0);
+    const auto sendPdu = [](int peerSocket, const QByteArray &pdu) {
+        return ::send(peerSocket, pdu.constData(), pdu.size(), 0) == pdu.size();
+    };
+    QByteArray pdu;
+
+    d->setState(QLowEnergyController::AdvertisingState);
+    QVERIFY(d->acceptCentral(central[0], QBluetoothAddress(QStringLiteral("AA:BB:CC:DD:EE:01"))));
+    QVERIFY(sendPdu(central[1], QByteArray::fromHex("1204000100")));
+    QTRY_VERIFY(!(pdu = receivePdu(central[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("13"));
+    QVERIFY(sendPdu(central[1], QByteArray::fromHex("1207000200")));
+    QTRY_VERIFY(!(pdu = receivePdu(central[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("13"));
+
+    QVERIFY(!d->isNotificationCoalescingEnabled());
+    d->setNotificationCoalescingEnabled(true);
+    QVERIFY(d->isNotificationCoalescingEnabled());
+
+    // the central does not read, so notifications are queued once the socket is full
+    const auto initial = d->notificationStatistics();
+    int value = 0;
+    while (d->notificationStatistics().deferred == initial.deferred && value < 1000)
+        service->writeCharacteristic(notified, valueOf(++value));
+    QVERIFY(d->notificationStatistics().deferred > initial.deferred);
+    const quint64 sentBeforeQueueing = d->notificationStatistics().sent - initial.sent;
+
+    // newer values replace the queued notification
+    for (int i = 0; i < 10; ++i)
+        service->writeCharacteristic(notified, valueOf(++value));
+    auto stats = d->notificationStatistics();
+    QCOMPARE(stats.coalesced - initial.coalesced, quint64(10));
+    QCOMPARE(stats.sent - initial.sent, sentBeforeQueueing);
+    QCOMPARE(stats.dropped, initial.dropped);
+
+    // an indication queues behind the notification, the next one waits for its confirmation
+    service->writeCharacteristic(indicated, valueOf(1));
+    service->writeCharacteristic(indicated, valueOf(2));
+    stats = d->notificationStatistics();
+    QCOMPARE(stats.coalesced - initial.coalesced, quint64(10));
+
+    // once the central reads, the queue is written in order with the latest value
+    QList<QByteArray> received;
+    const auto receiveAll = [&]() {
+        while (!(pdu = receivePdu(central[1])).isEmpty())
+            received << pdu;
+        return !received.isEmpty() && quint8(received.last().at(0)) == 0x1d;
+    };
+    QTRY_VERIFY(receiveAll());
+    QCOMPARE(quint64(received.size()), sentBeforeQueueing + 2);
+    QCOMPARE(received.at(received.size() - 2), QByteArray::fromHex("1b0300") + valueOf(value));
+    QCOMPARE(received.last(), QByteArray::fromHex("1d0600") + valueOf(1));
+    stats = d->notificationStatistics();
+    QCOMPARE(stats.sent - initial.sent, sentBeforeQueueing + 2);
+    QCOMPARE(stats.dropped, initial.dropped);
+
+    // fill the socket again while the indication is still unconfirmed
+    const auto beforeLoss = d->notificationStatistics();
+    while (d->notificationStatistics().deferred == beforeLoss.deferred && value < 2000)
+        service->writeCharacteristic(notified, valueOf(++value));
+    QVERIFY(d->notificationStatistics().deferred > beforeLoss.deferred);
+    service->writeCharacteristic(indicated, valueOf(3));
+
+    // the queued notification and both scheduled indications go with the connection
+    QSignalSpy disconnectedSpy(controller.data(), &QLowEnergyController::disconnected);
+    ::shutdown(central[1], SHUT_RDWR);
+    QTRY_COMPARE(disconnectedSpy.size(), 1);
+    QCOMPARE(d->notificationStatistics().dropped - beforeLoss.dropped, quint64(3));
+#else
+    QSKIP("Notification queue test only applicable for developer builds with BlueZ");
+#endif
+}
+
+void TestQLowEnergyControllerGattServer::attMtu()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    qputenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL", "1");
+    const QScopedPointer<QLowEnergyController> controller(QLowEnergyController::createPeripheral());
+    qunsetenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL");
+    QVERIFY(!controller.isNull());
+    auto *d = qobject_cast<QLowEnergyControllerPrivateBluez *>(
+            QLowEnergyControllerPrivate::get(controller.data()));
+    QVERIFY(d);
+
+    // the preferred MTU stays within the range of LE ATT MTUs
+    controller->setPreferredMtu(10);
+    QCOMPARE(controller->preferredMtu(), 23);
+    controller->setPreferredMtu(1000);
+    QCOMPARE(controller->preferredMtu(), 512);
+    controller->setPreferredMtu(100);
+    QCOMPARE(controller->preferredMtu(), 100);
+
+    // handles: service 1, then declaration 2n and value 2n + 1 of the n-th readable characteristic
+    QLowEnergyServiceData serviceData;
+    serviceData.setUuid(QBluetoothUuid::ServiceClassUuid::DeviceInformation);
+    for (int i = 0; i < 14; ++i) {
+        QLowEnergyCharacteristicData charData;
+        charData.setUuid(QBluetoothUuid(quint16(0xff00 + i)));
+        charData.setProperties(QLowEnergyCharacteristic::Read | QLowEnergyCharacteristic::Write);
+        charData.setValue(QByteArray(1, 0));
+        charData.setValueLength(1, 200);
+        serviceData.addCharacteristic(charData);
+    }
+    // declaration 30, value 31, CCCD 32
+    QLowEnergyCharacteristicData notifyData;
+    notifyData.setUuid(QBluetoothUuid::CharacteristicType::BatteryLevel);
+    notifyData.setProperties(QLowEnergyCharacteristic::Notify);
+    notifyData.setValue(QByteArray(1, 0));
+    notifyData.setValueLength(1, 200);
+    notifyData.addDescriptor(QLowEnergyDescriptorData(
+            QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration,
+            QByteArray(2, 0)));
+    serviceData.addCharacteristic(notifyData);
+    const QScopedPointer<QLowEnergyService> service(controller->addService(serviceData));
+    QVERIFY(!service.isNull());
+    const QSharedPointer<QLowEnergyServicePrivate> servicePrivate = d->localServices.first();
+    const QLowEnergyHandle valueHandle = 3;
+
+    // the client applies the smaller of both Rx MTUs, but at least the default one
+    QLowEnergyControllerPrivateBluez::Request mtuRequest;
+    mtuRequest.command = QBluezConst::AttCommand::ATT_OP_EXCHANGE_MTU_REQUEST;
+    d->processReply(mtuRequest, AttPduView(QByteArray::fromHex("03c800")));
+    QCOMPARE(controller->mtu(), 100);
+    d->processReply(mtuRequest, AttPduView(QByteArray::fromHex("034000")));
+    QCOMPARE(controller->mtu(), 64);
+    d->processReply(mtuRequest, AttPduView(QByteArray::fromHex("031000")));
+    QCOMPARE(controller->mtu(), 23);
+
+    // queued requests are rebuilt for a larger MTU, the one in flight is kept
+    const QByteArray shortValue(30, 'a');
+    const QByteArray longValue(200, 'b');
+    QList<uint> handleData;
+    for (QLowEnergyHandle handle = 2; handle < 30; handle += 2)
+        handleData.append(handle);
+    const auto inFlight = d->prepareWriteRequest(valueHandle, longValue, 0);
+    QCOMPARE(inFlight.payload.size(), 23);
+    d->openRequests.enqueue(inFlight);
+    d->requestPending = true;
+    d->openRequests.enqueue(d->prepareWriteRequest(valueHandle, shortValue, 0));
+    d->openRequests.enqueue(d->prepareWriteRequest(valueHandle, longValue, 0));
+    const auto readRequests = d->valueReadRequests(servicePrivate, handleData, true);
+    QCOMPARE(readRequests.size(), 2);
+    d->openRequests.append(readRequests);
+    const quint64 replannedBefore = d->pduStatistics().replannedRequests;
+
+    d->setMtuSize(100);
+    QCOMPARE(d->openRequests.size(), 4);
+    QCOMPARE(d->openRequests.at(0).payload, inFlight.payload);
+    // the short value fits into a single Write request now
+    QCOMPARE(d->openRequests.at(1).command, QBluezConst::AttCommand::ATT_OP_WRITE_REQUEST);
+    QCOMPARE(d->openRequests.at(1).payload, QByteArray::fromHex("120300") + shortValue);
+    // the long one is still prepared, but in larger parts
+    QCOMPARE(d->openRequests.at(2).command,
+             QBluezConst::AttCommand::ATT_OP_PREPARE_WRITE_REQUEST);
+    QCOMPARE(d->openRequests.at(2).payload, QByteArray::fromHex("1603000000") + longValue.left(95));
+    // both Read Multiple Variable batches are merged
+    QCOMPARE(d->openRequests.at(3).command,
+             QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST);
+    QCOMPARE(d->openRequests.at(3).payload.size(), 1 + 2 * handleData.size());
+    QVERIFY(d->openRequests.at(3).reference2.toBool());
+    QCOMPARE(d->pduStatistics().replannedRequests, replannedBefore + 4);
+    d->openRequests.clear();
+    d->requestPending = false;
+
+    // the server applies the smaller of both Rx MTUs and counts every PDU it sends
+    d->setMtuSize(23);
+    int central[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, central), 0);
+    const auto closePeer = qScopeGuard([&] { ::close(central[1]); });
+    d->setState(QLowEnergyController::AdvertisingState);
+    QVERIFY(d->acceptCentral(central[0], QBluetoothAddress(QStringLiteral("AA:BB:CC:DD:EE:01"))));
+    const auto statsBefore = d->pduStatistics();
+    const auto sendPdu = [&central](const QByteArray &pdu) {
+        return ::send(central[1], pdu.constData(), pdu.size(), 0) == pdu.size();
+    };
+    QByteArray pdu;
+    QVERIFY(sendPdu(QByteArray::fromHex("02c800")));
+    QTRY_VERIFY(!(pdu = receivePdu(central[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("036400"));
+    QCOMPARE(controller->mtu(), 100);
+    QVERIFY(sendPdu(QByteArray::fromHex("1220000100")));
+    QTRY_VERIFY(!(pdu = receivePdu(central[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("13"));
+    const QByteArray notifiedValue(10, 'c');
+    service->writeCharacteristic(
+            service->characteristic(QBluetoothUuid::CharacteristicType::BatteryLevel),
+            notifiedValue);
+    QTRY_VERIFY(!(pdu = receivePdu(central[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("1b1f00") + notifiedValue);
+    const auto statsAfter = d->pduStatistics();
+    QCOMPARE(statsAfter.pdusReceived, statsBefore.pdusReceived + 2);
+    QCOMPARE(statsAfter.bytesReceived, statsBefore.bytesReceived + 3 + 5);
+    QCOMPARE(statsAfter.pdusSent, statsBefore.pdusSent + 3);
+    QCOMPARE(statsAfter.bytesSent, statsBefore.bytesSent + 3 + 1 + 13);
+#else
+    QSKIP("ATT MTU test only applicable for developer builds with BlueZ");
+#endif
+}
+
+void TestQLowEnergyControllerGattServer::readMultiple()
+{
+#if defined(QT_BUILD_INTERNAL) && defined(CONFIG_BLUEZ_LE)
+    qputenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL", "1");
+    const QScopedPointer<QLowEnergyController> controller(QLowEnergyController::createPeripheral());
+    qunsetenv("QT_BLUETOOTH_USE_KERNEL_PERIPHERAL");
+    QVERIFY(!controller.isNull());
+    auto *d = qobject_cast<QLowEnergyControllerPrivateBluez *>(
+            QLowEnergyControllerPrivate::get(controller.data()));
+    QVERIFY(d);
+
+    // handles: service 1, A 2-4, B 5-7 (declaration, value, CCCD), C 8-9
+    const QBluetoothUuid uuidA(quint16(0xff01));
+    const QBluetoothUuid uuidB(quint16(0xff02));
+    const QBluetoothUuid uuidC(quint16(0xff03));
+    const QByteArray valueA("abc");
+    const QByteArray valueB("defghijklmnopqrstuvw");
+    const QByteArray valueC("x");
+    QLowEnergyServiceData serviceData;
+    serviceData.setUuid(QBluetoothUuid(quint16(0xff00)));
+    for (const auto &[uuid, value] : { std::pair(uuidA, valueA), std::pair(uuidB, valueB),
+                                       std::pair(uuidC, valueC) }) {
+        QLowEnergyCharacteristicData charData;
+        charData.setUuid(uuid);
+        charData.setValue(value);
+        if (uuid == uuidC) {
+            charData.setProperties(QLowEnergyCharacteristic::Read);
+        } else {
+            charData.setProperties(QLowEnergyCharacteristic::Read
+                                   | QLowEnergyCharacteristic::Notify);
+            charData.addDescriptor(QLowEnergyDescriptorData(
+                    QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration,
+                    QByteArray(2, 0)));
+        }
+        serviceData.addCharacteristic(charData);
+    }
+    const QScopedPointer<QLowEnergyService> service(controller->addService(serviceData));
+    QVERIFY(!service.isNull());
+    const auto valueOf = [&service](const QBluetoothUuid &uuid) {
+        return service->characteristic(uuid).value();
+    };
+    const auto cccdOf = [&service](const QBluetoothUuid &uuid) {
+        return service->characteristic(uuid).clientCharacteristicConfiguration().value();
+    };
+    const auto readMultipleRequest = [](QBluezConst::AttCommand command,
+                                        const QList<uint> &handleData) {
+        QLowEnergyControllerPrivateBluez::Request request;
+        request.command = command;
+        request.reference = QVariant::fromValue(handleData);
+        request.reference2 = false;
+        return request;
+    };
+    const auto stats = d->valueReadStatistics();
+
+    // A value cut off at the end of a variable length response is completed with a blob
+    // read, a value without any room left is read again
+    d->processReply(readMultipleRequest(
+                            QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST,
+                            { 2, 5, 8 }),
+                    AttPduView(QByteArray::fromHex("21") + QByteArray::fromHex("0100") + "A"
+                               + QByteArray::fromHex("0a00") + "DEFGH"));
+    QCOMPARE(valueOf(uuidA), QByteArray("A"));
+    QCOMPARE(valueOf(uuidB), QByteArray("DEFGH"));
+    QCOMPARE(d->valueReadStatistics().batchedValues, stats.batchedValues + 2);
+    QCOMPARE(d->openRequests.size(), 2);
+    QCOMPARE(d->openRequests.at(0).payload, QByteArray::fromHex("0c06000500"));
+    QCOMPARE(d->openRequests.at(1).payload, QByteArray::fromHex("0a0900"));
+    d->openRequests.clear();
+
+    // Read Multiple splits the response by the fixed descriptor sizes
+    const QList<uint> cccdHandles = { 2 | (4 << 16), 5 | (7 << 16) };
+    d->processReply(readMultipleRequest(QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST,
+                                        cccdHandles),
+                    AttPduView(QByteArray::fromHex("0f01000200")));
+    QCOMPARE(cccdOf(uuidA), QByteArray::fromHex("0100"));
+    QCOMPARE(cccdOf(uuidB), QByteArray::fromHex("0200"));
+    QVERIFY(d->openRequests.isEmpty());
+
+    // a response of another size is repeated as single reads
+    d->processReply(readMultipleRequest(QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_REQUEST,
+                                        cccdHandles),
+                    AttPduView(QByteArray::fromHex("0f010002")));
+    QCOMPARE(cccdOf(uuidA), QByteArray::fromHex("0100"));
+    QCOMPARE(d->valueReadStatistics().fallbacks, stats.fallbacks + 1);
+    QCOMPARE(d->openRequests.size(), 2);
+    QCOMPARE(d->openRequests.at(0).payload, QByteArray::fromHex("0a0400"));
+    QCOMPARE(d->openRequests.at(1).payload, QByteArray::fromHex("0a0700"));
+    d->openRequests.clear();
+
+    // a rejected probe falls back to Read Multiple, the result is kept per peer
+    d->processReply(readMultipleRequest(
+                            QBluezConst::AttCommand::ATT_OP_READ_MULTIPLE_VARIABLE_REQUEST,
+                            { 2, 8 }),
+                    AttPduView(QByteArray::fromHex("01200200" "06")));
+    QVERIFY(!d->readMultipleVariableSupported);
+    QCOMPARE(d->valueReadStatistics().fallbacks, stats.fallbacks + 2);
+    QCOMPARE(d->openRequests.size(), 2);
+    d->openRequests.clear();
+    using Controller = QLowEnergyControllerPrivateBluez;
+    const QBluetoothAddress rejectingPeer(QStringLiteral("AA:BB:CC:DD:EE:02"));
+    const QBluetoothAddress supportingPeer(QStringLiteral("AA:BB:CC:DD:EE:03"));
+    QVERIFY(!Controller::knownReadMultipleVariableSupport(rejectingPeer));
+    Controller::storeReadMultipleVariableSupport(rejectingPeer, false);
+    Controller::storeReadMultipleVariableSupport(supportingPeer, true);
+    Controller::storeReadMultipleVariableSupport(QBluetoothAddress(), true);
+    QCOMPARE(Controller::knownReadMultipleVariableSupport(rejectingPeer), std::optional(false));
+    QCOMPARE(Controller::knownReadMultipleVariableSupport(supportingPeer), std::optional(true));
+    QVERIFY(!Controller::knownReadMultipleVariableSupport(QBluetoothAddress()));
+    d->readMultipleVariableSupported = true;
+
+    // The server answers 0x20 with the length of each complete value, cut off at the MTU
+    int central[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, central), 0);
+    const auto closePeer = qScopeGuard([&] { ::close(central[1]); });
+    d->setState(QLowEnergyController::AdvertisingState);
+    QVERIFY(d->acceptCentral(central[0], QBluetoothAddress(QStringLiteral("AA:BB:CC:DD:EE:01"))));
+    const auto sendPdu = [&central](const QByteArray &pdu) {
+        return ::send(central[1], pdu.constData(), pdu.size(), 0) == pdu.size();
+    };
+    QByteArray pdu;
+    QVERIFY(sendPdu(QByteArray::fromHex("20030009000600")));
+    QTRY_VERIFY(!(pdu = receivePdu(central[1])).isEmpty());
+    QCOMPARE(pdu, QByteArray::fromHex("21") + QByteArray::fromHex("0300") + valueA
+                     + QByteArray::fromHex("0100") + valueC
+                     + QByteArray::fromHex("1400") + valueB.left(23 - 1 - 5 - 3 - 2));
+    // at least two handles are required
+    QVERIFY(sendPdu(QByteArray::fromHex("200300")));
+    QTRY_VERIFY(!(pdu = receivePdu(central[1])).isEmpty());
+    QCOMPARE(quint8(pdu.at(0)), quint8(0x01));
+    QCOMPARE(quint8(pdu.at(1)), quint8(0x20));
+#else
+    QSKIP("Read multiple test only applicable for developer builds with BlueZ");
+#endif
+}
+
 void TestQLowEnergyControllerGattServer::serviceData()
 {
     QLowEnergyDescriptorData descData;
@@ -7,6 +7,9 @@
 #if QT_CONFIG(bluez)
 #include <QtBluetooth/private/bluez5_helper_p.h>
 #endif
+#if QT_CONFIG(bluez_le) && defined(QT_BUILD_INTERNAL)
+#include <QtBluetooth/private/qlowenergycontroller_bluezdbus_p.h>
+#endif
 #include <QBluetoothAddress>
 #include <QBluetoothLocalDevice>
 #include <QBluetoothDeviceDiscoveryAgent>
@@ -57,6 +60,7 @@ private slots:
     void tst_customProgrammableDevice();
     void tst_errorCases();
     void tst_rssiError();
+    void tst_dbusServiceDiscovery();
 private:
     void verifyServiceProperties(const QLowEnergyService *info);
     bool verifyClientCharacteristicValue(const QByteArray& value);
@@ -2816,6 +2820,79 @@ void tst_QLowEnergyController::tst_rssiError()
     QCOMPARE(central->error(), QLowEnergyController::Error::RssiReadError);
 }
 
+void tst_QLowEnergyController::tst_dbusServiceDiscovery()
+{
+#if QT_CONFIG(bluez_le) && defined(QT_BUILD_INTERNAL)
+    // Mocked org.bluez object tree with two devices on one adapter
+    const QString adapterPath = QStringLiteral("/org/bluez/hci0");
+    const QString devicePath = adapterPath + QStringLiteral("/dev_00_11_22_33_44_55");
+    const QString otherDevicePath = adapterPath + QStringLiteral("/dev_66_77_88_99_AA_BB");
+    const QString gattService = QStringLiteral("org.bluez.GattService1");
+
+    ManagedObjectList objects;
+    objects[QDBusObjectPath(adapterPath)][QStringLiteral("org.bluez.Adapter1")] = QVariantMap {
+        { QStringLiteral("Address"), QStringLiteral("00:00:00:00:00:01") }
+    };
+    objects[QDBusObjectPath(devicePath)][QStringLiteral("org.bluez.Device1")] = QVariantMap {
+        { QStringLiteral("UUIDs"), QStringList { QStringLiteral("0000180f-0000-1000-8000-00805f9b34fb") } }
+    };
+    objects[QDBusObjectPath(devicePath + QStringLiteral("/service000a"))][gattService] = QVariantMap {
+        { QStringLiteral("UUID"), QStringLiteral("0000180a-0000-1000-8000-00805f9b34fb") },
+        { QStringLiteral("Primary"), true }
+    };
+    objects[QDBusObjectPath(devicePath + QStringLiteral("/service000a/char000b"))]
+            [QStringLiteral("org.bluez.GattCharacteristic1")] = QVariantMap {
+        { QStringLiteral("UUID"), QStringLiteral("00002a29-0000-1000-8000-00805f9b34fb") }
+    };
+    objects[QDBusObjectPath(devicePath + QStringLiteral("/service0020"))][gattService] = QVariantMap {
+        { QStringLiteral("UUID"), QStringLiteral("f000aa00-0451-4000-b000-000000000000") },
+        { QStringLiteral("Primary"), false }
+    };
+    objects[QDBusObjectPath(otherDevicePath + QStringLiteral("/service000a"))][gattService] =
+            QVariantMap {
+        { QStringLiteral("UUID"), QStringLiteral("00001800-0000-1000-8000-00805f9b34fb") },
+        { QStringLiteral("Primary"), true }
+    };
+
+    using Controller = QLowEnergyControllerPrivateBluezDBus;
+
+    // Battery service is only listed by Device1 and has to be emulated via Battery1
+    QList<Controller::DiscoveredService> services =
+            Controller::servicesFromManagedObjects(objects, devicePath);
+    QCOMPARE(services.size(), 3);
+    QCOMPARE(services.at(0).uuid, QBluetoothUuid(QBluetoothUuid::ServiceClassUuid::DeviceInformation));
+    QCOMPARE(services.at(0).path, devicePath + QStringLiteral("/service000a"));
+    QCOMPARE(services.at(0).type, QLowEnergyService::PrimaryService);
+    QVERIFY(!services.at(0).hasBatteryService);
+    QCOMPARE(services.at(1).uuid, QBluetoothUuid(QStringLiteral("f000aa00-0451-4000-b000-000000000000")));
+    QCOMPARE(services.at(1).type, QLowEnergyService::IncludedService);
+    QCOMPARE(services.at(2).uuid, QBluetoothUuid(QBluetoothUuid::ServiceClassUuid::BatteryService));
+    QCOMPARE(services.at(2).path, devicePath);
+    QVERIFY(services.at(2).hasBatteryService);
+
+    // A generic battery service takes precedence over the Battery1 interface
+    objects[QDBusObjectPath(devicePath)][QStringLiteral("org.bluez.Battery1")] = QVariantMap();
+    objects[QDBusObjectPath(devicePath + QStringLiteral("/service0030"))][gattService] = QVariantMap {
+        { QStringLiteral("UUID"), QStringLiteral("0000180f-0000-1000-8000-00805f9b34fb") },
+        { QStringLiteral("Primary"), true }
+    };
+    services = Controller::servicesFromManagedObjects(objects, devicePath);
+    QCOMPARE(services.size(), 3);
+    QCOMPARE(services.at(2).uuid, QBluetoothUuid(QBluetoothUuid::ServiceClassUuid::BatteryService));
+    QCOMPARE(services.at(2).path, devicePath + QStringLiteral("/service0030"));
+    QVERIFY(!services.at(2).hasBatteryService);
+
+    services = Controller::servicesFromManagedObjects(objects, otherDevicePath);
+    QCOMPARE(services.size(), 1);
+    QCOMPARE(services.at(0).uuid, QBluetoothUuid(QBluetoothUuid::ServiceClassUuid::GenericAccess));
+
+    QVERIFY(Controller::servicesFromManagedObjects(objects,
+                QStringLiteral("/org/bluez/hci1/dev_00_11_22_33_44_55")).isEmpty());
+#else
+    QSKIP("Requires the BlueZ DBus backend and a developer build");
+#endif
+}
+
 QTEST_MAIN(tst_QLowEnergyController)
 
 #include "tst_qlowenergycontroller.moc"